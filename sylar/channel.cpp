@@ -0,0 +1,253 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 11:20:43
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 11:20:43
+ * @FilePath: /sylar-wxb/sylar/channel.cpp
+ * @Description: 协程间的有界通道(Channel)和多路选择(Select)
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include "channel.h"
+#include "iomanager.h"
+#include "macro.h"
+#include "scheduler.h"
+#include "util.h"
+
+namespace sylar {
+
+void ChannelWaitList::push(ChannelWaiter* w)
+{
+  w->prev = tail_;
+  w->next = nullptr;
+  if(tail_) tail_->next = w;
+  else head_ = w;
+  tail_ = w;
+  w->linked = true;
+}
+
+void ChannelWaitList::remove(ChannelWaiter* w)
+{
+  if(w->prev) w->prev->next = w->next;
+  else head_ = w->next;
+  if(w->next) w->next->prev = w->prev;
+  else tail_ = w->prev;
+  w->prev = w->next = nullptr;
+  w->linked = false;
+}
+
+ChannelWaiter* ChannelWaitList::pop()
+{
+  ChannelWaiter* w = head_;
+  remove(w);
+  return w;
+}
+
+ChannelBase::ChannelBase(size_t capacity)
+  :capacity_(capacity)
+{
+}
+
+ChannelBase::~ChannelBase()
+{
+  SYLAR_ASSERT(recvq_.empty() && sendq_.empty());
+}
+
+bool ChannelBase::Claim(ChannelWaitState* state)
+{
+  int expect = ChannelWaitState::WAITING;
+  return state->state.compare_exchange_strong(expect, ChannelWaitState::WOKEN);
+}
+
+void ChannelBase::Wake(ChannelWaitState* state)
+{
+  // 被抢占时协程可能还没让出，调度器会跳过仍处于EXEC状态的协程
+  state->scheduler->schedule(state->fiber);
+}
+
+void ChannelBase::close()
+{
+  std::vector<ChannelWaitState*> states;
+  Spinlock::Lock lock(mutex_);
+  closed_ = true;
+  while(!recvq_.empty())
+  {
+    ChannelWaiter* w = recvq_.pop();
+    --recvWaiting_;
+    if(Claim(w->state))
+    {
+      states.push_back(w->state);
+    }
+  }
+  while(!sendq_.empty())
+  {
+    ChannelWaiter* w = sendq_.pop();
+    --sendWaiting_;
+    if(Claim(w->state))
+    {
+      states.push_back(w->state);
+    }
+  }
+  lock.unlock();
+  for(auto state : states)
+  {
+    Wake(state);
+  }
+}
+
+void ChannelBase::addWaiter(bool send, ChannelWaiter* w, ChannelWaitState* state, const void* src)
+{
+  w->state = state;
+  w->src = src;
+  w->done = false;
+  ChannelWaitState* woken = nullptr;
+  Spinlock::Lock lock(mutex_);
+  if(send)
+  {
+    sendq_.push(w);
+    ++sendWaiting_;
+    if(src) // 无缓冲的发送要有接收方来取
+    {
+      woken = popWaiter(false);
+    }
+  }
+  else
+  {
+    recvq_.push(w);
+    ++recvWaiting_;
+  }
+  lock.unlock();
+  if(woken)
+  {
+    Wake(woken);
+  }
+}
+
+void ChannelBase::removeWaiter(bool send, ChannelWaiter* w)
+{
+  Spinlock::Lock lock(mutex_);
+  if(!w->linked)
+  {
+    return;
+  }
+  if(send)
+  {
+    sendq_.remove(w);
+    --sendWaiting_;
+  }
+  else
+  {
+    recvq_.remove(w);
+    --recvWaiting_;
+  }
+}
+
+ChannelWaitState* ChannelBase::popWaiter(bool send)
+{
+  ChannelWaitList& list = send ? sendq_ : recvq_;
+  std::atomic<size_t>& count = send ? sendWaiting_ : recvWaiting_;
+  while(!list.empty())
+  {
+    ChannelWaiter* w = list.front();
+    if(w->src) // 无缓冲的发送方只能由接收方取值后唤醒
+    {
+      return nullptr;
+    }
+    list.pop();
+    --count;
+    if(Claim(w->state)) // 失败说明它已被别的通道或超时唤醒，继续找下一个
+    {
+      return w->state;
+    }
+  }
+  return nullptr;
+}
+
+int ChannelBase::Wait(ChannelCase** cases, size_t count, uint64_t timeout_ms)
+{
+  uint64_t deadline = timeout_ms == ~0ull ? ~0ull : GetCurrentMS() + timeout_ms;
+  while(true)
+  {
+    for(size_t i = 0; i < count; ++i)
+    {
+      if(cases[i]->tryOp())
+      {
+        return i;
+      }
+    }
+    uint64_t now = deadline == ~0ull ? 0 : GetCurrentMS();
+    if(deadline != ~0ull && now >= deadline)
+    {
+      return -1;
+    }
+
+    SYLAR_ASSERT(Scheduler::GetThis());
+    // 超时回调可能在本函数返回后才执行，这时只能用堆上的状态
+    std::shared_ptr<ChannelWaitState> state(new ChannelWaitState);
+    state->scheduler = Scheduler::GetThis();
+    state->fiber = Fiber::GetThis();
+    for(size_t i = 0; i < count; ++i)
+    {
+      cases[i]->enqueue(state.get());
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst); // 和快路径的"先操作再检查等待者"配对
+
+    bool ready = false;
+    for(size_t i = 0; i < count && !ready; ++i)
+    {
+      ready = cases[i]->ready();
+    }
+    Timer::ptr timer;
+    if(!ready || !Claim(state.get())) // 自己抢到就不用挂起，直接重试
+    {
+      if(!ready && deadline != ~0ull)
+      {
+        IOManager* iom = IOManager::GetThis();
+        SYLAR_ASSERT(iom);
+        timer = iom->addTimer(deadline - now, [state]()
+        {
+          if(Claim(state.get()))
+          {
+            state->timeout = true;
+            Wake(state.get());
+          }
+        });
+      }
+      Fiber::YieldToHold();
+      if(timer)
+      {
+        timer->cancel();
+      }
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+      cases[i]->dequeue();
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+      if(cases[i]->done()) // 值已被接收方取走
+      {
+        cases[i]->setOk(true);
+        return i;
+      }
+    }
+    if(state->timeout)
+    {
+      return -1;
+    }
+  }
+}
+
+int Select::wait(uint64_t timeout_ms)
+{
+  std::vector<ChannelCase*> cases;
+  cases.reserve(cases_.size());
+  for(auto& i : cases_)
+  {
+    cases.push_back(i.get());
+  }
+  return ChannelBase::Wait(cases.data(), cases.size(), timeout_ms);
+}
+
+} // namespace sylar
@@ -0,0 +1,612 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 11:20:43
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 11:20:43
+ * @FilePath: /sylar-wxb/sylar/channel.h
+ * @Description: 协程间的有界通道(Channel)和多路选择(Select)，满/空时挂起协程而不阻塞线程
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "fiber.h"
+#include "mutex.h"
+#include "noncopyable.h"
+
+namespace sylar {
+
+class Scheduler;
+
+/**
+ * @brief 一次挂起等待(send/recv/Select::wait)的状态，挂在多个通道上时共享
+ */
+struct ChannelWaitState
+{
+  enum State
+  {
+    /// 等待中
+    WAITING = 0,
+    /// 已被某个通道、关闭或超时唤醒
+    WOKEN = 1
+  };
+  /// 只有把WAITING改成WOKEN的一方可以唤醒协程
+  std::atomic<int> state = {WAITING};
+  /// 唤醒时调度回的调度器
+  Scheduler* scheduler = nullptr;
+  /// 等待的协程
+  Fiber::ptr fiber;
+  /// 是否是超时唤醒
+  bool timeout = false;
+};
+
+/**
+ * @brief 挂在一个通道等待队列上的节点
+ */
+struct ChannelWaiter
+{
+  /// 所属的等待
+  ChannelWaitState* state = nullptr;
+  /// 无缓冲通道上发送方待取走的值
+  const void* src = nullptr;
+  /// src已被接收方取走
+  bool done = false;
+  /// 是否在队列中
+  bool linked = false;
+  ChannelWaiter* prev = nullptr;
+  ChannelWaiter* next = nullptr;
+};
+
+/**
+ * @brief 双向链表实现的等待队列，节点可以从任意位置摘除(需在通道锁内使用)
+ */
+class ChannelWaitList
+{
+public:
+  bool empty() const { return !head_;}
+  ChannelWaiter* front() const { return head_;}
+  void push(ChannelWaiter* w);
+  void remove(ChannelWaiter* w);
+  ChannelWaiter* pop();
+private:
+  ChannelWaiter* head_ = nullptr;
+  ChannelWaiter* tail_ = nullptr;
+};
+
+/**
+ * @brief Select的一个分支
+ */
+class ChannelCase : Noncopyable
+{
+public:
+  ChannelCase(bool* ok) : ok_(ok) {}
+  virtual ~ChannelCase() {}
+
+  /**
+   * @brief 不挂起地尝试一次，完成(包括通道已关闭)返回true
+   */
+  virtual bool tryOp() = 0;
+
+  /**
+   * @brief 把本分支挂到通道的等待队列上
+   */
+  virtual void enqueue(ChannelWaitState* state) = 0;
+
+  /**
+   * @brief 挂上以后再检查一次是否已经可以完成，避免漏掉挂上之前发生的事件
+   */
+  virtual bool ready() = 0;
+
+  /**
+   * @brief 从通道的等待队列上摘下
+   */
+  virtual void dequeue() = 0;
+
+  /**
+   * @brief 挂起期间值已被接收方直接取走(无缓冲通道的发送)
+   */
+  bool done() const { return node_.done;}
+
+  void setOk(bool v) { if(ok_) *ok_ = v;}
+protected:
+  ChannelWaiter node_;
+  bool* ok_;
+};
+
+/**
+ * @brief 通道中与元素类型无关的部分：等待队列、关闭和挂起/唤醒
+ */
+class ChannelBase : Noncopyable
+{
+public:
+  /**
+   * @brief 容量，0表示无缓冲
+   */
+  size_t getCapacity() const { return capacity_;}
+
+  /**
+   * @brief 是否已关闭
+   */
+  bool isClosed() const { return closed_;}
+
+  /**
+   * @brief 关闭通道，唤醒所有等待者。关闭后发送失败，接收取完剩余元素后失败
+   */
+  void close();
+
+  /**
+   * @brief 等待多个分支中的一个完成
+   * @param[in] cases 分支
+   * @param[in] count 分支个数
+   * @param[in] timeout_ms 超时时间(毫秒)，~0ull表示不超时，0表示不挂起
+   * @return 完成的分支下标，超时返回-1
+   */
+  static int Wait(ChannelCase** cases, size_t count, uint64_t timeout_ms);
+protected:
+  ChannelBase(size_t capacity);
+  ~ChannelBase();
+
+  /**
+   * @brief 挂上等待节点，src不为空时是无缓冲通道的发送，同时叫醒一个接收方来取
+   */
+  void addWaiter(bool send, ChannelWaiter* w, ChannelWaitState* state, const void* src);
+
+  /**
+   * @brief 摘下等待节点(已被唤醒方摘下时什么都不做)
+   */
+  void removeWaiter(bool send, ChannelWaiter* w);
+
+  /**
+   * @brief 摘下并抢占一个等待者(需持有mutex_)，返回值在释放锁后交给Wake
+   * @details 在锁内唤醒会让被唤醒的线程抢占持锁线程后空转，所以都放到锁外
+   */
+  ChannelWaitState* popWaiter(bool send);
+
+  /**
+   * @brief 取走一个无缓冲发送方的值(需持有mutex_)，返回值在释放锁后交给Wake
+   * @param[in] take 拷贝值的函数
+   */
+  template<class Fn>
+  ChannelWaitState* takeOffer(Fn take)
+  {
+    while(!sendq_.empty())
+    {
+      ChannelWaiter* w = sendq_.pop();
+      --sendWaiting_;
+      if(Claim(w->state))
+      {
+        take(w->src);
+        w->done = true;
+        return w->state;
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * @brief 抢占等待状态，成功的一方负责唤醒
+   */
+  static bool Claim(ChannelWaitState* state);
+
+  /**
+   * @brief 唤醒等待的协程
+   */
+  static void Wake(ChannelWaitState* state);
+protected:
+  /// 容量
+  size_t capacity_;
+  /// 是否已关闭
+  std::atomic<bool> closed_ = {false};
+  /// 保护等待队列
+  Spinlock mutex_;
+  /// 等待接收的队列
+  ChannelWaitList recvq_;
+  /// 等待发送的队列
+  ChannelWaitList sendq_;
+  /// recvq_中的节点数，快路径上无锁读取
+  std::atomic<size_t> recvWaiting_ = {0};
+  /// sendq_中的节点数，快路径上无锁读取
+  std::atomic<size_t> sendWaiting_ = {0};
+};
+
+/**
+ * @brief 协程通道
+ * @details 有缓冲时元素存放在无锁的有界环形队列(MPMC，SPSC/MPSC同样适用)中，
+ *          只有队列满/空需要挂起或有等待者需要唤醒时才加锁；
+ *          无缓冲时发送方挂起直到接收方把值取走
+ */
+template<class T>
+class Channel : public ChannelBase
+{
+public:
+  typedef std::shared_ptr<Channel> ptr;
+
+  /**
+   * @brief 构造函数
+   * @param[in] capacity 缓冲区大小，0表示无缓冲
+   */
+  Channel(size_t capacity = 0)
+    :ChannelBase(capacity)
+  {
+    if(capacity_)
+    {
+      cells_.reset(new Cell[capacity_]);
+      for(size_t i = 0; i < capacity_; ++i)
+      {
+        cells_[i].seq.store(2 * i, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief 发送，缓冲区满时挂起
+   * @return 通道已关闭返回false
+   */
+  bool send(const T& v)
+  {
+    bool closed = false;
+    if(trySendNoWait(v, closed))
+    {
+      return true;
+    }
+    if(closed)
+    {
+      return false;
+    }
+    bool ok = false;
+    SendCase c(*this, v, &ok);
+    ChannelCase* cases[] = {&c};
+    Wait(cases, 1, ~0ull);
+    return ok;
+  }
+
+  /**
+   * @brief 接收，缓冲区空时挂起
+   * @return 通道已关闭且没有剩余元素返回false
+   */
+  bool recv(T& v)
+  {
+    return recv(v, ~0ull);
+  }
+
+  /**
+   * @brief 带超时的接收
+   * @param[in] timeout_ms 超时时间(毫秒)
+   * @return 超时或通道已关闭且没有剩余元素返回false
+   */
+  bool recv(T& v, uint64_t timeout_ms)
+  {
+    bool closed = false;
+    if(tryRecvNoWait(v, closed))
+    {
+      return true;
+    }
+    if(closed)
+    {
+      return false;
+    }
+    bool ok = false;
+    RecvCase c(*this, v, &ok);
+    ChannelCase* cases[] = {&c};
+    return Wait(cases, 1, timeout_ms) == 0 && ok;
+  }
+
+  /**
+   * @brief 不挂起地发送，缓冲区满、无缓冲或已关闭时返回false
+   */
+  bool trySend(const T& v)
+  {
+    bool closed = false;
+    return trySendNoWait(v, closed);
+  }
+
+  /**
+   * @brief 不挂起地接收
+   */
+  bool tryRecv(T& v)
+  {
+    bool closed = false;
+    return tryRecvNoWait(v, closed);
+  }
+
+  /**
+   * @brief 缓冲区中的元素个数(近似值)
+   */
+  size_t size() const
+  {
+    size_t e = enqueuePos_.load(std::memory_order_relaxed);
+    size_t d = dequeuePos_.load(std::memory_order_relaxed);
+    return e > d ? e - d : 0;
+  }
+
+  /**
+   * @brief 接收分支
+   */
+  class RecvCase : public ChannelCase
+  {
+  public:
+    RecvCase(Channel& ch, T& out, bool* ok) : ChannelCase(ok), ch_(ch), out_(out) {}
+    bool tryOp() override
+    {
+      bool closed = false;
+      if(ch_.tryRecvNoWait(out_, closed))
+      {
+        setOk(true);
+        return true;
+      }
+      if(closed)
+      {
+        setOk(false);
+        return true;
+      }
+      return false;
+    }
+    void enqueue(ChannelWaitState* state) override { ch_.addWaiter(false, &node_, state, nullptr);}
+    bool ready() override { return ch_.recvReady();}
+    void dequeue() override { ch_.removeWaiter(false, &node_);}
+  private:
+    Channel& ch_;
+    T& out_;
+  };
+
+  /**
+   * @brief 发送分支
+   */
+  class SendCase : public ChannelCase
+  {
+  public:
+    SendCase(Channel& ch, const T& v, bool* ok) : ChannelCase(ok), ch_(ch), v_(v) {}
+    bool tryOp() override
+    {
+      bool closed = false;
+      if(ch_.trySendNoWait(v_, closed))
+      {
+        setOk(true);
+        return true;
+      }
+      if(closed)
+      {
+        setOk(false);
+        return true;
+      }
+      return false;
+    }
+    void enqueue(ChannelWaitState* state) override
+    {
+      ch_.addWaiter(true, &node_, state, ch_.capacity_ ? nullptr : &v_);
+    }
+    bool ready() override { return ch_.sendReady();}
+    void dequeue() override { ch_.removeWaiter(true, &node_);}
+  private:
+    Channel& ch_;
+    const T& v_;
+  };
+private:
+  bool trySendNoWait(const T& v, bool& closed)
+  {
+    if(closed_)
+    {
+      closed = true;
+      return false;
+    }
+    if(!capacity_ || !push(v))
+    {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst); // 和等待方的"先挂上再检查"配对
+    if(recvWaiting_.load(std::memory_order_relaxed))
+    {
+      Spinlock::Lock lock(mutex_);
+      ChannelWaitState* state = popWaiter(false);
+      lock.unlock();
+      if(state)
+      {
+        Wake(state);
+      }
+    }
+    return true;
+  }
+
+  bool tryRecvNoWait(T& v, bool& closed)
+  {
+    if(capacity_)
+    {
+      if(pop(v))
+      {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(sendWaiting_.load(std::memory_order_relaxed))
+        {
+          Spinlock::Lock lock(mutex_);
+          ChannelWaitState* state = popWaiter(true);
+          lock.unlock();
+          if(state)
+          {
+            Wake(state);
+          }
+        }
+        return true;
+      }
+    }
+    else if(sendWaiting_.load())
+    {
+      Spinlock::Lock lock(mutex_);
+      ChannelWaitState* state = takeOffer([&v](const void* src) { v = *(const T*)src;});
+      lock.unlock();
+      if(state)
+      {
+        Wake(state);
+        return true;
+      }
+    }
+    if(closed_)
+    {
+      // 关闭前发送的元素仍然要取完
+      if(capacity_ && pop(v))
+      {
+        return true;
+      }
+      closed = true;
+    }
+    return false;
+  }
+
+  bool recvReady() const
+  {
+    if(closed_)
+    {
+      return true;
+    }
+    if(!capacity_)
+    {
+      return sendWaiting_.load() > 0;
+    }
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    return cells_[pos % capacity_].seq.load(std::memory_order_acquire) == 2 * pos + 1;
+  }
+
+  bool sendReady() const
+  {
+    if(closed_)
+    {
+      return true;
+    }
+    if(!capacity_)
+    {
+      return false;
+    }
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    return cells_[pos % capacity_].seq.load(std::memory_order_acquire) == 2 * pos;
+  }
+
+  /**
+   * @brief 无锁入队(Vyukov有界队列)
+   * @details 位置pos可写时格子的seq为2*pos，写入后为2*pos+1，
+   *          读出后改为2*(pos+capacity)留给下一轮；乘2是为了容量为1时两种状态不重叠
+   */
+  bool push(const T& v)
+  {
+    Cell* cell;
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    while(true)
+    {
+      cell = &cells_[pos % capacity_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)(2 * pos);
+      if(dif == 0)
+      {
+        if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if(dif < 0) // 满
+      {
+        return false;
+      }
+      else
+      {
+        pos = enqueuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = v;
+    cell->seq.store(2 * pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief 无锁出队
+   */
+  bool pop(T& v)
+  {
+    Cell* cell;
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    while(true)
+    {
+      cell = &cells_[pos % capacity_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t dif = (intptr_t)seq - (intptr_t)(2 * pos + 1);
+      if(dif == 0)
+      {
+        if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if(dif < 0) // 空
+      {
+        return false;
+      }
+      else
+      {
+        pos = dequeuePos_.load(std::memory_order_relaxed);
+      }
+    }
+    v = std::move(cell->data);
+    cell->seq.store(2 * (pos + capacity_), std::memory_order_release);
+    return true;
+  }
+private:
+  struct Cell
+  {
+    std::atomic<size_t> seq;
+    T data;
+  };
+  /// 环形缓冲区
+  std::unique_ptr<Cell[]> cells_;
+  /// 下一个写入位置
+  alignas(64) std::atomic<size_t> enqueuePos_ = {0};
+  /// 下一个读取位置
+  alignas(64) std::atomic<size_t> dequeuePos_ = {0};
+};
+
+/**
+ * @brief 多路选择，在多个通道的收发和超时中等待最先完成的一个
+ * @code
+ *   int v;
+ *   bool ok;
+ *   switch(Select().recv(ch1, v, &ok).send(ch2, 1).wait(100)) { ... }
+ * @endcode
+ */
+class Select : Noncopyable
+{
+public:
+  /**
+   * @brief 添加接收分支
+   * @param[out] ok 接收到值为true，通道已关闭为false
+   */
+  template<class T>
+  Select& recv(Channel<T>& ch, T& out, bool* ok = nullptr)
+  {
+    cases_.emplace_back(new typename Channel<T>::RecvCase(ch, out, ok));
+    return *this;
+  }
+
+  /**
+   * @brief 添加发送分支，v在wait返回前必须有效
+   * @param[out] ok 发送成功为true，通道已关闭为false
+   */
+  template<class T>
+  Select& send(Channel<T>& ch, const T& v, bool* ok = nullptr)
+  {
+    cases_.emplace_back(new typename Channel<T>::SendCase(ch, v, ok));
+    return *this;
+  }
+
+  /**
+   * @brief 等待一个分支完成
+   * @param[in] timeout_ms 超时时间(毫秒)，~0ull不超时，0不挂起
+   * @return 分支下标(按添加顺序)，超时返回-1
+   */
+  int wait(uint64_t timeout_ms = ~0ull);
+private:
+  std::vector<std::unique_ptr<ChannelCase> > cases_;
+};
+
+} // namespace sylar
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:05:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:05:37
+ * @FilePath: /sylar-wxb/sylar/co/io.cpp
+ * @Description: 可co_await的io就绪、定时睡眠和Socket收发
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <errno.h>
+
+#include "co/io.h"
+#include "hook.h"
+#include "log.h"
+#include "macro.h"
+
+namespace sylar {
+namespace co {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+/**
+ * @brief 独立运行的外壳协程：开始时挂起等调度器恢复，结束时自行销毁
+ */
+struct Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object()
+    {
+      return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {};}
+    std::suspend_never final_suspend() noexcept { return {};}
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+static Detached RunDetached(Task<void> task)
+{
+  try
+  {
+    co_await task;
+  }
+  catch(std::exception& ex)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "co::Spawn task except: " << ex.what();
+  }
+  catch(...)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "co::Spawn task except";
+  }
+}
+
+void Spawn(Scheduler* scheduler, Task<void> task)
+{
+  std::coroutine_handle<> h = RunDetached(std::move(task)).handle;
+  scheduler->schedule([h]() { h.resume();});
+}
+
+bool EventAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+  IOManager* iom = IOManager::GetThis();
+  SYLAR_ASSERT(iom);
+  if(timeoutMs_ == ~0ull)
+  {
+    handle_ = h;
+    // 返回0后回调可能已经在别的线程恢复了协程，之后不能再访问成员
+    int rt = iom->addEvent(fd_, event_, [this]() { handle_.resume();});
+    if(rt)
+    {
+      error_ = errno;
+      return false;
+    }
+    return true;
+  }
+
+  // 局部的shared_ptr保证协程在别的线程恢复并销毁帧后状态仍然有效
+  std::shared_ptr<TimedState> state(new TimedState);
+  state->handle = h;
+  state_ = state;
+  int fd = fd_;
+  IOManager::Event event = event_;
+  int rt = iom->addEvent(fd, event, [state]()
+  {
+    int expect = 0;
+    state->result.compare_exchange_strong(expect, 1); // 失败说明是超时取消触发的
+    if(--state->pending == 0)
+    {
+      state->handle.resume();
+    }
+  });
+  if(rt)
+  {
+    error_ = errno;
+    return false;
+  }
+  state->timer = iom->addTimer(timeoutMs_, [state, iom, fd, event]()
+  {
+    int expect = 0;
+    if(state->result.compare_exchange_strong(expect, ETIMEDOUT))
+    {
+      iom->cancelEvent(fd, event);
+    }
+  });
+  return --state->pending != 0; // 事件已经触发则直接继续
+}
+
+int EventAwaiter::await_resume()
+{
+  if(error_)
+  {
+    return error_;
+  }
+  if(state_)
+  {
+    state_->timer->cancel();
+    return state_->result == ETIMEDOUT ? ETIMEDOUT : 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief 执行原始io，返回EAGAIN时等待事件后重试
+ */
+template<class Fn>
+static Task<ssize_t> DoIo(int fd, IOManager::Event event, uint64_t timeout_ms, Fn fn)
+{
+  while(true)
+  {
+    ssize_t n = fn();
+    if(n >= 0 || errno != EAGAIN)
+    {
+      if(n < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      co_return n;
+    }
+    int err = co_await EventAwaiter(fd, event, timeout_ms);
+    if(err)
+    {
+      errno = err;
+      co_return -1;
+    }
+  }
+}
+
+Task<ssize_t> Read(int fd, void* buf, size_t len, uint64_t timeout_ms)
+{
+  return DoIo(fd, IOManager::READ, timeout_ms, [=]() { return read_f(fd, buf, len);});
+}
+
+Task<ssize_t> Write(int fd, const void* buf, size_t len, uint64_t timeout_ms)
+{
+  return DoIo(fd, IOManager::WRITE, timeout_ms, [=]() { return write_f(fd, buf, len);});
+}
+
+Task<ssize_t> Recv(Socket::ptr sock, void* buf, size_t len, int flags)
+{
+  if(!sock->isConnected())
+  {
+    co_return -1;
+  }
+  int fd = sock->getSocket();
+  co_return co_await DoIo(fd, IOManager::READ, sock->getRecvTimeout(),
+      [=]() { return recv_f(fd, buf, len, flags);});
+}
+
+Task<ssize_t> Send(Socket::ptr sock, const void* buf, size_t len, int flags)
+{
+  if(!sock->isConnected())
+  {
+    co_return -1;
+  }
+  int fd = sock->getSocket();
+  co_return co_await DoIo(fd, IOManager::WRITE, sock->getSendTimeout(),
+      [=]() { return send_f(fd, buf, len, flags);});
+}
+
+} // namespace co
+} // namespace sylar
@@ -0,0 +1,146 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:05:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:05:37
+ * @FilePath: /sylar-wxb/sylar/co/io.h
+ * @Description: 可co_await的io就绪、定时睡眠和Socket收发，直接使用原始系统调用，不经过hook挂起协程(需要SYLAR_COROUTINE=ON)
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef CO_IO_H
+#define CO_IO_H
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <memory>
+#include <sys/types.h>
+
+#include "co/task.h"
+#include "iomanager.h"
+#include "socket.h"
+
+namespace sylar {
+namespace co {
+
+/**
+ * @brief 等待fd读写就绪
+ * @details 回调由IOManager触发事件时调度执行，在回调里恢复协程；
+ *          不带超时时等待状态全部放在协程帧里，不分配内存
+ */
+class EventAwaiter
+{
+public:
+  /**
+   * @param[in] timeout_ms 超时时间(毫秒)，~0ull表示不超时
+   */
+  EventAwaiter(int fd, IOManager::Event event, uint64_t timeout_ms = ~0ull)
+    :fd_(fd), event_(event), timeoutMs_(timeout_ms) {}
+
+  bool await_ready() const { return false;}
+
+  bool await_suspend(std::coroutine_handle<> h);
+
+  /**
+   * @return 就绪返回0，超时返回ETIMEDOUT，注册失败返回errno
+   */
+  int await_resume();
+private:
+  /**
+   * @brief 带超时的等待状态：定时器回调可能在协程恢复之后才执行，只能放在堆上
+   */
+  struct TimedState
+  {
+    /// 0等待中，1已就绪，ETIMEDOUT已超时
+    std::atomic<int> result = {0};
+    /// 事件注册和定时器设置都完成后才能恢复协程
+    std::atomic<int> pending = {2};
+    std::coroutine_handle<> handle;
+    Timer::ptr timer;
+  };
+private:
+  int fd_;
+  IOManager::Event event_;
+  uint64_t timeoutMs_;
+  int error_ = 0;
+  std::coroutine_handle<> handle_;
+  std::shared_ptr<TimedState> state_;
+};
+
+/**
+ * @brief 等待fd可读
+ */
+inline EventAwaiter Readable(int fd, uint64_t timeout_ms = ~0ull)
+{
+  return EventAwaiter(fd, IOManager::READ, timeout_ms);
+}
+
+/**
+ * @brief 等待fd可写
+ */
+inline EventAwaiter Writable(int fd, uint64_t timeout_ms = ~0ull)
+{
+  return EventAwaiter(fd, IOManager::WRITE, timeout_ms);
+}
+
+/**
+ * @brief 睡眠，到期后由定时器回调恢复协程
+ */
+class SleepAwaiter
+{
+public:
+  explicit SleepAwaiter(uint64_t us) : us_(us) {}
+
+  bool await_ready() const { return false;}
+
+  void await_suspend(std::coroutine_handle<> h) const
+  {
+    IOManager::GetThis()->addTimerUs(us_, [h]() { h.resume();});
+  }
+
+  void await_resume() const {}
+private:
+  uint64_t us_;
+};
+
+inline SleepAwaiter SleepUs(uint64_t us) { return SleepAwaiter(us);}
+
+inline SleepAwaiter Sleep(uint64_t ms) { return SleepAwaiter(ms * 1000);}
+
+template<class Rep, class Period>
+SleepAwaiter Sleep(std::chrono::duration<Rep, Period> d)
+{
+  int64_t us = std::chrono::ceil<std::chrono::microseconds>(d).count();
+  return SleepAwaiter(us > 0 ? us : 0);
+}
+
+/**
+ * @brief 读fd，未就绪时挂起等待
+ * @param[in] timeout_ms 每次等待的超时时间(毫秒)，~0ull表示不超时
+ * @return 同read，超时返回-1且errno为ETIMEDOUT
+ */
+Task<ssize_t> Read(int fd, void* buf, size_t len, uint64_t timeout_ms = ~0ull);
+
+/**
+ * @brief 写fd，未就绪时挂起等待
+ * @return 同write，超时返回-1且errno为ETIMEDOUT
+ */
+Task<ssize_t> Write(int fd, const void* buf, size_t len, uint64_t timeout_ms = ~0ull);
+
+/**
+ * @brief Socket接收，超时使用Socket的接收超时
+ * @return 同Socket::recv
+ */
+Task<ssize_t> Recv(Socket::ptr sock, void* buf, size_t len, int flags = 0);
+
+/**
+ * @brief Socket发送，超时使用Socket的发送超时
+ * @return 同Socket::send
+ */
+Task<ssize_t> Send(Socket::ptr sock, const void* buf, size_t len, int flags = 0);
+
+} // namespace co
+} // namespace sylar
+
+#endif
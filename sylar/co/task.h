@@ -0,0 +1,184 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:05:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:05:37
+ * @FilePath: /sylar-wxb/sylar/co/task.h
+ * @Description: C++20无栈协程任务类型，协程帧通过Scheduler::schedule恢复(需要SYLAR_COROUTINE=ON)
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef CO_TASK_H
+#define CO_TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+#include "scheduler.h"
+
+namespace sylar {
+namespace co {
+
+template<class T>
+class Task;
+
+/**
+ * @brief Task的promise中与返回值无关的部分
+ */
+class PromiseBase
+{
+public:
+  /**
+   * @brief 结束时对称转移到等待者，没有等待者则停在终点由Task析构销毁
+   */
+  struct FinalAwaiter
+  {
+    bool await_ready() noexcept { return false;}
+
+    template<class Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+    {
+      std::coroutine_handle<> next = h.promise().continuation_;
+      return next ? next : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_always initial_suspend() noexcept { return {};}
+  FinalAwaiter final_suspend() noexcept { return {};}
+  void unhandled_exception() { exception_ = std::current_exception();}
+
+  void setContinuation(std::coroutine_handle<> h) { continuation_ = h;}
+
+  void rethrow()
+  {
+    if(exception_)
+    {
+      std::rethrow_exception(exception_);
+    }
+  }
+private:
+  /// co_await本任务的协程
+  std::coroutine_handle<> continuation_;
+  /// 协程体抛出的异常
+  std::exception_ptr exception_;
+};
+
+template<class T>
+class Promise : public PromiseBase
+{
+public:
+  Task<T> get_return_object();
+
+  template<class V>
+  void return_value(V&& v) { value_ = std::forward<V>(v);}
+
+  T& result()
+  {
+    rethrow();
+    return value_;
+  }
+private:
+  T value_{};
+};
+
+template<>
+class Promise<void> : public PromiseBase
+{
+public:
+  Task<void> get_return_object();
+  void return_void() {}
+  void result() { rethrow();}
+};
+
+/**
+ * @brief 惰性启动的协程任务：被co_await时才开始执行，执行完恢复等待者
+ * @details 只能移动；独立运行的任务用Spawn交给调度器
+ */
+template<class T = void>
+class Task
+{
+public:
+  typedef Promise<T> promise_type;
+  typedef std::coroutine_handle<promise_type> handle_type;
+
+  Task() {}
+  explicit Task(handle_type h) : handle_(h) {}
+  Task(Task&& o) : handle_(std::exchange(o.handle_, nullptr)) {}
+  Task& operator=(Task&& o)
+  {
+    if(this != &o)
+    {
+      reset();
+      handle_ = std::exchange(o.handle_, nullptr);
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() { reset();}
+
+  bool await_ready() const { return !handle_ || handle_.done();}
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h)
+  {
+    handle_.promise().setContinuation(h);
+    return handle_;
+  }
+
+  decltype(auto) await_resume() { return handle_.promise().result();}
+
+  /**
+   * @brief 交出协程句柄的所有权
+   */
+  handle_type release() { return std::exchange(handle_, nullptr);}
+private:
+  void reset()
+  {
+    if(handle_)
+    {
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+private:
+  handle_type handle_;
+};
+
+template<class T>
+inline Task<T> Promise<T>::get_return_object()
+{
+  return Task<T>(std::coroutine_handle<Promise<T> >::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object()
+{
+  return Task<void>(std::coroutine_handle<Promise<void> >::from_promise(*this));
+}
+
+/**
+ * @brief 在调度器上独立运行任务，结束后自动销毁协程帧，未捕获的异常记录日志
+ */
+void Spawn(Scheduler* scheduler, Task<void> task);
+
+/**
+ * @brief 让出：把当前协程放回当前调度器的队列末尾
+ */
+struct YieldAwaiter
+{
+  bool await_ready() const { return false;}
+  void await_suspend(std::coroutine_handle<> h) const
+  {
+    Scheduler::GetThis()->schedule([h]() { h.resume();});
+  }
+  void await_resume() const {}
+};
+
+inline YieldAwaiter Yield() { return {};}
+
+} // namespace co
+} // namespace sylar
+
+#endif
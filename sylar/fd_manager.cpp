@@ -18,16 +18,10 @@
 
 namespace sylar {
 
-FdCtx::FdCtx(int fd)
-  :isInit_(false), isSocket_(false), sysNonblock_(false), userNonblock_(false), isClosed_(false), 
-    fd_(fd), recvTimeout_(-1), sendTimeout_(-1) 
+FdCtx::FdCtx()
+  :isInit_(false), isClosed_(false), isSocket_(false), sysNonblock_(false), userNonblock_(false),
+    fd_(-1), generation_(0), recvTimeout_(-1), sendTimeout_(-1)
 {
-    init();
-}
-
-FdCtx::~FdCtx() 
-{
-
 }
 
 bool FdCtx::init()
@@ -39,15 +33,15 @@ bool FdCtx::init()
   recvTimeout_ = -1;
   sendTimeout_ = -1;
 
+  bool ok = false;
   struct stat fd_stat;
   if(-1 == fstat(fd_, &fd_stat))
   {
-      isInit_ = false;
-      isSocket_ = false;
+    isSocket_ = false;
   }
   else
   {
-    isInit_ = true;
+    ok = true;
     isSocket_ = S_ISSOCK(fd_stat.st_mode);
   }
 
@@ -66,9 +60,18 @@ bool FdCtx::init()
 
   userNonblock_ = false;
   isClosed_ = false;
+  isInit_ = ok; // 最后发布，其他线程看到isInit时其余字段已经就绪
   return isInit_;
 }
 
+void FdCtx::reset()
+{
+  isInit_ = false;
+  isSocket_ = false;
+  userNonblock_ = false;
+  ++generation_;
+}
+
 void FdCtx::setTimeout(int type, uint64_t v)
 {
   if(type == SO_RCVTIMEO)
@@ -95,43 +98,77 @@ uint64_t FdCtx::getTimeout(int type)
 
 FdManager::FdManager()
 {
-  datas_.resize(64);
+  for(int i = 0; i < MAX_SEGMENTS; ++i)
+  {
+    segments_[i] = nullptr;
+  }
 }
 
-FdCtx::ptr FdManager::get(int fd, bool auto_create)
+FdCtx* FdManager::allocSegment(int idx)
 {
-  if(fd == -1) return nullptr;
-
-  RWMutexType::ReadLock lock(mutex_);
-
-  if((int)datas_.size() <= fd)
+  FdCtx* seg = new FdCtx[SEGMENT_SIZE];
+  for(int i = 0; i < SEGMENT_SIZE; ++i)
   {
-    if(auto_create == false) return nullptr;
+    seg[i].fd_ = idx * SEGMENT_SIZE + i;
   }
-  else
+  FdCtx* expected = nullptr;
+  if(!segments_[idx].compare_exchange_strong(expected, seg, std::memory_order_acq_rel))
   {
-    if(datas_[fd] || !auto_create)
-    {
-      return datas_[fd];
-    }
+    delete [] seg; // 其他线程已经分配
+    return expected;
   }
-  lock.unlock();
+  return seg;
+}
 
-  RWMutexType::WriteLock lock2(mutex_);
-  FdCtx::ptr ctx(new FdCtx(fd));
-  if(fd >= (int)datas_.size())
+FdCtx::ptr FdManager::get(int fd, bool auto_create)
+{
+  FdCtx* ctx = getSlot(fd, auto_create);
+  if(!ctx)
   {
-    datas_.resize(fd * 1.5);
+    return nullptr;
   }
-  datas_[fd] = ctx;
+  if(SYLAR_LIKELY(ctx->isInit()))
+  {
+    return ctx;
+  }
+  if(!auto_create)
+  {
+    return nullptr;
+  }
+
+  FdCtx::MutexType::Lock lock(ctx->mutex);
+  ctx->init();
   return ctx;
 }
 
 void FdManager::del(int fd)
 {
-  RWMutexType::WriteLock lock(mutex_);
-  if((int)datas_.size() <= fd) return;
-  datas_[fd].reset();
+  FdCtx* ctx = getSlot(fd);
+  if(!ctx)
+  {
+    return;
+  }
+  FdCtx::MutexType::Lock lock(ctx->mutex);
+  if(ctx->isInit())
+  {
+    ctx->reset();
+  }
+}
+
+void FdManager::foreach(const std::function<void(FdCtx*)>& cb)
+{
+  for(int i = 0; i < MAX_SEGMENTS; ++i)
+  {
+    FdCtx* seg = segments_[i].load(std::memory_order_acquire);
+    if(!seg)
+    {
+      continue;
+    }
+    for(int j = 0; j < SEGMENT_SIZE; ++j)
+    {
+      cb(&seg[j]);
+    }
+  }
 }
 
-} // namespace sylar
\ No newline at end of file
+} // namespace sylar
@@ -11,42 +11,84 @@
 #ifndef FD_MANAGER_H
 #define FD_MANAGER_H
 
+#include <atomic>
+#include <functional>
 #include <memory>
-#include <vector>
 
+#include "fiber.h"
+#include "macro.h"
 #include "thread.h"
 #include "singleton.h"
 
 namespace sylar {
 
-class FdCtx : std::enable_shared_from_this<FdCtx>
+class Scheduler;
+class IOManager;
+
+/**
+ * @brief 文件句柄上下文，hook状态和IOManager的事件状态放在同一条记录里
+ * @details 记录按fd号存放在FdManager的分段数组中，创建后地址不变也不释放，
+ *          fd关闭后由下一个复用该fd号的句柄重新初始化，通过generation区分
+ */
+class alignas(64) FdCtx
 {
+friend class FdManager;
+friend class IOManager;
 public:
-  typedef std::shared_ptr<FdCtx> ptr;
+  /// 记录不会被释放，直接使用裸指针，避免每次hook调用的引用计数
+  typedef FdCtx* ptr;
+  typedef Mutex MutexType;
+
   /**
-    * @brief 通过文件句柄构造FdCtx
-    */
-  FdCtx(int fd);
+   * @brief 事件上下文类
+   */
+  struct EventContext
+  {
+    /// 事件执行的调度器
+    Scheduler* scheduler = nullptr;
+    /// 等待事件的IOManager(用于维护等待事件计数)
+    IOManager* iom = nullptr;
+    /// 事件协程
+    Fiber::ptr fiber;
+    /// 事件的回调函数
+    std::function<void()> cb;
+  };
+
   /**
-    * @brief 析构函数
-    */
-  ~FdCtx();
+   * @brief 构造函数
+   */
+  FdCtx();
 
   /**
-    * @brief 是否初始化完成
-    */
+   * @brief 是否初始化完成(句柄已打开且未关闭)
+   */
   bool isInit() const { return isInit_;}
 
   /**
-    * @brief 是否socket
-    */
+   * @brief 是否socket
+   */
   bool isSocket() const { return isSocket_;}
 
   /**
-    * @brief 是否已关闭
-    */
+   * @brief 是否已关闭
+   */
   bool isClose() const { return isClosed_;}
 
+  /**
+   * @brief 标记为已关闭(close时先标记，唤醒的协程不再重试io)
+   */
+  void setClose(bool v) { isClosed_ = v;}
+
+  /**
+   * @brief 返回文件句柄
+   */
+  int getFd() const { return fd_;}
+
+  /**
+   * @brief 返回该fd号被关闭的次数，挂起前后不一致说明期间fd被关闭(可能已被复用)
+   */
+  uint32_t getGeneration() const { return generation_;}
+
   /**
     * @brief 设置用户主动设置非阻塞
     * @param[in] v 是否阻塞
@@ -87,32 +129,61 @@ private:
     * @brief 初始化
     */
   bool init();
+
+  /**
+    * @brief 清除hook状态(关闭或删除时调用，需持有mutex)
+    */
+  void reset();
 private:
   /// 是否初始化
-  bool isInit_: 1;
+  std::atomic<bool> isInit_;
+  /// 是否关闭
+  std::atomic<bool> isClosed_;
   /// 是否socket
-  bool isSocket_: 1;
+  bool isSocket_;
   /// 是否hook非阻塞
-  bool sysNonblock_: 1;
+  bool sysNonblock_;
   /// 是否用户主动设置非阻塞
-  bool userNonblock_: 1;
-  /// 是否关闭
-  bool isClosed_: 1;
+  bool userNonblock_;
   /// 文件句柄
   int fd_;
+  /// 关闭次数
+  std::atomic<uint32_t> generation_;
   /// 读超时时间毫秒
   uint64_t recvTimeout_;
   /// 写超时时间毫秒
   uint64_t sendTimeout_;
+
+  /// 以下为IOManager的事件状态，由mutex保护
+  /// 读事件上下文
+  EventContext read;
+  /// 写事件上下文
+  EventContext write;
+  /// 当前等待中的事件(IOManager::Event)
+  int events = 0;
+  /// 已就绪但还没有协程等待的事件(边缘触发，记住后下次等待时不再进内核)
+  int ready = 0;
+  /// 注册了该fd的IOManager(EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLET，直到fd关闭)，nullptr表示未注册
+  IOManager* owner = nullptr;
+  /// 初始化和事件的Mutex
+  MutexType mutex;
 };
 
 /**
  * @brief 文件句柄管理类
+ * @details 两级分段数组：fd >> SEGMENT_BITS定位段，段按需分配且永不搬移，
+ *          查找只有一次原子load，不加锁
  */
 class FdManager
 {
 public:
-  typedef RWMutex RWMutexType;
+  /// 每段记录数的位数
+  static const int SEGMENT_BITS = 12;
+  /// 每段的记录数
+  static const int SEGMENT_SIZE = 1 << SEGMENT_BITS;
+  /// 最大段数(支持的fd上限为 MAX_SEGMENTS * SEGMENT_SIZE)
+  static const int MAX_SEGMENTS = 1024;
+
   /**
     * @brief 无参构造函数
     */
@@ -122,20 +193,52 @@ public:
     * @brief 获取/创建文件句柄类FdCtx
     * @param[in] fd 文件句柄
     * @param[in] auto_create 是否自动创建
-    * @return 返回对应文件句柄类FdCtx::ptr
+    * @return 返回对应文件句柄类FdCtx::ptr，未初始化且不自动创建时返回nullptr
     */
   FdCtx::ptr get(int fd, bool auto_create = false);
 
   /**
-    * @brief 删除文件句柄类
+    * @brief 删除文件句柄类(记录保留，只清除hook状态)
     * @param[in] fd 文件句柄
     */
   void del(int fd);
+
+  /**
+    * @brief 获取fd的记录，不管是否初始化
+    * @param[in] fd 文件句柄
+    * @param[in] auto_create 所在段不存在时是否分配
+    * @return fd超出范围或段不存在时返回nullptr
+    */
+  FdCtx* getSlot(int fd, bool auto_create = false)
+  {
+    if(SYLAR_UNLIKELY(fd < 0 || fd >= MAX_SEGMENTS * SEGMENT_SIZE))
+    {
+      return nullptr;
+    }
+    FdCtx* seg = segments_[fd >> SEGMENT_BITS].load(std::memory_order_acquire);
+    if(SYLAR_UNLIKELY(!seg))
+    {
+      if(!auto_create)
+      {
+        return nullptr;
+      }
+      seg = allocSegment(fd >> SEGMENT_BITS);
+    }
+    return &seg[fd & (SEGMENT_SIZE - 1)];
+  }
+
+  /**
+    * @brief 遍历所有已分配的记录
+    */
+  void foreach(const std::function<void(FdCtx*)>& cb);
+private:
+  /**
+    * @brief 分配一段记录，并发分配时只保留一个
+    */
+  FdCtx* allocSegment(int idx);
 private:
-  /// 读写锁
-  RWMutexType mutex_;
-  /// 文件句柄集合
-  std::vector<FdCtx::ptr> datas_;
+  /// 段数组，段内存不释放(退出时其他线程可能仍在访问)
+  std::atomic<FdCtx*> segments_[MAX_SEGMENTS];
 };
 
 /// 文件句柄单例
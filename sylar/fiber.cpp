@@ -11,7 +11,12 @@
 #include <cstddef>
 #include <exception>
 #include <functional>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <ucontext.h>
+#include <unistd.h>
 
 #include "fiber.h"
 #include "config.h"
@@ -30,6 +35,13 @@ static std::atomic<uint64_t> s_fiber_count(0);
 static thread_local Fiber* t_fiber = nullptr;
 static thread_local Fiber::ptr t_threadFiber = nullptr;
 
+static std::atomic<uint64_t> s_preempt_count(0);
+static thread_local volatile sig_atomic_t t_preempt = 0; // 当前协程已用完时间片
+static thread_local volatile uint64_t t_slice_begin = 0; // 当前协程换入的时间(微秒)
+static thread_local uint64_t t_slice_us = 0; // 时间片长度，0表示本线程没有开启
+static thread_local timer_t t_preempt_timer;
+static thread_local volatile sig_atomic_t t_switching = 0; // 正在swapcontext中，栈指针和栈帧可能不一致
+
 static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
   Config::Lookup<uint32_t>("fiber.stack_size", 128 * 1024, "fiber stack size");
 
@@ -49,6 +61,23 @@ public:
 
 using StackAllocator = MallocStackAllocator;
 
+/**
+ * @brief 切换上下文，期间标记t_switching
+ * @details 切换到的协程从它自己的SwapContext返回时清除标记，新协程在MainFunc入口清除
+ */
+static int SwapContext(ucontext_t* from, const ucontext_t* to)
+{
+  t_switching = 1;
+  int rt = swapcontext(from, to);
+  t_switching = 0;
+  return rt;
+}
+
+bool Fiber::IsSwitching()
+{
+  return t_switching;
+}
+
 uint64_t Fiber::GetFiberId()
 {
   if (t_fiber)
@@ -78,6 +107,7 @@ Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool use_caller)
   stacksize_ = stacksize ? stacksize : g_fiber_stack_size->getValue();
 
   stack_ = StackAllocator::Alloc(stacksize_);
+  setEntry();
   if (getcontext(&ctx_))
   {
     SYLAR_ASSERT2(false, "getcontext");
@@ -128,19 +158,29 @@ void Fiber::reset(std::function<void()> cb)
           || state_ == EXCEPT
           || state_ == INIT);
   cb_ = cb;
+  setEntry();
   ctx_.uc_link = nullptr;
   ctx_.uc_stack.ss_sp = stack_;
   ctx_.uc_stack.ss_size = stacksize_;
 
   makecontext(&ctx_, &Fiber::MainFunc, 0);
   state_ = INIT;
+  deadline_ = nullptr;
+}
+
+void Fiber::setEntry()
+{
+  typedef void(*FuncPtr)();
+  entryType_ = cb_ ? &cb_.target_type() : nullptr;
+  FuncPtr* fp = cb_.target<FuncPtr>();
+  entryFunc_ = fp ? (void*)*fp : nullptr;
 }
 
 void Fiber::call()
 {
   SYLAR_LOG_INFO(g_logger) << "call";
   SetThis(this);
-  if (swapcontext(&t_threadFiber->ctx_, &ctx_))
+  if (SwapContext(&t_threadFiber->ctx_, &ctx_))
   {
     SYLAR_ASSERT2(false, "swapcontext");
   }
@@ -149,7 +189,7 @@ void Fiber::call()
 void Fiber::back()
 {
   SetThis(t_threadFiber.get());
-  if (swapcontext(&ctx_, &t_threadFiber->ctx_))
+  if (SwapContext(&ctx_, &t_threadFiber->ctx_))
   {
     SYLAR_ASSERT2(false, "swapcontext");
   }
@@ -158,9 +198,14 @@ void Fiber::back()
 void Fiber::swapIn()
 {
   SetThis(this);
+  if (t_slice_us) // 新的时间片
+  {
+    t_slice_begin = GetCurrentUS();
+    t_preempt = 0;
+  }
   SYLAR_ASSERT(state_ != EXEC);
   state_ = EXEC;
-  if (swapcontext(&Scheduler::GetMainFiber()->ctx_, &ctx_)) // 让当前线程执行的协程暂停，转而执行this的栈空间
+  if (SwapContext(&Scheduler::GetMainFiber()->ctx_, &ctx_)) // 让当前线程执行的协程暂停，转而执行this的栈空间
   {
     SYLAR_ASSERT2(false, "swapcontext");
   }
@@ -169,7 +214,7 @@ void Fiber::swapIn()
 void Fiber::swapOut()
 {
   SetThis(Scheduler::GetMainFiber()); // 设置当前运行的协程就是主协程
-  if(swapcontext(&ctx_, &Scheduler::GetMainFiber()->ctx_)) // 将当前上下文变为空
+  if(SwapContext(&ctx_, &Scheduler::GetMainFiber()->ctx_)) // 将当前上下文变为空
   {
     SYLAR_ASSERT2(false, "swapcontext");
   }
@@ -180,6 +225,16 @@ void Fiber::SetThis(Fiber* f)
   t_fiber = f;
 }
 
+Deadline* Fiber::GetDeadline()
+{
+  return t_fiber ? t_fiber->deadline_ : nullptr;
+}
+
+void Fiber::SetDeadline(Deadline* v)
+{
+  GetThis()->deadline_ = v;
+}
+
 Fiber::ptr Fiber::GetThis()
 {
   if (t_fiber) return t_fiber->shared_from_this();
@@ -190,6 +245,11 @@ Fiber::ptr Fiber::GetThis()
   return t_fiber->shared_from_this();
 }
 
+Fiber* Fiber::GetThisRaw()
+{
+  return t_fiber;
+}
+
 void Fiber::YieldToReady()
 {
   Fiber::ptr cur = GetThis();
@@ -210,8 +270,84 @@ uint64_t Fiber::TotalFibers()
   return s_fiber_count;
 }
 
+bool Fiber::MaybeYield()
+{
+  if (SYLAR_LIKELY(!t_preempt)) return false;
+  t_preempt = 0;
+  Fiber* cur = t_fiber;
+  // 只让出调度器上的任务协程，线程主协程和调度协程不能让出
+  if (!cur || !cur->stack_ || cur == Scheduler::GetMainFiber() || !Scheduler::GetThis() || cur->state_ != EXEC)
+  {
+    return false;
+  }
+  ++s_preempt_count;
+  cur->preempted_ = true;
+  YieldToReady();
+  return true;
+}
+
+/**
+ * @brief 时间片时钟信号：当前协程换入后已运行超过时间片则打上标记
+ * @details 只读写本线程的变量和调用clock_gettime，信号处理函数里不能做其他事
+ */
+static void PreemptHandler(int)
+{
+  if (t_slice_us && GetCurrentUS() - t_slice_begin >= t_slice_us)
+  {
+    t_preempt = 1;
+  }
+}
+
+bool Fiber::StartPreempt(uint64_t slice_us)
+{
+  static bool s_installed = []()
+  {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &PreemptHandler;
+    sa.sa_flags = SA_RESTART; // 被打断的系统调用自动重启
+    sigemptyset(&sa.sa_mask);
+    return sigaction(SIGURG, &sa, nullptr) == 0;
+  }();
+  if (!s_installed || !slice_us || t_slice_us) return false;
+
+  // 按线程cpu时间计时，阻塞在epoll等系统调用里的空闲线程不会收到信号
+  struct sigevent sev;
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_THREAD_ID;
+  sev.sigev_signo = SIGURG;
+  sev._sigev_un._tid = syscall(SYS_gettid);
+  if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &t_preempt_timer))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "timer_create for preemption fail errno=" << errno << " " << strerror(errno);
+    return false;
+  }
+  struct itimerspec its;
+  its.it_value.tv_sec = slice_us / 1000000;
+  its.it_value.tv_nsec = slice_us % 1000000 * 1000;
+  its.it_interval = its.it_value;
+  t_slice_begin = GetCurrentUS();
+  t_slice_us = slice_us; // 先设置线程局部变量，信号处理函数里不会再分配
+  timer_settime(t_preempt_timer, 0, &its, nullptr);
+  return true;
+}
+
+void Fiber::StopPreempt()
+{
+  if (!t_slice_us) return;
+  timer_delete(t_preempt_timer);
+  t_slice_us = 0;
+  t_preempt = 0;
+}
+
+uint64_t Fiber::TotalPreempts()
+{
+  return s_preempt_count;
+}
+
 void Fiber::MainFunc()
 {
+  t_switching = 0;
   Fiber::ptr cur = GetThis();
   SYLAR_ASSERT(cur);
   try {
@@ -235,6 +371,7 @@ void Fiber::MainFunc()
 }
 void Fiber::CallerMainFunc()
 {
+  t_switching = 0;
   Fiber::ptr cur = GetThis();
   SYLAR_ASSERT(cur);
   try {
@@ -12,11 +12,13 @@
 #include <ucontext.h>
 #include <functional>
 #include <memory>
+#include <typeinfo>
 
 
 namespace sylar {
 
 class Scheduler;
+class Deadline;
 
 class Fiber : public std::enable_shared_from_this<Fiber>
 {
@@ -94,6 +96,26 @@ public:
 
   State getState() const { return state_;}
 
+  /**
+   * @brief 返回调度优先级(Scheduler::Priority)
+   */
+  int getPriority() const { return priority_;}
+
+  /**
+   * @brief 设置调度优先级，之后协程每次放回调度队列都使用该优先级
+   */
+  void setPriority(int v) { priority_ = v;}
+
+  /**
+   * @brief 返回执行函数的类型，用于按入口统计(如采样分析)，没有执行函数返回nullptr
+   */
+  const std::type_info* getEntryType() const { return entryType_;}
+
+  /**
+   * @brief 执行函数是普通函数指针时返回其地址，否则返回nullptr
+   */
+  void* getEntryFunc() const { return entryFunc_;}
+
 public:
   /**
    * @brief 设置当前线程的运行协程 
@@ -106,6 +128,16 @@ public:
    */  
   static Fiber::ptr GetThis();
 
+  /**
+   * @brief 返回当前协程的裸指针，不会创建主协程，可在信号处理函数中使用
+   */
+  static Fiber* GetThisRaw();
+
+  /**
+   * @brief 当前线程是否正在切换协程上下文，此时不能在信号处理函数中展开调用栈
+   */
+  static bool IsSwitching();
+
   /**
    * @brief 将当前协程切换到后台，并设置为READY状态
    */  
@@ -121,6 +153,30 @@ public:
    */  
   static uint64_t TotalFibers();
 
+  /**
+   * @brief 抢占点：当前协程用完时间片时让出(放回队列末尾)，否则立即返回
+   * @details 长时间计算的循环里调用；hook的socket io入口也会调用
+   * @return 是否让出过
+   */
+  static bool MaybeYield();
+
+  /**
+   * @brief 为当前线程开启时间片：按线程cpu时间每slice_us发一次SIGURG，
+   *        协程换入后运行超过slice_us即标记为超时，在下一个抢占点让出
+   * @details cpu时间定时器的精度是内核tick，比tick短的时间片按tick计；阻塞的空闲线程不会收到信号
+   */
+  static bool StartPreempt(uint64_t slice_us);
+
+  /**
+   * @brief 关闭当前线程的时间片
+   */
+  static void StopPreempt();
+
+  /**
+   * @brief 返回因时间片用完而让出的总次数
+   */
+  static uint64_t TotalPreempts();
+
   /**
    * @brief 协程执行函数
    * @post 执行完成返回到线程主协程 
@@ -138,6 +194,22 @@ public:
    */  
   static uint64_t GetFiberId();
 
+  /**
+   * @brief 返回当前协程的截止时间，没有返回nullptr
+   */
+  static Deadline* GetDeadline();
+
+  /**
+   * @brief 设置当前协程的截止时间(由Deadline作用域维护)
+   */
+  static void SetDeadline(Deadline* v);
+
+private:
+  /**
+   * @brief 根据cb_记录入口信息
+   */
+  void setEntry();
+
 private:
   uint64_t id_ = 0; // 协程id
 
@@ -150,6 +222,12 @@ private:
   void* stack_ = nullptr; // 协程运行栈指针
 
   std::function<void()> cb_; // 协程运行函数
+  Deadline* deadline_ = nullptr; // 协程当前的截止时间
+
+  int priority_ = 1; // 调度优先级，默认Scheduler::NORMAL
+  bool preempted_ = false; // 上次让出是因为时间片用完
+  const std::type_info* entryType_ = nullptr; // 执行函数的类型
+  void* entryFunc_ = nullptr; // 执行函数为函数指针时的地址
 };
 
 }
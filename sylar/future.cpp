@@ -0,0 +1,176 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 12:26:51
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 12:26:51
+ * @FilePath: /sylar-wxb/sylar/future.cpp
+ * @Description: 协程版Future/Promise、WaitGroup以及并行扇出/汇聚(WhenAll/WhenAny)
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include "future.h"
+#include "macro.h"
+
+namespace sylar {
+
+/**
+ * @brief 唤醒以next相连的等待者，同一调度器上连续的等待者一次加锁批量放回
+ */
+static void wake_all(FiberWaiter* waiter)
+{
+  std::vector<Fiber::ptr> fibers;
+  Scheduler* scheduler = nullptr;
+  while(waiter)
+  {
+    FiberWaiter* next = waiter->next; // 唤醒后节点所在的栈随时可能失效
+    if(waiter->scheduler != scheduler && !fibers.empty())
+    {
+      scheduler->schedule(fibers.begin(), fibers.end());
+      fibers.clear();
+    }
+    scheduler = waiter->scheduler;
+    fibers.push_back(nullptr);
+    fibers.back().swap(waiter->fiber);
+    waiter = next;
+  }
+  if(!fibers.empty())
+  {
+    scheduler->schedule(fibers.begin(), fibers.end());
+  }
+}
+
+FutureStateBase::~FutureStateBase()
+{
+  SYLAR_ASSERT(waiters_.empty());
+}
+
+void FutureStateBase::wait()
+{
+  if(ready_)
+  {
+    return;
+  }
+  SYLAR_ASSERT(Scheduler::GetThis());
+  FiberWaiter waiter;
+  waiter.scheduler = Scheduler::GetThis();
+  waiter.fiber = Fiber::GetThis();
+  {
+    Spinlock::Lock lock(mutex_);
+    if(ready_)
+    {
+      return;
+    }
+    waiters_.push(&waiter);
+  }
+  // 结果可能在挂起前就被设置，调度器会跳过仍处于EXEC状态的协程
+  Fiber::YieldToHold();
+}
+
+void FutureStateBase::onReady(std::function<void()> cb)
+{
+  {
+    Spinlock::Lock lock(mutex_);
+    if(!ready_)
+    {
+      callbacks_.push_back(std::move(cb));
+      return;
+    }
+  }
+  cb();
+}
+
+void FutureStateBase::finish(FiberWaiter* waiters, std::vector<std::function<void()> >& cbs)
+{
+  wake_all(waiters);
+  for(auto& cb : cbs)
+  {
+    cb();
+  }
+}
+
+Future<void> WhenAll(const std::vector<Future<void> >& futures)
+{
+  struct Context
+  {
+    Promise<void> promise;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed = {false};
+  };
+  std::shared_ptr<Context> ctx(new Context);
+  ctx->remaining = futures.size();
+  Future<void> result = ctx->promise.getFuture();
+  if(futures.empty())
+  {
+    ctx->promise.setValue();
+    return result;
+  }
+  for(auto& future : futures)
+  {
+    auto state = future.getState();
+    state->onReady([ctx, state]()
+    {
+      if(state->hasException() && !ctx->failed.exchange(true))
+      {
+        try { state->rethrow(); }
+        catch(...) { ctx->promise.setException(std::current_exception());}
+      }
+      if(--ctx->remaining == 0 && !ctx->failed)
+      {
+        ctx->promise.setValue();
+      }
+    });
+  }
+  return result;
+}
+
+WaitGroup::~WaitGroup()
+{
+  SYLAR_ASSERT(waiters_.empty());
+}
+
+void WaitGroup::add(int64_t n)
+{
+  if(n > 0) // 增加计数不会归零，不用加锁
+  {
+    count_.fetch_add(n);
+    return;
+  }
+  FiberWaiter* waiters = nullptr;
+  {
+    // 归零和取等待者在同一次加锁内完成；等待者都要拿到这把锁才返回，
+    // 所以它返回(可能随即析构本对象)时这里已经不再访问成员
+    Spinlock::Lock lock(mutex_);
+    int64_t v = count_.fetch_add(n) + n;
+    SYLAR_ASSERT2(v >= 0, "WaitGroup negative counter");
+    if(v == 0)
+    {
+      waiters = waiters_.popAll();
+    }
+  }
+  wake_all(waiters);
+}
+
+void WaitGroup::done()
+{
+  add(-1);
+}
+
+void WaitGroup::wait()
+{
+  FiberWaiter waiter;
+  {
+    // 不能只看count_为0就返回：归零的一方可能还没有释放锁
+    Spinlock::Lock lock(mutex_);
+    if(count_ == 0)
+    {
+      return;
+    }
+    SYLAR_ASSERT(Scheduler::GetThis());
+    waiter.scheduler = Scheduler::GetThis();
+    waiter.fiber = Fiber::GetThis();
+    waiters_.push(&waiter);
+  }
+  Fiber::YieldToHold();
+}
+
+} // namespace sylar
@@ -0,0 +1,409 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 12:26:51
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 12:26:51
+ * @FilePath: /sylar-wxb/sylar/future.h
+ * @Description: 协程版Future/Promise、WaitGroup以及并行扇出/汇聚(WhenAll/WhenAny)，等待时挂起协程而不阻塞线程
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef FUTURE_H
+#define FUTURE_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "mutex.h"
+#include "noncopyable.h"
+#include "scheduler.h"
+
+namespace sylar {
+
+/**
+ * @brief Future共享状态中与值类型无关的部分
+ */
+class FutureStateBase : Noncopyable
+{
+public:
+  ~FutureStateBase();
+
+  /**
+   * @brief 结果是否已设置
+   */
+  bool isReady() const { return ready_;}
+
+  /**
+   * @brief 挂起当前协程直到结果被设置
+   */
+  void wait();
+
+  /**
+   * @brief 结果设置后在设置结果的线程上执行cb，已经设置则立即执行
+   */
+  void onReady(std::function<void()> cb);
+
+  /**
+   * @brief 设置异常
+   */
+  void setException(std::exception_ptr e)
+  {
+    complete([this, &e]() { exception_ = e;});
+  }
+
+  /**
+   * @brief 结果是异常时抛出
+   */
+  void rethrow() const
+  {
+    if(exception_)
+    {
+      std::rethrow_exception(exception_);
+    }
+  }
+
+  /**
+   * @brief 结果是否是异常
+   */
+  bool hasException() const { return exception_ != nullptr;}
+protected:
+  /**
+   * @brief 在锁内保存结果，再在锁外唤醒等待者、执行回调
+   * @exception std::logic_error 结果已经设置过
+   */
+  template<class Fn>
+  void complete(Fn store)
+  {
+    FiberWaiter* waiters = nullptr;
+    std::vector<std::function<void()> > cbs;
+    {
+      Spinlock::Lock lock(mutex_);
+      if(ready_)
+      {
+        throw std::logic_error("promise already satisfied");
+      }
+      store();
+      ready_ = true;
+      waiters = waiters_.popAll();
+      cbs.swap(callbacks_);
+    }
+    finish(waiters, cbs);
+  }
+
+  void finish(FiberWaiter* waiters, std::vector<std::function<void()> >& cbs);
+private:
+  Spinlock mutex_;
+  std::atomic<bool> ready_ = {false};
+  /// 挂起的协程
+  FiberWaitQueue waiters_;
+  /// 完成回调
+  std::vector<std::function<void()> > callbacks_;
+  /// 异常结果
+  std::exception_ptr exception_;
+};
+
+/**
+ * @brief Future共享状态
+ */
+template<class T>
+class FutureState : public FutureStateBase
+{
+public:
+  typedef std::shared_ptr<FutureState> ptr;
+
+  template<class V>
+  void setValue(V&& v)
+  {
+    complete([this, &v]() { value_ = std::forward<V>(v);});
+  }
+
+  const T& value() const { return value_;}
+private:
+  T value_;
+};
+
+template<>
+class FutureState<void> : public FutureStateBase
+{
+public:
+  typedef std::shared_ptr<FutureState> ptr;
+
+  void setValue()
+  {
+    complete([]() {});
+  }
+
+  void value() const {}
+};
+
+/**
+ * @brief 异步结果，可以复制，多个协程可以同时等待同一个结果
+ */
+template<class T>
+class Future
+{
+public:
+  /// get()的返回类型，T为void时是void
+  typedef typename std::add_lvalue_reference<const T>::type GetType;
+
+  Future() {}
+  explicit Future(typename FutureState<T>::ptr state) : state_(state) {}
+
+  /**
+   * @brief 是否关联了共享状态
+   */
+  bool valid() const { return state_ != nullptr;}
+
+  /**
+   * @brief 结果是否已设置
+   */
+  bool isReady() const { return state_->isReady();}
+
+  /**
+   * @brief 挂起当前协程直到结果被设置
+   */
+  void wait() const { state_->wait();}
+
+  /**
+   * @brief 等待并返回结果，结果是异常时抛出
+   */
+  GetType get() const
+  {
+    state_->wait();
+    state_->rethrow();
+    return state_->value();
+  }
+
+  /**
+   * @brief 结果设置后执行cb(在设置结果的线程上)
+   */
+  void onReady(std::function<void()> cb) const { state_->onReady(std::move(cb));}
+
+  const typename FutureState<T>::ptr& getState() const { return state_;}
+private:
+  typename FutureState<T>::ptr state_;
+};
+
+/**
+ * @brief 结果的设置方
+ */
+template<class T>
+class Promise
+{
+public:
+  Promise() : state_(new FutureState<T>) {}
+
+  /**
+   * @brief 获取关联的Future
+   */
+  Future<T> getFuture() const { return Future<T>(state_);}
+
+  /**
+   * @brief 设置结果并唤醒等待者
+   */
+  template<class... Args>
+  void setValue(Args&&... args) const { state_->setValue(std::forward<Args>(args)...);}
+
+  /**
+   * @brief 设置异常并唤醒等待者
+   */
+  void setException(std::exception_ptr e) const { state_->setException(e);}
+private:
+  typename FutureState<T>::ptr state_;
+};
+
+/**
+ * @brief 执行fn并把结果或异常写入promise
+ */
+template<class R, class F>
+void RunAndSet(const Promise<R>& promise, F& fn)
+{
+  try
+  {
+    if constexpr(std::is_void<R>::value)
+    {
+      fn();
+      promise.setValue();
+    }
+    else
+    {
+      promise.setValue(fn());
+    }
+  }
+  catch(...)
+  {
+    promise.setException(std::current_exception());
+  }
+}
+
+/**
+ * @brief 在调度器上异步执行fn
+ * @return fn返回值的Future
+ */
+template<class F>
+Future<typename std::invoke_result<F>::type> Async(Scheduler* scheduler, F fn)
+{
+  typedef typename std::invoke_result<F>::type R;
+  Promise<R> promise;
+  scheduler->schedule([promise, fn]() mutable
+  {
+    RunAndSet(promise, fn);
+  });
+  return promise.getFuture();
+}
+
+/**
+ * @brief 对[begin, end)中每个元素在调度器上并行执行fn，所有任务一次性批量调度
+ * @return 与输入一一对应的Future
+ */
+template<class InputIterator, class F>
+std::vector<Future<typename std::invoke_result<F, decltype(*std::declval<InputIterator>())>::type> >
+ParallelMap(Scheduler* scheduler, InputIterator begin, InputIterator end, F fn)
+{
+  typedef typename std::invoke_result<F, decltype(*begin)>::type R;
+  typedef typename std::decay<decltype(*begin)>::type V;
+  std::vector<Future<R> > futures;
+  std::vector<std::function<void()> > tasks;
+  for(; begin != end; ++begin)
+  {
+    Promise<R> promise;
+    futures.push_back(promise.getFuture());
+    V v = *begin;
+    tasks.push_back([promise, fn, v]() mutable
+    {
+      auto call = [&fn, &v]() { return fn(v);};
+      RunAndSet(promise, call);
+    });
+  }
+  scheduler->schedule(tasks.begin(), tasks.end()); // 一次加锁放入全部任务
+  return futures;
+}
+
+/**
+ * @brief 所有Future都完成后完成，有异常时以第一个异常完成
+ * @return 按输入顺序排列的结果
+ */
+template<class T>
+Future<std::vector<T> > WhenAll(const std::vector<Future<T> >& futures)
+{
+  struct Context
+  {
+    Promise<std::vector<T> > promise;
+    std::vector<T> results;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> failed = {false};
+  };
+  std::shared_ptr<Context> ctx(new Context);
+  ctx->results.resize(futures.size());
+  ctx->remaining = futures.size();
+  Future<std::vector<T> > result = ctx->promise.getFuture();
+  if(futures.empty())
+  {
+    ctx->promise.setValue(std::vector<T>());
+    return result;
+  }
+  for(size_t i = 0; i < futures.size(); ++i)
+  {
+    auto state = futures[i].getState();
+    state->onReady([ctx, state, i]()
+    {
+      if(state->hasException())
+      {
+        if(!ctx->failed.exchange(true))
+        {
+          try { state->rethrow(); }
+          catch(...) { ctx->promise.setException(std::current_exception());}
+        }
+      }
+      else
+      {
+        ctx->results[i] = state->value();
+      }
+      if(--ctx->remaining == 0 && !ctx->failed)
+      {
+        ctx->promise.setValue(std::move(ctx->results));
+      }
+    });
+  }
+  return result;
+}
+
+/**
+ * @brief 所有Future<void>都完成后完成，有异常时以第一个异常完成
+ */
+Future<void> WhenAll(const std::vector<Future<void> >& futures);
+
+/**
+ * @brief 任意一个Future完成(包括异常)后完成
+ * @return 最先完成的下标
+ */
+template<class T>
+Future<size_t> WhenAny(const std::vector<Future<T> >& futures)
+{
+  struct Context
+  {
+    Promise<size_t> promise;
+    std::atomic<bool> done = {false};
+  };
+  std::shared_ptr<Context> ctx(new Context);
+  Future<size_t> result = ctx->promise.getFuture();
+  if(futures.empty())
+  {
+    ctx->promise.setException(std::make_exception_ptr(std::invalid_argument("WhenAny of nothing")));
+    return result;
+  }
+  for(size_t i = 0; i < futures.size(); ++i)
+  {
+    futures[i].onReady([ctx, i]()
+    {
+      if(!ctx->done.exchange(true))
+      {
+        ctx->promise.setValue(i);
+      }
+    });
+  }
+  return result;
+}
+
+/**
+ * @brief 等待一组任务完成的计数器
+ */
+class WaitGroup : Noncopyable
+{
+public:
+  WaitGroup(int64_t count = 0) : count_(count) {}
+  ~WaitGroup();
+
+  /**
+   * @brief 增加计数
+   */
+  void add(int64_t n = 1);
+
+  /**
+   * @brief 完成一个任务，计数归零时唤醒所有等待者
+   */
+  void done();
+
+  /**
+   * @brief 挂起当前协程直到计数归零
+   */
+  void wait();
+
+  /**
+   * @brief 当前计数
+   */
+  int64_t getCount() const { return count_;}
+private:
+  Spinlock mutex_;
+  std::atomic<int64_t> count_;
+  FiberWaitQueue waiters_;
+};
+
+} // namespace sylar
+
+#endif
@@ -8,6 +8,7 @@
  * 
  * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
  */
+#include <atomic>
 #include <cstdint>
 #include <dlfcn.h>
 #include <fcntl.h>
@@ -94,11 +95,219 @@ void set_hook_enable(bool flag)
 
 } // namespace sylar
 
-struct timer_info
+/**
+ * @brief 协程挂起等待io时的记录，按线程缓存复用，不释放，线程退出后交给其他线程复用
+ * @details state高32位为generation，低32位为取消原因；归还时generation加一，
+ *          迟到的超时回调CAS失败，不会影响记录的下一次使用
+ */
+struct WaitRecord
+{
+  std::atomic<uint64_t> state = {0};
+  std::atomic<sylar::IOManager*> iom = {nullptr};
+  std::atomic<uint32_t> event = {0};
+  /// Deadline使用：当前挂起等待的fd
+  std::atomic<int> fd = {-1};
+  /// Deadline使用：协程是否正挂起在fd上
+  std::atomic<bool> waiting = {false};
+  WaitRecord* next = nullptr;
+
+  uint32_t generation() const { return state.load() >> 32;}
+  int cancelled() const { return (int)(uint32_t)state.load();}
+
+  /**
+   * @brief 仍是第gen次使用且没有被取消时，标记取消原因
+   */
+  bool cancel(uint32_t gen, int reason)
+  {
+    uint64_t expected = (uint64_t)gen << 32;
+    return state.compare_exchange_strong(expected, expected | (uint32_t)reason);
+  }
+};
+
+/**
+ * @brief 线程缓存的空闲等待记录(侵入式链表，归还不分配内存)
+ * @details 迟到的超时回调可能还持有记录指针，记录不能释放；线程退出时整条链表交给全局池，
+ *          其他线程(如弹性扩容新建的线程)先从全局池取，避免线程反复创建退出时记录无限增长
+ */
+struct WaitRecordCache
 {
-  int cancelled = 0;
+  WaitRecord* head = nullptr;
+
+  ~WaitRecordCache();
 };
 
+static sylar::Spinlock s_wait_records_mutex;
+/// 已退出线程留下的空闲等待记录
+static WaitRecord* s_wait_records = nullptr;
+
+WaitRecordCache::~WaitRecordCache()
+{
+  if(!head)
+  {
+    return;
+  }
+  WaitRecord* tail = head;
+  while(tail->next)
+  {
+    tail = tail->next;
+  }
+  sylar::Spinlock::Lock lock(s_wait_records_mutex);
+  tail->next = s_wait_records;
+  s_wait_records = head;
+  head = nullptr;
+}
+
+static thread_local WaitRecordCache t_wait_records;
+
+static WaitRecord* acquire_wait_record()
+{
+  WaitRecord* rec = t_wait_records.head;
+  if(SYLAR_UNLIKELY(!rec))
+  {
+    {
+      sylar::Spinlock::Lock lock(s_wait_records_mutex); // 整条取走，之后都在本线程缓存里周转
+      rec = s_wait_records;
+      s_wait_records = nullptr;
+    }
+    if(!rec)
+    {
+      return new WaitRecord;
+    }
+  }
+  t_wait_records.head = rec->next;
+  return rec;
+}
+
+static void release_wait_record(WaitRecord* rec)
+{
+  rec->waiting = false;
+  rec->state.store((uint64_t)(rec->generation() + 1) << 32);
+  rec->next = t_wait_records.head;
+  t_wait_records.head = rec;
+}
+
+/**
+ * @brief 挂起当前协程，直到已添加的fd事件触发或超时
+ * @details 超时回调只捕获记录指针、generation和fd，存放在std::function内部，不分配内存；
+ *          协程有截止时间且比单次超时先到时，改为等待截止时间的定时器
+ * @return 事件触发返回0，超时返回ETIMEDOUT
+ */
+static int wait_event(sylar::IOManager* iom, int fd, uint32_t event, uint64_t timeout_ms, sylar::Deadline* deadline)
+{
+  if(deadline && (timeout_ms == (uint64_t)-1
+        || sylar::GetCurrentMS() + timeout_ms >= deadline->getDeadline())) // 截止时间先到
+  {
+    return deadline->wait(iom, fd, event);
+  }
+  if(timeout_ms == (uint64_t)-1)
+  {
+    sylar::Fiber::YieldToHold();
+    return 0;
+  }
+
+  WaitRecord* rec = acquire_wait_record();
+  rec->iom.store(iom, std::memory_order_relaxed);
+  rec->event.store(event, std::memory_order_relaxed);
+  uint32_t gen = rec->generation();
+  sylar::Timer::ptr timer = iom->addTimer(timeout_ms, [rec, gen, fd]()
+  {
+    // 先读出参数再CAS：CAS成功说明期间记录没有被归还复用
+    sylar::IOManager* iom = rec->iom.load(std::memory_order_relaxed);
+    uint32_t event = rec->event.load(std::memory_order_relaxed);
+    if(rec->cancel(gen, ETIMEDOUT))
+    {
+      iom->cancelEvent(fd, (sylar::IOManager::Event)event);
+    }
+  });
+
+  sylar::Fiber::YieldToHold();
+  timer->cancel();
+  int cancelled = rec->cancelled();
+  release_wait_record(rec);
+  return cancelled;
+}
+
+namespace sylar {
+
+Deadline::Deadline(uint64_t timeout_ms)
+  :prev_(Fiber::GetDeadline())
+  ,deadline_(GetCurrentMS() + timeout_ms)
+{
+  if(prev_ && prev_->deadline_ < deadline_) // 内层不能放宽外层的截止时间
+  {
+    deadline_ = prev_->deadline_;
+  }
+  Fiber::SetDeadline(this);
+}
+
+Deadline::~Deadline()
+{
+  if(timer_)
+  {
+    timer_->cancel();
+  }
+  if(record_)
+  {
+    release_wait_record((WaitRecord*)record_);
+  }
+  Fiber::SetDeadline(prev_);
+}
+
+bool Deadline::isExpired() const
+{
+  return (record_ && ((WaitRecord*)record_)->cancelled())
+    || GetCurrentMS() >= deadline_;
+}
+
+int Deadline::wait(IOManager* iom, int fd, uint32_t event)
+{
+  WaitRecord* rec = (WaitRecord*)record_;
+  if(!rec) // 整个作用域只创建一个定时器
+  {
+    rec = acquire_wait_record();
+    record_ = rec;
+    uint32_t gen = rec->generation();
+    uint64_t now = GetCurrentMS();
+    timer_ = iom->addTimer(deadline_ > now ? deadline_ - now : 0, [rec, gen]()
+    {
+      if(rec->cancel(gen, ETIMEDOUT) && rec->waiting)
+      {
+        rec->iom.load()->cancelEvent(rec->fd, (IOManager::Event)rec->event.load());
+      }
+    });
+  }
+
+  rec->iom = iom;
+  rec->fd = fd;
+  rec->event = event;
+  rec->waiting = true;
+  if(rec->cancelled()) // 挂起前已经到期
+  {
+    if(iom->delEvent(fd, (IOManager::Event)event))
+    {
+      rec->waiting = false;
+      return ETIMEDOUT;
+    }
+    // 事件已经被触发，协程已被调度，必须让出一次
+  }
+  Fiber::YieldToHold();
+  rec->waiting = false;
+  return rec->cancelled();
+}
+
+uint64_t Deadline::GetRemain()
+{
+  Deadline* deadline = Fiber::GetDeadline();
+  if(!deadline)
+  {
+    return ~0ull;
+  }
+  uint64_t now = GetCurrentMS();
+  return deadline->deadline_ > now ? deadline->deadline_ - now : 0;
+}
+
+} // namespace sylar
+
 template<typename OriginFun, typename... Args>
 static ssize_t do_io(int fd, OriginFun fun, const char* hook_fun_name, uint32_t event, int timeout_so, Args&&... args)
 {
@@ -124,11 +333,21 @@ static ssize_t do_io(int fd, OriginFun fun, const char* hook_fun_name, uint32_t
     return fun(fd, std::forward<Args>(args)...);
   }
 
+  sylar::Fiber::MaybeYield(); // 时间片用完的协程在io前让出
+
+  sylar::Deadline* deadline = sylar::Fiber::GetDeadline();
+  if(deadline && deadline->isExpired()) // 已经超过截止时间，不再做io
+  {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+
   uint64_t to = ctx->getTimeout(timeout_so); // 获取超时时间
-  std::shared_ptr<timer_info> tinfo(new timer_info);
+  // 记录是复用的，挂起期间fd被关闭甚至被新连接复用时generation会变化
+  uint32_t gen = ctx->getGeneration();
 
 retry:
-  // 尝试执行原始函数直到成功
+  // 尝试执行原始函数直到成功，立即完成时不分配任何内存
   ssize_t n = fun(fd, std::forward<Args>(args)...);
   while(n == -1 && errno == EINTR)
   {
@@ -137,48 +356,31 @@ retry:
   if(n == -1 && errno == EAGAIN) // errno表示io暂时没完成
   {
     sylar::IOManager* iom = sylar::IOManager::GetThis();
-    sylar::Timer::ptr timer;
-    std::weak_ptr<timer_info> winfo(tinfo);
-
-    if(to != (uint64_t)-1)
+    // 先挂事件：fd已经就绪时直接重试，不用创建定时器
+    int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
+    if(rt == 1) // 之前的边缘事件还没有被消费
     {
-      timer = iom->addConditionTimer(to, [winfo, fd, iom, event]()
-      {
-        auto t = winfo.lock();
-        if(!t || t->cancelled)
-        {
-          return;
-        }
-        t->cancelled = ETIMEDOUT;
-        iom->cancelEvent(fd, (sylar::IOManager::Event)(event));
-      }, winfo);
+      goto retry;
     }
-
-    int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
     if(SYLAR_UNLIKELY(rt))
     {
       SYLAR_LOG_ERROR(h_logger) << hook_fun_name << " addEvent("
           << fd << ", " << event << ")";
-      if(timer)
-      {
-        timer->cancel();
-      }
       return -1;
-    } 
-    else
+    }
+
+    int cancelled = wait_event(iom, fd, event, to, deadline);
+    if(cancelled)
     {
-      sylar::Fiber::YieldToHold();
-      if(timer)
-      {
-        timer->cancel();
-      }
-      if(tinfo->cancelled)
-      {
-        errno = tinfo->cancelled;
-        return -1;
-      }
-      goto retry;
+      errno = cancelled;
+      return -1;
+    }
+    if(ctx->isClose() || ctx->getGeneration() != gen) // 等待期间fd被其他协程关闭
+    {
+      errno = EBADF;
+      return -1;
     }
+    goto retry;
   }
   
   return n;
@@ -216,7 +418,7 @@ int usleep(useconds_t usec)
   }
   sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
   sylar::IOManager* iom = sylar::IOManager::GetThis();
-  iom->addTimer(usec / 1000, std::bind((void(sylar::Scheduler::*)
+  iom->addTimerUs(usec, std::bind((void(sylar::Scheduler::*)
                 (sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule, iom, fiber, -1));
   sylar::Fiber::YieldToHold();
   return 0;
@@ -229,10 +431,10 @@ int nanosleep(const struct timespec *req, struct timespec *rem)
     return nanosleep_f(req, rem);
   }
 
-  int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 /1000;
+  uint64_t timeout_us = req->tv_sec * 1000 * 1000ull + (req->tv_nsec + 999) / 1000;
   sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
   sylar::IOManager* iom = sylar::IOManager::GetThis();
-  iom->addTimer(timeout_ms, std::bind((void(sylar::Scheduler::*)
+  iom->addTimerUs(timeout_us, std::bind((void(sylar::Scheduler::*)
           (sylar::Fiber::ptr, int thread))&sylar::IOManager::schedule
           ,iom, fiber, -1));
   sylar::Fiber::YieldToHold();
@@ -275,6 +477,13 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
     return connect_f(fd, addr, addrlen);
   }
 
+  sylar::Deadline* deadline = sylar::Fiber::GetDeadline();
+  if(deadline && deadline->isExpired())
+  {
+    errno = ETIMEDOUT;
+    return -1;
+  }
+
   int n = connect_f(fd, addr, addrlen);
   if(n == 0)
   {
@@ -288,44 +497,18 @@ int connect_with_timeout(int fd, const struct sockaddr* addr, socklen_t addrlen,
 
   // 因为这里套接字是非阻塞的，connect可能在最开始没有连接成功，在这里继续监听写事件，获取连接信息
   sylar::IOManager* iom = sylar::IOManager::GetThis();
-  sylar::Timer::ptr timer;
-  std::shared_ptr<timer_info> tinfo(new timer_info);
-  std::weak_ptr<timer_info> winfo(tinfo);
-
-  if(timeout_ms != (uint64_t)-1) //超时后取消
-  {
-    timer = iom->addConditionTimer(timeout_ms, [winfo, fd, iom]() // 增加一个定时器用于定时取消
-    {
-      auto t = winfo.lock();
-      if(!t || t->cancelled)
-      {
-        return;
-      }
-      t->cancelled = ETIMEDOUT;
-      iom->cancelEvent(fd, sylar::IOManager::WRITE);
-    }, winfo);
-  }
-
   int rt = iom->addEvent(fd, sylar::IOManager::WRITE); // 如果连接成功，rt就会得到写事件通知
   if(rt == 0) // 代表事件增加成功
   {
-    sylar::Fiber::YieldToHold(); // 执行调度器的fiber,???这里怎么换回来的
-    if(timer)
-    {
-      timer->cancel();
-    }
-    if(tinfo->cancelled)
+    int cancelled = wait_event(iom, fd, sylar::IOManager::WRITE, timeout_ms, deadline);
+    if(cancelled)
     {
-      errno = tinfo->cancelled;
+      errno = cancelled;
       return -1;
     }
   }
-  else
+  else if(rt != 1) // 1表示已经可写
   {
-    if(timer)
-    {
-      timer->cancel();
-    }
     SYLAR_LOG_ERROR(h_logger) << "connect addEvent(" << fd << ", WRITE) error";
   }
 
@@ -400,18 +583,8 @@ ssize_t sendmsg(int s, const struct msghdr *msg, int flags) {
 
 int close(int fd)
 {
-  if(!sylar::t_hook_enable) return close_f(fd);
-
-  sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
-  if(ctx)
-  {
-    auto iom = sylar::IOManager::GetThis();
-    if(iom) {
-        iom->cancelAll(fd);
-    }
-    sylar::FdMgr::GetInstance()->del(fd);
-  }
-  return close_f(fd);
+  // 未开启hook的线程关闭fd也要唤醒等待者并清除epoll注册状态，否则复用该fd号的新连接收不到事件
+  return sylar::IOManager::CloseFd(fd, close_f);
 }
 
 int fcntl(int fd, int cmd, ... /* arg */ )
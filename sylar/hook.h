@@ -2,14 +2,20 @@
 #define HOOK_H
 
 #include <bits/types/struct_timespec.h>
+#include <cstdint>
+#include <memory>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "noncopyable.h"
 
 namespace sylar {
 
+class IOManager;
+class Timer;
+
 /**
  * @brief 当前线程是否hook 
  */
@@ -20,6 +26,57 @@ bool is_hook_enable();
  */
 void set_hook_enable(bool flag);
 
+/**
+ * @brief 协程级截止时间
+ * @details 作用域内当前协程所有hook的io(含connect)共享同一个截止时间：第一次挂起时才创建
+ *          一个定时器，之后的等待都复用它；截止时间过后的io直接返回ETIMEDOUT，不再进内核。
+ *          fd上设置的SO_RCVTIMEO/SO_SNDTIMEO更早到期时仍按单次调用超时。嵌套时取更早的截止时间
+ */
+class Deadline : Noncopyable
+{
+public:
+  /**
+   * @brief 构造函数，作用于当前协程
+   * @param[in] timeout_ms 从现在开始的超时时间(毫秒)
+   */
+  Deadline(uint64_t timeout_ms);
+
+  /**
+   * @brief 析构函数，恢复外层的截止时间
+   */
+  ~Deadline();
+
+  /**
+   * @brief 返回截止时间(绝对时间毫秒)
+   */
+  uint64_t getDeadline() const { return deadline_;}
+
+  /**
+   * @brief 是否已经过了截止时间
+   */
+  bool isExpired() const;
+
+  /**
+   * @brief 挂起当前协程，直到已添加的fd事件触发或到达截止时间(hook内部使用)
+   * @return 事件触发返回0，到达截止时间返回ETIMEDOUT
+   */
+  int wait(IOManager* iom, int fd, uint32_t event);
+
+  /**
+   * @brief 返回当前协程剩余的时间(毫秒)，没有截止时间返回~0ull
+   */
+  static uint64_t GetRemain();
+private:
+  /// 外层的截止时间
+  Deadline* prev_;
+  /// 截止时间(绝对时间毫秒)
+  uint64_t deadline_;
+  /// 等待记录，第一次挂起时获取
+  void* record_ = nullptr;
+  /// 截止时间定时器，第一次挂起时创建
+  std::shared_ptr<Timer> timer_;
+};
+
 } // namespace sylar
 
 #ifdef __cplusplus
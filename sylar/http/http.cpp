@@ -0,0 +1,267 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:20:05
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:20:05
+ * @FilePath: /sylar-wxb/sylar/http/http.cpp
+ * @Description: HTTP请求/响应定义
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <sstream>
+#include <strings.h>
+
+#include "http.h"
+
+namespace sylar {
+namespace http {
+
+HttpMethod StringToHttpMethod(std::string_view m)
+{
+#define XX(num, name, string) \
+  if (m == #string) \
+  { \
+    return HttpMethod::name; \
+  }
+  HTTP_METHOD_MAP(XX);
+#undef XX
+  return HttpMethod::INVALID_METHOD;
+}
+
+static const char* s_method_string[] = {
+#define XX(num, name, string) #string,
+  HTTP_METHOD_MAP(XX)
+#undef XX
+};
+
+const char* HttpMethodToString(const HttpMethod& m)
+{
+  uint32_t idx = (uint32_t)m;
+  if (idx >= (sizeof(s_method_string) / sizeof(s_method_string[0])))
+  {
+    return "<unknown>";
+  }
+  return s_method_string[idx];
+}
+
+const char* HttpStatusToString(const HttpStatus& s)
+{
+  switch (s)
+  {
+#define XX(code, name, msg) \
+    case HttpStatus::name: \
+      return #msg;
+    HTTP_STATUS_MAP(XX);
+#undef XX
+    default:
+      return "<unknown>";
+  }
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+{
+  return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+HttpRequest::HttpRequest()
+  : method_(HttpMethod::GET), version_(0x11), close_(false)
+{
+}
+
+std::string_view HttpRequest::getHeader(std::string_view key, std::string_view def) const
+{
+  // header数量很少，线性查找比建索引更快
+  for (auto& i : headers_)
+  {
+    if (EqualsIgnoreCase(i.first, key))
+    {
+      return i.second;
+    }
+  }
+  return def;
+}
+
+bool HttpRequest::hasHeader(std::string_view key) const
+{
+  for (auto& i : headers_)
+  {
+    if (EqualsIgnoreCase(i.first, key))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void HttpRequest::reset()
+{
+  method_ = HttpMethod::GET;
+  version_ = 0x11;
+  close_ = false;
+  path_ = query_ = fragment_ = body_ = std::string_view();
+  headers_.clear();
+}
+
+void HttpRequest::encode(std::string& out, std::string_view host) const
+{
+  out.append(HttpMethodToString(method_)).push_back(' ');
+  out.append(path_.empty() ? std::string_view("/") : path_);
+  if (!query_.empty())
+  {
+    out.append("?").append(query_);
+  }
+  if (!fragment_.empty())
+  {
+    out.append("#").append(fragment_);
+  }
+  out.append(version_ == 0x10 ? " HTTP/1.0\r\n" : " HTTP/1.1\r\n");
+
+  bool has_host = false;
+  for (auto& i : headers_)
+  {
+    if (EqualsIgnoreCase(i.first, "connection")
+        || EqualsIgnoreCase(i.first, "content-length"))
+    {
+      continue;
+    }
+    has_host = has_host || EqualsIgnoreCase(i.first, "host");
+    out.append(i.first).append(": ").append(i.second).append("\r\n");
+  }
+  if (!has_host && !host.empty())
+  {
+    out.append("Host: ").append(host).append("\r\n");
+  }
+  out.append(close_ ? "connection: close\r\n" : "connection: keep-alive\r\n");
+  if (!body_.empty())
+  {
+    out.append("content-length: ").append(std::to_string(body_.size())).append("\r\n");
+  }
+  out.append("\r\n").append(body_);
+}
+
+std::ostream& HttpRequest::dump(std::ostream& os) const
+{
+  os << HttpMethodToString(method_) << " "
+     << path_
+     << (query_.empty() ? "" : "?")
+     << query_
+     << (fragment_.empty() ? "" : "#")
+     << fragment_
+     << " HTTP/"
+     << ((uint32_t)(version_ >> 4))
+     << "."
+     << ((uint32_t)(version_ & 0x0F))
+     << "\r\n";
+  for (auto& i : headers_)
+  {
+    os << i.first << ": " << i.second << "\r\n";
+  }
+  os << "\r\n" << body_;
+  return os;
+}
+
+std::string HttpRequest::toString() const
+{
+  std::stringstream ss;
+  dump(ss);
+  return ss.str();
+}
+
+HttpResponse::HttpResponse(uint8_t version, bool close)
+  : status_(HttpStatus::OK), version_(version), close_(close)
+{
+}
+
+void HttpResponse::setHeader(const std::string& key, const std::string& val)
+{
+  for (auto& i : headers_)
+  {
+    if (EqualsIgnoreCase(i.first, key))
+    {
+      i.second = val;
+      return;
+    }
+  }
+  headers_.emplace_back(key, val);
+}
+
+std::string HttpResponse::getHeader(const std::string& key, const std::string& def) const
+{
+  for (auto& i : headers_)
+  {
+    if (EqualsIgnoreCase(i.first, key))
+    {
+      return i.second;
+    }
+  }
+  return def;
+}
+
+void HttpResponse::delHeader(const std::string& key)
+{
+  for (auto it = headers_.begin(); it != headers_.end(); ++it)
+  {
+    if (EqualsIgnoreCase(it->first, key))
+    {
+      headers_.erase(it);
+      return;
+    }
+  }
+}
+
+void HttpResponse::reset()
+{
+  status_ = HttpStatus::OK;
+  body_.clear();
+  reason_.clear();
+  headers_.clear();
+}
+
+void HttpResponse::encode(std::string& out) const
+{
+  out.append(version_ == 0x10 ? "HTTP/1.0 " : "HTTP/1.1 ");
+  out.append(std::to_string((uint32_t)status_));
+  out.push_back(' ');
+  out.append(reason_.empty() ? HttpStatusToString(status_) : reason_.c_str());
+  out.append("\r\n");
+
+  for (auto& i : headers_)
+  {
+    if (EqualsIgnoreCase(i.first, "connection")
+        || EqualsIgnoreCase(i.first, "content-length"))
+    {
+      continue;
+    }
+    out.append(i.first).append(": ").append(i.second).append("\r\n");
+  }
+  out.append(close_ ? "connection: close\r\n" : "connection: keep-alive\r\n");
+  out.append("content-length: ").append(std::to_string(body_.size())).append("\r\n\r\n");
+  out.append(body_);
+}
+
+std::ostream& HttpResponse::dump(std::ostream& os) const
+{
+  std::string out;
+  encode(out);
+  return os << out;
+}
+
+std::string HttpResponse::toString() const
+{
+  std::string out;
+  encode(out);
+  return out;
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req)
+{
+  return req.dump(os);
+}
+
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp)
+{
+  return rsp.dump(os);
+}
+
+} // namespace http
+} // namespace sylar
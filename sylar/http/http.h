@@ -0,0 +1,254 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:20:05
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:20:05
+ * @FilePath: /sylar-wxb/sylar/http/http.h
+ * @Description: HTTP请求/响应定义
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef HTTP_HTTP_H
+#define HTTP_HTTP_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace sylar {
+namespace http {
+
+/* Request Methods */
+#define HTTP_METHOD_MAP(XX)         \
+  XX(0,  DELETE,      DELETE)       \
+  XX(1,  GET,         GET)          \
+  XX(2,  HEAD,        HEAD)         \
+  XX(3,  POST,        POST)         \
+  XX(4,  PUT,         PUT)          \
+  XX(5,  CONNECT,     CONNECT)      \
+  XX(6,  OPTIONS,     OPTIONS)      \
+  XX(7,  TRACE,       TRACE)        \
+  XX(8,  PATCH,       PATCH)        \
+
+/* Status Codes */
+#define HTTP_STATUS_MAP(XX)                                                 \
+  XX(100, CONTINUE,                        Continue)                        \
+  XX(101, SWITCHING_PROTOCOLS,             Switching Protocols)             \
+  XX(200, OK,                              OK)                              \
+  XX(201, CREATED,                         Created)                         \
+  XX(202, ACCEPTED,                        Accepted)                        \
+  XX(204, NO_CONTENT,                      No Content)                      \
+  XX(206, PARTIAL_CONTENT,                 Partial Content)                 \
+  XX(301, MOVED_PERMANENTLY,               Moved Permanently)               \
+  XX(302, FOUND,                           Found)                           \
+  XX(304, NOT_MODIFIED,                    Not Modified)                    \
+  XX(400, BAD_REQUEST,                     Bad Request)                     \
+  XX(401, UNAUTHORIZED,                    Unauthorized)                    \
+  XX(403, FORBIDDEN,                       Forbidden)                       \
+  XX(404, NOT_FOUND,                       Not Found)                       \
+  XX(405, METHOD_NOT_ALLOWED,              Method Not Allowed)              \
+  XX(408, REQUEST_TIMEOUT,                 Request Timeout)                 \
+  XX(411, LENGTH_REQUIRED,                 Length Required)                 \
+  XX(413, PAYLOAD_TOO_LARGE,               Payload Too Large)               \
+  XX(414, URI_TOO_LONG,                    URI Too Long)                    \
+  XX(431, REQUEST_HEADER_FIELDS_TOO_LARGE, Request Header Fields Too Large) \
+  XX(500, INTERNAL_SERVER_ERROR,           Internal Server Error)           \
+  XX(501, NOT_IMPLEMENTED,                 Not Implemented)                 \
+  XX(502, BAD_GATEWAY,                     Bad Gateway)                     \
+  XX(503, SERVICE_UNAVAILABLE,             Service Unavailable)             \
+  XX(504, GATEWAY_TIMEOUT,                 Gateway Timeout)                 \
+  XX(505, HTTP_VERSION_NOT_SUPPORTED,      HTTP Version Not Supported)      \
+
+/**
+ * @brief HTTP方法枚举
+ */
+enum class HttpMethod
+{
+#define XX(num, name, string) name = num,
+  HTTP_METHOD_MAP(XX)
+#undef XX
+  INVALID_METHOD
+};
+
+/**
+ * @brief HTTP状态枚举
+ */
+enum class HttpStatus
+{
+#define XX(code, name, desc) name = code,
+  HTTP_STATUS_MAP(XX)
+#undef XX
+};
+
+/**
+ * @brief 将字符串方法名转成HTTP方法枚举，未知返回INVALID_METHOD
+ */
+HttpMethod StringToHttpMethod(std::string_view m);
+
+/**
+ * @brief 将HTTP方法枚举转换成字符串
+ */
+const char* HttpMethodToString(const HttpMethod& m);
+
+/**
+ * @brief 将HTTP状态枚举转换成字符串
+ */
+const char* HttpStatusToString(const HttpStatus& s);
+
+/**
+ * @brief 忽略大小写比较
+ */
+bool EqualsIgnoreCase(std::string_view a, std::string_view b);
+
+/**
+ * @brief HTTP请求
+ * @details 所有字段都是指向接收缓冲区的string_view，不做拷贝，
+ *          只在解析出它的缓冲区数据未被移动前有效(即servlet处理期间)
+ */
+class HttpRequest
+{
+public:
+  typedef std::shared_ptr<HttpRequest> ptr;
+  typedef std::vector<std::pair<std::string_view, std::string_view>> MapType;
+
+  HttpRequest();
+
+  HttpMethod getMethod() const { return method_;}
+
+  /**
+   * @brief 返回版本，0x11表示HTTP/1.1
+   */
+  uint8_t getVersion() const { return version_;}
+
+  std::string_view getPath() const { return path_;}
+
+  std::string_view getQuery() const { return query_;}
+
+  std::string_view getFragment() const { return fragment_;}
+
+  std::string_view getBody() const { return body_;}
+
+  const MapType& getHeaders() const { return headers_;}
+
+  /**
+   * @brief 获取header(名称忽略大小写)，不存在返回def
+   */
+  std::string_view getHeader(std::string_view key, std::string_view def = std::string_view()) const;
+
+  bool hasHeader(std::string_view key) const;
+
+  /**
+   * @brief 是否在响应后关闭连接
+   */
+  bool isClose() const { return close_;}
+
+  void setMethod(HttpMethod v) { method_ = v;}
+  void setVersion(uint8_t v) { version_ = v;}
+  void setPath(std::string_view v) { path_ = v;}
+  void setQuery(std::string_view v) { query_ = v;}
+  void setFragment(std::string_view v) { fragment_ = v;}
+  void setBody(std::string_view v) { body_ = v;}
+  void setClose(bool v) { close_ = v;}
+  void addHeader(std::string_view key, std::string_view val) { headers_.emplace_back(key, val);}
+
+  /**
+   * @brief 清空，复用headers_的内存
+   */
+  void reset();
+
+  /**
+   * @brief 序列化后追加到out末尾(客户端pipeline时多个请求合并发送)
+   * @details 自动补充content-length，未设置Host时使用host参数
+   */
+  void encode(std::string& out, std::string_view host = std::string_view()) const;
+
+  std::ostream& dump(std::ostream& os) const;
+
+  std::string toString() const;
+
+private:
+  HttpMethod method_;
+  uint8_t version_;
+  bool close_;
+  std::string_view path_;
+  std::string_view query_;
+  std::string_view fragment_;
+  std::string_view body_;
+  MapType headers_;
+};
+
+/**
+ * @brief HTTP响应
+ */
+class HttpResponse
+{
+public:
+  typedef std::shared_ptr<HttpResponse> ptr;
+  typedef std::vector<std::pair<std::string, std::string>> MapType;
+
+  HttpResponse(uint8_t version = 0x11, bool close = true);
+
+  HttpStatus getStatus() const { return status_;}
+  uint8_t getVersion() const { return version_;}
+  const std::string& getBody() const { return body_;}
+  const std::string& getReason() const { return reason_;}
+  const MapType& getHeaders() const { return headers_;}
+  bool isClose() const { return close_;}
+
+  void setStatus(HttpStatus v) { status_ = v;}
+  void setVersion(uint8_t v) { version_ = v;}
+  void setBody(const std::string& v) { body_ = v;}
+  void setBody(std::string&& v) { body_ = std::move(v);}
+  std::string& getBodyRef() { return body_;}
+  void setReason(const std::string& v) { reason_ = v;}
+  void setClose(bool v) { close_ = v;}
+
+  /**
+   * @brief 设置header，已存在则覆盖(名称忽略大小写)
+   */
+  void setHeader(const std::string& key, const std::string& val);
+
+  /**
+   * @brief 追加header，不检查重复(解析响应时使用)
+   */
+  void addHeader(const std::string& key, const std::string& val) { headers_.emplace_back(key, val);}
+
+  std::string getHeader(const std::string& key, const std::string& def = "") const;
+
+  void delHeader(const std::string& key);
+
+  /**
+   * @brief 清空，复用已分配的内存
+   */
+  void reset();
+
+  /**
+   * @brief 序列化后追加到out末尾(pipeline时多个响应合并发送)
+   */
+  void encode(std::string& out) const;
+
+  std::ostream& dump(std::ostream& os) const;
+
+  std::string toString() const;
+
+private:
+  HttpStatus status_;
+  uint8_t version_;
+  bool close_;
+  std::string body_;
+  std::string reason_;
+  MapType headers_;
+};
+
+std::ostream& operator<<(std::ostream& os, const HttpRequest& req);
+
+std::ostream& operator<<(std::ostream& os, const HttpResponse& rsp);
+
+} // namespace http
+} // namespace sylar
+
+#endif
@@ -0,0 +1,402 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:05:33
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:05:33
+ * @FilePath: /sylar-wxb/sylar/http/http_connection.cpp
+ * @Description: HTTP客户端连接及连接池
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <cstring>
+#include <sstream>
+
+#include "http_connection.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_http_client_pool_max_size =
+  sylar::Config::Lookup("http.client.pool.max_size", (uint32_t)32, "http client pool max connections per host");
+
+static sylar::ConfigVar<uint32_t>::ptr g_http_client_pool_idle_timeout =
+  sylar::Config::Lookup("http.client.pool.idle_timeout", (uint32_t)(30 * 1000), "http client pool idle timeout ms");
+
+static sylar::ConfigVar<uint32_t>::ptr g_http_client_pool_max_request =
+  sylar::Config::Lookup("http.client.pool.max_request", (uint32_t)1000, "http client pool max requests per connection");
+
+std::string HttpResult::toString() const
+{
+  std::stringstream ss;
+  ss << "[HttpResult result=" << result
+     << " error=" << error
+     << " response=" << (response ? response->toString() : "nullptr")
+     << "]";
+  return ss.str();
+}
+
+HttpConnection::HttpConnection(Socket::ptr sock)
+  : sock_(sock), createTime_(sylar::GetCurrentMS())
+{
+  buf_.resize(HttpRequestParser::GetHttpRequestBufferSize());
+}
+
+HttpConnection::~HttpConnection()
+{
+  SYLAR_LOG_DEBUG(g_logger) << "HttpConnection::~HttpConnection";
+  sock_->close();
+}
+
+HttpResult::ptr HttpConnection::sendAll(const std::string& out)
+{
+  size_t off = 0;
+  while (off < out.size())
+  {
+    int rt = sock_->send(out.data() + off, out.size() - off);
+    if (rt <= 0)
+    {
+      reusable_ = false;
+      if (rt == 0)
+      {
+        return std::make_shared<HttpResult>((int)HttpResult::Error::SEND_CLOSE_BY_PEER, nullptr,
+            "send request closed by peer: " + sock_->getRemoteAddress()->toString());
+      }
+      return std::make_shared<HttpResult>((int)HttpResult::Error::SEND_SOCKET_ERROR, nullptr,
+          "send request socket error errno=" + std::to_string(errno) + " errstr=" + std::string(strerror(errno)));
+    }
+    off += rt;
+  }
+  return nullptr;
+}
+
+HttpResult::ptr HttpConnection::recvResponse(HttpResponse::ptr rsp, bool head)
+{
+  while (true)
+  {
+    if (begin_ < end_)
+    {
+      int64_t n = parser_.execute(&buf_[begin_], end_ - begin_, *rsp, head);
+      if (n < 0)
+      {
+        reusable_ = false;
+        return std::make_shared<HttpResult>((int)HttpResult::Error::PARSE_ERROR, nullptr, "parse response error");
+      }
+      if (n > 0)
+      {
+        begin_ += n;
+        if (begin_ == end_)
+        {
+          begin_ = end_ = 0;
+        }
+        parser_.reset();
+        if (rsp->isClose())
+        {
+          reusable_ = false;
+        }
+        return std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
+      }
+    }
+
+    // 腾出空间，body较大时扩容
+    size_t need = std::max<size_t>(parser_.getNeedSize(), end_ - begin_ + 1);
+    if (end_ == buf_.size() || need > buf_.size() - begin_)
+    {
+      if (begin_ > 0)
+      {
+        memmove(&buf_[0], &buf_[begin_], end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+      }
+      if (need > buf_.size())
+      {
+        buf_.resize(std::max<size_t>(need, buf_.size() * 2));
+      }
+    }
+
+    int rt = sock_->recv(&buf_[end_], buf_.size() - end_);
+    if (rt == 0)
+    {
+      reusable_ = false;
+      if (parser_.finish(&buf_[begin_], end_ - begin_, *rsp) > 0)
+      {
+        begin_ = end_ = 0;
+        parser_.reset();
+        return std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
+      }
+      return std::make_shared<HttpResult>((int)HttpResult::Error::RECV_CLOSE_BY_PEER, nullptr,
+          "recv response closed by peer: " + sock_->getRemoteAddress()->toString());
+    }
+    if (rt < 0)
+    {
+      reusable_ = false;
+      if (errno == ETIMEDOUT || errno == EAGAIN)
+      {
+        return std::make_shared<HttpResult>((int)HttpResult::Error::TIMEOUT, nullptr,
+            "recv response timeout: " + sock_->getRemoteAddress()->toString());
+      }
+      return std::make_shared<HttpResult>((int)HttpResult::Error::RECV_SOCKET_ERROR, nullptr,
+          "recv response socket error errno=" + std::to_string(errno) + " errstr=" + std::string(strerror(errno)));
+    }
+    end_ += rt;
+  }
+}
+
+HttpResult::ptr HttpConnection::request(const HttpRequest& req, uint64_t timeout_ms, std::string_view host)
+{
+  out_.clear();
+  req.encode(out_, host);
+  sock_->setRecvTimeout(timeout_ms);
+  ++requestCount_;
+  auto err = sendAll(out_);
+  if (err)
+  {
+    return err;
+  }
+  HttpResponse::ptr rsp = std::make_shared<HttpResponse>();
+  return recvResponse(rsp, req.getMethod() == HttpMethod::HEAD);
+}
+
+std::vector<HttpResult::ptr> HttpConnection::requestBatch(const std::vector<HttpRequest>& reqs, uint64_t timeout_ms,
+                                                          std::string_view host)
+{
+  std::vector<HttpResult::ptr> results;
+  results.reserve(reqs.size());
+  out_.clear();
+  for (auto& i : reqs)
+  {
+    i.encode(out_, host);
+  }
+  sock_->setRecvTimeout(timeout_ms);
+  requestCount_ += reqs.size();
+
+  HttpResult::ptr err = sendAll(out_);
+  for (size_t i = 0; i < reqs.size() && !err; ++i)
+  {
+    HttpResponse::ptr rsp = std::make_shared<HttpResponse>();
+    auto r = recvResponse(rsp, reqs[i].getMethod() == HttpMethod::HEAD);
+    if (r->result != (int)HttpResult::Error::OK)
+    {
+      err = r;
+      break;
+    }
+    results.push_back(r);
+  }
+  while (results.size() < reqs.size())
+  {
+    results.push_back(err);
+  }
+  return results;
+}
+
+HttpConnectionPool::HttpConnectionPool(const std::string& host, uint32_t port, uint32_t max_size,
+                                       uint32_t idle_timeout_ms, uint32_t max_request)
+  : host_(host), vhost_(port == 80 ? host : host + ":" + std::to_string(port)), port_(port),
+    maxSize_(max_size), idleTimeout_(idle_timeout_ms), maxRequest_(max_request), sem_(max_size)
+{
+}
+
+HttpConnectionPool::~HttpConnectionPool()
+{
+  MutexType::Lock lock(mutex_);
+  for (auto i : conns_)
+  {
+    delete i;
+  }
+  conns_.clear();
+}
+
+bool HttpConnectionPool::isExpired(HttpConnection* conn, uint64_t now) const
+{
+  return !conn->isReusable()
+    || conn->requestCount_ >= maxRequest_
+    || conn->lastUsed_ + idleTimeout_ <= now;
+}
+
+size_t HttpConnectionPool::getIdleCount()
+{
+  MutexType::Lock lock(mutex_);
+  return conns_.size();
+}
+
+HttpConnection::ptr HttpConnectionPool::getConnection()
+{
+  sem_.wait();
+
+  uint64_t now = sylar::GetCurrentMS();
+  std::vector<HttpConnection*> invalid_conns;
+  HttpConnection* ptr = nullptr;
+  Address::ptr addr;
+  {
+    MutexType::Lock lock(mutex_);
+    // 尾部是最久未使用的，先清理过期连接
+    while (!conns_.empty() && isExpired(conns_.back(), now))
+    {
+      invalid_conns.push_back(conns_.back());
+      conns_.pop_back();
+    }
+    while (!conns_.empty())
+    {
+      auto conn = conns_.front();
+      conns_.pop_front();
+      if (isExpired(conn, now))
+      {
+        invalid_conns.push_back(conn);
+        continue;
+      }
+      ptr = conn;
+      break;
+    }
+    addr = addr_;
+  }
+  for (auto i : invalid_conns)
+  {
+    delete i;
+  }
+  total_ -= invalid_conns.size();
+
+  if (!ptr)
+  {
+    if (!addr)
+    {
+      IPAddress::ptr ipaddr = Address::LookupAnyIPAddress(host_);
+      if (!ipaddr)
+      {
+        SYLAR_LOG_ERROR(g_logger) << "get addr fail: " << host_;
+        sem_.notify();
+        return nullptr;
+      }
+      ipaddr->setPort(port_);
+      addr = ipaddr;
+      MutexType::Lock lock(mutex_);
+      addr_ = addr;
+    }
+    Socket::ptr sock = Socket::CreateTCP(addr);
+    if (!sock)
+    {
+      SYLAR_LOG_ERROR(g_logger) << "create sock fail: " << *addr;
+      sem_.notify();
+      return nullptr;
+    }
+    if (!sock->connect(addr))
+    {
+      SYLAR_LOG_ERROR(g_logger) << "sock connect fail: " << *addr;
+      sem_.notify();
+      return nullptr;
+    }
+    ptr = new HttpConnection(sock);
+    ++total_;
+    ++created_;
+  }
+  return HttpConnection::ptr(ptr, std::bind(&HttpConnectionPool::ReleasePtr,
+                             std::placeholders::_1, shared_from_this()));
+}
+
+void HttpConnectionPool::ReleasePtr(HttpConnection* ptr, HttpConnectionPool::ptr pool)
+{
+  ptr->lastUsed_ = sylar::GetCurrentMS();
+  if (pool->isExpired(ptr, ptr->lastUsed_))
+  {
+    delete ptr;
+    --pool->total_;
+  }
+  else
+  {
+    MutexType::Lock lock(pool->mutex_);
+    pool->conns_.push_front(ptr);
+  }
+  pool->sem_.notify();
+}
+
+HttpResult::ptr HttpConnectionPool::doGet(const std::string& path, uint64_t timeout_ms,
+                                          const std::map<std::string, std::string>& headers,
+                                          const std::string& body)
+{
+  return doRequest(HttpMethod::GET, path, timeout_ms, headers, body);
+}
+
+HttpResult::ptr HttpConnectionPool::doPost(const std::string& path, uint64_t timeout_ms,
+                                           const std::map<std::string, std::string>& headers,
+                                           const std::string& body)
+{
+  return doRequest(HttpMethod::POST, path, timeout_ms, headers, body);
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(HttpMethod method, const std::string& path, uint64_t timeout_ms,
+                                              const std::map<std::string, std::string>& headers,
+                                              const std::string& body)
+{
+  // HttpRequest只保存string_view，引用的参数在本次调用内一直有效
+  HttpRequest req;
+  req.setMethod(method);
+  std::string_view uri(path);
+  size_t pos = uri.find('?');
+  req.setPath(uri.substr(0, pos));
+  if (pos != std::string_view::npos)
+  {
+    req.setQuery(uri.substr(pos + 1));
+  }
+  for (auto& i : headers)
+  {
+    if (EqualsIgnoreCase(i.first, "connection"))
+    {
+      req.setClose(EqualsIgnoreCase(i.second, "close"));
+      continue;
+    }
+    req.addHeader(i.first, i.second);
+  }
+  req.setBody(body);
+  return doRequest(req, timeout_ms);
+}
+
+HttpResult::ptr HttpConnectionPool::doRequest(const HttpRequest& req, uint64_t timeout_ms)
+{
+  auto conn = getConnection();
+  if (!conn)
+  {
+    return std::make_shared<HttpResult>((int)HttpResult::Error::POOL_GET_CONNECTION, nullptr,
+        "pool host:" + host_ + " port:" + std::to_string(port_));
+  }
+  return conn->request(req, timeout_ms, vhost_);
+}
+
+std::vector<HttpResult::ptr> HttpConnectionPool::doRequestBatch(const std::vector<HttpRequest>& reqs, uint64_t timeout_ms)
+{
+  auto conn = getConnection();
+  if (!conn)
+  {
+    auto err = std::make_shared<HttpResult>((int)HttpResult::Error::POOL_GET_CONNECTION, nullptr,
+        "pool host:" + host_ + " port:" + std::to_string(port_));
+    return std::vector<HttpResult::ptr>(reqs.size(), err);
+  }
+  return conn->requestBatch(reqs, timeout_ms, vhost_);
+}
+
+HttpConnectionPool::ptr HttpConnectionPoolManager::get(const std::string& host, uint32_t port)
+{
+  std::string key = host + ":" + std::to_string(port);
+  {
+    RWMutexType::ReadLock lock(mutex_);
+    auto it = datas_.find(key);
+    if (it != datas_.end())
+    {
+      return it->second;
+    }
+  }
+  RWMutexType::WriteLock lock(mutex_);
+  auto& pool = datas_[key];
+  if (!pool)
+  {
+    pool.reset(new HttpConnectionPool(host, port, g_http_client_pool_max_size->getValue(),
+                                      g_http_client_pool_idle_timeout->getValue(),
+                                      g_http_client_pool_max_request->getValue()));
+  }
+  return pool;
+}
+
+} // namespace http
+} // namespace sylar
@@ -0,0 +1,241 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:05:33
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:05:33
+ * @FilePath: /sylar-wxb/sylar/http/http_connection.h
+ * @Description: HTTP客户端连接及连接池
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef HTTP_CONNECTION_H
+#define HTTP_CONNECTION_H
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "address.h"
+#include "http.h"
+#include "http_parser.h"
+#include "mutex.h"
+#include "singleton.h"
+#include "socket.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief HTTP请求结果
+ */
+struct HttpResult
+{
+  typedef std::shared_ptr<HttpResult> ptr;
+
+  enum class Error
+  {
+    /// 正常
+    OK = 0,
+    /// 无法解析HOST
+    INVALID_HOST = 1,
+    /// 连接失败
+    CONNECT_FAIL = 2,
+    /// 发送时连接被对端关闭
+    SEND_CLOSE_BY_PEER = 3,
+    /// 发送时socket错误
+    SEND_SOCKET_ERROR = 4,
+    /// 接收时连接被对端关闭
+    RECV_CLOSE_BY_PEER = 5,
+    /// 接收时socket错误
+    RECV_SOCKET_ERROR = 6,
+    /// 超时
+    TIMEOUT = 7,
+    /// 响应解析失败
+    PARSE_ERROR = 8,
+    /// 创建socket失败
+    CREATE_SOCKET_ERROR = 9,
+    /// 从连接池获取连接失败
+    POOL_GET_CONNECTION = 10,
+  };
+
+  HttpResult(int _result, HttpResponse::ptr _response, const std::string& _error)
+    : result(_result), response(_response), error(_error) {}
+
+  /// 错误码
+  int result;
+  /// 响应
+  HttpResponse::ptr response;
+  /// 错误描述
+  std::string error;
+
+  std::string toString() const;
+};
+
+class HttpConnectionPool;
+
+/**
+ * @brief HTTP客户端连接
+ */
+class HttpConnection
+{
+friend class HttpConnectionPool;
+public:
+  typedef std::shared_ptr<HttpConnection> ptr;
+
+  HttpConnection(Socket::ptr sock);
+
+  ~HttpConnection();
+
+  Socket::ptr getSocket() const { return sock_;}
+
+  /**
+   * @brief 发送请求并等待响应
+   * @param host 请求中没有Host头时使用的值
+   */
+  HttpResult::ptr request(const HttpRequest& req, uint64_t timeout_ms, std::string_view host = std::string_view());
+
+  /**
+   * @brief pipeline批量请求：全部请求合并成一次send，再按顺序读取响应
+   * @return 与reqs一一对应的结果，连接出错后剩余请求返回同样的错误
+   */
+  std::vector<HttpResult::ptr> requestBatch(const std::vector<HttpRequest>& reqs, uint64_t timeout_ms,
+                                            std::string_view host = std::string_view());
+
+  uint64_t getCreateTime() const { return createTime_;}
+
+  uint64_t getRequestCount() const { return requestCount_;}
+
+  /**
+   * @brief 是否可以放回连接池继续使用
+   */
+  bool isReusable() const { return reusable_ && sock_->isConnected();}
+
+private:
+  HttpResult::ptr sendAll(const std::string& out);
+
+  HttpResult::ptr recvResponse(HttpResponse::ptr rsp, bool head);
+
+private:
+  Socket::ptr sock_;
+  std::vector<char> buf_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  HttpResponseParser parser_;
+  std::string out_;
+  uint64_t createTime_ = 0;
+  uint64_t lastUsed_ = 0;
+  uint64_t requestCount_ = 0;
+  bool reusable_ = true;
+};
+
+/**
+ * @brief 同一host:port的连接池
+ * @details 最多max_size个连接，超出时请求协程挂起在FiberSemaphore上等待归还；
+ *          空闲超过idle_timeout或已处理max_request个请求的连接不再复用
+ */
+class HttpConnectionPool : public std::enable_shared_from_this<HttpConnectionPool>
+{
+public:
+  typedef std::shared_ptr<HttpConnectionPool> ptr;
+  typedef Mutex MutexType;
+
+  HttpConnectionPool(const std::string& host, uint32_t port, uint32_t max_size,
+                     uint32_t idle_timeout_ms, uint32_t max_request);
+
+  ~HttpConnectionPool();
+
+  /**
+   * @brief 获取连接，没有可用连接且已达上限时挂起等待，需在协程中调用
+   * @return 析构时自动归还连接池，连接失败返回nullptr
+   */
+  HttpConnection::ptr getConnection();
+
+  HttpResult::ptr doGet(const std::string& path, uint64_t timeout_ms,
+                        const std::map<std::string, std::string>& headers = {},
+                        const std::string& body = "");
+
+  HttpResult::ptr doPost(const std::string& path, uint64_t timeout_ms,
+                         const std::map<std::string, std::string>& headers = {},
+                         const std::string& body = "");
+
+  /**
+   * @brief 发送请求
+   * @param path 路径，可以带?query
+   */
+  HttpResult::ptr doRequest(HttpMethod method, const std::string& path, uint64_t timeout_ms,
+                            const std::map<std::string, std::string>& headers = {},
+                            const std::string& body = "");
+
+  HttpResult::ptr doRequest(const HttpRequest& req, uint64_t timeout_ms);
+
+  /**
+   * @brief 在同一连接上pipeline发送一批请求
+   */
+  std::vector<HttpResult::ptr> doRequestBatch(const std::vector<HttpRequest>& reqs, uint64_t timeout_ms);
+
+  const std::string& getHost() const { return host_;}
+
+  uint32_t getPort() const { return port_;}
+
+  /**
+   * @brief 当前存在的连接数(使用中+空闲)
+   */
+  int32_t getTotal() const { return total_;}
+
+  /**
+   * @brief 累计创建的连接数
+   */
+  uint64_t getCreated() const { return created_;}
+
+  size_t getIdleCount();
+
+private:
+  static void ReleasePtr(HttpConnection* ptr, HttpConnectionPool::ptr pool);
+
+  bool isExpired(HttpConnection* conn, uint64_t now) const;
+
+private:
+  std::string host_;
+  std::string vhost_;
+  uint32_t port_;
+  uint32_t maxSize_;
+  uint32_t idleTimeout_;
+  uint32_t maxRequest_;
+
+  MutexType mutex_;
+  /// 空闲连接，头部是最近归还的
+  std::list<HttpConnection*> conns_;
+  Address::ptr addr_;
+  std::atomic<int32_t> total_ = {0};
+  std::atomic<uint64_t> created_ = {0};
+  FiberSemaphore sem_;
+};
+
+/**
+ * @brief 按host:port管理连接池
+ */
+class HttpConnectionPoolManager
+{
+public:
+  typedef RWMutex RWMutexType;
+
+  /**
+   * @brief 获取host:port的连接池，不存在时按http.client.pool配置创建
+   */
+  HttpConnectionPool::ptr get(const std::string& host, uint32_t port);
+
+private:
+  RWMutexType mutex_;
+  std::map<std::string, HttpConnectionPool::ptr> datas_;
+};
+
+typedef sylar::Singleton<HttpConnectionPoolManager> HttpConnectionPoolMgr;
+
+} // namespace http
+} // namespace sylar
+
+#endif
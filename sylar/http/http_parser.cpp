@@ -0,0 +1,645 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:48:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:48:37
+ * @FilePath: /sylar-wxb/sylar/http/http_parser.cpp
+ * @Description: 零拷贝HTTP请求解析器
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "http_parser.h"
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_request_buffer_size =
+  sylar::Config::Lookup("http.request.buffer_size", (uint64_t)(4 * 1024), "http request buffer size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_request_max_header_size =
+  sylar::Config::Lookup("http.request.max_header_size", (uint64_t)(8 * 1024), "http request max header size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_request_max_body_size =
+  sylar::Config::Lookup("http.request.max_body_size", (uint64_t)(64 * 1024 * 1024), "http request max body size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_response_max_header_size =
+  sylar::Config::Lookup("http.response.max_header_size", (uint64_t)(8 * 1024), "http response max header size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_response_max_body_size =
+  sylar::Config::Lookup("http.response.max_body_size", (uint64_t)(64 * 1024 * 1024), "http response max body size");
+
+static uint64_t s_http_request_buffer_size = 0;
+static uint64_t s_http_request_max_header_size = 0;
+static uint64_t s_http_request_max_body_size = 0;
+static uint64_t s_http_response_max_header_size = 0;
+static uint64_t s_http_response_max_body_size = 0;
+
+namespace {
+struct _RequestSizeIniter
+{
+  _RequestSizeIniter()
+  {
+    s_http_request_buffer_size = g_http_request_buffer_size->getValue();
+    s_http_request_max_header_size = g_http_request_max_header_size->getValue();
+    s_http_request_max_body_size = g_http_request_max_body_size->getValue();
+    s_http_response_max_header_size = g_http_response_max_header_size->getValue();
+    s_http_response_max_body_size = g_http_response_max_body_size->getValue();
+
+    g_http_request_buffer_size->addListener([](const uint64_t& ov, const uint64_t& nv)
+    {
+      s_http_request_buffer_size = nv;
+    });
+    g_http_request_max_header_size->addListener([](const uint64_t& ov, const uint64_t& nv)
+    {
+      s_http_request_max_header_size = nv;
+    });
+    g_http_request_max_body_size->addListener([](const uint64_t& ov, const uint64_t& nv)
+    {
+      s_http_request_max_body_size = nv;
+    });
+    g_http_response_max_header_size->addListener([](const uint64_t& ov, const uint64_t& nv)
+    {
+      s_http_response_max_header_size = nv;
+    });
+    g_http_response_max_body_size->addListener([](const uint64_t& ov, const uint64_t& nv)
+    {
+      s_http_response_max_body_size = nv;
+    });
+  }
+};
+static _RequestSizeIniter _init;
+}
+
+uint64_t HttpRequestParser::GetHttpRequestBufferSize()
+{
+  return s_http_request_buffer_size;
+}
+
+uint64_t HttpRequestParser::GetHttpRequestMaxHeaderSize()
+{
+  return s_http_request_max_header_size;
+}
+
+uint64_t HttpRequestParser::GetHttpRequestMaxBodySize()
+{
+  return s_http_request_max_body_size;
+}
+
+uint64_t HttpResponseParser::GetHttpResponseMaxHeaderSize()
+{
+  return s_http_response_max_header_size;
+}
+
+uint64_t HttpResponseParser::GetHttpResponseMaxBodySize()
+{
+  return s_http_response_max_body_size;
+}
+
+/**
+ * @brief 去掉首尾的空格和制表符(OWS)
+ */
+static std::string_view TrimOws(std::string_view v)
+{
+  while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+  {
+    v.remove_prefix(1);
+  }
+  while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+  {
+    v.remove_suffix(1);
+  }
+  return v;
+}
+
+HttpRequestParser::HttpRequestParser()
+{
+  reset();
+}
+
+void HttpRequestParser::reset()
+{
+  scanned_ = 0;
+  start_ = 0;
+  headerLen_ = 0;
+  contentLength_ = 0;
+  parsedBase_ = nullptr;
+  hasContentLength_ = false;
+  status_ = HttpStatus::OK;
+}
+
+int64_t HttpRequestParser::execute(const char* data, size_t len, HttpRequest& req)
+{
+  if (headerLen_ == 0)
+  {
+    // 逐行查找空行，遇到不完整的行就记住位置等待更多数据
+    size_t pos = scanned_;
+    while (pos < len)
+    {
+      const char* p = (const char*)memchr(data + pos, '\n', len - pos);
+      if (!p)
+      {
+        break;
+      }
+      size_t eol = p - data;
+      size_t line_len = eol - pos;
+      if (line_len == 0 || (line_len == 1 && data[pos] == '\r'))
+      {
+        if (pos == start_)
+        {
+          // 请求行之前的空行直接忽略(RFC 7230 3.5)
+          start_ = eol + 1;
+        }
+        else
+        {
+          headerLen_ = eol + 1;
+          break;
+        }
+      }
+      pos = eol + 1;
+    }
+
+    if (headerLen_ == 0)
+    {
+      scanned_ = pos;
+      if (len - start_ > s_http_request_max_header_size)
+      {
+        status_ = HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE;
+        return -1;
+      }
+      return 0;
+    }
+    if (headerLen_ - start_ > s_http_request_max_header_size)
+    {
+      status_ = HttpStatus::REQUEST_HEADER_FIELDS_TOO_LARGE;
+      return -1;
+    }
+    if (!parseHeaders(data, req))
+    {
+      return -1;
+    }
+  }
+
+  if (len < headerLen_ + contentLength_)
+  {
+    return 0;
+  }
+  if (parsedBase_ != data)
+  {
+    // 等body期间缓冲区被搬移过，之前的string_view已失效
+    if (!parseHeaders(data, req))
+    {
+      return -1;
+    }
+  }
+  req.setBody(std::string_view(data + headerLen_, contentLength_));
+  return headerLen_ + contentLength_;
+}
+
+bool HttpRequestParser::parseHeaders(const char* data, HttpRequest& req)
+{
+  req.reset();
+  contentLength_ = 0;
+  hasContentLength_ = false;
+  parsedBase_ = data;
+
+  const char* cur = data + start_;
+  const char* end = data + headerLen_;
+  bool first = true;
+  while (cur < end)
+  {
+    const char* eol = (const char*)memchr(cur, '\n', end - cur);
+    std::string_view line(cur, eol - cur);
+    cur = eol + 1;
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.remove_suffix(1);
+    }
+    if (line.empty())
+    {
+      break;
+    }
+
+    if (first)
+    {
+      first = false;
+      if (!parseRequestLine(line, req))
+      {
+        return false;
+      }
+      continue;
+    }
+
+    if (line.front() == ' ' || line.front() == '\t')
+    {
+      // obs-fold已废弃
+      return error(HttpStatus::BAD_REQUEST);
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0
+        || line[colon - 1] == ' ' || line[colon - 1] == '\t')
+    {
+      return error(HttpStatus::BAD_REQUEST);
+    }
+    if (!onHeader(line.substr(0, colon), TrimOws(line.substr(colon + 1)), req))
+    {
+      return false;
+    }
+  }
+
+  if (contentLength_ > s_http_request_max_body_size)
+  {
+    return error(HttpStatus::PAYLOAD_TOO_LARGE);
+  }
+  return true;
+}
+
+bool HttpRequestParser::parseRequestLine(std::string_view line, HttpRequest& req)
+{
+  size_t sp1 = line.find(' ');
+  if (sp1 == std::string_view::npos)
+  {
+    return error(HttpStatus::BAD_REQUEST);
+  }
+  size_t sp2 = line.find(' ', sp1 + 1);
+  if (sp2 == std::string_view::npos)
+  {
+    return error(HttpStatus::BAD_REQUEST);
+  }
+
+  HttpMethod m = StringToHttpMethod(line.substr(0, sp1));
+  if (m == HttpMethod::INVALID_METHOD)
+  {
+    SYLAR_LOG_WARN(g_logger) << "invalid http request method: " << line.substr(0, sp1);
+    return error(HttpStatus::NOT_IMPLEMENTED);
+  }
+  req.setMethod(m);
+
+  std::string_view version = line.substr(sp2 + 1);
+  if (version.size() != 8 || version.compare(0, 7, "HTTP/1.") != 0)
+  {
+    return error(HttpStatus::HTTP_VERSION_NOT_SUPPORTED);
+  }
+  if (version[7] == '1')
+  {
+    req.setVersion(0x11);
+  }
+  else if (version[7] == '0')
+  {
+    req.setVersion(0x10);
+    req.setClose(true);
+  }
+  else
+  {
+    return error(HttpStatus::HTTP_VERSION_NOT_SUPPORTED);
+  }
+
+  std::string_view uri = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  if (uri.compare(0, 7, "http://") == 0 || uri.compare(0, 8, "https://") == 0)
+  {
+    // absolute-form，去掉scheme和host
+    size_t slash = uri.find('/', uri.find("//") + 2);
+    uri = slash == std::string_view::npos ? std::string_view("/") : uri.substr(slash);
+  }
+  size_t pos = uri.find('#');
+  if (pos != std::string_view::npos)
+  {
+    req.setFragment(uri.substr(pos + 1));
+    uri = uri.substr(0, pos);
+  }
+  pos = uri.find('?');
+  if (pos != std::string_view::npos)
+  {
+    req.setQuery(uri.substr(pos + 1));
+    uri = uri.substr(0, pos);
+  }
+  if (uri.empty() || (uri.front() != '/' && uri != "*"))
+  {
+    return error(HttpStatus::BAD_REQUEST);
+  }
+  req.setPath(uri);
+  return true;
+}
+
+bool HttpRequestParser::onHeader(std::string_view key, std::string_view val, HttpRequest& req)
+{
+  req.addHeader(key, val);
+  switch (key.size())
+  {
+    case 10:
+      if (EqualsIgnoreCase(key, "connection"))
+      {
+        if (EqualsIgnoreCase(val, "close"))
+        {
+          req.setClose(true);
+        }
+        else if (EqualsIgnoreCase(val, "keep-alive"))
+        {
+          req.setClose(false);
+        }
+      }
+      break;
+    case 14:
+      if (EqualsIgnoreCase(key, "content-length"))
+      {
+        if (val.empty() || val.size() > 19)
+        {
+          return error(HttpStatus::BAD_REQUEST);
+        }
+        uint64_t v = 0;
+        for (char c : val)
+        {
+          if (c < '0' || c > '9')
+          {
+            return error(HttpStatus::BAD_REQUEST);
+          }
+          v = v * 10 + (c - '0');
+        }
+        if (hasContentLength_ && v != contentLength_)
+        {
+          return error(HttpStatus::BAD_REQUEST);
+        }
+        hasContentLength_ = true;
+        contentLength_ = v;
+      }
+      break;
+    case 17:
+      if (EqualsIgnoreCase(key, "transfer-encoding"))
+      {
+        // 暂不支持chunked请求体
+        return error(HttpStatus::NOT_IMPLEMENTED);
+      }
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+HttpResponseParser::HttpResponseParser()
+{
+  reset();
+}
+
+void HttpResponseParser::reset()
+{
+  scanned_ = 0;
+  headerLen_ = 0;
+  contentLength_ = 0;
+  chunked_ = false;
+  untilClose_ = false;
+}
+
+int64_t HttpResponseParser::execute(const char* data, size_t len, HttpResponse& rsp, bool head)
+{
+  if (headerLen_ == 0)
+  {
+    size_t pos = scanned_;
+    while (pos < len)
+    {
+      const char* p = (const char*)memchr(data + pos, '\n', len - pos);
+      if (!p)
+      {
+        break;
+      }
+      size_t eol = p - data;
+      size_t line_len = eol - pos;
+      if (pos > 0 && (line_len == 0 || (line_len == 1 && data[pos] == '\r')))
+      {
+        headerLen_ = eol + 1;
+        break;
+      }
+      pos = eol + 1;
+    }
+    if (headerLen_ == 0)
+    {
+      scanned_ = pos;
+      return len > s_http_response_max_header_size ? -1 : 0;
+    }
+    if (!parseHeaders(data, rsp, head))
+    {
+      return -1;
+    }
+  }
+
+  if (chunked_)
+  {
+    int64_t n = parseChunked(data + headerLen_, len - headerLen_, rsp);
+    return n <= 0 ? n : headerLen_ + n;
+  }
+  if (untilClose_ || len < headerLen_ + contentLength_)
+  {
+    return 0;
+  }
+  rsp.setBody(std::string(data + headerLen_, contentLength_));
+  return headerLen_ + contentLength_;
+}
+
+int64_t HttpResponseParser::finish(const char* data, size_t len, HttpResponse& rsp)
+{
+  if (headerLen_ == 0 || !untilClose_)
+  {
+    return -1;
+  }
+  rsp.setBody(std::string(data + headerLen_, len - headerLen_));
+  return len;
+}
+
+bool HttpResponseParser::parseHeaders(const char* data, HttpResponse& rsp, bool head)
+{
+  rsp.reset();
+  const char* cur = data;
+  const char* end = data + headerLen_;
+  bool first = true;
+  bool has_length = false;
+  while (cur < end)
+  {
+    const char* eol = (const char*)memchr(cur, '\n', end - cur);
+    std::string_view line(cur, eol - cur);
+    cur = eol + 1;
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.remove_suffix(1);
+    }
+    if (line.empty())
+    {
+      break;
+    }
+
+    if (first)
+    {
+      // HTTP/1.1 200 OK
+      first = false;
+      if (line.size() < 12 || line.compare(0, 7, "HTTP/1.") != 0 || line[8] != ' ')
+      {
+        return false;
+      }
+      rsp.setVersion(line[7] == '0' ? 0x10 : 0x11);
+      rsp.setClose(line[7] == '0');
+      int code = 0;
+      for (size_t i = 9; i < 12; ++i)
+      {
+        if (line[i] < '0' || line[i] > '9')
+        {
+          return false;
+        }
+        code = code * 10 + (line[i] - '0');
+      }
+      rsp.setStatus((HttpStatus)code);
+      if (line.size() > 13)
+      {
+        rsp.setReason(std::string(line.substr(13)));
+      }
+      continue;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0)
+    {
+      return false;
+    }
+    std::string_view key = line.substr(0, colon);
+    std::string_view val = TrimOws(line.substr(colon + 1));
+    if (EqualsIgnoreCase(key, "content-length"))
+    {
+      uint64_t v = 0;
+      for (char c : val)
+      {
+        if (c < '0' || c > '9')
+        {
+          return false;
+        }
+        v = v * 10 + (c - '0');
+      }
+      contentLength_ = v;
+      has_length = true;
+    }
+    else if (EqualsIgnoreCase(key, "transfer-encoding"))
+    {
+      chunked_ = val.size() >= 7 && EqualsIgnoreCase(val.substr(val.size() - 7), "chunked");
+    }
+    else if (EqualsIgnoreCase(key, "connection"))
+    {
+      if (EqualsIgnoreCase(val, "close"))
+      {
+        rsp.setClose(true);
+      }
+      else if (EqualsIgnoreCase(val, "keep-alive"))
+      {
+        rsp.setClose(false);
+      }
+    }
+    rsp.addHeader(std::string(key), std::string(val));
+  }
+
+  uint32_t code = (uint32_t)rsp.getStatus();
+  if (head || code / 100 == 1 || code == 204 || code == 304)
+  {
+    // 这些响应没有body
+    chunked_ = false;
+    contentLength_ = 0;
+  }
+  else if (!chunked_ && !has_length)
+  {
+    untilClose_ = true;
+    rsp.setClose(true);
+  }
+  return contentLength_ <= s_http_response_max_body_size;
+}
+
+int64_t HttpResponseParser::parseChunked(const char* data, size_t len, HttpResponse& rsp)
+{
+  // 先确认所有chunk都已到达再解码，数据不完整时不修改rsp
+  size_t pos = 0;
+  uint64_t total = 0;
+  while (true)
+  {
+    const char* p = (const char*)memchr(data + pos, '\n', len - pos);
+    if (!p)
+    {
+      return 0;
+    }
+    uint64_t size = 0;
+    int digits = 0;
+    for (const char* c = data + pos; c < p; ++c)
+    {
+      int v = isdigit(*c) ? *c - '0' : (isxdigit(*c) ? (tolower(*c) - 'a' + 10) : -1);
+      if (v < 0)
+      {
+        break; // chunk扩展或\r
+      }
+      if (++digits > 16)
+      {
+        return -1; // 超过uint64_t范围
+      }
+      size = size * 16 + v;
+    }
+    if (!digits)
+    {
+      return -1;
+    }
+    pos = p - data + 1;
+    if (size == 0)
+    {
+      // 跳过trailer直到空行
+      while (true)
+      {
+        const char* e = (const char*)memchr(data + pos, '\n', len - pos);
+        if (!e)
+        {
+          return 0;
+        }
+        size_t line_len = e - (data + pos);
+        pos = e - data + 1;
+        if (line_len == 0 || (line_len == 1 && data[pos - 2] == '\r'))
+        {
+          break;
+        }
+      }
+      break;
+    }
+    if (size > s_http_response_max_body_size - total)
+    {
+      return -1;
+    }
+    total += size;
+    if (len < pos + size + 2)
+    {
+      return 0;
+    }
+    // chunk数据后必须紧跟\r\n
+    if (data[pos + size] != '\r' || data[pos + size + 1] != '\n')
+    {
+      return -1;
+    }
+    pos += size + 2;
+  }
+
+  std::string& body = rsp.getBodyRef();
+  body.clear();
+  body.reserve(total);
+  size_t cur = 0;
+  while (true)
+  {
+    const char* p = (const char*)memchr(data + cur, '\n', pos - cur);
+    uint64_t size = strtoull(data + cur, nullptr, 16);
+    cur = p - data + 1;
+    if (size == 0)
+    {
+      break;
+    }
+    body.append(data + cur, size);
+    cur += size + 2;
+  }
+  return pos;
+}
+
+} // namespace http
+} // namespace sylar
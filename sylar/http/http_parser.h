@@ -0,0 +1,162 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:48:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:48:37
+ * @FilePath: /sylar-wxb/sylar/http/http_parser.h
+ * @Description: 零拷贝HTTP请求解析器
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "http.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief HTTP请求解析器
+ * @details 用memchr按行扫描接收缓冲区，解析结果全部是指向缓冲区的string_view。
+ *          数据不完整时记住已扫描的位置，下次从断点继续找头部结束，避免重复扫描。
+ *          同一连接上的pipeline请求依次调用execute，每个请求完成后reset。
+ */
+class HttpRequestParser
+{
+public:
+  typedef std::shared_ptr<HttpRequestParser> ptr;
+
+  HttpRequestParser();
+
+  /**
+   * @brief 解析data开头的一个请求
+   * @param data 缓冲区中未处理数据的起始地址，两次调用之间数据可以被整体搬移
+   * @param len 未处理数据的长度
+   * @param req 解析结果，引用data中的数据
+   * @return >0 完整请求占用的字节数，0 数据不完整需要继续读，-1 出错(getStatus为应答状态)
+   */
+  int64_t execute(const char* data, size_t len, HttpRequest& req);
+
+  /**
+   * @brief 开始解析下一个请求
+   */
+  void reset();
+
+  /**
+   * @brief 出错时应答的状态码
+   */
+  HttpStatus getStatus() const { return status_;}
+
+  /**
+   * @brief 当前请求完整需要的字节数，头部未解析完成时为0
+   */
+  uint64_t getNeedSize() const { return headerLen_ ? headerLen_ + contentLength_ : 0;}
+
+  /**
+   * @brief 返回连接接收缓冲区的初始大小
+   */
+  static uint64_t GetHttpRequestBufferSize();
+
+  /**
+   * @brief 返回请求头部的最大长度
+   */
+  static uint64_t GetHttpRequestMaxHeaderSize();
+
+  /**
+   * @brief 返回请求body的最大长度
+   */
+  static uint64_t GetHttpRequestMaxBodySize();
+
+private:
+  /**
+   * @brief 解析[start_, headerLen_)之间的请求行和头部
+   */
+  bool parseHeaders(const char* data, HttpRequest& req);
+
+  bool parseRequestLine(std::string_view line, HttpRequest& req);
+
+  bool onHeader(std::string_view key, std::string_view val, HttpRequest& req);
+
+  bool error(HttpStatus s) { status_ = s; return false;}
+
+private:
+  /// 下次查找头部结束时开始的位置
+  size_t scanned_;
+  /// 请求行之前的空行长度
+  size_t start_;
+  /// 头部(含结尾空行)长度，0表示还没找到头部结束
+  size_t headerLen_;
+  /// body长度
+  uint64_t contentLength_;
+  /// 上次解析头部时的数据地址，数据被搬移后需要重新解析
+  const char* parsedBase_;
+  bool hasContentLength_;
+  HttpStatus status_;
+};
+
+/**
+ * @brief HTTP响应解析器(客户端使用)
+ * @details 响应头和body都拷贝到HttpResponse中，支持content-length、chunked以及读到连接关闭为止三种body
+ */
+class HttpResponseParser
+{
+public:
+  typedef std::shared_ptr<HttpResponseParser> ptr;
+
+  HttpResponseParser();
+
+  /**
+   * @brief 解析data开头的一个响应
+   * @param head 是否是HEAD请求的响应(没有body)
+   * @return >0 完整响应占用的字节数，0 数据不完整需要继续读，-1 出错
+   */
+  int64_t execute(const char* data, size_t len, HttpResponse& rsp, bool head = false);
+
+  /**
+   * @brief 连接关闭时调用，body以连接关闭为结束的响应在此完成
+   * @return 完整响应占用的字节数，不完整返回-1
+   */
+  int64_t finish(const char* data, size_t len, HttpResponse& rsp);
+
+  void reset();
+
+  /**
+   * @brief 当前响应完整需要的字节数，未知时为0
+   */
+  uint64_t getNeedSize() const { return headerLen_ && !chunked_ && !untilClose_ ? headerLen_ + contentLength_ : 0;}
+
+  /**
+   * @brief 返回响应头部的最大长度
+   */
+  static uint64_t GetHttpResponseMaxHeaderSize();
+
+  /**
+   * @brief 返回响应body的最大长度
+   */
+  static uint64_t GetHttpResponseMaxBodySize();
+
+private:
+  bool parseHeaders(const char* data, HttpResponse& rsp, bool head);
+
+  /**
+   * @brief 检查chunked body是否完整，完整时解码到rsp并返回body占用的字节数，不完整返回0，出错返回-1
+   */
+  int64_t parseChunked(const char* data, size_t len, HttpResponse& rsp);
+
+private:
+  size_t scanned_;
+  size_t headerLen_;
+  uint64_t contentLength_;
+  bool chunked_;
+  bool untilClose_;
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 14:45:12
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 14:45:12
+ * @FilePath: /sylar-wxb/sylar/http/http_server.cpp
+ * @Description: HTTP/1.1服务器
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <cstring>
+
+#include "http_server.h"
+#include "http_parser.h"
+#include "log.h"
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+HttpServer::HttpServer(bool keepalive, IOManager* io_worker, IOManager* accept_worker)
+  : TcpServer(io_worker, accept_worker), isKeepalive_(keepalive)
+{
+  dispatch_.reset(new ServletDispatch);
+  type_ = "http";
+}
+
+void HttpServer::setName(const std::string& v)
+{
+  TcpServer::setName(v);
+  dispatch_->setDefault(std::make_shared<NotFoundServlet>(v));
+}
+
+bool HttpServer::sendAll(Socket::ptr client, const std::string& out)
+{
+  size_t off = 0;
+  while (off < out.size())
+  {
+    int rt = client->send(out.data() + off, out.size() - off);
+    if (rt <= 0)
+    {
+      return false;
+    }
+    off += rt;
+  }
+  return true;
+}
+
+void HttpServer::handleClient(Socket::ptr client)
+{
+  SYLAR_LOG_DEBUG(g_logger) << "handleClient " << *client;
+  uint64_t buff_size = HttpRequestParser::GetHttpRequestBufferSize();
+  std::unique_ptr<char[]> buff(new char[buff_size]);
+  size_t begin = 0; // 未处理数据的起始位置
+  size_t end = 0;   // 已读数据的结束位置
+
+  HttpRequestParser parser;
+  HttpRequest req;
+  HttpResponse rsp;
+  std::string out;
+  bool close = false;
+
+  while (!close)
+  {
+    // 保证有空间可读：先把未处理数据搬到开头，仍不够(请求体较大)再扩容
+    size_t need = std::max<size_t>(parser.getNeedSize(), end - begin + 1);
+    if (end == buff_size || need > buff_size - begin)
+    {
+      if (begin > 0)
+      {
+        memmove(buff.get(), buff.get() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+      }
+      if (need > buff_size)
+      {
+        size_t nsize = std::max<size_t>(need, buff_size * 2);
+        std::unique_ptr<char[]> nbuff(new char[nsize]);
+        memcpy(nbuff.get(), buff.get(), end);
+        buff.swap(nbuff);
+        buff_size = nsize;
+      }
+    }
+
+    int rt = client->recv(buff.get() + end, buff_size - end);
+    if (rt <= 0)
+    {
+      SYLAR_LOG_DEBUG(g_logger) << "recv http request fail, errno=" << errno
+        << " errstr=" << strerror(errno) << " client:" << *client;
+      break;
+    }
+    end += rt;
+
+    // 处理本次读到的所有完整请求
+    while (begin < end)
+    {
+      int64_t n = parser.execute(buff.get() + begin, end - begin, req);
+      if (n == 0)
+      {
+        break;
+      }
+      if (n < 0)
+      {
+        SYLAR_LOG_DEBUG(g_logger) << "parse http request fail, status=" << (int)parser.getStatus()
+          << " client:" << *client;
+        rsp.reset();
+        rsp.setVersion(0x11);
+        rsp.setStatus(parser.getStatus());
+        rsp.setClose(true);
+        rsp.encode(out);
+        close = true;
+        break;
+      }
+
+      rsp.reset();
+      rsp.setVersion(req.getVersion());
+      rsp.setClose(req.isClose() || !isKeepalive_);
+      rsp.setHeader("Server", getName());
+      dispatch_->handle(req, rsp, client);
+      rsp.encode(out);
+
+      begin += n;
+      parser.reset();
+      if (rsp.isClose())
+      {
+        close = true;
+        break;
+      }
+    }
+    if (begin == end)
+    {
+      begin = end = 0;
+    }
+
+    if (!out.empty())
+    {
+      if (!sendAll(client, out))
+      {
+        break;
+      }
+      out.clear();
+    }
+  }
+  client->close();
+}
+
+} // namespace http
+} // namespace sylar
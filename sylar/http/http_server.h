@@ -0,0 +1,69 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 14:45:12
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 14:45:12
+ * @FilePath: /sylar-wxb/sylar/http/http_server.h
+ * @Description: HTTP/1.1服务器
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <memory>
+#include <string>
+
+#include "tcp_server.h"
+#include "http.h"
+#include "servlet.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief HTTP服务器
+ * @details 每个连接一个协程：读入的数据里有多少个完整请求就依次处理多少个(pipeline)，
+ *          这些请求的响应合并成一次send；请求对象直接引用接收缓冲区，不拷贝
+ */
+class HttpServer : public TcpServer
+{
+public:
+  typedef std::shared_ptr<HttpServer> ptr;
+
+  /**
+   * @brief 构造函数
+   * @param keepalive 是否支持长连接
+   * @param io_worker 连接读写和servlet执行的调度器
+   * @param accept_worker 接收连接的调度器
+   */
+  HttpServer(bool keepalive = false,
+             IOManager* io_worker = IOManager::GetThis(),
+             IOManager* accept_worker = IOManager::GetThis());
+
+  ServletDispatch::ptr getServletDispatch() const { return dispatch_;}
+
+  void setServletDispatch(ServletDispatch::ptr v) { dispatch_ = v;}
+
+  virtual void setName(const std::string& v) override;
+
+  bool isKeepalive() const { return isKeepalive_;}
+
+protected:
+  virtual void handleClient(Socket::ptr client) override;
+
+private:
+  /**
+   * @brief 发送out中的全部数据
+   */
+  bool sendAll(Socket::ptr client, const std::string& out);
+
+private:
+  bool isKeepalive_;
+  ServletDispatch::ptr dispatch_;
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 14:21:50
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 14:21:50
+ * @FilePath: /sylar-wxb/sylar/http/servlet.cpp
+ * @Description: HTTP Servlet及路由分发
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <algorithm>
+#include <fnmatch.h>
+#include <sstream>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "profiler.h"
+#include "servlet.h"
+
+namespace sylar {
+namespace http {
+
+FunctionServlet::FunctionServlet(callback cb)
+  : Servlet("FunctionServlet"), cb_(cb)
+{
+}
+
+int32_t FunctionServlet::handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session)
+{
+  return cb_(request, response, session);
+}
+
+ServletDispatch::ServletDispatch()
+  : Servlet("ServletDispatch")
+{
+  default_.reset(new NotFoundServlet("sylar/1.0"));
+}
+
+int32_t ServletDispatch::handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session)
+{
+  auto slt = getMatchedServlet(request.getPath());
+  if (slt)
+  {
+    slt->handle(request, response, session);
+  }
+  return 0;
+}
+
+void ServletDispatch::addServlet(const std::string& uri, Servlet::ptr slt)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  datas_[uri] = slt;
+}
+
+void ServletDispatch::addServlet(const std::string& uri, FunctionServlet::callback cb)
+{
+  addServlet(uri, std::make_shared<FunctionServlet>(cb));
+}
+
+void ServletDispatch::addGlobServlet(const std::string& uri, Servlet::ptr slt)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  for (auto it = globs_.begin(); it != globs_.end(); ++it)
+  {
+    if (it->first == uri)
+    {
+      globs_.erase(it);
+      break;
+    }
+  }
+  globs_.push_back(std::make_pair(uri, slt));
+}
+
+void ServletDispatch::addGlobServlet(const std::string& uri, FunctionServlet::callback cb)
+{
+  addGlobServlet(uri, std::make_shared<FunctionServlet>(cb));
+}
+
+void ServletDispatch::delServlet(const std::string& uri)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  datas_.erase(uri);
+}
+
+void ServletDispatch::delGlobServlet(const std::string& uri)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  for (auto it = globs_.begin(); it != globs_.end(); ++it)
+  {
+    if (it->first == uri)
+    {
+      globs_.erase(it);
+      break;
+    }
+  }
+}
+
+Servlet::ptr ServletDispatch::getServlet(const std::string& uri)
+{
+  RWMutexType::ReadLock lock(mutex_);
+  auto it = datas_.find(uri);
+  return it == datas_.end() ? nullptr : it->second;
+}
+
+Servlet::ptr ServletDispatch::getGlobServlet(const std::string& uri)
+{
+  RWMutexType::ReadLock lock(mutex_);
+  for (auto it = globs_.begin(); it != globs_.end(); ++it)
+  {
+    if (it->first == uri)
+    {
+      return it->second;
+    }
+  }
+  return nullptr;
+}
+
+Servlet::ptr ServletDispatch::getMatchedServlet(std::string_view uri)
+{
+  RWMutexType::ReadLock lock(mutex_);
+  auto mit = datas_.find(uri);
+  if (mit != datas_.end())
+  {
+    return mit->second;
+  }
+  if (!globs_.empty())
+  {
+    // fnmatch需要以'\0'结尾的字符串，复用线程局部缓冲避免每次分配
+    static thread_local std::string s_path;
+    s_path.assign(uri.data(), uri.size());
+    for (auto it = globs_.begin(); it != globs_.end(); ++it)
+    {
+      if (!fnmatch(it->first.c_str(), s_path.c_str(), 0))
+      {
+        return it->second;
+      }
+    }
+  }
+  return default_;
+}
+
+NotFoundServlet::NotFoundServlet(const std::string& name)
+  : Servlet("NotFoundServlet")
+{
+  content_ = "<html><head><title>404 Not Found"
+    "</title></head><body><center><h1>404 Not Found</h1></center>"
+    "<hr><center>" + name + "</center></body></html>";
+}
+
+int32_t NotFoundServlet::handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session)
+{
+  response.setStatus(HttpStatus::NOT_FOUND);
+  response.setHeader("Server", "sylar/1.0.0");
+  response.setHeader("Content-Type", "text/html");
+  response.setBody(content_);
+  return 0;
+}
+
+MetricsServlet::MetricsServlet(MetricsRegistry* registry)
+  : Servlet("MetricsServlet")
+  , registry_(registry ? registry : MetricsMgr::GetInstance())
+{
+}
+
+int32_t MetricsServlet::handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session)
+{
+  response.setHeader("Content-Type", "text/plain; version=0.0.4");
+  response.setBody(registry_->toPrometheus());
+  return 0;
+}
+
+/**
+ * @brief 取query中key对应的值，不存在返回def
+ */
+static std::string GetQueryParam(std::string_view query, std::string_view key, const std::string& def)
+{
+  while (!query.empty())
+  {
+    size_t pos = query.find('&');
+    std::string_view kv = query.substr(0, pos);
+    size_t eq = kv.find('=');
+    if (kv.substr(0, eq) == key)
+    {
+      return eq == std::string_view::npos ? std::string() : std::string(kv.substr(eq + 1));
+    }
+    if (pos == std::string_view::npos) break;
+    query.remove_prefix(pos + 1);
+  }
+  return def;
+}
+
+ProfilerServlet::ProfilerServlet(uint32_t max_seconds)
+  : Servlet("ProfilerServlet")
+  , maxSeconds_(max_seconds)
+{
+}
+
+int32_t ProfilerServlet::handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session)
+{
+  uint32_t seconds = atoi(GetQueryParam(request.getQuery(), "seconds", "10").c_str());
+  uint32_t hz = atoi(GetQueryParam(request.getQuery(), "hz", "0").c_str());
+  std::string format = GetQueryParam(request.getQuery(), "format", "folded");
+  seconds = std::max(1u, std::min(seconds, maxSeconds_));
+
+  response.setHeader("Content-Type", "text/plain");
+  if (!CpuProfiler::Start(hz))
+  {
+    response.setStatus(HttpStatus::SERVICE_UNAVAILABLE);
+    response.setBody("profiler is busy\n");
+    return 0;
+  }
+  sleep(seconds); // hook后只挂起当前协程
+  CpuProfiler::Stop();
+
+  std::stringstream ss;
+  if (format == "top")
+  {
+    CpuProfiler::WriteTop(ss);
+  }
+  else
+  {
+    CpuProfiler::WriteFolded(ss, format == "fiber");
+  }
+  response.setBody(ss.str());
+  return 0;
+}
+
+} // namespace http
+} // namespace sylar
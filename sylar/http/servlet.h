@@ -0,0 +1,190 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 14:21:50
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 14:21:50
+ * @FilePath: /sylar-wxb/sylar/http/servlet.h
+ * @Description: HTTP Servlet及路由分发
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef HTTP_SERVLET_H
+#define HTTP_SERVLET_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "http.h"
+#include "mutex.h"
+#include "socket.h"
+
+namespace sylar {
+
+class MetricsRegistry;
+
+namespace http {
+
+/**
+ * @brief Servlet基类
+ */
+class Servlet
+{
+public:
+  typedef std::shared_ptr<Servlet> ptr;
+
+  Servlet(const std::string& name) : name_(name) {}
+
+  virtual ~Servlet() {}
+
+  /**
+   * @brief 处理请求
+   * @param request 请求，只在本次调用期间有效
+   * @param response 响应
+   * @param session 连接
+   * @return 是否处理成功
+   */
+  virtual int32_t handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session) = 0;
+
+  const std::string& getName() const { return name_;}
+
+protected:
+  std::string name_;
+};
+
+/**
+ * @brief 函数式Servlet
+ */
+class FunctionServlet : public Servlet
+{
+public:
+  typedef std::shared_ptr<FunctionServlet> ptr;
+  typedef std::function<int32_t(const HttpRequest& request, HttpResponse& response, Socket::ptr session)> callback;
+
+  FunctionServlet(callback cb);
+
+  virtual int32_t handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session) override;
+
+private:
+  callback cb_;
+};
+
+/**
+ * @brief Servlet分发器
+ * @details 先精确匹配，再按添加顺序做通配(fnmatch)匹配，都不命中返回默认Servlet
+ */
+class ServletDispatch : public Servlet
+{
+public:
+  typedef std::shared_ptr<ServletDispatch> ptr;
+  typedef RWMutex RWMutexType;
+
+  ServletDispatch();
+
+  virtual int32_t handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session) override;
+
+  /**
+   * @brief 添加精确匹配servlet
+   */
+  void addServlet(const std::string& uri, Servlet::ptr slt);
+
+  void addServlet(const std::string& uri, FunctionServlet::callback cb);
+
+  /**
+   * @brief 添加通配匹配servlet，uri按fnmatch规则匹配，如 /static/ 前缀通配
+   */
+  void addGlobServlet(const std::string& uri, Servlet::ptr slt);
+
+  void addGlobServlet(const std::string& uri, FunctionServlet::callback cb);
+
+  void delServlet(const std::string& uri);
+
+  void delGlobServlet(const std::string& uri);
+
+  Servlet::ptr getDefault() const { return default_;}
+
+  void setDefault(Servlet::ptr v) { default_ = v;}
+
+  Servlet::ptr getServlet(const std::string& uri);
+
+  Servlet::ptr getGlobServlet(const std::string& uri);
+
+  /**
+   * @brief 按 精确->通配->默认 的顺序查找servlet
+   */
+  Servlet::ptr getMatchedServlet(std::string_view uri);
+
+private:
+  RWMutexType mutex_;
+  /// 精确匹配，std::less<>支持直接用string_view查找，不需要构造string
+  std::map<std::string, Servlet::ptr, std::less<>> datas_;
+  /// 通配匹配
+  std::vector<std::pair<std::string, Servlet::ptr>> globs_;
+  /// 默认servlet
+  Servlet::ptr default_;
+};
+
+/**
+ * @brief 404 Servlet
+ */
+class NotFoundServlet : public Servlet
+{
+public:
+  typedef std::shared_ptr<NotFoundServlet> ptr;
+
+  NotFoundServlet(const std::string& name);
+
+  virtual int32_t handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session) override;
+
+private:
+  std::string content_;
+};
+
+/**
+ * @brief 以Prometheus文本格式输出指标注册表，供拉取，如 addServlet("/metrics", ...)
+ */
+class MetricsServlet : public Servlet
+{
+public:
+  typedef std::shared_ptr<MetricsServlet> ptr;
+
+  /**
+   * @param registry 指标注册表，为空使用MetricsMgr
+   */
+  MetricsServlet(MetricsRegistry* registry = nullptr);
+
+  virtual int32_t handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session) override;
+
+private:
+  MetricsRegistry* registry_;
+};
+
+/**
+ * @brief 按请求采样cpu，如 addServlet("/profile", ...)
+ * @details GET /profile?seconds=10&hz=99&format=folded|top|fiber，
+ *          采样期间处理协程睡眠不占线程；format=folded输出折叠栈(默认)，
+ *          fiber按单个协程展开，top按协程入口汇总。已有采样在进行时返回503
+ */
+class ProfilerServlet : public Servlet
+{
+public:
+  typedef std::shared_ptr<ProfilerServlet> ptr;
+
+  /**
+   * @param max_seconds 允许的最长采样时间
+   */
+  ProfilerServlet(uint32_t max_seconds = 60);
+
+  virtual int32_t handle(const HttpRequest& request, HttpResponse& response, Socket::ptr session) override;
+
+private:
+  uint32_t maxSeconds_;
+};
+
+} // namespace http
+} // namespace sylar
+
+#endif
@@ -9,10 +9,17 @@
  * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
  */
 #include "iomanager.h"
+#include "config.h"
+#include "hook.h"
 #include "log.h"
 #include "macro.h"
+#include "util.h"
+#include <algorithm>
 
 #include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -21,6 +28,41 @@ namespace sylar {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static sylar::ConfigVar<bool>::ptr g_iomanager_inline_dispatch =
+  sylar::Config::Lookup("iomanager.inline_dispatch", false, "resume fibers woken by io inline on the polling thread");
+
+static sylar::ConfigVar<uint32_t>::ptr g_iomanager_inline_budget =
+  sylar::Config::Lookup("iomanager.inline_budget", (uint32_t)64, "max fibers resumed inline per epoll_wait");
+
+static sylar::ConfigVar<uint32_t>::ptr g_iomanager_busy_poll_us =
+  sylar::Config::Lookup("iomanager.busy_poll_us", (uint32_t)0, "max busy-poll time (us) of an idle thread before blocking in epoll_wait, 0 disables");
+
+static sylar::ConfigVar<uint32_t>::ptr g_iomanager_socket_busy_poll_us =
+  sylar::Config::Lookup("iomanager.socket_busy_poll_us", (uint32_t)0, "SO_BUSY_POLL (us) set on sockets when first registered, 0 disables");
+
+static sylar::ConfigVar<bool>::ptr g_iomanager_epoll_pwait2 =
+  sylar::Config::Lookup("iomanager.epoll_pwait2", true, "wait with epoll_pwait2 (us timeout) when the kernel supports it, otherwise use a timerfd");
+
+#ifndef SYS_epoll_pwait2
+#define SYS_epoll_pwait2 441
+#endif
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+/**
+ * @brief 自旋等待时让出流水线
+ */
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
 enum EpollCtlOp
 {
 
@@ -72,47 +114,64 @@ static std::ostream& operator<< (std::ostream& os, EPOLL_EVENTS events)
   return os;
 }
 
-IOManager::FdContext::EventContext& IOManager::FdContext::getContext(IOManager::Event event)
+IOManager::FdContext::EventContext& IOManager::GetContext(FdContext* fd_ctx, IOManager::Event event)
 {
   switch(event)
   {
     case IOManager::READ:
-      return read;
+      return fd_ctx->read;
     case IOManager::WRITE:
-      return write;
+      return fd_ctx->write;
     default:
       SYLAR_ASSERT2(false, "getContext");
   }
   throw std::invalid_argument("getContext invalid event");
 }
 
-void IOManager::FdContext::resetContext(EventContext& ctx)
+void IOManager::ResetContext(FdContext::EventContext& ctx)
 {
   ctx.scheduler = nullptr;
+  ctx.iom = nullptr;
   ctx.fiber.reset();
   ctx.cb = nullptr;
 }
 
-void IOManager::FdContext::triggerEvent(IOManager::Event event)
+void IOManager::TriggerEvent(FdContext* fd_ctx, IOManager::Event event)
 {
-  //SYLAR_LOG_INFO(g_logger) << "fd=" << fd
-  //    << " triggerEvent event=" << event
-  //    << " events=" << events;
-  SYLAR_ASSERT(events & event);
-  //if(SYLAR_UNLIKELY(!(event & event))) {
-  //    return;
-  //}
-  events = (Event)(events & ~event); // 计算与当前事件未重合的事件，赋值给成员变量
-  EventContext& ctx = getContext(event);
+  SYLAR_ASSERT(fd_ctx->events & event);
+  fd_ctx->events = fd_ctx->events & ~event; // 计算与当前事件未重合的事件，赋值给成员变量
+  FdContext::EventContext& ctx = GetContext(fd_ctx, event);
   if(ctx.cb) ctx.scheduler->schedule(&ctx.cb);
   else ctx.scheduler->schedule(&ctx.fiber);
 
+  --ctx.iom->pendingEventCount_;
   ctx.scheduler = nullptr;
+  ctx.iom = nullptr;
   return;
 }
 
-IOManager::IOManager(size_t threads, bool use_caller, const std::string& name)
+void IOManager::dispatchEvent(FdContext* fd_ctx, Event event, std::vector<Fiber::ptr>& ready)
+{
+  FdContext::EventContext& ctx = GetContext(fd_ctx, event);
+  if(inlineDispatch_ && ctx.fiber && ctx.scheduler == this && ready.size() < inlineBudget_)
+  {
+    SYLAR_ASSERT(fd_ctx->events & event);
+    fd_ctx->events &= ~event;
+    ready.push_back(std::move(ctx.fiber));
+    --ctx.iom->pendingEventCount_;
+    ResetContext(ctx);
+    return;
+  }
+  TriggerEvent(fd_ctx, event);
+}
+
+IOManager::IOManager(size_t threads, bool use_caller, const std::string& name
+                     , const Placement& placement)
   :Scheduler(threads, use_caller, name)
+  ,inlineDispatch_(g_iomanager_inline_dispatch->getValue())
+  ,inlineBudget_(g_iomanager_inline_budget->getValue())
+  ,busyPollUs_(g_iomanager_busy_poll_us->getValue())
+  ,socketBusyPollUs_(g_iomanager_socket_busy_poll_us->getValue())
 {
     epfd_ = epoll_create(5000);
     SYLAR_ASSERT(epfd_ > 0);
@@ -131,59 +190,62 @@ IOManager::IOManager(size_t threads, bool use_caller, const std::string& name)
     rt = epoll_ctl(epfd_, EPOLL_CTL_ADD, tickleFds_[0], &event);
     SYLAR_ASSERT(!rt);
 
-    contextResize(32);
+    bool pwait2 = g_iomanager_epoll_pwait2->getValue();
+    if(pwait2) // 探测内核是否支持epoll_pwait2(5.11+)
+    {
+      struct timespec ts = {0, 0};
+      if(syscall(SYS_epoll_pwait2, epfd_, &event, 1, &ts, nullptr, 0) < 0 && errno == ENOSYS)
+      {
+        SYLAR_LOG_INFO(g_logger) << "epoll_pwait2 not supported, fallback to timerfd";
+        pwait2 = false;
+      }
+    }
+    if(!pwait2) // 定时器时间到时由timerfd唤醒，和定时器同为CLOCK_REALTIME
+    {
+      timerFd_ = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+      SYLAR_ASSERT(timerFd_ >= 0);
+      event.events = EPOLLIN | EPOLLET;
+      event.data.fd = timerFd_;
+      rt = epoll_ctl(epfd_, EPOLL_CTL_ADD, timerFd_, &event);
+      SYLAR_ASSERT(!rt);
+    }
 
+    setPlacement(placement);
     start();
 }
 
 IOManager::~IOManager()
 {
   stop();
-  close(epfd_);
-  close(tickleFds_[0]);
-  close(tickleFds_[1]);
-
-  for(size_t i = 0; i < fdContexts_.size(); ++i)
+  // 注册在本epoll上的fd交给下一个等待它的IOManager重新注册
+  FdMgr::GetInstance()->foreach([this](FdContext* fd_ctx)
   {
-    if(fdContexts_[i])
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if(fd_ctx->owner == this)
     {
-      delete fdContexts_[i];
+      fd_ctx->owner = nullptr;
+      fd_ctx->ready = NONE;
     }
-  }
-}
-
-void IOManager::contextResize(size_t size)
-{
-  fdContexts_.resize(size);
-
-  for(size_t i = 0; i < fdContexts_.size(); ++i)
+  });
+  close(epfd_);
+  close(tickleFds_[0]);
+  close(tickleFds_[1]);
+  if(timerFd_ >= 0)
   {
-    if(!fdContexts_[i])
-    {
-      fdContexts_[i] = new FdContext;
-      fdContexts_[i]->fd = i;
-    }
+    close(timerFd_);
   }
 }
 
 int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
 {
-  FdContext* fd_ctx = nullptr;
-  RWMutexType::ReadLock lock(mutex_);
-  if((int)fdContexts_.size() > fd)
+  FdContext* fd_ctx = FdMgr::GetInstance()->getSlot(fd, true);
+  if(SYLAR_UNLIKELY(!fd_ctx))
   {
-    fd_ctx = fdContexts_[fd];
-    lock.unlock();
-  }
-  else
-  {
-    lock.unlock();
-    RWMutexType::WriteLock lock2(mutex_);
-    contextResize(fd * 1.5);
-    fd_ctx = fdContexts_[fd];
+    SYLAR_LOG_ERROR(g_logger) << "addEvent fd=" << fd << " out of range";
+    return -1;
   }
 
-  FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+  FdContext::MutexType::Lock lock(fd_ctx->mutex);
   if(SYLAR_UNLIKELY(fd_ctx->events & event)) // 说明事件重复了
   {
     SYLAR_LOG_ERROR(g_logger) << "addEvent assert fd=" << fd << " event=" << (EPOLL_EVENTS)event
@@ -191,25 +253,58 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
     SYLAR_ASSERT(!(fd_ctx->events & event));
   }
 
-  int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD; //不为None说明本来就有这个事件，是要修改
-  epoll_event epevent;
-  epevent.events = EPOLLET | fd_ctx->events | event;
-  epevent.data.ptr = fd_ctx;
+  if(fd_ctx->ready & event) // 之前已经就绪过，不需要等待
+  {
+    fd_ctx->ready &= ~event;
+    if(cb)
+    {
+      Scheduler* scheduler = Scheduler::GetThis();
+      (scheduler ? scheduler : this)->schedule(&cb);
+      return 0;
+    }
+    return 1;
+  }
 
-  int rt = epoll_ctl(epfd_, op, fd, &epevent);
-  if(rt)
+  if(!fd_ctx->owner) // 只在第一次等待时注册，之后一直保持到fd关闭
   {
-    SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd_ << ", " << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-        << rt << " (" << errno << ") (" << strerror(errno) << ") fd_ctx->events=" << (EPOLL_EVENTS)fd_ctx->events;
-    return -1;
+    epoll_event epevent;
+    epevent.events = EPOLLET | EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    epevent.data.ptr = fd_ctx;
+
+    ++epollCtlCount_;
+    int rt = epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &epevent);
+    if(rt && errno == EEXIST)
+    {
+      ++epollCtlCount_;
+      rt = epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &epevent);
+    }
+    if(rt)
+    {
+      SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd_ << ", " << (EpollCtlOp)EPOLL_CTL_ADD << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
+          << rt << " (" << errno << ") (" << strerror(errno) << ") fd_ctx->events=" << (EPOLL_EVENTS)fd_ctx->events;
+      return -1;
+    }
+    fd_ctx->owner = this;
+    if(socketBusyPollUs_ && fd_ctx->isSocket()) // 让内核在recv/epoll时忙轮询网卡队列
+    {
+      int us = socketBusyPollUs_;
+      int prefer = 1;
+      if(setsockopt_f(fd, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us))
+          || setsockopt_f(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)))
+      {
+        SYLAR_LOG_DEBUG(g_logger) << "setsockopt SO_BUSY_POLL fd=" << fd << " errno=" << errno
+          << " errstr=" << strerror(errno);
+      }
+    }
   }
 
   ++pendingEventCount_;
-  fd_ctx->events = (Event)(fd_ctx->events | event);
-  FdContext::EventContext& event_ctx = fd_ctx->getContext(event);
+  fd_ctx->events |= event;
+  FdContext::EventContext& event_ctx = GetContext(fd_ctx, event);
   SYLAR_ASSERT(!event_ctx.scheduler && !event_ctx.fiber && !event_ctx.cb);
 
   event_ctx.scheduler = Scheduler::GetThis();
+  event_ctx.iom = this;
   if(cb) event_ctx.cb.swap(cb);
   else
   {
@@ -222,113 +317,137 @@ int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
 
 bool IOManager::delEvent(int fd, Event event)
 {
-  RWMutexType::ReadLock lock(mutex_);
-  if((int)fdContexts_.size() <= fd)
+  FdContext* fd_ctx = FdMgr::GetInstance()->getSlot(fd);
+  if(!fd_ctx)
   {
     return false;
   }
-  FdContext* fd_ctx = fdContexts_[fd];
-  lock.unlock();
 
-  FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+  FdContext::MutexType::Lock lock(fd_ctx->mutex);
   if(SYLAR_UNLIKELY(!(fd_ctx->events & event)))
   {
     return false;
   }
 
-  Event new_events = (Event)(fd_ctx->events & ~event);
-  int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL; // 如果还有事件剩余，只用修改当前事件；否则删除这整个事件
-  epoll_event epevent;
-  epevent.events = EPOLLET | new_events; // 相当于把event的部分掩码设置成0了
-  epevent.data.ptr = fd_ctx;
-
-  int rt = epoll_ctl(epfd_, op, fd, &epevent);
-  if(rt)
-  {
-    SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd_ << ", " << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-      << rt << " (" << errno << ") (" << strerror(errno) << ")";
-    return false;
-  }
-
-  --pendingEventCount_;
-  fd_ctx->events = new_events;
-  FdContext::EventContext& event_ctx = fd_ctx->getContext(event);
-  fd_ctx->resetContext(event_ctx); // 将相应的事件删除
+  // epoll注册保持不变，只去掉等待者
+  FdContext::EventContext& event_ctx = GetContext(fd_ctx, event);
+  --event_ctx.iom->pendingEventCount_;
+  fd_ctx->events &= ~event;
+  ResetContext(event_ctx); // 将相应的事件删除
   return true;
 }
 
 bool IOManager::cancelEvent(int fd, Event event)
 {
-  RWMutexType::ReadLock lock(mutex_);
-  if((int)fdContexts_.size() <= fd)
+  FdContext* fd_ctx = FdMgr::GetInstance()->getSlot(fd);
+  if(!fd_ctx)
   {
     return false;
   }
-  FdContext* fd_ctx = fdContexts_[fd];
-  lock.unlock();
 
-  FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+  FdContext::MutexType::Lock lock(fd_ctx->mutex);
   if(SYLAR_UNLIKELY(!(fd_ctx->events & event))) return false;
 
-  Event new_events = (Event)(fd_ctx->events & ~event);
-  int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-  epoll_event epevent;
-  epevent.events = EPOLLET | new_events;
-  epevent.data.ptr = fd_ctx;
-
-  int rt = epoll_ctl(epfd_, op, fd, &epevent);
-  if(rt) {
-      SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd_ << ", " << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-          << rt << " (" << errno << ") (" << strerror(errno) << ")";
-      return false;
-  }
-
-  fd_ctx->triggerEvent(event); // 最后一次触发当前事件
-  --pendingEventCount_;
+  TriggerEvent(fd_ctx, event); // 最后一次触发当前事件
   return true;
 }
 
 bool IOManager::cancelAll(int fd)
 {
-  RWMutexType::ReadLock lock(mutex_);
-  if((int)fdContexts_.size() <= fd) {
-      return false;
+  FdContext* fd_ctx = FdMgr::GetInstance()->getSlot(fd);
+  if(!fd_ctx)
+  {
+    return false;
   }
-  FdContext* fd_ctx = fdContexts_[fd];
-  lock.unlock();
 
-  FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+  FdContext::MutexType::Lock lock(fd_ctx->mutex);
   if(!fd_ctx->events)
   {
     return false;
   }
 
-  int op = EPOLL_CTL_DEL;
-  epoll_event epevent;
-  epevent.events = 0;
-  epevent.data.ptr = fd_ctx;
+  if(fd_ctx->events & READ)
+  {
+    TriggerEvent(fd_ctx, READ);
+  }
+  if(fd_ctx->events & WRITE)
+  {
+    TriggerEvent(fd_ctx, WRITE);
+  }
 
-  int rt = epoll_ctl(epfd_, op, fd, &epevent);
-  if(rt)
+  SYLAR_ASSERT(fd_ctx->events == 0);
+  return true;
+}
+
+int IOManager::CloseFd(int fd, int (*close_fun)(int))
+{
+  FdContext* fd_ctx = FdMgr::GetInstance()->getSlot(fd);
+  if(!fd_ctx)
   {
-    SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd_ << ", " << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-        << rt << " (" << errno << ") (" << strerror(errno) << ")";
-    return false;
+    return close_fun(fd);
   }
 
+  FdContext::MutexType::Lock lock(fd_ctx->mutex);
+  fd_ctx->setClose(true);
+  if(fd_ctx->isInit())
+  {
+    fd_ctx->reset();
+  }
   if(fd_ctx->events & READ)
   {
-    fd_ctx->triggerEvent(READ);
-    --pendingEventCount_;
+    TriggerEvent(fd_ctx, READ);
   }
   if(fd_ctx->events & WRITE)
   {
-    fd_ctx->triggerEvent(WRITE);
-    --pendingEventCount_;
+    TriggerEvent(fd_ctx, WRITE);
   }
+  // 关闭后内核自动从epoll中移除，下次复用这个fd号时需要重新注册
+  fd_ctx->ready = NONE;
+  fd_ctx->owner = nullptr;
+  return close_fun(fd);
+}
 
-  SYLAR_ASSERT(fd_ctx->events == 0);
-  return true;
+IOManager::IoStats IOManager::getIoStats()
+{
+  IoStats stats;
+  stats.pendingEvents = pendingEventCount_;
+  stats.eventsPerWakeup = eventsPerWakeup_.snapshot();
+  return stats;
+}
+
+std::ostream& IOManager::dumpStats(std::ostream& os)
+{
+  Stats s = getStats();
+  os << "scheduler " << getName() << ": threads=" << s.threads << " active=" << s.activeThreads
+     << " idle=" << s.idleThreads << " queued=" << s.queued << " scheduled=" << s.scheduled
+     << " switches=" << s.switches << " queue_latency_us(p50/p99/max)=" << s.queueLatencyUs.percentile(50)
+     << "/" << s.queueLatencyUs.percentile(99) << "/" << s.queueLatencyUs.max << std::endl;
+  IoStats io = getIoStats();
+  os << "io: pending_events=" << io.pendingEvents << " wakeups=" << io.eventsPerWakeup.count
+     << " events_per_wakeup(mean/p99/max)=" << io.eventsPerWakeup.mean() << "/" << io.eventsPerWakeup.percentile(99)
+     << "/" << io.eventsPerWakeup.max << " epoll_wait=" << getEpollWaitCount() << " epoll_ctl=" << getEpollCtlCount()
+     << std::endl;
+  TimerStats t = getTimerStats();
+  os << "timer: pending=" << t.pending << " expired=" << t.expired << " lateness_us(p50/p99/max)="
+     << t.latenessUs.percentile(50) << "/" << t.latenessUs.percentile(99) << "/" << t.latenessUs.max << std::endl;
+  return os;
+}
+
+std::vector<IOManager::IdleStats::ptr> IOManager::getIdleStats()
+{
+  MutexType::Lock lock(statsMutex_);
+  return idleStats_;
+}
+
+std::ostream& IOManager::dumpIdleStats(std::ostream& os)
+{
+  for(auto& i : getIdleStats())
+  {
+    os << i->thread << ": spins=" << i->spins << " spin_hits=" << i->spinHits
+       << " spin_us=" << i->spinUs << " parks=" << i->parks << " park_us=" << i->parkUs
+       << " spin_budget_us=" << i->spinBudgetUs << std::endl;
+  }
+  return os;
 }
 
 IOManager* IOManager::GetThis()
@@ -342,13 +461,21 @@ void IOManager::tickle()
   {
     return;
   }
+  if(busyPollUs_)
+  {
+    pendingTickle_ = true;
+    if(spinningCount_ > 0) // 自旋中的线程会看到pendingTickle_，不用写管道
+    {
+      return;
+    }
+  }
   int rt = write(tickleFds_[1], "T", 1);
   SYLAR_ASSERT(rt == 1);
 }
 
 bool IOManager::stopping(uint64_t& timeout)
 {
-  timeout = getNextTimer();
+  timeout = getNextTimerUs();
   return timeout == ~0ull && pendingEventCount_ == 0 && Scheduler::stopping();
 }
 
@@ -358,6 +485,119 @@ bool IOManager::stopping()
   return stopping(timeout);
 }
 
+int IOManager::waitEvents(epoll_event* events, int max_events, uint64_t timeout_us)
+{
+  ++epollWaitCount_;
+  if(timerFd_ < 0)
+  {
+    struct timespec ts;
+    ts.tv_sec = timeout_us / 1000000;
+    ts.tv_nsec = timeout_us % 1000000 * 1000;
+    return syscall(SYS_epoll_pwait2, epfd_, events, max_events, &ts, nullptr, 0);
+  }
+
+  // timerfd到期唤醒，epoll_wait按毫秒向上取整的超时只作兜底
+  // 已设置的到期时间更早且未过时不用重设，被提前唤醒的线程会重新计算超时
+  uint64_t now = GetCurrentUS();
+  uint64_t deadline = now + timeout_us;
+  uint64_t armed = timerFdDeadline_;
+  if(timeout_us % 1000 && (armed <= now || deadline < armed)
+      && timerFdDeadline_.compare_exchange_strong(armed, deadline))
+  {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = deadline / 1000000;
+    its.it_value.tv_nsec = deadline % 1000000 * 1000;
+    timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &its, nullptr);
+  }
+  return epoll_wait(epfd_, events, max_events, (int)((timeout_us + 999) / 1000));
+}
+
+void IOManager::processEvents(epoll_event* events, int rt, std::vector<Fiber::ptr>& ready)
+{
+  eventsPerWakeup_.record(rt);
+  std::vector<std::function<void()> > cbs;
+  listExpiredCb(cbs); // 找到应该执行的定时器回调函数
+  if(!cbs.empty())
+  {
+    //SYLAR_LOG_DEBUG(g_logger) << "on timer cbs.size=" << cbs.size();
+    schedule(cbs.begin(), cbs.end());
+    cbs.clear();
+  }
+
+  //if(SYLAR_UNLIKELY(rt == MAX_EVNETS)) {
+  //    SYLAR_LOG_INFO(g_logger) << "epoll wait events=" << rt;
+  //}
+
+  for(int i = 0; i < rt; ++i)
+  {
+    epoll_event& event = events[i];
+    if(event.data.fd == tickleFds_[0]) // 用于唤醒的管道描述符
+    {
+      uint8_t dummy[256];
+      while(read(tickleFds_[0], dummy, sizeof(dummy)) > 0);
+      continue;
+    }
+    if(event.data.fd == timerFd_) // 定时器到期，回调已在上面取出
+    {
+      uint64_t expirations;
+      while(read(timerFd_, &expirations, sizeof(expirations)) > 0);
+      continue;
+    }
+
+    FdContext* fd_ctx = (FdContext*)event.data.ptr;
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if(SYLAR_UNLIKELY(fd_ctx->owner != this)) // 同一批事件中fd已被关闭
+    {
+      continue;
+    }
+    if(event.events & (EPOLLERR | EPOLLHUP)) // 错误事件，读写都唤醒
+    {
+      event.events |= EPOLLIN | EPOLLOUT;
+    }
+    if(event.events & EPOLLRDHUP) // 对端关闭写，读会返回0
+    {
+      event.events |= EPOLLIN;
+    }
+    int real_events = NONE;
+    if(event.events & EPOLLIN)
+    {
+      real_events |= READ;
+    }
+    if(event.events & EPOLLOUT)
+    {
+      real_events |= WRITE;
+    }
+
+    // 没有等待者的就绪事件记下来，注册保持不变，不再调用epoll_ctl
+    fd_ctx->ready |= real_events & ~fd_ctx->events;
+    real_events &= fd_ctx->events;
+
+    if(real_events & READ)
+    {
+      dispatchEvent(fd_ctx, READ, ready);
+    }
+    if(real_events & WRITE)
+    {
+      dispatchEvent(fd_ctx, WRITE, ready);
+    }
+  }
+}
+
+void IOManager::poll()
+{
+  static const int MAX_EVENTS = 64;
+  epoll_event events[MAX_EVENTS];
+  ++epollWaitCount_;
+  int rt = epoll_wait(epfd_, events, MAX_EVENTS, 0);
+  std::vector<Fiber::ptr> ready;
+  processEvents(events, rt > 0 ? rt : 0, ready);
+  if(!ready.empty()) // 当前在调度协程上，不能就地运行，放入队列
+  {
+    schedule(ready.begin(), ready.end());
+  }
+}
+
 void IOManager::idle()
 {
   SYLAR_LOG_DEBUG(g_logger) << "idle";
@@ -367,101 +607,137 @@ void IOManager::idle()
   {
     delete[] ptr;
   });
+  std::vector<Fiber::ptr> ready; // 本轮就地运行的协程
+  ready.reserve(inlineBudget_);
+
+  IdleStats::ptr stats(new IdleStats);
+  stats->thread = Thread::GetName();
+  {
+    MutexType::Lock lock(statsMutex_);
+    idleStats_.push_back(stats);
+  }
+  if(timerFd_ < 0) // epoll_pwait2的超时受线程timer slack(默认50微秒)影响，调到最小
+  {
+    prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+  }
+  uint64_t spin_us = busyPollUs_; // 当前自旋时长(微秒)，按唤醒情况自适应调整
+  stats->spinBudgetUs = spin_us;
 
   while(true)
   {
-    uint64_t next_timeout = 0; // 得到epoll_wait最大超时时间，之后需要执行定时器函数
+    uint64_t next_timeout = 0; // 得到epoll_wait最大超时时间(微秒)，之后需要执行定时器函数
     if(SYLAR_UNLIKELY(stopping(next_timeout)))
     {
       SYLAR_LOG_INFO(g_logger) << "name=" << getName() << " idle stopping exit";
       break;
     }
-
-    int rt = 0;
-    do {
-      static const int MAX_TIMEOUT = 3000;
-      if(next_timeout != ~0ull)
+    if(isElastic())
+    {
+      if(retireIdleThread())
       {
-        next_timeout = (int)next_timeout > MAX_TIMEOUT? MAX_TIMEOUT : next_timeout;
-      } 
-      else
+        MutexType::Lock lock(statsMutex_);
+        idleStats_.erase(std::find(idleStats_.begin(), idleStats_.end(), stats));
+        break;
+      }
+      uint64_t idle_us = getElastic().idleMs * 1000; // 睡眠不超过空闲阈值，按时检查是否退出
+      if(next_timeout > idle_us)
       {
-        next_timeout = MAX_TIMEOUT;
+        next_timeout = idle_us;
       }
+    }
 
-      rt = epoll_wait(epfd_, events, MAX_EVNETS, (int)next_timeout);
-      if(rt < 0 && errno == EINTR) {}
-      else break; // 超时或者拿到事件返回
-    } while(true);
-
-    std::vector<std::function<void()> > cbs;
-    listExpiredCb(cbs); // 找到应该执行的定时器回调函数
-    if(!cbs.empty())
+    uint32_t max_spin_us = busyPollUs_;
+    if(spin_us > max_spin_us)
     {
-      //SYLAR_LOG_DEBUG(g_logger) << "on timer cbs.size=" << cbs.size();
-      schedule(cbs.begin(), cbs.end());
-      cbs.clear();
+      spin_us = max_spin_us;
     }
 
-    //if(SYLAR_UNLIKELY(rt == MAX_EVNETS)) {
-    //    SYLAR_LOG_INFO(g_logger) << "epoll wait events=" << rt;
-    //}
-
-    for(int i = 0; i < rt; ++i)
+    int rt = 0;
+    bool parked = true;
+    if(spin_us) // 阻塞前先自旋一段时间，期间有io事件或新任务就不再进内核睡眠
     {
-      epoll_event& event = events[i];
-      if(event.data.fd == tickleFds_[0]) // 用于唤醒的管道描述符
+      uint64_t limit = spin_us;
+      if(next_timeout < limit)
       {
-        uint8_t dummy[256];
-        while(read(tickleFds_[0], dummy, sizeof(dummy)) > 0);
-        continue;
+        limit = next_timeout;
       }
-
-      FdContext* fd_ctx = (FdContext*)event.data.ptr;
-      FdContext::MutexType::Lock lock(fd_ctx->mutex);
-      if(event.events & (EPOLLERR | EPOLLHUP)) // 错误事件
+      // 不能在这里清掉pendingTickle_：它可能是给另一个正在自旋的线程的，那次tickle没有写管道
+      ++spinningCount_;
+      uint64_t begin = GetCurrentUS();
+      uint64_t now = begin;
+      while(true)
       {
-        event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+        ++epollWaitCount_;
+        rt = epoll_wait(epfd_, events, MAX_EVNETS, 0);
+        if(rt > 0 || pendingTickle_)
+        {
+          break;
+        }
+        cpu_relax();
+        now = GetCurrentUS();
+        if(now - begin >= limit)
+        {
+          break;
+        }
       }
-      int real_events = NONE;
-      if(event.events & EPOLLIN)
+      --spinningCount_;
+      bool tickled = pendingTickle_.exchange(false); // 减少计数后再检查，不会漏掉tickle
+      ++stats->spins;
+      stats->spinUs += now - begin;
+      if(rt > 0 || tickled)
       {
-        real_events |= READ;
+        ++stats->spinHits;
+        parked = false;
       }
-      if(event.events & EPOLLOUT)
+      else if(rt < 0)
       {
-        real_events |= WRITE;
+        rt = 0;
       }
+    }
 
-      if((fd_ctx->events & real_events) == NONE)
+    if(parked)
+    {
+      uint64_t begin = max_spin_us ? GetCurrentUS() : 0;
+      do {
+        static const uint64_t MAX_TIMEOUT = 3000 * 1000;
+        if(next_timeout > MAX_TIMEOUT)
+        {
+          next_timeout = MAX_TIMEOUT;
+        }
+
+        rt = waitEvents(events, MAX_EVNETS, next_timeout);
+        if(rt < 0 && errno == EINTR) {}
+        else break; // 超时或者拿到事件返回
+      } while(true);
+
+      if(max_spin_us)
       {
-        continue;
+        // 自适应：睡眠很快被唤醒说明再多自旋一会就能等到，加倍；睡得久说明自旋是浪费，减半
+        uint64_t slept = GetCurrentUS() - begin;
+        ++stats->parks;
+        stats->parkUs += slept;
+        if(rt > 0 && slept < max_spin_us)
+        {
+          spin_us = spin_us ? std::min<uint64_t>(spin_us * 2, max_spin_us) : std::min<uint64_t>(10, max_spin_us);
+        }
+        else if(slept >= max_spin_us)
+        {
+          spin_us /= 2;
+        }
+        stats->spinBudgetUs = spin_us;
       }
+    }
 
-      int left_events = (fd_ctx->events & ~real_events); // 得到还没有到达的事件（剩余的事件）
-      int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-      event.events = EPOLLET | left_events;
-
-      int rt2 = epoll_ctl(epfd_, op, fd_ctx->fd, &event);
-      if(rt2)
-      {
-        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << epfd_ << ", " << (EpollCtlOp)op << ", " << fd_ctx->fd << ", " << (EPOLL_EVENTS)event.events << "):"
-          << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
-        continue;
-      }
+    processEvents(events, rt, ready);
 
-      //SYLAR_LOG_INFO(g_logger) << " fd=" << fd_ctx->fd << " events=" << fd_ctx->events
-      //                         << " real_events=" << real_events;
-      if(real_events & READ)
-      {
-        fd_ctx->triggerEvent(READ);
-        --pendingEventCount_;
-      }
-      if(real_events & WRITE)
+    if(!ready.empty()) // 锁都已释放，就地运行被唤醒的协程
+    {
+      inlineCount_ += ready.size();
+      for(auto& fiber : ready)
       {
-        fd_ctx->triggerEvent(WRITE);
-        --pendingEventCount_;
+        runInline(fiber);
       }
+      ready.clear();
     }
 
     Fiber::ptr cur = Fiber::GetThis();
@@ -11,9 +11,12 @@
 #ifndef IOMANAGER_H
 #define IOMANAGER_H
 
+#include "fd_manager.h"
 #include "scheduler.h"
 #include "timer.h"
 
+struct epoll_event;
+
 
 namespace sylar {
 
@@ -21,7 +24,6 @@ class IOManager : public Scheduler, public TimerManager
 {
 public:
   typedef std::shared_ptr<IOManager> ptr;
-  typedef RWMutex RWMutexType;
 
   /**
    * @brief IO事件
@@ -37,55 +39,8 @@ public:
   };
 
 private:
-  /**
-   * @brief Socket事件上下文类
-   */
-  struct FdContext
-  {
-    typedef Mutex MutexType;
-    /**
-     * @brief 事件上下文类
-     */
-    struct EventContext
-    {
-      /// 事件执行的调度器
-      Scheduler* scheduler = nullptr;
-      /// 事件协程
-      Fiber::ptr fiber;
-      /// 事件的回调函数
-      std::function<void()> cb;
-    };
-
-    /**
-     * @brief 获取事件上下文类
-     * @param[in] event 事件类型
-     * @return 返回对应事件的上线文
-     */
-    EventContext& getContext(Event event);
-
-    /**
-     * @brief 重置事件上下文
-     * @param[in, out] ctx 待重置的上下文类
-     */
-    void resetContext(EventContext& ctx);
-
-    /**
-     * @brief 触发事件
-     * @param[in] event 事件类型
-     */
-    void triggerEvent(Event event);
-
-    /// 读事件上下文
-    EventContext read;
-    /// 写事件上下文
-    EventContext write;
-    /// 事件关联的句柄
-    int fd = 0;
-    /// 当前的事件
-    Event events = NONE;
-    /// 事件的Mutex
-    MutexType mutex;
-  };
+  /// socket事件上下文，和hook状态共用FdManager中的记录
+  typedef FdCtx FdContext;
 
 public:
   /**
@@ -93,8 +48,10 @@ public:
    * @param[in] threads 线程数量
    * @param[in] use_caller 是否将调用线程包含进去
    * @param[in] name 调度器的名称
+   * @param[in] placement 调度线程的cpu/NUMA放置，构造时就会启动线程，只能在这里指定
    */
-  IOManager(size_t threads = 1, bool use_caller = true, const std::string& name = "");
+  IOManager(size_t threads = 1, bool use_caller = true, const std::string& name = ""
+            , const Placement& placement = Placement());
 
   /**
    * @brief 析构函数
@@ -103,10 +60,12 @@ public:
 
   /**
    * @brief 添加事件
+   * @details fd第一次添加事件时以边缘触发方式注册读写事件，之后不再调用epoll_ctl；
+   *          事件已经就绪时不会挂起：有回调则直接调度回调并返回0，否则返回1由调用方重试io
    * @param[in] fd socket句柄
    * @param[in] event 事件类型
    * @param[in] cb 事件回调函数
-   * @return 添加成功返回0,失败返回-1
+   * @return 添加成功返回0,事件已就绪返回1,失败返回-1
    */
   int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
 
@@ -136,35 +95,187 @@ public:
    * @brief 返回当前的IOManager
    */
   static IOManager* GetThis();
+
+  /**
+   * @brief 关闭fd：唤醒等待该fd的协程，清除hook和注册状态后再关闭
+   * @details 在fd记录的锁内关闭，保证复用同一fd号的新连接一定会重新注册epoll
+   * @param[in] close_fun 真正的关闭函数
+   */
+  static int CloseFd(int fd, int (*close_fun)(int));
+
+  /**
+   * @brief 设置是否在idle中直接运行被io事件唤醒的协程(run-to-completion)
+   * @details 开启后本调度器的协程在epoll_wait所在线程上就地恢复，省去一次调度队列加锁和协程切换
+   * @param[in] v 是否开启
+   * @param[in] budget 每轮epoll_wait最多就地运行的协程数，超出的放回调度队列
+   */
+  void setInlineDispatch(bool v, uint32_t budget) { inlineDispatch_ = v; inlineBudget_ = budget;}
+
+  /**
+   * @brief 是否开启了就地运行
+   */
+  bool isInlineDispatch() const { return inlineDispatch_;}
+
+  /**
+   * @brief 返回就地运行的协程次数
+   */
+  uint64_t getInlineCount() const { return inlineCount_;}
+
+  /**
+   * @brief idle线程的自旋/阻塞统计，每个调度线程一份
+   */
+  struct IdleStats
+  {
+    typedef std::shared_ptr<IdleStats> ptr;
+    /// 线程名称
+    std::string thread;
+    /// 自旋次数
+    std::atomic<uint64_t> spins = {0};
+    /// 自旋期间等到io事件或新任务的次数
+    std::atomic<uint64_t> spinHits = {0};
+    /// 自旋总耗时(微秒)
+    std::atomic<uint64_t> spinUs = {0};
+    /// 阻塞在epoll_wait的次数
+    std::atomic<uint64_t> parks = {0};
+    /// 阻塞总时长(微秒)
+    std::atomic<uint64_t> parkUs = {0};
+    /// 当前的自旋时长(微秒)
+    std::atomic<uint64_t> spinBudgetUs = {0};
+  };
+
+  /**
+   * @brief 设置忙轮询
+   * @param[in] spin_us idle线程阻塞前最多自旋的时间(微秒)，实际时长在[0, spin_us]内自适应，0表示直接阻塞
+   * @param[in] socket_us 第一次注册socket时设置的SO_BUSY_POLL(微秒)，0表示不设置
+   */
+  void setBusyPoll(uint32_t spin_us, uint32_t socket_us) { busyPollUs_ = spin_us; socketBusyPollUs_ = socket_us;}
+
+  /**
+   * @brief 返回各idle线程的自旋/阻塞统计
+   */
+  std::vector<IdleStats::ptr> getIdleStats();
+
+  /**
+   * @brief 输出各idle线程的自旋/阻塞统计
+   */
+  std::ostream& dumpIdleStats(std::ostream& os);
+
+  /**
+   * @brief io事件统计快照
+   */
+  struct IoStats
+  {
+    /// 等待中的io事件数
+    size_t pendingEvents = 0;
+    /// 每次epoll_wait返回的事件数，count即处理事件的轮数
+    LatencyHistogram::Snapshot eventsPerWakeup;
+  };
+
+  IoStats getIoStats();
+
+  /**
+   * @brief 输出调度、io事件和定时器的统计
+   */
+  std::ostream& dumpStats(std::ostream& os);
+
+  /**
+   * @brief 返回epoll_ctl调用次数
+   */
+  uint64_t getEpollCtlCount() const { return epollCtlCount_;}
+
+  /**
+   * @brief 返回epoll_wait调用次数
+   */
+  uint64_t getEpollWaitCount() const { return epollWaitCount_;}
+
+  /**
+   * @brief 是否用epoll_pwait2等待(否则用timerfd实现微秒级超时)
+   */
+  bool isEpollPwait2() const { return timerFd_ < 0;}
 protected:
   void tickle() override;
   bool stopping() override;
   void idle() override;
+  void poll() override;
   void onTimerInsertedAtFront() override;
 
   /**
-   * @brief 重置socket句柄上下文的容器大小
-   * @param[in] size 容量大小
+   * @brief 获取事件上下文
+   * @param[in] event 事件类型
+   */
+  static FdContext::EventContext& GetContext(FdContext* fd_ctx, Event event);
+
+  /**
+   * @brief 重置事件上下文
+   */
+  static void ResetContext(FdContext::EventContext& ctx);
+
+  /**
+   * @brief 触发事件并减少等待者所属IOManager的等待计数(需持有fd_ctx->mutex)
+   */
+  static void TriggerEvent(FdContext* fd_ctx, Event event);
+
+  /**
+   * @brief idle中分发事件：本调度器的协程在预算内放入ready就地运行，否则同TriggerEvent
+   */
+  void dispatchEvent(FdContext* fd_ctx, Event event, std::vector<Fiber::ptr>& ready);
+
+  /**
+   * @brief 取出到期定时器放入队列，并分发epoll_wait返回的事件
+   * @param[out] ready 可就地运行的协程
    */
-  void contextResize(size_t size);
+  void processEvents(epoll_event* events, int rt, std::vector<Fiber::ptr>& ready);
 
   /**
    * @brief 判断是否可以停止
-   * @param[out] timeout 最近要出发的定时器事件间隔
+   * @param[out] timeout 最近要出发的定时器事件间隔(微秒)
    * @return 返回是否可以停止
    */
   bool stopping(uint64_t& timeout);
+
+  /**
+   * @brief 阻塞等待io事件，超时精确到微秒
+   * @param[out] events 事件数组
+   * @param[in] max_events 数组大小
+   * @param[in] timeout_us 超时时间(微秒)
+   * @return 同epoll_wait
+   */
+  int waitEvents(epoll_event* events, int max_events, uint64_t timeout_us);
 private:
   /// epoll 文件句柄
   int epfd_ = 0;
   /// pipe 文件句柄
   int tickleFds_[2];
+  /// 内核不支持epoll_pwait2时用于微秒级超时的timerfd
+  int timerFd_ = -1;
+  /// timerFd_当前设置的到期时间(微秒)
+  std::atomic<uint64_t> timerFdDeadline_ = {0};
   /// 当前等待执行的事件数量
   std::atomic<size_t> pendingEventCount_ = {0};
-  /// IOManager的Mutex
-  RWMutexType mutex_;
-  /// socket事件上下文的容器
-  std::vector<FdContext*> fdContexts_;
+  /// epoll_ctl调用次数
+  std::atomic<uint64_t> epollCtlCount_ = {0};
+  /// epoll_wait调用次数
+  std::atomic<uint64_t> epollWaitCount_ = {0};
+  /// 是否就地运行被唤醒的协程
+  bool inlineDispatch_ = false;
+  /// 每轮就地运行的协程数上限
+  uint32_t inlineBudget_ = 64;
+  /// 就地运行的协程次数
+  std::atomic<uint64_t> inlineCount_ = {0};
+  /// idle线程最多自旋的时间(微秒)
+  std::atomic<uint32_t> busyPollUs_ = {0};
+  /// socket的SO_BUSY_POLL(微秒)
+  uint32_t socketBusyPollUs_ = 0;
+  /// 正在自旋的idle线程数
+  std::atomic<int> spinningCount_ = {0};
+  /// 有线程自旋时tickle只设置这个标记
+  std::atomic<bool> pendingTickle_ = {false};
+  /// 统计的Mutex
+  MutexType statsMutex_;
+  /// 各idle线程的统计
+  std::vector<IdleStats::ptr> idleStats_;
+  /// 每轮处理的事件数
+  LatencyHistogram eventsPerWakeup_;
 };
 
 } // namespace sylar
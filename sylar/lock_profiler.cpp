@@ -0,0 +1,153 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 18:05:20
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 18:05:20
+ * @FilePath: /sylar-wxb/sylar/lock_profiler.cpp
+ * @Description: 锁竞争分析：按加锁位置统计加锁次数、竞争次数以及等待/持有时间分布
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cxxabi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lock_profiler.h"
+
+namespace sylar {
+
+/// 位置表大小(2的幂)
+static const size_t SITE_SLOTS = 4096;
+
+// 位置表只增不删，加锁路径上查找不能再加锁
+static std::atomic<LockSite*> s_sites[SITE_SLOTS];
+static LockSite s_overflow = {"<overflow>", 0, &typeid(void), false};
+
+bool LockProfiler::IsEnabled()
+{
+#ifdef SYLAR_LOCK_PROFILING
+  return true;
+#else
+  return false;
+#endif
+}
+
+static bool SameSite(const LockSite* site, const char* file, int line, const std::type_info& type, bool shared)
+{
+  return site->file == file && site->line == line && *site->type == type && site->shared == shared;
+}
+
+LockSite* LockProfiler::GetSite(const char* file, int line, const std::type_info& type, bool shared)
+{
+  // 同一文件的__builtin_FILE()在一个编译单元里是同一个地址，直接按指针散列
+  size_t h = (size_t)file * 31 + (size_t)line * 2 + shared;
+  h ^= h >> 17;
+  for (size_t i = 0; i < SITE_SLOTS; ++i)
+  {
+    std::atomic<LockSite*>& slot = s_sites[(h + i) & (SITE_SLOTS - 1)];
+    LockSite* site = slot.load(std::memory_order_acquire);
+    if (!site)
+    {
+      LockSite* fresh = new LockSite{file, line, &type, shared};
+      if (slot.compare_exchange_strong(site, fresh, std::memory_order_acq_rel)) return fresh;
+      delete fresh; // 另一个线程先占了这个槽
+    }
+    if (SameSite(site, file, line, type, shared)) return site;
+  }
+  return &s_overflow;
+}
+
+static std::string SiteName(const LockSite* site)
+{
+  // 去掉工程目录前缀
+  const char* file = site->file;
+#ifdef PROJECT_DIR
+  size_t len = strlen(PROJECT_DIR);
+  if (!strncmp(file, PROJECT_DIR, len)) file += len;
+#endif
+  return std::string(file) + ":" + std::to_string(site->line);
+}
+
+static std::string TypeName(const std::type_info& type)
+{
+  int status = 0;
+  char* v = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  if (!v) return type.name();
+  std::string rt(v);
+  free(v);
+  return rt;
+}
+
+static uint64_t TotalWait(const LockProfiler::SiteStats& s)
+{
+  return s.waitNs.sum;
+}
+
+std::vector<LockProfiler::SiteStats> LockProfiler::GetStats()
+{
+  std::vector<SiteStats> rt;
+  auto add = [&rt](const LockSite* site)
+  {
+    uint64_t acquisitions = site->acquisitions.get();
+    if (!acquisitions) return;
+    std::string name = SiteName(site);
+    std::string type = TypeName(*site->type);
+    // 头文件中的同一位置在不同编译单元里是不同的file指针，合并
+    auto it = std::find_if(rt.begin(), rt.end(), [&](const SiteStats& s)
+    {
+      return s.site == name && s.type == type && s.shared == site->shared;
+    });
+    if (it == rt.end())
+    {
+      rt.emplace_back();
+      it = rt.end() - 1;
+      it->site = name;
+      it->type = type;
+      it->shared = site->shared;
+    }
+    it->acquisitions += acquisitions;
+    it->contended += site->contended.get();
+    it->waitNs.merge(site->waitNs.snapshot());
+    it->holdNs.merge(site->holdNs.snapshot());
+  };
+  for (auto& i : s_sites)
+  {
+    LockSite* site = i.load(std::memory_order_acquire);
+    if (site) add(site);
+  }
+  add(&s_overflow);
+  std::sort(rt.begin(), rt.end(), [](const SiteStats& a, const SiteStats& b)
+  {
+    return TotalWait(a) > TotalWait(b);
+  });
+  return rt;
+}
+
+std::ostream& LockProfiler::Dump(std::ostream& os, size_t n)
+{
+  if (!IsEnabled())
+  {
+    os << "lock profiling disabled, build with -DSYLAR_LOCK_PROFILING=ON" << std::endl;
+    return os;
+  }
+  std::vector<SiteStats> stats = GetStats();
+  os << "[LockProfiler sites=" << stats.size() << "] ranked by total wait" << std::endl;
+  os << "  wait_total_us  acquired  contended  wait_us(p99/max)  hold_us(p50/p99/max)  site" << std::endl;
+  for (size_t i = 0; i < stats.size() && i < n; ++i)
+  {
+    const SiteStats& s = stats[i];
+    char buf[256];
+    snprintf(buf, sizeof(buf), "  %13.1f  %8lu  %8lu(%4.1f%%)  %.1f/%.1f  %.1f/%.1f/%.1f  "
+             , s.waitNs.sum / 1000.0, (unsigned long)s.acquisitions, (unsigned long)s.contended
+             , s.acquisitions ? s.contended * 100.0 / s.acquisitions : 0.0
+             , s.waitNs.percentile(99) / 1000.0, s.waitNs.max / 1000.0
+             , s.holdNs.percentile(50) / 1000.0, s.holdNs.percentile(99) / 1000.0, s.holdNs.max / 1000.0);
+    os << buf << s.site << " " << s.type << (s.shared ? " (read)" : "") << std::endl;
+  }
+  return os;
+}
+
+} // namespace sylar
@@ -0,0 +1,128 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 18:05:20
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 18:05:20
+ * @FilePath: /sylar-wxb/sylar/lock_profiler.h
+ * @Description: 锁竞争分析：按加锁位置统计加锁次数、竞争次数以及等待/持有时间分布
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef LOCK_PROFILER_H
+#define LOCK_PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <time.h>
+#include <typeinfo>
+#include <vector>
+
+#include "stats.h"
+
+namespace sylar {
+
+/**
+ * @brief 一个加锁位置(文件、行、锁类型、读/写)的统计
+ */
+struct LockSite
+{
+  const char* file;
+  int line;
+  const std::type_info* type;
+  /// 是否是读锁
+  bool shared;
+  ShardedCounter acquisitions;
+  /// try失败后才拿到锁的次数
+  ShardedCounter contended;
+  /// 等待时间(纳秒)，未竞争记0
+  LatencyHistogram waitNs;
+  /// 持有时间(纳秒)
+  LatencyHistogram holdNs;
+};
+
+/**
+ * @brief 锁竞争分析
+ * @details 编译时定义SYLAR_LOCK_PROFILING(cmake -DSYLAR_LOCK_PROFILING=ON)后，
+ *          mutex.h中的ScopedLockImpl/ReadScopedLockImpl/WriteScopedLockImpl在构造处记录调用位置，
+ *          每次加锁先try，失败记为竞争并计时等待；解锁时记录持有时间。
+ *          只统计通过这几个局部锁加的锁；未定义时局部锁和原来完全一样，没有任何开销
+ */
+class LockProfiler
+{
+public:
+  /**
+   * @brief 一个加锁位置的汇总
+   */
+  struct SiteStats
+  {
+    /// 文件:行
+    std::string site;
+    /// 锁类型
+    std::string type;
+    bool shared = false;
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    LatencyHistogram::Snapshot waitNs;
+    LatencyHistogram::Snapshot holdNs;
+  };
+
+  /**
+   * @brief 是否编译进了锁竞争分析
+   */
+  static bool IsEnabled();
+
+  /**
+   * @brief 查找或创建加锁位置，无锁；位置表满后都记到一个溢出位置上
+   */
+  static LockSite* GetSite(const char* file, int line, const std::type_info& type, bool shared);
+
+  /**
+   * @brief 返回全部加锁位置的统计，按总等待时间降序
+   */
+  static std::vector<SiteStats> GetStats();
+
+  /**
+   * @brief 输出等待时间最长的n个加锁位置
+   */
+  static std::ostream& Dump(std::ostream& os, size_t n = 20);
+
+  static uint64_t NowNs()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  }
+
+  /**
+   * @brief 记录一次加锁
+   * @param try_lock 尝试加锁，返回是否成功
+   * @param lock 阻塞加锁
+   * @return 拿到锁的时间，解锁时用于计算持有时间
+   */
+  template<typename TryLock, typename Lock>
+  static uint64_t Acquire(LockSite* site, TryLock try_lock, Lock lock)
+  {
+    site->acquisitions.add();
+    if (try_lock())
+    {
+      site->waitNs.record(0);
+      return NowNs();
+    }
+    uint64_t begin = NowNs();
+    lock();
+    uint64_t end = NowNs();
+    site->contended.add();
+    site->waitNs.record(end - begin);
+    return end;
+  }
+
+  static void Release(LockSite* site, uint64_t acquired_ns)
+  {
+    site->holdNs.record(NowNs() - acquired_ns);
+  }
+};
+
+} // namespace sylar
+
+#endif
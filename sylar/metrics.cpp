@@ -0,0 +1,373 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:20:15
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:20:15
+ * @FilePath: /sylar-wxb/sylar/metrics.cpp
+ * @Description: 指标注册表和Prometheus文本格式导出
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <set>
+#include <sstream>
+
+#include "config.h"
+#include "iomanager.h"
+#include "log.h"
+#include "metrics.h"
+
+namespace sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<std::string>::ptr g_metrics_prefix =
+  Config::Lookup<std::string>("metrics.prefix", "", "prefix added to every exported metric name");
+
+static ConfigVar<std::set<std::string> >::ptr g_metrics_disabled =
+  Config::Lookup("metrics.disabled", std::set<std::string>(), "metric names not exported");
+
+static ConfigVar<std::vector<uint64_t> >::ptr g_metrics_histogram_bounds =
+  Config::Lookup("metrics.histogram_bounds"
+                 , std::vector<uint64_t>{1, 4, 16, 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576, 4194304}
+                 , "default exported bucket bounds of histograms");
+
+/**
+ * @brief 按Prometheus的方式输出浮点数
+ */
+static void WriteValue(std::ostream& os, double v)
+{
+  if (std::isnan(v)) os << "NaN";
+  else if (std::isinf(v)) os << (v > 0 ? "+Inf" : "-Inf");
+  else if (v == (double)(int64_t)v) os << (int64_t)v;
+  else os << v;
+}
+
+/**
+ * @brief 输出一行样本：name{labels,extra} value
+ */
+static void WriteSample(std::ostream& os, const std::string& name, const std::string& labels
+                        , const std::string& extra, double v)
+{
+  os << name;
+  if (!labels.empty() || !extra.empty())
+  {
+    os << '{' << labels;
+    if (!labels.empty() && !extra.empty()) os << ',';
+    os << extra << '}';
+  }
+  os << ' ';
+  WriteValue(os, v);
+  os << '\n';
+}
+
+static std::string FormatLabels(const MetricLabels& labels)
+{
+  std::string out;
+  for (auto& i : labels)
+  {
+    if (!out.empty()) out += ',';
+    out += i.first;
+    out += "=\"";
+    for (char c : i.second) // 标签值转义 \ " 换行
+    {
+      if (c == '\\') out += "\\\\";
+      else if (c == '"') out += "\\\"";
+      else if (c == '\n') out += "\\n";
+      else out += c;
+    }
+    out += '"';
+  }
+  return out;
+}
+
+static bool IsValidLabelName(const std::string& name)
+{
+  if (name.empty() || isdigit((unsigned char)name[0]) || name.compare(0, 2, "__") == 0) return false;
+  for (char c : name)
+  {
+    if (!isalnum((unsigned char)c) && c != '_') return false;
+  }
+  return true;
+}
+
+const char* Metric::TypeToString(Type type)
+{
+  switch (type)
+  {
+    case COUNTER: return "counter";
+    case GAUGE: return "gauge";
+    case HISTOGRAM: return "histogram";
+  }
+  return "untyped";
+}
+
+void Counter::write(std::ostream& os, const std::string& name, const std::string& labels)
+{
+  WriteSample(os, name, labels, "", get());
+}
+
+void Gauge::set(double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(v));
+  bits_.store(bits, std::memory_order_relaxed);
+}
+
+void Gauge::add(double v)
+{
+  uint64_t old_bits = bits_.load(std::memory_order_relaxed);
+  while (true)
+  {
+    double old_v;
+    memcpy(&old_v, &old_bits, sizeof(old_v));
+    double new_v = old_v + v;
+    uint64_t new_bits;
+    memcpy(&new_bits, &new_v, sizeof(new_v));
+    if (bits_.compare_exchange_weak(old_bits, new_bits, std::memory_order_relaxed)) return;
+  }
+}
+
+double Gauge::get() const
+{
+  uint64_t bits = bits_.load(std::memory_order_relaxed);
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+void Gauge::write(std::ostream& os, const std::string& name, const std::string& labels)
+{
+  WriteSample(os, name, labels, "", get());
+}
+
+void Histogram::write(std::ostream& os, const std::string& name, const std::string& labels)
+{
+  WriteSnapshot(os, name, labels, hist_.snapshot(), bounds_);
+}
+
+void Histogram::WriteSnapshot(std::ostream& os, const std::string& name, const std::string& labels
+                              , const LatencyHistogram::Snapshot& s, const std::vector<uint64_t>& bounds)
+{
+  // 内部分桶的上界不超过导出边界的计入该边界，边界单调递增所以只扫一遍
+  uint64_t cumulative = 0;
+  size_t b = 0;
+  for (uint64_t bound : bounds)
+  {
+    while (b < s.buckets.size() && LatencyHistogram::BucketUpper(b) <= bound)
+    {
+      cumulative += s.buckets[b++];
+    }
+    WriteSample(os, name + "_bucket", labels, "le=\"" + std::to_string(bound) + "\"", cumulative);
+  }
+  uint64_t total = 0;
+  for (auto i : s.buckets) total += i;
+  WriteSample(os, name + "_bucket", labels, "le=\"+Inf\"", total);
+  WriteSample(os, name + "_sum", labels, "", s.sum);
+  WriteSample(os, name + "_count", labels, "", total);
+}
+
+void CallbackMetric::write(std::ostream& os, const std::string& name, const std::string& labels)
+{
+  WriteSample(os, name, labels, "", cb_());
+}
+
+void CallbackHistogram::write(std::ostream& os, const std::string& name, const std::string& labels)
+{
+  Histogram::WriteSnapshot(os, name, labels, cb_(), bounds_);
+}
+
+bool MetricsRegistry::IsValidName(const std::string& name)
+{
+  if (name.empty() || isdigit((unsigned char)name[0])) return false;
+  for (char c : name)
+  {
+    if (!isalnum((unsigned char)c) && c != '_' && c != ':') return false;
+  }
+  return true;
+}
+
+Metric::ptr MetricsRegistry::getOrAdd(const std::string& name, const std::string& help, Metric::Type type
+                                      , const MetricLabels& labels, std::function<Metric::ptr()> factory, bool replace)
+{
+  if (!replace)
+  {
+    RWMutexType::ReadLock lock(mutex_);
+    auto it = families_.find(name);
+    if (it != families_.end() && it->second.type == type)
+    {
+      auto mit = it->second.metrics.find(labels);
+      if (mit != it->second.metrics.end()) return mit->second;
+    }
+  }
+
+  if (!IsValidName(name))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "metric name invalid " << name;
+    return nullptr;
+  }
+  for (auto& i : labels)
+  {
+    if (!IsValidLabelName(i.first))
+    {
+      SYLAR_LOG_ERROR(g_logger) << "metric " << name << " label name invalid " << i.first;
+      return nullptr;
+    }
+  }
+
+  RWMutexType::WriteLock lock(mutex_);
+  auto it = families_.find(name);
+  if (it == families_.end())
+  {
+    it = families_.insert(std::make_pair(name, Family{type, help, {}})).first;
+  }
+  else if (it->second.type != type)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "metric " << name << " exists but type not " << Metric::TypeToString(type)
+      << " real_type=" << Metric::TypeToString(it->second.type);
+    return nullptr;
+  }
+  Metric::ptr& slot = it->second.metrics[labels];
+  if (!slot || replace)
+  {
+    slot = factory();
+  }
+  return slot;
+}
+
+std::vector<uint64_t> MetricsRegistry::getBounds(const std::vector<uint64_t>& bounds) const
+{
+  std::vector<uint64_t> v = bounds.empty() ? g_metrics_histogram_bounds->getValue() : bounds;
+  std::sort(v.begin(), v.end());
+  v.erase(std::unique(v.begin(), v.end()), v.end());
+  return v;
+}
+
+Counter::ptr MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+  return std::static_pointer_cast<Counter>(getOrAdd(name, help, Metric::COUNTER, labels
+      , []() { return std::make_shared<Counter>();}, false));
+}
+
+Gauge::ptr MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels)
+{
+  return std::static_pointer_cast<Gauge>(getOrAdd(name, help, Metric::GAUGE, labels
+      , []() { return std::make_shared<Gauge>();}, false));
+}
+
+Histogram::ptr MetricsRegistry::histogram(const std::string& name, const std::string& help, const MetricLabels& labels
+                                          , const std::vector<uint64_t>& bounds)
+{
+  std::vector<uint64_t> v = getBounds(bounds);
+  Metric::ptr m = getOrAdd(name, help, Metric::HISTOGRAM, labels
+      , [&v]() { return std::make_shared<Histogram>(v);}, false);
+  // 同名的直方图可能是回调注册的
+  return std::dynamic_pointer_cast<Histogram>(m);
+}
+
+bool MetricsRegistry::addCallback(const std::string& name, const std::string& help, Metric::Type type
+                                  , const MetricLabels& labels, CallbackMetric::Callback cb)
+{
+  if (type == Metric::HISTOGRAM) return false;
+  return getOrAdd(name, help, type, labels, [type, &cb]() { return std::make_shared<CallbackMetric>(type, cb);}, true)
+    != nullptr;
+}
+
+bool MetricsRegistry::addHistogramCallback(const std::string& name, const std::string& help, const MetricLabels& labels
+                                           , CallbackHistogram::Callback cb, const std::vector<uint64_t>& bounds)
+{
+  std::vector<uint64_t> v = getBounds(bounds);
+  return getOrAdd(name, help, Metric::HISTOGRAM, labels
+      , [&cb, &v]() { return std::make_shared<CallbackHistogram>(cb, v);}, true) != nullptr;
+}
+
+void MetricsRegistry::remove(const std::string& name, const MetricLabels& labels)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  auto it = families_.find(name);
+  if (it == families_.end()) return;
+  it->second.metrics.erase(labels);
+  if (it->second.metrics.empty()) families_.erase(it);
+}
+
+std::ostream& MetricsRegistry::writePrometheus(std::ostream& os)
+{
+  const std::string prefix = g_metrics_prefix->getValue();
+  const std::set<std::string> disabled = g_metrics_disabled->getValue();
+  // 回调可能加锁，先复制出来再在锁外输出
+  std::vector<std::pair<std::string, Family> > families;
+  {
+    RWMutexType::ReadLock lock(mutex_);
+    families.reserve(families_.size());
+    for (auto& i : families_)
+    {
+      if (!disabled.count(i.first)) families.push_back(i);
+    }
+  }
+  for (auto& i : families)
+  {
+    std::string name = prefix + i.first;
+    std::string help = i.second.help;
+    for (size_t pos = 0; (pos = help.find_first_of("\\\n", pos)) != std::string::npos; pos += 2)
+    {
+      help.replace(pos, 1, help[pos] == '\\' ? "\\\\" : "\\n");
+    }
+    os << "# HELP " << name << ' ' << help << '\n';
+    os << "# TYPE " << name << ' ' << Metric::TypeToString(i.second.type) << '\n';
+    for (auto& m : i.second.metrics)
+    {
+      m.second->write(os, name, FormatLabels(m.first));
+    }
+  }
+  return os;
+}
+
+std::string MetricsRegistry::toPrometheus()
+{
+  std::stringstream ss;
+  writePrometheus(ss);
+  return ss.str();
+}
+
+void MetricsRegistry::addScheduler(IOManager* iom)
+{
+  MetricLabels labels = {{"scheduler", iom->getName()}};
+  addCallback("sylar_scheduler_threads", "scheduler threads", Metric::GAUGE, labels
+      , [iom]() { return (double)iom->getThreadCount();});
+  addCallback("sylar_scheduler_active_threads", "scheduler threads running a task", Metric::GAUGE, labels
+      , [iom]() { return (double)iom->getStats().activeThreads;});
+  addCallback("sylar_scheduler_queued_tasks", "tasks waiting in the run queues", Metric::GAUGE, labels
+      , [iom]() { return (double)iom->getStats().queued;});
+  addCallback("sylar_scheduler_scheduled_total", "tasks enqueued", Metric::COUNTER, labels
+      , [iom]() { return (double)iom->getStats().scheduled;});
+  addCallback("sylar_scheduler_switches_total", "fiber switches", Metric::COUNTER, labels
+      , [iom]() { return (double)iom->getStats().switches;});
+  addCallback("sylar_scheduler_stalls_total", "tasks running longer than scheduler.stall_threshold_ms", Metric::COUNTER, labels
+      , [iom]() { return (double)iom->getStats().stalls;});
+  addHistogramCallback("sylar_scheduler_queue_latency_us", "time from schedule to run in us", labels
+      , [iom]() { return iom->getStats().queueLatencyUs;});
+  addCallback("sylar_iomanager_pending_events", "io events being waited for", Metric::GAUGE, labels
+      , [iom]() { return (double)iom->getIoStats().pendingEvents;});
+  addHistogramCallback("sylar_iomanager_events_per_wakeup", "events returned by one epoll_wait", labels
+      , [iom]() { return iom->getIoStats().eventsPerWakeup;}, {0, 1, 2, 4, 8, 16, 32, 64, 128, 256});
+  addCallback("sylar_timer_pending", "timers not expired yet", Metric::GAUGE, labels
+      , [iom]() { return (double)iom->getTimerStats().pending;});
+  addHistogramCallback("sylar_timer_lateness_us", "time from timer expiry to dispatch in us", labels
+      , [iom]() { return iom->getTimerStats().latenessUs;});
+}
+
+void MetricsRegistry::removeScheduler(IOManager* iom)
+{
+  MetricLabels labels = {{"scheduler", iom->getName()}};
+  for (const char* name : {"sylar_scheduler_threads", "sylar_scheduler_active_threads", "sylar_scheduler_queued_tasks"
+                           , "sylar_scheduler_scheduled_total", "sylar_scheduler_switches_total"
+                           , "sylar_scheduler_stalls_total", "sylar_scheduler_queue_latency_us", "sylar_iomanager_pending_events"
+                           , "sylar_iomanager_events_per_wakeup", "sylar_timer_pending", "sylar_timer_lateness_us"})
+  {
+    remove(name, labels);
+  }
+}
+
+} // namespace sylar
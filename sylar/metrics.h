@@ -0,0 +1,254 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:20:15
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:20:15
+ * @FilePath: /sylar-wxb/sylar/metrics.h
+ * @Description: 带标签的计数器/仪表/直方图注册表，写入按线程分片无竞争，按Prometheus文本格式导出
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mutex.h"
+#include "singleton.h"
+#include "stats.h"
+
+namespace sylar {
+
+class IOManager;
+
+/**
+ * @brief 指标标签，按键排序输出
+ */
+typedef std::map<std::string, std::string> MetricLabels;
+
+/**
+ * @brief 指标基类，一个对象对应一组标签取值
+ */
+class Metric
+{
+public:
+  typedef std::shared_ptr<Metric> ptr;
+
+  enum Type
+  {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+  };
+
+  explicit Metric(Type type) : type_(type) {}
+
+  virtual ~Metric() {}
+
+  Type getType() const { return type_;}
+
+  /**
+   * @brief 输出Prometheus文本格式的样本行
+   * @param name 带前缀的指标名
+   * @param labels 已格式化的标签，如 a="1",b="2"，可以为空
+   */
+  virtual void write(std::ostream& os, const std::string& name, const std::string& labels) = 0;
+
+  static const char* TypeToString(Type type);
+private:
+  Type type_;
+};
+
+/**
+ * @brief 只增计数器
+ */
+class Counter : public Metric
+{
+public:
+  typedef std::shared_ptr<Counter> ptr;
+
+  Counter() : Metric(COUNTER) {}
+
+  void inc(uint64_t v = 1) { value_.add(v);}
+
+  uint64_t get() const { return value_.get();}
+
+  void write(std::ostream& os, const std::string& name, const std::string& labels) override;
+private:
+  ShardedCounter value_;
+};
+
+/**
+ * @brief 可增可减的当前值
+ */
+class Gauge : public Metric
+{
+public:
+  typedef std::shared_ptr<Gauge> ptr;
+
+  Gauge() : Metric(GAUGE) {}
+
+  void set(double v);
+
+  void add(double v);
+
+  double get() const;
+
+  void write(std::ostream& os, const std::string& name, const std::string& labels) override;
+private:
+  /// double的位模式
+  std::atomic<uint64_t> bits_ = {0};
+};
+
+/**
+ * @brief 对数-线性分桶的直方图，导出时按bounds汇总成Prometheus的累计桶
+ * @details 导出的桶边界取整到内部分桶边界，误差不超过12.5%
+ */
+class Histogram : public Metric
+{
+public:
+  typedef std::shared_ptr<Histogram> ptr;
+
+  explicit Histogram(const std::vector<uint64_t>& bounds) : Metric(HISTOGRAM), bounds_(bounds) {}
+
+  void observe(uint64_t v) { hist_.record(v);}
+
+  LatencyHistogram::Snapshot snapshot() const { return hist_.snapshot();}
+
+  void write(std::ostream& os, const std::string& name, const std::string& labels) override;
+
+  /**
+   * @brief 按bounds输出快照的_bucket/_sum/_count行
+   */
+  static void WriteSnapshot(std::ostream& os, const std::string& name, const std::string& labels
+                            , const LatencyHistogram::Snapshot& s, const std::vector<uint64_t>& bounds);
+private:
+  LatencyHistogram hist_;
+  std::vector<uint64_t> bounds_;
+};
+
+/**
+ * @brief 导出时才取值的计数器或仪表，用于暴露已有的统计
+ */
+class CallbackMetric : public Metric
+{
+public:
+  typedef std::function<double()> Callback;
+
+  CallbackMetric(Type type, Callback cb) : Metric(type), cb_(cb) {}
+
+  void write(std::ostream& os, const std::string& name, const std::string& labels) override;
+private:
+  Callback cb_;
+};
+
+/**
+ * @brief 导出时才取快照的直方图
+ */
+class CallbackHistogram : public Metric
+{
+public:
+  typedef std::function<LatencyHistogram::Snapshot()> Callback;
+
+  CallbackHistogram(Callback cb, const std::vector<uint64_t>& bounds)
+    : Metric(HISTOGRAM), cb_(cb), bounds_(bounds) {}
+
+  void write(std::ostream& os, const std::string& name, const std::string& labels) override;
+private:
+  Callback cb_;
+  std::vector<uint64_t> bounds_;
+};
+
+/**
+ * @brief 指标注册表
+ * @details 同名同标签重复注册返回同一个对象；热路径保存返回的指针直接写入，不再查表。
+ *          配置：metrics.prefix 导出时加在指标名前，metrics.disabled 不导出的指标名，
+ *          metrics.histogram_bounds 直方图默认的导出桶边界
+ */
+class MetricsRegistry
+{
+public:
+  typedef RWMutex RWMutexType;
+
+  /**
+   * @brief 获取或创建计数器
+   * @return 名称非法或同名指标类型不同时返回nullptr
+   */
+  Counter::ptr counter(const std::string& name, const std::string& help, const MetricLabels& labels = MetricLabels());
+
+  Gauge::ptr gauge(const std::string& name, const std::string& help, const MetricLabels& labels = MetricLabels());
+
+  /**
+   * @param bounds 导出桶边界，为空用metrics.histogram_bounds
+   */
+  Histogram::ptr histogram(const std::string& name, const std::string& help, const MetricLabels& labels = MetricLabels()
+                           , const std::vector<uint64_t>& bounds = std::vector<uint64_t>());
+
+  /**
+   * @brief 注册导出时取值的计数器(type为COUNTER)或仪表(GAUGE)，已存在时替换
+   */
+  bool addCallback(const std::string& name, const std::string& help, Metric::Type type
+                   , const MetricLabels& labels, CallbackMetric::Callback cb);
+
+  bool addHistogramCallback(const std::string& name, const std::string& help, const MetricLabels& labels
+                            , CallbackHistogram::Callback cb, const std::vector<uint64_t>& bounds = std::vector<uint64_t>());
+
+  /**
+   * @brief 删除一组标签对应的指标，该名称下没有指标时一并删除
+   */
+  void remove(const std::string& name, const MetricLabels& labels = MetricLabels());
+
+  /**
+   * @brief 按Prometheus文本格式(0.0.4)输出全部指标
+   */
+  std::ostream& writePrometheus(std::ostream& os);
+
+  std::string toPrometheus();
+
+  /**
+   * @brief 导出IOManager的调度、io事件和定时器统计，标签scheduler=名称
+   * @details 回调引用iom，销毁前需调用removeScheduler
+   */
+  void addScheduler(IOManager* iom);
+
+  void removeScheduler(IOManager* iom);
+
+  /**
+   * @brief 指标名是否合法：[a-zA-Z_:][a-zA-Z0-9_:]*
+   */
+  static bool IsValidName(const std::string& name);
+private:
+  /**
+   * @brief 同名的一组指标
+   */
+  struct Family
+  {
+    Metric::Type type;
+    std::string help;
+    std::map<MetricLabels, Metric::ptr> metrics;
+  };
+
+  /**
+   * @brief 查找或用factory创建指标
+   * @param replace 已存在时是否用新建的替换
+   */
+  Metric::ptr getOrAdd(const std::string& name, const std::string& help, Metric::Type type
+                       , const MetricLabels& labels, std::function<Metric::ptr()> factory, bool replace);
+
+  std::vector<uint64_t> getBounds(const std::vector<uint64_t>& bounds) const;
+private:
+  RWMutexType mutex_;
+  std::map<std::string, Family> families_;
+};
+
+typedef Singleton<MetricsRegistry> MetricsMgr;
+
+} // namespace sylar
+
+#endif
@@ -9,6 +9,11 @@
 #include "mutex.h"
 #include <bits/stdint-uintn.h>
 #include <stdexcept>
+
+#include "macro.h"
+#include "scheduler.h"
+#include "util.h"
+
 namespace sylar {
 
 Semaphore::Semaphore(uint32_t count)
@@ -39,4 +44,334 @@ void Semaphore::notify()
     throw std::logic_error("sem_post error");
   }
 }
-} // namespace sylar
\ No newline at end of file
+
+FiberSemaphore::FiberSemaphore(size_t initial_concurrency)
+  : concurrency_(initial_concurrency)
+{
+}
+
+FiberSemaphore::~FiberSemaphore()
+{
+  SYLAR_ASSERT(waiters_.empty());
+}
+
+bool FiberSemaphore::tryWait()
+{
+  MutexType::Lock lock(mutex_);
+  if (concurrency_ > 0u)
+  {
+    --concurrency_;
+    return true;
+  }
+  return false;
+}
+
+void FiberSemaphore::wait()
+{
+  SYLAR_ASSERT(Scheduler::GetThis());
+  {
+    MutexType::Lock lock(mutex_);
+    if (concurrency_ > 0u)
+    {
+      --concurrency_;
+      return;
+    }
+    waiters_.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
+  }
+  // notify可能在挂起前就把协程放回调度队列，调度器会跳过仍处于EXEC状态的协程
+  Fiber::YieldToHold();
+}
+
+void FiberSemaphore::notify()
+{
+  MutexType::Lock lock(mutex_);
+  if (!waiters_.empty())
+  {
+    auto next = waiters_.front();
+    waiters_.pop_front();
+    next.first->schedule(next.second);
+  }
+  else
+  {
+    ++concurrency_;
+  }
+}
+
+/**
+ * @brief 把等待者调度回它的调度器，调用后节点可能随等待协程返回而失效
+ */
+static void wake_waiter(FiberWaiter* waiter)
+{
+  Scheduler* scheduler = waiter->scheduler;
+  Fiber::ptr fiber;
+  fiber.swap(waiter->fiber);
+  scheduler->schedule(fiber);
+}
+
+/**
+ * @brief 依次唤醒以next相连的等待者
+ */
+static void wake_waiters(FiberWaiter* waiter)
+{
+  while(waiter)
+  {
+    FiberWaiter* next = waiter->next;
+    wake_waiter(waiter);
+    waiter = next;
+  }
+}
+
+FiberMutex::~FiberMutex()
+{
+  SYLAR_ASSERT(waiters_.empty());
+}
+
+bool FiberMutex::tryLock()
+{
+  uint32_t s = state_.load(std::memory_order_relaxed);
+  return !(s & LOCKED) && state_.compare_exchange_strong(s, s | LOCKED, std::memory_order_acquire);
+}
+
+void FiberMutex::lockSlow()
+{
+  SYLAR_ASSERT(Scheduler::GetThis());
+  FiberWaiter waiter;
+  waiter.scheduler = Scheduler::GetThis();
+  bool woken = false;
+  while(true)
+  {
+    {
+      Spinlock::Lock lock(mutex_);
+      uint32_t s = state_.load(std::memory_order_relaxed);
+      while(true)
+      {
+        uint32_t clear = woken ? WOKEN : 0;
+        if(!(s & LOCKED)) // 持有者已经解锁
+        {
+          if(state_.compare_exchange_weak(s, (s & ~clear) | LOCKED, std::memory_order_acquire))
+          {
+            return;
+          }
+          continue;
+        }
+        if(state_.compare_exchange_weak(s, (s & ~clear) + WAITER, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      waiter.fiber = Fiber::GetThis();
+      if(woken) // 被唤醒后没抢到，保持原来的位置
+      {
+        waiters_.pushFront(&waiter);
+      }
+      else
+      {
+        waiter.waitBeginUs = GetCurrentUS();
+        waiters_.push(&waiter);
+      }
+    }
+    Fiber::YieldToHold();
+    if(waiter.handoff) // 锁已经交到本协程手上
+    {
+      return;
+    }
+    woken = true;
+  }
+}
+
+void FiberMutex::unlockSlow()
+{
+  FiberWaiter* waiter = nullptr;
+  {
+    Spinlock::Lock lock(mutex_);
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    if((s & WOKEN) || waiters_.empty()) // 已经有一个醒着去抢锁了
+    {
+      state_.fetch_sub(LOCKED, std::memory_order_release);
+      return;
+    }
+    waiter = waiters_.pop();
+    if(GetCurrentUS() - waiter->waitBeginUs >= STARVE_US)
+    {
+      // 保留LOCKED位，锁直接交给队首，后来者不能插队
+      waiter->handoff = true;
+      state_.fetch_sub(WAITER, std::memory_order_release);
+    }
+    else
+    {
+      state_.fetch_add(WOKEN - WAITER - LOCKED, std::memory_order_release);
+    }
+  }
+  wake_waiter(waiter);
+}
+
+FiberRWMutex::~FiberRWMutex()
+{
+  SYLAR_ASSERT(waiters_.empty());
+}
+
+void FiberRWMutex::rdlock()
+{
+  uint32_t s = state_.load(std::memory_order_relaxed);
+  while(!(s & (WRITER | WAITING)))
+  {
+    if(state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+    {
+      return;
+    }
+  }
+  waitSlow(false);
+}
+
+void FiberRWMutex::wrlock()
+{
+  uint32_t expect = 0;
+  if(!state_.compare_exchange_strong(expect, WRITER, std::memory_order_acquire))
+  {
+    waitSlow(true);
+  }
+}
+
+bool FiberRWMutex::tryRdlock()
+{
+  uint32_t s = state_.load(std::memory_order_relaxed);
+  while(!(s & (WRITER | WAITING)))
+  {
+    if(state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FiberRWMutex::tryWrlock()
+{
+  uint32_t expect = 0;
+  return state_.compare_exchange_strong(expect, WRITER, std::memory_order_acquire);
+}
+
+void FiberRWMutex::unlock()
+{
+  uint32_t s = state_.load(std::memory_order_relaxed);
+  if(s & WRITER)
+  {
+    uint32_t expect = WRITER;
+    if(!state_.compare_exchange_strong(expect, 0, std::memory_order_release))
+    {
+      wakeSlow();
+    }
+    return;
+  }
+  s = state_.fetch_sub(1, std::memory_order_release) - 1;
+  if(s == WAITING) // 最后一个读者离开，有人在排队
+  {
+    wakeSlow();
+  }
+}
+
+void FiberRWMutex::waitSlow(bool writer)
+{
+  SYLAR_ASSERT(Scheduler::GetThis());
+  FiberWaiter waiter;
+  {
+    Spinlock::Lock lock(mutex_);
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    while(true)
+    {
+      // 队列为空时锁可能已经空出来了
+      if(!(s & WAITING) && (writer ? s == 0 : !(s & WRITER)))
+      {
+        if(state_.compare_exchange_weak(s, writer ? WRITER : s + 1, std::memory_order_acquire))
+        {
+          return;
+        }
+        continue;
+      }
+      if(state_.compare_exchange_weak(s, s | WAITING, std::memory_order_relaxed))
+      {
+        break;
+      }
+    }
+    waiter.scheduler = Scheduler::GetThis();
+    waiter.fiber = Fiber::GetThis();
+    waiter.writer = writer;
+    waiters_.push(&waiter);
+  }
+  Fiber::YieldToHold();
+}
+
+void FiberRWMutex::wakeSlow()
+{
+  FiberWaiter* woken = nullptr;
+  {
+    Spinlock::Lock lock(mutex_);
+    SYLAR_ASSERT(!waiters_.empty());
+    woken = waiters_.pop();
+    FiberWaiter* last = woken;
+    uint32_t s = WRITER;
+    if(!woken->writer) // 队首连续的读者一起放行
+    {
+      s = 1;
+      while(!waiters_.empty() && !waiters_.front()->writer)
+      {
+        last = waiters_.pop();
+        ++s;
+      }
+    }
+    last->next = nullptr;
+    if(!waiters_.empty())
+    {
+      s |= WAITING;
+    }
+    state_.store(s, std::memory_order_release);
+  }
+  wake_waiters(woken);
+}
+
+FiberCondVar::~FiberCondVar()
+{
+  SYLAR_ASSERT(waiters_.empty());
+}
+
+void FiberCondVar::wait(FiberMutex& mutex)
+{
+  SYLAR_ASSERT(Scheduler::GetThis());
+  FiberWaiter waiter;
+  waiter.scheduler = Scheduler::GetThis();
+  waiter.fiber = Fiber::GetThis();
+  {
+    Spinlock::Lock lock(mutex_);
+    waiters_.push(&waiter);
+  }
+  // 先入队再解锁，notify不会丢；挂起前被调度的话调度器会等它让出
+  mutex.unlock();
+  Fiber::YieldToHold();
+  mutex.lock();
+}
+
+void FiberCondVar::notifyOne()
+{
+  FiberWaiter* waiter = nullptr;
+  {
+    Spinlock::Lock lock(mutex_);
+    if(waiters_.empty())
+    {
+      return;
+    }
+    waiter = waiters_.pop();
+  }
+  wake_waiter(waiter);
+}
+
+void FiberCondVar::notifyAll()
+{
+  FiberWaiter* waiters = nullptr;
+  {
+    Spinlock::Lock lock(mutex_);
+    waiters = waiters_.popAll();
+  }
+  wake_waiters(waiters);
+}
+
+} // namespace sylar
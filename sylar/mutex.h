@@ -18,6 +18,9 @@
 
 #include "noncopyable.h"
 #include "fiber.h"
+#ifdef SYLAR_LOCK_PROFILING
+#include "lock_profiler.h"
+#endif
 
 namespace sylar {
 
@@ -47,14 +50,20 @@ private:
 
 /**
  * @brief 局部锁的模板实现 
+ * @details 定义SYLAR_LOCK_PROFILING时构造函数多两个默认参数，记录调用处的文件和行
  */
 template<typename T>
 struct ScopedLockImpl
 {
 public:
+#ifdef SYLAR_LOCK_PROFILING
+  ScopedLockImpl(T& mutex, const char* file = __builtin_FILE(), int line = __builtin_LINE())
+    : mutex_(mutex), site_(LockProfiler::GetSite(file, line, typeid(T), false))
+#else
   ScopedLockImpl(T& mutex) : mutex_(mutex)
+#endif
   {
-    mutex_.lock();
+    doLock();
     locked_ = true;
   }
 
@@ -67,7 +76,7 @@ public:
   {
     if (!locked_)
     {
-      mutex_.lock();
+      doLock();
       locked_ = true;
     }
   }
@@ -76,12 +85,28 @@ public:
   {
     if (locked_)
     {
+#ifdef SYLAR_LOCK_PROFILING
+      LockProfiler::Release(site_, acquiredNs_);
+#endif
       mutex_.unlock();
       locked_ = false;
     }
   }
+private:
+  void doLock()
+  {
+#ifdef SYLAR_LOCK_PROFILING
+    acquiredNs_ = LockProfiler::Acquire(site_, [this]() { return mutex_.tryLock();}, [this]() { mutex_.lock();});
+#else
+    mutex_.lock();
+#endif
+  }
 private:
   T& mutex_;
+#ifdef SYLAR_LOCK_PROFILING
+  LockSite* site_;
+  uint64_t acquiredNs_ = 0;
+#endif
   bool locked_;
 };
 
@@ -92,9 +117,14 @@ template<typename T>
 struct ReadScopedLockImpl
 {
 public:
+#ifdef SYLAR_LOCK_PROFILING
+  ReadScopedLockImpl(T& mutex, const char* file = __builtin_FILE(), int line = __builtin_LINE())
+    : mutex_(mutex), site_(LockProfiler::GetSite(file, line, typeid(T), true))
+#else
   ReadScopedLockImpl(T& mutex) : mutex_(mutex)
+#endif
   {
-    mutex_.rdlock();
+    doLock();
     locked_ = true;
   }
   ~ReadScopedLockImpl()
@@ -104,9 +134,9 @@ public:
 
   void lock()
   {
-    if (locked_)
+    if (!locked_)
     {
-      mutex_.rdlock();
+      doLock();
       locked_ = true;
     }
   }
@@ -115,12 +145,28 @@ public:
   {
     if (locked_)
     {
+#ifdef SYLAR_LOCK_PROFILING
+      LockProfiler::Release(site_, acquiredNs_);
+#endif
       mutex_.unlock();
       locked_ = false;
     }
   }
+private:
+  void doLock()
+  {
+#ifdef SYLAR_LOCK_PROFILING
+    acquiredNs_ = LockProfiler::Acquire(site_, [this]() { return mutex_.tryRdlock();}, [this]() { mutex_.rdlock();});
+#else
+    mutex_.rdlock();
+#endif
+  }
 private:
   T& mutex_;
+#ifdef SYLAR_LOCK_PROFILING
+  LockSite* site_;
+  uint64_t acquiredNs_ = 0;
+#endif
   bool locked_;
 };
 
@@ -131,9 +177,14 @@ template<typename T>
 struct WriteScopedLockImpl
 {
 public:
+#ifdef SYLAR_LOCK_PROFILING
+  WriteScopedLockImpl(T& mutex, const char* file = __builtin_FILE(), int line = __builtin_LINE())
+    : mutex_(mutex), site_(LockProfiler::GetSite(file, line, typeid(T), false))
+#else
   WriteScopedLockImpl(T& mutex) : mutex_(mutex)
+#endif
   {
-    mutex_.wrlock();
+    doLock();
     locked_ = true;
   }
 
@@ -146,7 +197,7 @@ public:
   {
     if (!locked_)
     {
-      mutex_.wrlock();
+      doLock();
       locked_ = true;
     }
   }
@@ -155,13 +206,30 @@ public:
   {
     if (locked_)
     {
+#ifdef SYLAR_LOCK_PROFILING
+      LockProfiler::Release(site_, acquiredNs_);
+#endif
       mutex_.unlock();
       locked_ = false;
     }
   }
 
+private:
+  void doLock()
+  {
+#ifdef SYLAR_LOCK_PROFILING
+    acquiredNs_ = LockProfiler::Acquire(site_, [this]() { return mutex_.tryWrlock();}, [this]() { mutex_.wrlock();});
+#else
+    mutex_.wrlock();
+#endif
+  }
+
 private:
   T& mutex_;
+#ifdef SYLAR_LOCK_PROFILING
+  LockSite* site_;
+  uint64_t acquiredNs_ = 0;
+#endif
   
   bool locked_;
 };
@@ -189,6 +257,11 @@ public:
     pthread_mutex_lock(&mutex_);
   }
 
+  bool tryLock()
+  {
+    return pthread_mutex_trylock(&mutex_) == 0;
+  }
+
   void unlock()
   {
     pthread_mutex_unlock(&mutex_);
@@ -212,6 +285,8 @@ public:
 
   void lock() {}
 
+  bool tryLock() { return true;}
+
   void unlock() {}
 };
 
@@ -245,6 +320,16 @@ public:
     pthread_rwlock_wrlock(&lock_);
   }
 
+  bool tryRdlock()
+  {
+    return pthread_rwlock_tryrdlock(&lock_) == 0;
+  }
+
+  bool tryWrlock()
+  {
+    return pthread_rwlock_trywrlock(&lock_) == 0;
+  }
+
   void unlock()
   {
     pthread_rwlock_unlock(&lock_);
@@ -281,6 +366,10 @@ public:
     * @brief 上写锁
     */
   void wrlock() {}
+
+  bool tryRdlock() { return true;}
+
+  bool tryWrlock() { return true;}
   /**
     * @brief 解锁
     */
@@ -316,6 +405,13 @@ public:
       pthread_spin_lock(&m_mutex);
   }
 
+  /**
+    * @brief 尝试上锁
+    */
+  bool tryLock() {
+      return pthread_spin_trylock(&m_mutex) == 0;
+  }
+
   /**
     * @brief 解锁
     */
@@ -347,6 +443,11 @@ public:
     while(std::atomic_flag_test_and_set_explicit(&mutex_, std::memory_order_acquire));
   }
 
+  bool tryLock()
+  {
+    return !std::atomic_flag_test_and_set_explicit(&mutex_, std::memory_order_acquire);
+  }
+
   void unlock()
   {
     std::atomic_flag_clear_explicit(&mutex_, std::memory_order_release);
@@ -375,6 +476,227 @@ private:
   size_t concurrency_;
 };
 
+/**
+ * @brief 挂起在协程锁上的等待者，节点放在等待协程的栈上，入队出队不分配内存
+ */
+struct FiberWaiter
+{
+  /// 唤醒时调度回的调度器
+  Scheduler* scheduler = nullptr;
+  /// 等待的协程
+  Fiber::ptr fiber;
+  /// 是否等待写锁(FiberRWMutex)
+  bool writer = false;
+  /// 唤醒时锁是否已经直接交给它(FiberMutex)
+  bool handoff = false;
+  /// 开始等待的时间(微秒,FiberMutex)
+  uint64_t waitBeginUs = 0;
+  /// 队列中的下一个
+  FiberWaiter* next = nullptr;
+};
+
+/**
+ * @brief 先进先出的等待队列(需在外部锁保护下使用)
+ */
+class FiberWaitQueue
+{
+public:
+  bool empty() const { return !head_;}
+  FiberWaiter* front() const { return head_;}
+  void push(FiberWaiter* w)
+  {
+    w->next = nullptr;
+    if(tail_) tail_->next = w;
+    else head_ = w;
+    tail_ = w;
+  }
+  /**
+   * @brief 取出全部等待者，返回以next相连的链表
+   */
+  FiberWaiter* popAll()
+  {
+    FiberWaiter* w = head_;
+    head_ = tail_ = nullptr;
+    return w;
+  }
+  void pushFront(FiberWaiter* w)
+  {
+    w->next = head_;
+    head_ = w;
+    if(!tail_) tail_ = w;
+  }
+  FiberWaiter* pop()
+  {
+    FiberWaiter* w = head_;
+    head_ = w->next;
+    if(!head_) tail_ = nullptr;
+    return w;
+  }
+private:
+  FiberWaiter* head_ = nullptr;
+  FiberWaiter* tail_ = nullptr;
+};
+
+/**
+ * @brief 协程互斥量，竞争时挂起协程而不是阻塞线程
+ * @details 无竞争时只有一次CAS。等待者先进先出排队，解锁时唤醒队首(同时最多唤醒一个)：
+ *          队首等待不足STARVE_US时放开锁让它和新来者竞争(失败则排回队首)，
+ *          避免每次加锁都要切换协程；超过STARVE_US则把锁直接交给它，防止饿死
+ */
+class FiberMutex : Noncopyable
+{
+public:
+  typedef ScopedLockImpl<FiberMutex> Lock;
+
+  FiberMutex() {}
+  ~FiberMutex();
+
+  /**
+   * @brief 尝试加锁，不挂起
+   */
+  bool tryLock();
+
+  /**
+   * @brief 加锁，锁被占用时挂起当前协程
+   */
+  void lock()
+  {
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    if((s & LOCKED) || !state_.compare_exchange_strong(s, s | LOCKED, std::memory_order_acquire))
+    {
+      lockSlow();
+    }
+  }
+
+  /**
+   * @brief 解锁，有等待者时把锁交给队首并调度它
+   */
+  void unlock()
+  {
+    uint32_t expect = LOCKED;
+    if(!state_.compare_exchange_strong(expect, 0, std::memory_order_release))
+    {
+      unlockSlow();
+    }
+  }
+private:
+  void lockSlow();
+  void unlockSlow();
+private:
+  /// 已加锁
+  static const uint32_t LOCKED = 1;
+  /// 有被唤醒还没重新抢锁的等待者，解锁时不用再唤醒
+  static const uint32_t WOKEN = 2;
+  /// 每个等待者在state_中的计数
+  static const uint32_t WAITER = 4;
+  /// 队首等待超过这个时间(微秒)后解锁改为直接交接
+  static const uint64_t STARVE_US = 1000;
+  /// 加锁位、唤醒位和等待者数
+  std::atomic<uint32_t> state_ = {0};
+  /// 保护等待队列
+  Spinlock mutex_;
+  /// 等待队列
+  FiberWaitQueue waiters_;
+};
+
+/**
+ * @brief 协程读写锁，竞争时挂起协程而不是阻塞线程
+ * @details 无竞争时读写都只有一次CAS；有等待者后新来的读者也排队，
+ *          解锁时按先进先出交接：队首是写者交给它一个，是读者则交给队首连续的所有读者
+ */
+class FiberRWMutex : Noncopyable
+{
+public:
+  typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+  typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+  FiberRWMutex() {}
+  ~FiberRWMutex();
+
+  /**
+   * @brief 上读锁
+   */
+  void rdlock();
+
+  /**
+   * @brief 上写锁
+   */
+  void wrlock();
+
+  /**
+   * @brief 尝试上读锁，不挂起
+   */
+  bool tryRdlock();
+
+  /**
+   * @brief 尝试上写锁，不挂起
+   */
+  bool tryWrlock();
+
+  /**
+   * @brief 解锁
+   */
+  void unlock();
+private:
+  void waitSlow(bool writer);
+  void wakeSlow();
+private:
+  /// 持有写锁
+  static const uint32_t WRITER = 1u << 30;
+  /// 等待队列非空
+  static const uint32_t WAITING = 1u << 31;
+  /// 低30位是读者数
+  static const uint32_t READERS = WRITER - 1;
+  std::atomic<uint32_t> state_ = {0};
+  /// 保护等待队列
+  Spinlock mutex_;
+  /// 等待队列
+  FiberWaitQueue waiters_;
+};
+
+/**
+ * @brief 协程条件变量，配合FiberMutex使用
+ */
+class FiberCondVar : Noncopyable
+{
+public:
+  FiberCondVar() {}
+  ~FiberCondVar();
+
+  /**
+   * @brief 释放mutex并挂起，被唤醒后重新加锁返回
+   * @pre 当前协程持有mutex
+   */
+  void wait(FiberMutex& mutex);
+
+  /**
+   * @brief 等待直到pred()为真
+   */
+  template<class Predicate>
+  void wait(FiberMutex& mutex, Predicate pred)
+  {
+    while(!pred())
+    {
+      wait(mutex);
+    }
+  }
+
+  /**
+   * @brief 唤醒一个等待者
+   */
+  void notifyOne();
+
+  /**
+   * @brief 唤醒全部等待者
+   */
+  void notifyAll();
+private:
+  /// 保护等待队列
+  Spinlock mutex_;
+  /// 等待队列
+  FiberWaitQueue waiters_;
+};
+
 
 
 
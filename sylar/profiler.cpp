@@ -0,0 +1,372 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:55:40
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:55:40
+ * @FilePath: /sylar-wxb/sylar/profiler.cpp
+ * @Description: 基于SIGPROF的采样cpu分析，按协程入口归类，输出火焰图用的折叠栈
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <fstream>
+#include <map>
+#include <sched.h>
+#include <set>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+#include "fiber.h"
+#include "log.h"
+#include "mutex.h"
+#include "profiler.h"
+#include "thread.h"
+#include "util.h"
+
+namespace sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<uint32_t>::ptr g_profiler_hz =
+  Config::Lookup<uint32_t>("profiler.hz", 99, "cpu profiler sampling frequency");
+
+static ConfigVar<uint32_t>::ptr g_profiler_max_samples =
+  Config::Lookup<uint32_t>("profiler.max_samples", 20000, "cpu profiler sample buffer size");
+
+/// 栈顶的信号处理函数和信号返回跳板
+static const int SKIP_FRAMES = 2;
+
+namespace {
+
+/**
+ * @brief 一次采样，信号处理函数写入，ready置位后才能读取
+ */
+struct Sample
+{
+  std::atomic<bool> ready = {false};
+  uint64_t fiber_id;
+  const std::type_info* entry_type;
+  void* entry_func;
+  char thread[16];
+  int depth;
+  void* pcs[CpuProfiler::MAX_DEPTH];
+};
+
+/**
+ * @brief 一个入口的汇总
+ */
+struct EntryStat
+{
+  uint64_t samples = 0;
+  std::set<uint64_t> fibers;
+};
+
+} // namespace
+
+static Mutex s_mutex; // 保护Start/Stop和读取样本，信号处理函数不加锁
+static Sample* s_samples = nullptr;
+static size_t s_capacity = 0;
+static std::atomic<size_t> s_next = {0};
+static std::atomic<uint64_t> s_dropped = {0};
+static std::atomic<bool> s_running = {false};
+static std::atomic<int> s_inflight = {0}; // 正在执行的信号处理函数数
+
+/**
+ * @brief 采样信号：只写预分配的缓冲区和调用backtrace(Start里已预热)
+ */
+static void ProfHandler(int)
+{
+  int saved_errno = errno;
+  ++s_inflight;
+  if (s_running)
+  {
+    size_t i = s_next.fetch_add(1, std::memory_order_relaxed);
+    if (i < s_capacity)
+    {
+      Sample& s = s_samples[i];
+      Fiber* f = Fiber::GetThisRaw();
+      s.fiber_id = f ? f->getId() : 0;
+      s.entry_type = f ? f->getEntryType() : nullptr;
+      s.entry_func = f ? f->getEntryFunc() : nullptr;
+      strncpy(s.thread, Thread::GetName().c_str(), sizeof(s.thread) - 1);
+      s.thread[sizeof(s.thread) - 1] = '\0';
+      // 打断在协程切换中间时栈帧不完整，展开会读到错误的返回地址，只记录入口
+      s.depth = Fiber::IsSwitching() ? 0 : backtrace(s.pcs, CpuProfiler::MAX_DEPTH);
+      s.ready.store(true, std::memory_order_release);
+    }
+    else
+    {
+      ++s_dropped;
+    }
+  }
+  --s_inflight;
+  errno = saved_errno;
+}
+
+/**
+ * @brief 等待其他线程上的信号处理函数退出
+ */
+static void WaitInflight()
+{
+  while (s_inflight)
+  {
+    sched_yield();
+  }
+}
+
+static std::string Demangle(const char* name)
+{
+  int status = 0;
+  char* v = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  if (!v) return name;
+  std::string rt(v);
+  free(v);
+  return rt;
+}
+
+/**
+ * @brief 解析地址所在的函数，';'是折叠栈的分隔符，替换掉
+ */
+static const std::string& Symbolize(void* pc, std::unordered_map<void*, std::string>& cache)
+{
+  auto it = cache.find(pc);
+  if (it != cache.end()) return it->second;
+
+  std::string name;
+  Dl_info info;
+  if (dladdr(pc, &info) && info.dli_sname)
+  {
+    name = Demangle(info.dli_sname);
+  }
+  else if (dladdr(pc, &info) && info.dli_fname)
+  {
+    const char* base = strrchr(info.dli_fname, '/');
+    char buf[32];
+    snprintf(buf, sizeof(buf), "+0x%lx", (unsigned long)((char*)pc - (char*)info.dli_fbase));
+    name = std::string(base ? base + 1 : info.dli_fname) + buf;
+  }
+  else
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "0x%lx", (unsigned long)pc);
+    name = buf;
+  }
+  std::replace(name.begin(), name.end(), ';', ':');
+  return cache[pc] = name;
+}
+
+static std::string EntryName(const Sample& s, std::unordered_map<void*, std::string>& cache)
+{
+  if (s.entry_func) return Symbolize(s.entry_func, cache);
+  if (s.entry_type)
+  {
+    std::string name = Demangle(s.entry_type->name());
+    std::replace(name.begin(), name.end(), ';', ':');
+    return name;
+  }
+  return std::string("thread:") + s.thread;
+}
+
+static bool IsFiberMain(const std::string& name)
+{
+  return name == "sylar::Fiber::MainFunc()" || name == "sylar::Fiber::CallerMainFunc()";
+}
+
+static bool IsStdWrapper(const std::string& name)
+{
+  return !name.compare(0, 5, "std::") || !name.compare(0, 10, "void std::");
+}
+
+/**
+ * @brief 汇总已记录的样本
+ * @param[out] folded 折叠栈 -> 样本数
+ * @param[out] entries 入口 -> 汇总
+ */
+static void Collect(std::map<std::string, uint64_t>& folded, std::map<std::string, EntryStat>& entries, bool by_fiber)
+{
+  Mutex::Lock lock(s_mutex);
+  std::unordered_map<void*, std::string> cache;
+  std::vector<const std::string*> frames;
+  size_t n = std::min(s_next.load(), s_capacity);
+  for (size_t i = 0; i < n; ++i)
+  {
+    const Sample& s = s_samples[i];
+    if (!s.ready.load(std::memory_order_acquire)) continue;
+
+    // pcs从内到外，除了被打断的那一帧都是返回地址，减1落回call指令所在的函数
+    frames.clear();
+    for (int j = SKIP_FRAMES; j < s.depth; ++j)
+    {
+      void* pc = j == SKIP_FRAMES ? s.pcs[j] : (char*)s.pcs[j] - 1;
+      const std::string& name = Symbolize(pc, cache);
+      if (IsFiberMain(name))
+      {
+        // 去掉协程入口外面的std::function调用层
+        while (!frames.empty() && IsStdWrapper(*frames.back())) frames.pop_back();
+        break;
+      }
+      frames.push_back(&name);
+    }
+
+    std::string entry = EntryName(s, cache);
+    if (s.entry_func && !frames.empty() && *frames.back() == entry) frames.pop_back(); // 入口本身就是最外层函数
+    EntryStat& stat = entries[entry];
+    ++stat.samples;
+    stat.fibers.insert(s.fiber_id);
+
+    std::string line = entry;
+    if (by_fiber) line += "#" + std::to_string(s.fiber_id);
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+    {
+      line += ";";
+      line += **it;
+    }
+    ++folded[line];
+  }
+}
+
+bool CpuProfiler::Start(uint32_t hz)
+{
+  static bool s_installed = []()
+  {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = &ProfHandler;
+    sa.sa_flags = SA_RESTART; // 被打断的系统调用自动重启
+    sigemptyset(&sa.sa_mask);
+    return sigaction(SIGPROF, &sa, nullptr) == 0;
+  }();
+  if (!s_installed) return false;
+
+  hz = hz ? hz : g_profiler_hz->getValue();
+  if (!hz || hz > 1000000) return false;
+
+  Mutex::Lock lock(s_mutex);
+  if (s_running) return false;
+  WaitInflight();
+
+  size_t capacity = g_profiler_max_samples->getValue();
+  if (capacity != s_capacity)
+  {
+    delete[] s_samples;
+    s_samples = capacity ? new Sample[capacity] : nullptr;
+    s_capacity = capacity;
+  }
+  for (size_t i = 0; i < s_capacity; ++i)
+  {
+    s_samples[i].ready = false;
+  }
+  s_next = 0;
+  s_dropped = 0;
+
+  // backtrace第一次调用会加载libgcc_s并分配内存，不能放在信号处理函数里
+  void* warmup[4];
+  backtrace(warmup, 4);
+
+  s_running = true;
+  struct itimerval tv;
+  tv.it_interval.tv_sec = 0;
+  tv.it_interval.tv_usec = 1000000 / hz;
+  tv.it_value = tv.it_interval;
+  if (setitimer(ITIMER_PROF, &tv, nullptr))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "setitimer(ITIMER_PROF) fail errno=" << errno << " " << strerror(errno);
+    s_running = false;
+    return false;
+  }
+  SYLAR_LOG_INFO(g_logger) << "cpu profiler started hz=" << hz << " max_samples=" << s_capacity;
+  return true;
+}
+
+void CpuProfiler::Stop()
+{
+  Mutex::Lock lock(s_mutex);
+  if (!s_running) return;
+  struct itimerval tv;
+  memset(&tv, 0, sizeof(tv));
+  setitimer(ITIMER_PROF, &tv, nullptr);
+  s_running = false;
+  WaitInflight();
+  SYLAR_LOG_INFO(g_logger) << "cpu profiler stopped samples=" << GetSampleCount()
+    << " dropped=" << s_dropped;
+}
+
+bool CpuProfiler::IsRunning()
+{
+  return s_running;
+}
+
+uint64_t CpuProfiler::GetSampleCount()
+{
+  return std::min(s_next.load(), s_capacity);
+}
+
+uint64_t CpuProfiler::GetDropCount()
+{
+  return s_dropped;
+}
+
+std::ostream& CpuProfiler::WriteFolded(std::ostream& os, bool by_fiber)
+{
+  std::map<std::string, uint64_t> folded;
+  std::map<std::string, EntryStat> entries;
+  Collect(folded, entries, by_fiber);
+  for (auto& i : folded)
+  {
+    os << i.first << " " << i.second << "\n";
+  }
+  return os;
+}
+
+std::ostream& CpuProfiler::WriteTop(std::ostream& os, size_t n)
+{
+  std::map<std::string, uint64_t> folded;
+  std::map<std::string, EntryStat> entries;
+  Collect(folded, entries, false);
+
+  uint64_t total = 0;
+  std::vector<std::pair<uint64_t, const std::string*>> sorted;
+  for (auto& i : entries)
+  {
+    total += i.second.samples;
+    sorted.emplace_back(i.second.samples, &i.first);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint64_t, const std::string*>& a
+                                            , const std::pair<uint64_t, const std::string*>& b)
+  {
+    return a.first > b.first;
+  });
+
+  os << "samples=" << total << " dropped=" << s_dropped << "\n";
+  for (size_t i = 0; i < sorted.size() && i < n; ++i)
+  {
+    char pct[16];
+    snprintf(pct, sizeof(pct), "%6.2f%%", total ? sorted[i].first * 100.0 / total : 0.0);
+    os << pct << " " << sorted[i].first << " fibers=" << entries[*sorted[i].second].fibers.size()
+       << " " << *sorted[i].second << "\n";
+  }
+  return os;
+}
+
+bool CpuProfiler::DumpFolded(const std::string& path, bool by_fiber)
+{
+  std::ofstream ofs;
+  if (!FSUtil::OpenForWrite(ofs, path, std::ios::trunc))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "open " << path << " fail";
+    return false;
+  }
+  WriteFolded(ofs, by_fiber);
+  return true;
+}
+
+} // namespace sylar
@@ -0,0 +1,80 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:55:40
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:55:40
+ * @FilePath: /sylar-wxb/sylar/profiler.h
+ * @Description: 基于SIGPROF的采样cpu分析，按协程入口归类，输出火焰图用的折叠栈
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace sylar {
+
+/**
+ * @brief 进程级采样cpu分析器
+ * @details setitimer(ITIMER_PROF)按进程cpu时间定时，信号落在正在消耗cpu的线程上，
+ *          信号处理函数记录当前协程id、协程入口和调用栈到预分配的缓冲区，缓冲区满后丢弃。
+ *          协程入口取协程执行函数的类型(lambda、std::bind等)，普通函数指针取函数名；
+ *          线程主协程上的样本(调度循环、非协程线程)归到 thread:线程名。
+ *          函数名通过dladdr解析，可执行文件需要用-rdynamic链接(cmake的ENABLE_EXPORTS)，
+ *          否则输出 模块+偏移，可以用addr2line离线解析。
+ *          配置：profiler.hz 采样频率，profiler.max_samples 缓冲区能容纳的样本数
+ */
+class CpuProfiler
+{
+public:
+  /// 每个样本最多记录的栈帧数
+  static const int MAX_DEPTH = 48;
+
+  /**
+   * @brief 开始采样，清空上次的样本
+   * @param hz 采样频率，0使用profiler.hz
+   * @return 已在采样或安装信号处理失败返回false
+   */
+  static bool Start(uint32_t hz = 0);
+
+  /**
+   * @brief 停止采样，样本保留到下次Start
+   */
+  static void Stop();
+
+  static bool IsRunning();
+
+  /**
+   * @brief 返回已记录的样本数
+   */
+  static uint64_t GetSampleCount();
+
+  /**
+   * @brief 返回缓冲区满后丢弃的样本数
+   */
+  static uint64_t GetDropCount();
+
+  /**
+   * @brief 输出折叠栈，每行 入口;外层函数;...;内层函数 样本数，可直接交给flamegraph.pl
+   * @param by_fiber 入口后附加 #协程id，按单个协程区分
+   */
+  static std::ostream& WriteFolded(std::ostream& os, bool by_fiber = false);
+
+  /**
+   * @brief 按协程入口汇总：样本数、占比、涉及的协程数，按样本数降序输出前n个
+   */
+  static std::ostream& WriteTop(std::ostream& os, size_t n = 20);
+
+  /**
+   * @brief 折叠栈写入文件
+   */
+  static bool DumpFolded(const std::string& path, bool by_fiber = false);
+};
+
+} // namespace sylar
+
+#endif
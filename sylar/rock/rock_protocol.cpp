@@ -0,0 +1,138 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:20:41
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:20:41
+ * @FilePath: /sylar-wxb/sylar/rock/rock_protocol.cpp
+ * @Description: Rock二进制RPC协议
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <cstring>
+#include <sstream>
+
+#include "rock_protocol.h"
+#include "byte_sequence.h"
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_rock_protocol_max_length =
+  sylar::Config::Lookup("rock.protocol.max_length", (uint32_t)(1024 * 1024 * 64), "rock protocol max length");
+
+RockMessageHeader::RockMessageHeader()
+  : version(RockProtocol::VERSION), type(0), length(0), sn(0), cmd(0), result(0)
+{
+  magic[0] = RockProtocol::MAGIC_0;
+  magic[1] = RockProtocol::MAGIC_1;
+}
+
+std::string RockMessage::toString() const
+{
+  std::stringstream ss;
+  ss << "[RockMessage type=" << type_
+     << " sn=" << sn_
+     << " cmd=" << cmd_
+     << " body_length=" << body_.size()
+     << "]";
+  return ss.str();
+}
+
+std::shared_ptr<RockResponse> RockRequest::createResponse()
+{
+  RockResponse::ptr rsp = std::make_shared<RockResponse>();
+  rsp->setSn(sn_);
+  rsp->setCmd(cmd_);
+  return rsp;
+}
+
+std::string RockResponse::toString() const
+{
+  std::stringstream ss;
+  ss << "[RockResponse sn=" << sn_
+     << " cmd=" << cmd_
+     << " result=" << result_
+     << " body_length=" << body_.size()
+     << "]";
+  return ss.str();
+}
+
+uint32_t RockProtocol::GetMaxLength()
+{
+  return g_rock_protocol_max_length->getValue();
+}
+
+void RockProtocol::Encode(const RockMessage& msg, std::string& out)
+{
+  RockMessageHeader header;
+  header.type = msg.getType();
+  header.length = byteswapOnLittleEndian((uint32_t)msg.getBody().size());
+  header.sn = byteswapOnLittleEndian(msg.getSn());
+  header.cmd = byteswapOnLittleEndian(msg.getCmd());
+  if (msg.getType() == RockMessage::RESPONSE)
+  {
+    header.result = byteswapOnLittleEndian(static_cast<const RockResponse&>(msg).getResult());
+  }
+  out.append((const char*)&header, sizeof(header));
+  out.append(msg.getBody());
+}
+
+int64_t RockProtocol::Decode(const char* data, size_t len, RockMessage::ptr& msg)
+{
+  if (len < sizeof(RockMessageHeader))
+  {
+    return 0;
+  }
+  RockMessageHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.magic[0] != MAGIC_0 || header.magic[1] != MAGIC_1)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "rock decode invalid magic "
+      << (int)header.magic[0] << "," << (int)header.magic[1];
+    return -1;
+  }
+  if (header.version != VERSION)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "rock decode invalid version " << (int)header.version;
+    return -1;
+  }
+  uint32_t length = byteswapOnLittleEndian(header.length);
+  if (length > GetMaxLength())
+  {
+    SYLAR_LOG_ERROR(g_logger) << "rock decode invalid length " << length;
+    return -1;
+  }
+  if (len < sizeof(header) + length)
+  {
+    return 0;
+  }
+
+  switch (header.type)
+  {
+    case RockMessage::REQUEST:
+      msg = std::make_shared<RockRequest>();
+      break;
+    case RockMessage::RESPONSE:
+    {
+      auto rsp = std::make_shared<RockResponse>();
+      rsp->setResult(byteswapOnLittleEndian(header.result));
+      msg = rsp;
+      break;
+    }
+    case RockMessage::NOTIFY:
+      msg = std::make_shared<RockNotify>();
+      break;
+    default:
+      SYLAR_LOG_ERROR(g_logger) << "rock decode invalid type " << (int)header.type;
+      return -1;
+  }
+  msg->setSn(byteswapOnLittleEndian(header.sn));
+  msg->setCmd(byteswapOnLittleEndian(header.cmd));
+  msg->getBodyRef().assign(data + sizeof(header), length);
+  return sizeof(header) + length;
+}
+
+} // namespace sylar
@@ -0,0 +1,187 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:20:41
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:20:41
+ * @FilePath: /sylar-wxb/sylar/rock/rock_protocol.h
+ * @Description: Rock二进制RPC协议
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef ROCK_PROTOCOL_H
+#define ROCK_PROTOCOL_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <google/protobuf/message.h>
+
+namespace sylar {
+
+/**
+ * @brief Rock消息头，所有整数按网络字节序传输
+ * @details 
+ *  | magic(2) | version(1) | type(1) | length(4) | sn(4) | cmd(4) | result(4) | body(length) |
+ *  sn是请求序号，同一连接上的多个请求靠sn匹配响应，响应可以乱序返回
+ */
+#pragma pack(push, 1)
+struct RockMessageHeader
+{
+  RockMessageHeader();
+
+  uint8_t magic[2];
+  uint8_t version;
+  uint8_t type;
+  uint32_t length;
+  uint32_t sn;
+  uint32_t cmd;
+  int32_t result;
+};
+#pragma pack(pop)
+
+/**
+ * @brief Rock消息基类
+ */
+class RockMessage
+{
+public:
+  typedef std::shared_ptr<RockMessage> ptr;
+
+  enum MessageType
+  {
+    /// 请求
+    REQUEST = 1,
+    /// 响应
+    RESPONSE = 2,
+    /// 通知(不需要响应)
+    NOTIFY = 3
+  };
+
+  RockMessage(MessageType type) : type_(type) {}
+
+  virtual ~RockMessage() {}
+
+  MessageType getType() const { return type_;}
+
+  uint32_t getSn() const { return sn_;}
+  void setSn(uint32_t v) { sn_ = v;}
+
+  uint32_t getCmd() const { return cmd_;}
+  void setCmd(uint32_t v) { cmd_ = v;}
+
+  const std::string& getBody() const { return body_;}
+  std::string& getBodyRef() { return body_;}
+  void setBody(const std::string& v) { body_ = v;}
+  void setBody(std::string&& v) { body_ = std::move(v);}
+
+  /**
+   * @brief 将protobuf消息序列化为body
+   */
+  template<class T>
+  bool setAsPB(const T& v)
+  {
+    return v.SerializeToString(&body_);
+  }
+
+  /**
+   * @brief 将body解析为protobuf消息，失败返回nullptr
+   */
+  template<class T>
+  std::shared_ptr<T> getAsPB() const
+  {
+    std::shared_ptr<T> v = std::make_shared<T>();
+    if (v->ParseFromString(body_))
+    {
+      return v;
+    }
+    return nullptr;
+  }
+
+  virtual std::string toString() const;
+
+protected:
+  MessageType type_;
+  uint32_t sn_ = 0;
+  uint32_t cmd_ = 0;
+  std::string body_;
+};
+
+class RockResponse;
+
+/**
+ * @brief Rock请求
+ */
+class RockRequest : public RockMessage
+{
+public:
+  typedef std::shared_ptr<RockRequest> ptr;
+
+  RockRequest() : RockMessage(REQUEST) {}
+
+  /**
+   * @brief 创建与本请求对应(sn、cmd相同)的响应
+   */
+  std::shared_ptr<RockResponse> createResponse();
+};
+
+/**
+ * @brief Rock响应
+ */
+class RockResponse : public RockMessage
+{
+public:
+  typedef std::shared_ptr<RockResponse> ptr;
+
+  RockResponse() : RockMessage(RESPONSE) {}
+
+  int32_t getResult() const { return result_;}
+  void setResult(int32_t v) { result_ = v;}
+
+  virtual std::string toString() const override;
+
+private:
+  int32_t result_ = 0;
+};
+
+/**
+ * @brief Rock通知
+ */
+class RockNotify : public RockMessage
+{
+public:
+  typedef std::shared_ptr<RockNotify> ptr;
+
+  RockNotify() : RockMessage(NOTIFY) {}
+};
+
+/**
+ * @brief Rock协议编解码
+ */
+class RockProtocol
+{
+public:
+  static const uint8_t MAGIC_0 = 0xab;
+  static const uint8_t MAGIC_1 = 0xcd;
+  static const uint8_t VERSION = 0x1;
+
+  /**
+   * @brief 编码消息并追加到out末尾
+   */
+  static void Encode(const RockMessage& msg, std::string& out);
+
+  /**
+   * @brief 从data开头解码一个消息
+   * @return >0 消息占用的字节数，0 数据不完整，-1 数据非法(应关闭连接)
+   */
+  static int64_t Decode(const char* data, size_t len, RockMessage::ptr& msg);
+
+  /**
+   * @brief 返回body最大长度(rock.protocol.max_length)
+   */
+  static uint32_t GetMaxLength();
+};
+
+} // namespace sylar
+
+#endif
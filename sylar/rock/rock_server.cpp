@@ -0,0 +1,68 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 18:30:15
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 18:30:15
+ * @FilePath: /sylar-wxb/sylar/rock/rock_server.cpp
+ * @Description: Rock服务器
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include "rock_server.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+RockServer::RockServer(IOManager* worker, IOManager* io_worker, IOManager* accept_worker)
+  : TcpServer(io_worker, accept_worker), worker_(worker)
+{
+  type_ = "rock";
+}
+
+void RockServer::addHandler(uint32_t cmd, RockStream::request_handler cb)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  handlers_[cmd] = cb;
+}
+
+void RockServer::delHandler(uint32_t cmd)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  handlers_.erase(cmd);
+}
+
+bool RockServer::dispatch(RockRequest::ptr req, RockResponse::ptr rsp, RockStream::ptr stream)
+{
+  RockStream::request_handler cb;
+  {
+    RWMutexType::ReadLock lock(mutex_);
+    auto it = handlers_.find(req->getCmd());
+    if (it != handlers_.end())
+    {
+      cb = it->second;
+    }
+  }
+  if (!cb)
+  {
+    rsp->setResult(404);
+    rsp->setBody("unknown cmd " + std::to_string(req->getCmd()));
+    return false;
+  }
+  return cb(req, rsp, stream);
+}
+
+void RockServer::handleClient(Socket::ptr client)
+{
+  SYLAR_LOG_DEBUG(g_logger) << "handleClient " << *client;
+  RockSession::ptr session = std::make_shared<RockSession>(client);
+  session->setWorker(worker_);
+  session->setRequestHandler(std::bind(&RockServer::dispatch,
+                                       std::static_pointer_cast<RockServer>(shared_from_this()), std::placeholders::_1,
+                                       std::placeholders::_2, std::placeholders::_3));
+  session->setNotifyHandler(notifyHandler_);
+  session->readLoop();
+}
+
+} // namespace sylar
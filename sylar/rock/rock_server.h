@@ -0,0 +1,67 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 18:30:15
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 18:30:15
+ * @FilePath: /sylar-wxb/sylar/rock/rock_server.h
+ * @Description: Rock服务器
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef ROCK_SERVER_H
+#define ROCK_SERVER_H
+
+#include <map>
+#include <memory>
+
+#include "mutex.h"
+#include "rock_stream.h"
+#include "tcp_server.h"
+
+namespace sylar {
+
+/**
+ * @brief Rock服务器，按cmd分发请求
+ */
+class RockServer : public TcpServer
+{
+public:
+  typedef std::shared_ptr<RockServer> ptr;
+  typedef RWMutex RWMutexType;
+
+  /**
+   * @param worker 执行请求处理函数的调度器
+   * @param io_worker 连接读写的调度器
+   * @param accept_worker 接收连接的调度器
+   */
+  RockServer(IOManager* worker = IOManager::GetThis(),
+             IOManager* io_worker = IOManager::GetThis(),
+             IOManager* accept_worker = IOManager::GetThis());
+
+  /**
+   * @brief 注册cmd的请求处理函数
+   */
+  void addHandler(uint32_t cmd, RockStream::request_handler cb);
+
+  void delHandler(uint32_t cmd);
+
+  void setNotifyHandler(RockStream::notify_handler cb) { notifyHandler_ = cb;}
+
+protected:
+  virtual void handleClient(Socket::ptr client) override;
+
+  /**
+   * @brief 按cmd分发请求，未注册的cmd返回404
+   */
+  bool dispatch(RockRequest::ptr req, RockResponse::ptr rsp, RockStream::ptr stream);
+
+private:
+  IOManager* worker_;
+  RWMutexType mutex_;
+  std::map<uint32_t, RockStream::request_handler> handlers_;
+  RockStream::notify_handler notifyHandler_;
+};
+
+} // namespace sylar
+
+#endif
@@ -0,0 +1,354 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:52:06
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:52:06
+ * @FilePath: /sylar-wxb/sylar/rock/rock_stream.cpp
+ * @Description: Rock连接，支持同一连接上多个请求并发(按sn复用)
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "rock_stream.h"
+#include "byte_sequence.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+std::string RockResult::toString() const
+{
+  std::stringstream ss;
+  ss << "[RockResult result=" << result
+     << " used=" << used
+     << " response=" << (response ? response->toString() : "null")
+     << " request=" << (request ? request->toString() : "null")
+     << "]";
+  return ss.str();
+}
+
+RockStream::RockStream(Socket::ptr sock)
+  : sock_(sock), isConnected_(sock && sock->isConnected())
+{
+}
+
+RockStream::~RockStream()
+{
+  SYLAR_LOG_DEBUG(g_logger) << "RockStream::~RockStream " << this;
+}
+
+size_t RockStream::getPendingCount()
+{
+  MutexType::Lock lock(ctxMutex_);
+  return ctxs_.size();
+}
+
+RockStream::Ctx::ptr RockStream::takeCtx(uint32_t sn)
+{
+  MutexType::Lock lock(ctxMutex_);
+  auto it = ctxs_.find(sn);
+  if (it == ctxs_.end())
+  {
+    return nullptr;
+  }
+  Ctx::ptr ctx = it->second;
+  ctxs_.erase(it);
+  return ctx;
+}
+
+RockResult::ptr RockStream::request(RockRequest::ptr req, uint32_t timeout_ms)
+{
+  if (!isConnected())
+  {
+    return std::make_shared<RockResult>(RockResult::NOT_CONNECT, 0, nullptr, req);
+  }
+  IOManager* iom = IOManager::GetThis();
+  SYLAR_ASSERT(iom);
+
+  uint64_t start = sylar::GetCurrentMS();
+  Ctx::ptr ctx = std::make_shared<Ctx>();
+  ctx->sn = ++sn_;
+  ctx->fiber = Fiber::GetThis();
+  ctx->scheduler = Scheduler::GetThis();
+  req->setSn(ctx->sn);
+
+  std::weak_ptr<RockStream> wself(shared_from_this());
+  uint32_t sn = ctx->sn;
+  {
+    // 定时器在锁内创建，保证响应/超时回调拿到的ctx里timer已经设置
+    MutexType::Lock lock(ctxMutex_);
+    ctx->timer = iom->addTimer(timeout_ms, [wself, sn]()
+    {
+      RockStream::ptr self = wself.lock();
+      if (!self)
+      {
+        return;
+      }
+      Ctx::ptr ctx = self->takeCtx(sn);
+      if (ctx)
+      {
+        ctx->result = RockResult::TIMEOUT;
+        ctx->scheduler->schedule(ctx->fiber);
+      }
+    });
+    ctxs_[sn] = ctx;
+  }
+
+  if (!sendMessage(*req))
+  {
+    if (takeCtx(sn))
+    {
+      ctx->timer->cancel();
+      return std::make_shared<RockResult>(RockResult::SEND_ERROR, sylar::GetCurrentMS() - start, nullptr, req);
+    }
+    // 已被onClose取走并调度，继续挂起等待它唤醒
+  }
+
+  Fiber::YieldToHold();
+  return std::make_shared<RockResult>(ctx->result, sylar::GetCurrentMS() - start, ctx->response, req);
+}
+
+void RockStream::onResponse(RockResponse::ptr rsp)
+{
+  Ctx::ptr ctx = takeCtx(rsp->getSn());
+  if (!ctx)
+  {
+    SYLAR_LOG_DEBUG(g_logger) << "rock response without request (timeout?) " << rsp->toString();
+    return;
+  }
+  ctx->timer->cancel();
+  ctx->response = rsp;
+  ctx->result = RockResult::OK;
+  ctx->scheduler->schedule(ctx->fiber);
+}
+
+bool RockStream::sendMessage(const RockMessage& msg)
+{
+  {
+    MutexType::Lock lock(sendMutex_);
+    if (!isConnected_)
+    {
+      return false;
+    }
+    RockProtocol::Encode(msg, sendBuf_);
+    if (writing_)
+    {
+      // 正在发送的协程会把这条消息一起写出
+      return true;
+    }
+    writing_ = true;
+  }
+  return flush();
+}
+
+bool RockStream::flush()
+{
+  while (true)
+  {
+    {
+      MutexType::Lock lock(sendMutex_);
+      if (sendBuf_.empty())
+      {
+        writing_ = false;
+        return true;
+      }
+      sending_.swap(sendBuf_);
+    }
+
+    size_t off = 0;
+    while (off < sending_.size())
+    {
+      int rt = sock_->send(sending_.data() + off, sending_.size() - off);
+      if (rt <= 0)
+      {
+        SYLAR_LOG_DEBUG(g_logger) << "rock send fail rt=" << rt << " errno=" << errno
+          << " errstr=" << strerror(errno);
+        {
+          MutexType::Lock lock(sendMutex_);
+          writing_ = false;
+          sendBuf_.clear();
+        }
+        sending_.clear();
+        close();
+        return false;
+      }
+      off += rt;
+    }
+    sending_.clear();
+  }
+}
+
+bool RockStream::start(IOManager* iom)
+{
+  if (!iom || !isConnected())
+  {
+    return false;
+  }
+  if (!worker_)
+  {
+    worker_ = iom;
+  }
+  iom->schedule(std::bind(&RockStream::readLoop, shared_from_this()));
+  return true;
+}
+
+void RockStream::readLoop()
+{
+  if (!worker_)
+  {
+    worker_ = IOManager::GetThis();
+  }
+  std::vector<char> buf(64 * 1024);
+  size_t begin = 0;
+  size_t end = 0;
+  while (isConnected_)
+  {
+    if (end == buf.size())
+    {
+      buf.resize(buf.size() * 2);
+    }
+    int rt = sock_->recv(&buf[end], buf.size() - end);
+    if (rt <= 0)
+    {
+      break;
+    }
+    end += rt;
+
+    bool error = false;
+    while (begin < end)
+    {
+      RockMessage::ptr msg;
+      int64_t n = RockProtocol::Decode(&buf[begin], end - begin, msg);
+      if (n == 0)
+      {
+        break;
+      }
+      if (n < 0)
+      {
+        error = true;
+        break;
+      }
+      begin += n;
+      switch (msg->getType())
+      {
+        case RockMessage::RESPONSE:
+          onResponse(std::static_pointer_cast<RockResponse>(msg));
+          break;
+        case RockMessage::REQUEST:
+          worker_->schedule(std::bind(&RockStream::handleRequest, shared_from_this(),
+                                      std::static_pointer_cast<RockRequest>(msg)));
+          break;
+        case RockMessage::NOTIFY:
+          worker_->schedule(std::bind(&RockStream::handleNotify, shared_from_this(),
+                                      std::static_pointer_cast<RockNotify>(msg)));
+          break;
+      }
+    }
+    if (error)
+    {
+      break;
+    }
+    if (begin == end)
+    {
+      begin = end = 0;
+      continue;
+    }
+    // 剩下的是不完整的消息，搬到缓冲区开头，比缓冲区大时扩容
+    if (begin > 0)
+    {
+      memmove(&buf[0], &buf[begin], end - begin);
+      end -= begin;
+      begin = 0;
+    }
+    if (end >= sizeof(RockMessageHeader))
+    {
+      RockMessageHeader header;
+      memcpy(&header, &buf[0], sizeof(header));
+      size_t need = sizeof(header) + byteswapOnLittleEndian(header.length);
+      if (need > buf.size())
+      {
+        buf.resize(need);
+      }
+    }
+  }
+  onClose();
+}
+
+void RockStream::handleRequest(RockRequest::ptr req)
+{
+  RockResponse::ptr rsp = req->createResponse();
+  if (!requestHandler_ || !requestHandler_(req, rsp, shared_from_this()))
+  {
+    SYLAR_LOG_DEBUG(g_logger) << "rock handle request fail " << req->toString();
+    if (rsp->getResult() == 0)
+    {
+      rsp->setResult(500);
+    }
+  }
+  sendMessage(*rsp);
+}
+
+void RockStream::handleNotify(RockNotify::ptr nty)
+{
+  if (notifyHandler_)
+  {
+    notifyHandler_(nty, shared_from_this());
+  }
+}
+
+void RockStream::close()
+{
+  if (!isConnected_.exchange(false))
+  {
+    return;
+  }
+  // 关闭socket会唤醒读协程，由读协程执行onClose
+  sock_->close();
+}
+
+void RockStream::onClose()
+{
+  isConnected_ = false;
+  sock_->close();
+  std::unordered_map<uint32_t, Ctx::ptr> ctxs;
+  {
+    MutexType::Lock lock(ctxMutex_);
+    ctxs.swap(ctxs_);
+  }
+  for (auto& i : ctxs)
+  {
+    i.second->timer->cancel();
+    i.second->result = RockResult::CONNECTION_CLOSED;
+    i.second->scheduler->schedule(i.second->fiber);
+  }
+}
+
+RockSession::RockSession(Socket::ptr sock)
+  : RockStream(sock)
+{
+}
+
+RockConnection::RockConnection()
+  : RockStream(nullptr)
+{
+}
+
+bool RockConnection::connect(Address::ptr addr, uint64_t timeout_ms)
+{
+  Socket::ptr sock = Socket::CreateTCP(addr);
+  if (!sock->connect(addr, timeout_ms))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "rock connect " << *addr << " fail";
+    return false;
+  }
+  setSocket(sock);
+  return start(IOManager::GetThis());
+}
+
+} // namespace sylar
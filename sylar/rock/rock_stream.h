@@ -0,0 +1,214 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:52:06
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:52:06
+ * @FilePath: /sylar-wxb/sylar/rock/rock_stream.h
+ * @Description: Rock连接，支持同一连接上多个请求并发(按sn复用)
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef ROCK_STREAM_H
+#define ROCK_STREAM_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "iomanager.h"
+#include "mutex.h"
+#include "rock_protocol.h"
+#include "socket.h"
+#include "timer.h"
+
+namespace sylar {
+
+/**
+ * @brief Rock请求结果
+ */
+struct RockResult
+{
+  typedef std::shared_ptr<RockResult> ptr;
+
+  enum Error
+  {
+    /// 正常收到响应(业务结果见response->getResult())
+    OK = 0,
+    /// 超时
+    TIMEOUT = -1,
+    /// 未连接
+    NOT_CONNECT = -2,
+    /// 发送失败
+    SEND_ERROR = -3,
+    /// 等待响应时连接断开
+    CONNECTION_CLOSED = -4,
+  };
+
+  RockResult(int32_t _result, int32_t _used, RockResponse::ptr rsp, RockRequest::ptr req)
+    : result(_result), used(_used), response(rsp), request(req) {}
+
+  /// 错误码
+  int32_t result;
+  /// 耗时(毫秒)
+  int32_t used;
+  RockResponse::ptr response;
+  RockRequest::ptr request;
+
+  std::string toString() const;
+};
+
+/**
+ * @brief Rock连接基类
+ * @details 一个读协程负责收包：响应按sn找到等待的协程并唤醒，请求和通知各自起协程处理。
+ *          发送端多个协程同时发送时，第一个协程负责把缓冲区中累积的所有消息写出，
+ *          其余协程只追加数据后返回，消息不会交错且高并发时自动合并成一次send。
+ */
+class RockStream : public std::enable_shared_from_this<RockStream>
+{
+public:
+  typedef std::shared_ptr<RockStream> ptr;
+  typedef Mutex MutexType;
+  typedef std::function<bool(RockRequest::ptr, RockResponse::ptr, RockStream::ptr)> request_handler;
+  typedef std::function<bool(RockNotify::ptr, RockStream::ptr)> notify_handler;
+
+  RockStream(Socket::ptr sock);
+
+  virtual ~RockStream();
+
+  Socket::ptr getSocket() const { return sock_;}
+
+  bool isConnected() const { return isConnected_;}
+
+  /**
+   * @brief 发送请求并挂起当前协程等待响应，需在IOManager协程中调用
+   * @param timeout_ms 超时时间，由IOManager的定时器驱动
+   */
+  RockResult::ptr request(RockRequest::ptr req, uint32_t timeout_ms);
+
+  /**
+   * @brief 发送消息(响应、通知)
+   */
+  bool sendMessage(const RockMessage& msg);
+
+  /**
+   * @brief 在iom上启动读协程
+   */
+  bool start(IOManager* iom = IOManager::GetThis());
+
+  /**
+   * @brief 读循环，在当前协程中运行直到连接断开
+   */
+  void readLoop();
+
+  void close();
+
+  void setRequestHandler(request_handler v) { requestHandler_ = v;}
+
+  void setNotifyHandler(notify_handler v) { notifyHandler_ = v;}
+
+  /**
+   * @brief 设置处理请求/通知的调度器，默认为读协程所在的调度器
+   */
+  void setWorker(IOManager* v) { worker_ = v;}
+
+  /**
+   * @brief 等待响应的请求数
+   */
+  size_t getPendingCount();
+
+protected:
+  void setSocket(Socket::ptr v)
+  {
+    sock_ = v;
+    isConnected_ = v && v->isConnected();
+  }
+
+private:
+  /**
+   * @brief 等待响应的请求上下文
+   */
+  struct Ctx
+  {
+    typedef std::shared_ptr<Ctx> ptr;
+    uint32_t sn = 0;
+    int32_t result = RockResult::OK;
+    Fiber::ptr fiber;
+    Scheduler* scheduler = nullptr;
+    Timer::ptr timer;
+    RockResponse::ptr response;
+  };
+
+  /**
+   * @brief 取出sn对应的上下文，只有一个调用方能取到(响应、超时、断开三者互斥)
+   */
+  Ctx::ptr takeCtx(uint32_t sn);
+
+  void onResponse(RockResponse::ptr rsp);
+
+  void handleRequest(RockRequest::ptr req);
+
+  void handleNotify(RockNotify::ptr nty);
+
+  /**
+   * @brief 连接断开，唤醒所有等待的请求
+   */
+  void onClose();
+
+  /**
+   * @brief 写出发送缓冲区中的所有数据
+   */
+  bool flush();
+
+private:
+  Socket::ptr sock_;
+  std::atomic<bool> isConnected_ = {false};
+  std::atomic<uint32_t> sn_ = {0};
+  IOManager* worker_ = nullptr;
+
+  MutexType ctxMutex_;
+  std::unordered_map<uint32_t, Ctx::ptr> ctxs_;
+
+  MutexType sendMutex_;
+  /// 待发送数据
+  std::string sendBuf_;
+  /// 正在发送的数据，只有writer访问
+  std::string sending_;
+  /// 是否有协程正在发送
+  bool writing_ = false;
+
+  request_handler requestHandler_;
+  notify_handler notifyHandler_;
+};
+
+/**
+ * @brief 服务端Rock连接
+ */
+class RockSession : public RockStream
+{
+public:
+  typedef std::shared_ptr<RockSession> ptr;
+
+  RockSession(Socket::ptr sock);
+};
+
+/**
+ * @brief 客户端Rock连接
+ */
+class RockConnection : public RockStream
+{
+public:
+  typedef std::shared_ptr<RockConnection> ptr;
+
+  RockConnection();
+
+  /**
+   * @brief 连接服务器并启动读协程
+   */
+  bool connect(Address::ptr addr, uint64_t timeout_ms = -1);
+};
+
+} // namespace sylar
+
+#endif
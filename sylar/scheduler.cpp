@@ -1,9 +1,11 @@
+#include <algorithm>
 #include <cstddef>
 #include <functional>
 #include <ostream>
 #include <vector>
 #include <string>
 
+#include "config.h"
 #include "log.h"
 #include "mutex.h"
 #include "scheduler.h"
@@ -11,17 +13,35 @@
 #include "thread.h"
 #include "util.h"
 #include "hook.h"
+#include "watchdog.h"
 
 
 namespace sylar {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
 
+static ConfigVar<uint64_t>::ptr g_scheduler_starvation_us =
+  Config::Lookup<uint64_t>("scheduler.starvation_us", 10 * 1000, "low priority task starvation threshold us, 0 is strict priority");
+
+static ConfigVar<uint64_t>::ptr g_scheduler_elastic_latency_us =
+  Config::Lookup<uint64_t>("scheduler.elastic_latency_us", 2 * 1000, "elastic scheduler grows a thread when tasks wait longer than this us");
+
+static ConfigVar<uint64_t>::ptr g_scheduler_elastic_idle_ms =
+  Config::Lookup<uint64_t>("scheduler.elastic_idle_ms", 5 * 1000, "elastic scheduler retires a thread idle longer than this ms");
+
+static ConfigVar<uint64_t>::ptr g_scheduler_preempt_us =
+  Config::Lookup<uint64_t>("scheduler.preempt_us", 0, "fiber time slice in thread cpu us, 0 disables preemption");
+
 static thread_local Scheduler* t_scheduler = nullptr;
 static thread_local Fiber* t_scheduler_fiber = nullptr; //调度协程的上下文
+static thread_local uint64_t t_busy_us = 0; // 本线程最近一次取到任务的时间
+static thread_local bool t_retired = false; // 本线程已被弹性伸缩退出登记
+static thread_local StallWatchdog::Slot* t_stall = nullptr; // 本线程的卡顿检测心跳
 
 Scheduler::Scheduler(size_t threads, bool use_caller, const std::string& name)
-  : name_(name)
+  : starvationUs_(g_scheduler_starvation_us->getValue())
+  , preemptUs_(g_scheduler_preempt_us->getValue())
+  , name_(name)
 {
   SYLAR_ASSERT(threads > 0);
 
@@ -79,16 +99,100 @@ void Scheduler::start()
   SYLAR_ASSERT(threads_.empty());
 
   threads_.resize(threadCount_);
-
   for (size_t i = 0; i < threadCount_; i++)
   {
-    threads_[i].reset(new Thread(std::bind(&Scheduler::run, this), name_ + "_" + std::to_string(i)));
+    threads_[i] = createThread(nextThreadIndex_++);
     threadIds_.push_back(threads_[i]->getId());
   }
   lock.unlock();
 
 }
 
+Thread::ptr Scheduler::createThread(size_t index)
+{
+  std::vector<int> cpus = placement_.cpus;
+  if (cpus.empty() && placement_.numaNode >= 0)
+  {
+    cpus = Thread::GetNumaNodeCpus(placement_.numaNode);
+  }
+  std::vector<int> thread_cpus;
+  if (placement_.pinThreads && !cpus.empty()) thread_cpus.push_back(cpus[index % cpus.size()]);
+  else thread_cpus = cpus;
+  // 在线程内先绑定再运行调度，栈和缓冲区从一开始就分配在本节点上
+  return Thread::ptr(new Thread(std::bind(&Scheduler::run, this), name_ + "_" + std::to_string(index)
+                                , thread_cpus, placement_.numaNode));
+}
+
+void Scheduler::setElastic(const Elastic& v)
+{
+  MutexType::Lock lock(mutex_);
+  elastic_ = v;
+  if (!elastic_.latencyUs) elastic_.latencyUs = g_scheduler_elastic_latency_us->getValue();
+  if (!elastic_.idleMs) elastic_.idleMs = g_scheduler_elastic_idle_ms->getValue();
+  if (elastic_.maxThreads && elastic_.minThreads > elastic_.maxThreads) elastic_.minThreads = elastic_.maxThreads;
+}
+
+void Scheduler::checkGrow(uint64_t now, uint64_t wait_us)
+{
+  // 每个延迟周期最多加一个线程，给新线程消化积压的时间
+  if (wait_us < elastic_.latencyUs || stopping_ || growPending_ || threadCount_ >= elastic_.maxThreads
+      || now - lastGrowUs_ < elastic_.latencyUs)
+  {
+    return;
+  }
+  lastGrowUs_ = now;
+  growPending_ = true;
+}
+
+std::vector<int> Scheduler::getThreadIds()
+{
+  MutexType::Lock lock(mutex_);
+  return threadIds_;
+}
+
+void Scheduler::grow()
+{
+  std::vector<Thread::ptr> retired;
+  {
+    MutexType::Lock lock(mutex_);
+    retired.swap(retired_);
+    if (growPending_.exchange(false) && !stopping_ && threadCount_ < elastic_.maxThreads)
+    {
+      Thread::ptr thr = createThread(nextThreadIndex_++);
+      threads_.push_back(thr);
+      threadIds_.push_back(thr->getId());
+      ++threadCount_;
+      ++growCount_;
+      SYLAR_LOG_INFO(g_logger) << name_ << " elastic grow thread=" << thr->getName() << " size=" << threadCount_;
+    }
+  }
+  // 退出的线程已经跑完run，join只等它返回
+  for (auto& i : retired) i->join();
+}
+
+bool Scheduler::retireIdleThread()
+{
+  if (!isElastic() || t_retired || sylar::GetThreadId() == rootThread_) return false;
+  uint64_t now = sylar::GetCurrentUS();
+  MutexType::Lock lock(mutex_);
+  if (now - t_busy_us < elastic_.idleMs * 1000 || stopping_ || threadCount_ <= elastic_.minThreads) return false;
+
+  int id = sylar::GetThreadId();
+  for (auto& queue : queues_) // 还有指定在本线程执行的任务
+  {
+    for (auto& ft : queue)
+    {
+      if (ft.thread_ == id) return false;
+    }
+  }
+  threadIds_.erase(std::find(threadIds_.begin(), threadIds_.end(), id));
+  --threadCount_;
+  ++shrinkCount_;
+  t_retired = true;
+  SYLAR_LOG_INFO(g_logger) << name_ << " elastic retire thread=" << Thread::GetName() << " size=" << threadCount_;
+  return true;
+}
+
 void Scheduler::stop()
 {
   autoStop_ = true;
@@ -127,6 +231,8 @@ void Scheduler::stop()
   {
     MutexType::Lock lock(mutex_);
     thrs.swap(threads_);
+    thrs.insert(thrs.end(), retired_.begin(), retired_.end());
+    retired_.clear();
   }
 
   for (auto& i : thrs) i->join();
@@ -147,6 +253,10 @@ void Scheduler::run()
     t_scheduler_fiber = Fiber::GetThis().get(); // 拿到当前线程的执行协程
   }
 
+  t_busy_us = sylar::GetCurrentUS();
+  t_retired = false;
+  t_stall = StallWatchdogMgr::GetInstance()->addThread(this);
+  uint64_t preempt_us = 0; // 本线程当前生效的时间片
   Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this))); // 用于其他没有执行的空闲任务
   Fiber::ptr cb_fiber; //用于将回调函数情况
 
@@ -158,41 +268,37 @@ void Scheduler::run()
     bool is_active = false;
     {
       MutexType::Lock lock(mutex_);
-      auto it = fibers_.begin();
-      while (it != fibers_.end())
+      if (takeTask(ft, tickle_me))
       {
-        if (it->thread_ != -1 && it->thread_ != sylar::GetThreadId()) // 当前协程不是在本线程上执行
-        {
-          it++;
-          tickle_me = true;
-          continue;
-        }
-
-        SYLAR_ASSERT(it->fiber_ || it->cb_);
-        if (it->fiber_ && it->fiber_->getState() == Fiber::EXEC)
-        {
-          it++;
-          continue;
-        }
-
-        ft = *it;
-        fibers_.erase(it++);
         activeThreadCount_++;
         is_active = true;
-        break;
       }
-      tickle_me |= it != fibers_.end();
     }
 
     if (tickle_me) tickle();
+    if (growPending_) grow();
+    if (SYLAR_UNLIKELY(is_active && preempt_us != preemptUs_))
+    {
+      preempt_us = preemptUs_;
+      Fiber::StopPreempt();
+      if (preempt_us) Fiber::StartPreempt(preempt_us);
+    }
 
     if (ft.fiber_ && (ft.fiber_->getState() != Fiber::TERM && ft.fiber_->getState() != Fiber::EXCEPT))
     {
+      switchCount_.add();
+      t_stall->begin(t_busy_us);
       ft.fiber_->swapIn();
+      t_stall->end();
       activeThreadCount_--;
 
       if (ft.fiber_->getState() == Fiber::READY)
       {
+        if (ft.fiber_->preempted_) // 先收集就绪的io，被抢占的协程排在它们后面
+        {
+          ft.fiber_->preempted_ = false;
+          poll();
+        }
         schedule(ft.fiber_);
       }
       else if (ft.fiber_->getState() != Fiber::TERM && ft.fiber_->getState() != Fiber::EXCEPT)
@@ -205,11 +311,20 @@ void Scheduler::run()
     {
       if (cb_fiber) cb_fiber->reset(ft.cb_);
       else cb_fiber.reset(new Fiber(ft.cb_));
+      cb_fiber->setPriority(ft.priority_); // 回调中让出后按任务的优先级重新入队
       ft.reset();
+      switchCount_.add();
+      t_stall->begin(t_busy_us);
       cb_fiber->swapIn();
+      t_stall->end();
       activeThreadCount_--;
       if (cb_fiber->getState() == Fiber::READY)
       {
+        if (cb_fiber->preempted_)
+        {
+          cb_fiber->preempted_ = false;
+          poll();
+        }
         schedule(cb_fiber);
         cb_fiber.reset();
       }
@@ -245,6 +360,178 @@ void Scheduler::run()
       }
     }
   }
+
+  if (preempt_us) Fiber::StopPreempt();
+  StallWatchdogMgr::GetInstance()->delThread(t_stall);
+  t_stall = nullptr;
+
+  if (t_retired) // 弹性退出的线程交给下次grow或stop回收
+  {
+    MutexType::Lock lock(mutex_);
+    int id = sylar::GetThreadId();
+    auto it = std::find_if(threads_.begin(), threads_.end(), [id](const Thread::ptr& t) { return t->getId() == id;});
+    if (it != threads_.end())
+    {
+      retired_.push_back(*it);
+      threads_.erase(it);
+    }
+  }
+}
+
+void Scheduler::enqueue(FiberAndThread& ft, int priority, uint64_t deadline_us)
+{
+  if (priority < 0)
+  {
+    priority = ft.fiber_ ? ft.fiber_->getPriority() : NORMAL;
+  }
+  else if (ft.fiber_)
+  {
+    ft.fiber_->setPriority(priority);
+  }
+  if (priority >= PRIORITY_COUNT) priority = LOW;
+  if (!deadline_us && ft.fiber_ && ft.fiber_->deadline_) // 处于Deadline作用域内的协程按其截止时间参与EDF
+  {
+    deadline_us = ft.fiber_->deadline_->getDeadline() * 1000;
+  }
+
+  ft.priority_ = priority;
+  ft.deadlineUs_ = deadline_us;
+  ft.enqueueUs_ = sylar::GetCurrentUS();
+  scheduledCount_.add();
+  if (ft.thread_ != -1 && isElastic()
+      && std::find(threadIds_.begin(), threadIds_.end(), ft.thread_) == threadIds_.end())
+  {
+    ft.thread_ = -1; // 指定的线程已经弹性退出
+  }
+  if (isElastic() && idleThreadCount_ == 0 && taskCount_ > 0)
+  {
+    // 线程都在忙时没有人出队，入队时看最早的任务等了多久
+    uint64_t oldest = ft.enqueueUs_;
+    for (auto& queue : queues_)
+    {
+      if (!queue.empty() && queue.front().enqueueUs_ < oldest) oldest = queue.front().enqueueUs_;
+    }
+    checkGrow(ft.enqueueUs_, ft.enqueueUs_ - oldest);
+  }
+  ++taskCount_;
+  if (!deadline_us)
+  {
+    queues_[priority * 2 + 1].push_back(std::move(ft));
+    return;
+  }
+
+  // 截止时间大多递增，从队尾向前找插入位置，相同截止时间保持先进先出
+  TaskQueue& queue = queues_[priority * 2];
+  auto it = queue.end();
+  while (it != queue.begin())
+  {
+    auto prev = std::prev(it);
+    if (prev->deadlineUs_ <= deadline_us) break;
+    it = prev;
+  }
+  queue.insert(it, std::move(ft));
+}
+
+bool Scheduler::takeFrom(TaskQueue& queue, FiberAndThread& ft, bool& tickle_me)
+{
+  auto it = queue.begin();
+  while (it != queue.end())
+  {
+    if (it->thread_ != -1 && it->thread_ != sylar::GetThreadId()) // 当前协程不是在本线程上执行
+    {
+      it++;
+      tickle_me = true;
+      continue;
+    }
+
+    SYLAR_ASSERT(it->fiber_ || it->cb_);
+    if (it->fiber_ && it->fiber_->getState() == Fiber::EXEC)
+    {
+      it++;
+      continue;
+    }
+
+    ft = std::move(*it);
+    queue.erase(it);
+    --taskCount_;
+    return true;
+  }
+  return false;
+}
+
+bool Scheduler::takeTask(FiberAndThread& ft, bool& tickle_me)
+{
+  if (taskCount_ == 0) return false;
+
+  TaskQueue* starving = nullptr;
+  if (starvationUs_)
+  {
+    // 第一个非空队列本来就会被调度，只看排在它后面的队列
+    bool served = false;
+    uint64_t now = 0;
+    uint64_t oldest = ~0ull;
+    for (auto& queue : queues_)
+    {
+      if (queue.empty()) continue;
+      if (!served)
+      {
+        served = true;
+        continue;
+      }
+      if (!now) now = sylar::GetCurrentUS();
+      uint64_t enqueue_us = queue.front().enqueueUs_;
+      if (now - enqueue_us > starvationUs_ && enqueue_us < oldest)
+      {
+        oldest = enqueue_us;
+        starving = &queue;
+      }
+    }
+  }
+
+  bool taken = (starving && takeFrom(*starving, ft, tickle_me));
+  for (size_t i = 0; !taken && i < PRIORITY_COUNT * 2; ++i)
+  {
+    taken = takeFrom(queues_[i], ft, tickle_me);
+  }
+  tickle_me |= taken && taskCount_ > 0;
+  if (taken)
+  {
+    t_busy_us = sylar::GetCurrentUS();
+    queueLatency_.record(t_busy_us - ft.enqueueUs_);
+    if (isElastic()) checkGrow(t_busy_us, t_busy_us - ft.enqueueUs_);
+  }
+  return taken;
+}
+
+void Scheduler::runInline(const Fiber::ptr& fiber)
+{
+  if (fiber->getState() == Fiber::EXEC) // 还没有在唤醒它之前的线程上让出
+  {
+    schedule(fiber);
+    return;
+  }
+
+  Fiber* caller = t_scheduler_fiber;
+  t_scheduler_fiber = Fiber::GetThis().get(); // 协程swapOut时回到当前协程
+  t_busy_us = sylar::GetCurrentUS();
+  switchCount_.add();
+  idleThreadCount_--;
+  activeThreadCount_++;
+  if (t_stall) t_stall->begin(t_busy_us);
+  fiber->swapIn();
+  if (t_stall) t_stall->end();
+  activeThreadCount_--;
+  idleThreadCount_++;
+  t_scheduler_fiber = caller;
+
+  if (fiber->getState() == Fiber::READY)
+  {
+    schedule(fiber);
+  }
+  else if (fiber->getState() != Fiber::TERM && fiber->getState() != Fiber::EXCEPT)
+  {
+    fiber->state_ = Fiber::HOLD;
+  }
 }
 
 void Scheduler::tickle()
@@ -255,13 +542,14 @@ void Scheduler::tickle()
 bool Scheduler::stopping()
 {
   MutexType::Lock lock(mutex_);
-  return autoStop_ && stopping_ && fibers_.empty() && activeThreadCount_ == 0;
+  return autoStop_ && stopping_ && taskCount_ == 0 && activeThreadCount_ == 0;
 }
 void Scheduler::idle()
 {
   SYLAR_LOG_INFO(g_logger) << "idle";
   while (!stopping())
   {
+    if (retireIdleThread()) break;
     sylar::Fiber::YieldToHold();
   }
   SYLAR_LOG_INFO(g_logger) << "idle end";
@@ -284,19 +572,53 @@ void Scheduler::switchTo(int thread)
 std::ostream& Scheduler::dump(std::ostream &os)
 {
   os << "[Scheduler name=" << name_ << " size=" << threadCount_ << " active_count=" << activeThreadCount_
-    << " idle_count=" << idleThreadCount_ << " stopping=" << stopping_
-    << " ]" << std::endl << "    ";
-  for(size_t i = 0; i < threadIds_.size(); ++i) 
+    << " idle_count=" << idleThreadCount_ << " stopping=" << stopping_;
   {
-    if(i) 
+    MutexType::Lock lock(mutex_);
+    os << " tasks=" << taskCount_ << " (high/normal/low";
+    for (size_t i = 0; i < PRIORITY_COUNT; ++i)
+    {
+      os << (i ? "/" : " ") << queues_[i * 2].size() + queues_[i * 2 + 1].size();
+    }
+    os << ")";
+    os << " switches=" << switchCount_.get() << " stalls=" << stallCount_;
+    LatencyHistogram::Snapshot lat = queueLatency_.snapshot();
+    os << " queue_latency_us(p50/p99/max)=" << lat.percentile(50) << "/" << lat.percentile(99) << "/" << lat.max;
+    if (isElastic())
+    {
+      os << " elastic=[" << elastic_.minThreads << "," << elastic_.maxThreads << "] grow=" << growCount_
+        << " shrink=" << shrinkCount_;
+    }
+    os << " ]" << std::endl << "    ";
+    for(size_t i = 0; i < threadIds_.size(); ++i) 
     {
-        os << ", ";
+      if(i) 
+      {
+          os << ", ";
+      }
+      os << threadIds_[i];
     }
-    os << threadIds_[i];
   }
   return os;
 }
 
+Scheduler::Stats Scheduler::getStats()
+{
+  Stats stats;
+  stats.threads = getThreadCount();
+  stats.activeThreads = activeThreadCount_;
+  stats.idleThreads = idleThreadCount_;
+  {
+    MutexType::Lock lock(mutex_);
+    stats.queued = taskCount_;
+  }
+  stats.scheduled = scheduledCount_.get();
+  stats.switches = switchCount_.get();
+  stats.stalls = stallCount_;
+  stats.queueLatencyUs = queueLatency_.snapshot();
+  return stats;
+}
+
 SchedulerSwitcher::SchedulerSwitcher(Scheduler* target)
 {
   caller_ = Scheduler::GetThis();
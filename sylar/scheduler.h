@@ -11,22 +11,42 @@
 
 #include <cstddef>
 #include <functional>
+#include <list>
 #include <ostream>
 #include <vector>
 
 #include "log.h"
 #include "mutex.h"
+#include "stats.h"
 #include "thread.h"
 #include "fiber.h"
 
 namespace sylar {
 
+class StallWatchdog;
+
 class Scheduler
 {
+friend class StallWatchdog;
 public:
   typedef std::shared_ptr<Scheduler> ptr;
   typedef Mutex MutexType;
 
+  /**
+   * @brief 任务优先级，高优先级的任务先调度
+   * @details 协程记住最后一次显式指定的优先级，让出或被io唤醒后按该优先级重新入队
+   */
+  enum Priority
+  {
+    /// 健康检查、控制面等延迟敏感的任务
+    HIGH    = 0,
+    /// 默认
+    NORMAL  = 1,
+    /// 后台批量任务
+    LOW     = 2,
+    PRIORITY_COUNT
+  };
+
   /**
    * @brief 
    * @param threads 线程数
@@ -38,7 +58,73 @@ public:
   virtual ~Scheduler();
 
   const std::string& getName() const { return name_;}
+
+  /**
+   * @brief 返回调度器的线程数量(包含use_caller的线程) 
+   */  
+  size_t getThreadCount() const { return threadCount_ + (rootThread_ == -1 ? 0 : 1);}
+
+  /**
+   * @brief 返回当前全部调度线程的id(包含use_caller的线程)，可用于schedule指定线程
+   */
+  std::vector<int> getThreadIds();
   
+  /**
+   * @brief 调度线程的放置方式
+   */
+  struct Placement
+  {
+    /// 绑定的cpu集合，为空不绑定
+    std::vector<int> cpus;
+    /// 线程内存优先分配的NUMA节点，-1不设置；cpus为空时绑定到该节点的全部cpu
+    int numaNode = -1;
+    /// 是否每个线程只绑定cpus中的一个cpu(按线程序号轮流分配)
+    bool pinThreads = false;
+  };
+
+  /**
+   * @brief 设置调度线程绑定的cpu集合，需在start之前调用
+   */
+  void setCpuAffinity(const std::vector<int>& cpus) { placement_.cpus = cpus;}
+
+  const std::vector<int>& getCpuAffinity() const { return placement_.cpus;}
+
+  /**
+   * @brief 设置调度线程的放置方式，需在start之前调用
+   */
+  void setPlacement(const Placement& v) { placement_ = v;}
+
+  const Placement& getPlacement() const { return placement_;}
+
+  /**
+   * @brief 弹性线程数配置
+   */
+  struct Elastic
+  {
+    /// 线程数下限(不含use_caller的线程)
+    size_t minThreads = 1;
+    /// 线程数上限，0表示不开启弹性伸缩
+    size_t maxThreads = 0;
+    /// 任务排队超过该时间(微秒)时增加线程，0取scheduler.elastic_latency_us
+    uint64_t latencyUs = 0;
+    /// 线程持续空闲超过该时间(毫秒)后退出，0取scheduler.elastic_idle_ms
+    uint64_t idleMs = 0;
+  };
+
+  /**
+   * @brief 开启弹性线程数：排队延迟超过目标时增加线程，持续空闲后减少线程，线程数保持在[minThreads, maxThreads]内
+   * @details 有任务指定在某线程上执行时该线程不会退出；指定到已退出线程的任务改由任意线程执行
+   */
+  void setElastic(const Elastic& v);
+
+  const Elastic& getElastic() const { return elastic_;}
+
+  /**
+   * @brief 返回弹性伸缩增加/减少线程的次数
+   */
+  uint64_t getGrowCount() const { return growCount_;}
+  uint64_t getShrinkCount() const { return shrinkCount_;}
+
   /**
    * @brief 返回当前协程调度器 
    */  
@@ -71,6 +157,27 @@ public:
     }
 
     if (need_tickle) tickle();
+    if (growPending_) grow();
+  }
+
+  /**
+   * @brief 按优先级将协程放入队列
+   * @param fc 协程或函数
+   * @param priority 优先级
+   * @param deadline_us 截止时间(微秒，GetCurrentUS为基准)，同一优先级内截止时间早的先调度(EDF)，0表示按先进先出
+   * @param thread 协程执行的线程id，-1标识任意线程
+   */
+  template<typename FiberOrCb>
+  void schedule(FiberOrCb fc, Priority priority, uint64_t deadline_us = 0, int thread = -1)
+  {
+    bool need_tickle = false;
+    {
+      MutexType::Lock lock(mutex_);
+      need_tickle = scheduleNoLock(fc, thread, priority, deadline_us);
+    }
+
+    if (need_tickle) tickle();
+    if (growPending_) grow();
   }
 
   /**
@@ -81,22 +188,62 @@ public:
   template<typename InputIterator>
   void schedule(InputIterator begin, InputIterator end)
   {
-    bool need_tickle = false;
-    {
-      MutexType::Lock lock(mutex_);
-      while(begin != end)
-      {
-        need_tickle = scheduleNoLock(&*begin, -1) || need_tickle;
-        begin++;
-      }
-    }
+    scheduleBatch(begin, end, -1);
+  }
 
-    if (need_tickle) tickle();
+  /**
+   * @brief 按同一优先级批量调度协程
+   */
+  template<typename InputIterator>
+  void schedule(InputIterator begin, InputIterator end, Priority priority)
+  {
+    scheduleBatch(begin, end, priority);
   }
 
+  /**
+   * @brief 设置防饿死阈值：低优先级队列的队首等待超过该时间时先于高优先级任务调度，0表示严格按优先级
+   */
+  void setStarvationUs(uint64_t v) { starvationUs_ = v;}
+
+  uint64_t getStarvationUs() const { return starvationUs_;}
+
+  /**
+   * @brief 设置协程时间片(微秒)，0表示不抢占，各线程在下次取到任务时生效
+   * @details 超出时间片的协程在下一个抢占点(Fiber::MaybeYield、hook的socket io)让出
+   */
+  void setPreemptUs(uint64_t v) { preemptUs_ = v;}
+
+  uint64_t getPreemptUs() const { return preemptUs_;}
+
   void switchTo(int thread = -1);
   std::ostream& dump(std::ostream& os);
 
+  /**
+   * @brief 调度器运行统计快照
+   */
+  struct Stats
+  {
+    /// 线程数(包含use_caller的线程)
+    size_t threads = 0;
+    size_t activeThreads = 0;
+    size_t idleThreads = 0;
+    /// 队列中等待执行的任务数
+    size_t queued = 0;
+    /// 累计入队的任务数
+    uint64_t scheduled = 0;
+    /// 累计切入执行的协程次数
+    uint64_t switches = 0;
+    /// 任务执行超过scheduler.stall_threshold_ms的次数
+    uint64_t stalls = 0;
+    /// 入队到开始执行的时间(微秒)
+    LatencyHistogram::Snapshot queueLatencyUs;
+  };
+
+  /**
+   * @brief 汇总各线程的统计，热路径上只有分片的原子加
+   */
+  Stats getStats();
+
 protected:
 
   /**
@@ -116,6 +263,11 @@ protected:
    */  
   virtual void idle();
 
+  /**
+   * @brief 协程因时间片用完让出后调用：不进入idle，把已就绪的事件和到期定时器放入队列
+   */
+  virtual void poll() {}
+
   /**
    * @brief 设置当前协程调度器
    */  
@@ -126,24 +278,58 @@ protected:
    */  
   bool hasIdleThreads() { return idleThreadCount_ > 0;}
 
+  /**
+   * @brief 是否开启了弹性线程数
+   */
+  bool isElastic() const { return elastic_.maxThreads > 0;}
+
+  /**
+   * @brief idle中调用：当前线程持续空闲且线程数高于下限时退出登记，返回true后idle应结束
+   */
+  bool retireIdleThread();
+
+  /**
+   * @brief 在当前协程(idle)上直接运行一个就绪协程，它让出或结束后回到调用处
+   * @details 运行期间把当前协程临时作为调度协程；协程还在其他线程上执行时放回调度队列
+   */
+  void runInline(const Fiber::ptr& fiber);
+
 
 private:
 /**
  * @brief 协程调度启动（无锁） 
+ * @param priority 优先级，-1表示协程沿用自己的优先级，函数为NORMAL
  */  
 template<typename FiberOrCb>
-bool scheduleNoLock(FiberOrCb fc, int thread)
+bool scheduleNoLock(FiberOrCb fc, int thread, int priority = -1, uint64_t deadline_us = 0)
 {
-  bool need_tickle = fibers_.empty(); // 之前没任务，需要重新唤醒
+  bool need_tickle = taskCount_ == 0; // 之前没任务，需要重新唤醒
   FiberAndThread ft(fc, thread);
   static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
   SYLAR_LOG_DEBUG(g_logger) << "schedule no lock";
 
-  if (ft.fiber_ || ft.cb_) fibers_.push_back(ft); // 将要执行的任务放进去
+  if (ft.fiber_ || ft.cb_) enqueue(ft, priority, deadline_us); // 将要执行的任务放进去
 
   return need_tickle;
 }
 
+template<typename InputIterator>
+void scheduleBatch(InputIterator begin, InputIterator end, int priority)
+{
+  bool need_tickle = false;
+  {
+    MutexType::Lock lock(mutex_);
+    while(begin != end)
+    {
+      need_tickle = scheduleNoLock(&*begin, -1, priority) || need_tickle;
+      begin++;
+    }
+  }
+
+  if (need_tickle) tickle();
+  if (growPending_) grow();
+}
+
 private:
   struct FiberAndThread
   {
@@ -153,6 +339,12 @@ private:
 
     int thread_; //当前协程在哪个线程上执行
 
+    int priority_ = NORMAL; // 优先级
+
+    uint64_t deadlineUs_ = 0; // 截止时间(微秒)，0表示没有
+
+    uint64_t enqueueUs_ = 0; // 入队时间(微秒)，用于防饿死
+
     FiberAndThread(Fiber::ptr fiber, int thread)
       : fiber_(fiber), thread_(thread) {}
 
@@ -176,9 +368,45 @@ private:
       fiber_ = nullptr;
       cb_ = nullptr;
       thread_ = -1;
+      priority_ = NORMAL;
+      deadlineUs_ = 0;
     }
   };
 
+  typedef std::list<FiberAndThread> TaskQueue;
+
+  /**
+   * @brief 确定优先级和截止时间后放入对应队列(需持有mutex_)
+   */
+  void enqueue(FiberAndThread& ft, int priority, uint64_t deadline_us);
+
+  /**
+   * @brief 取出一个本线程可以执行的任务(需持有mutex_)
+   * @param[out] tickle_me 是否还有任务需要其他线程处理
+   */
+  bool takeTask(FiberAndThread& ft, bool& tickle_me);
+
+  /**
+   * @brief 从一个队列中取出本线程可以执行的任务(需持有mutex_)
+   */
+  bool takeFrom(TaskQueue& queue, FiberAndThread& ft, bool& tickle_me);
+
+  /**
+   * @brief 排队延迟超过目标时登记增加线程(需持有mutex_)
+   * @param wait_us 任务已经排队的时间
+   */
+  void checkGrow(uint64_t now, uint64_t wait_us);
+
+  /**
+   * @brief 创建第index个调度线程(需持有mutex_)
+   */
+  Thread::ptr createThread(size_t index);
+
+  /**
+   * @brief 创建登记的线程，回收已退出的线程
+   */
+  void grow();
+
 
 
 private:
@@ -186,16 +414,47 @@ private:
 
   std::vector<Thread::ptr> threads_; // 线程池
 
-  std::list<FiberAndThread> fibers_; // 待执行的协程队列
+  /// 待执行的任务，每个优先级两个队列：按截止时间排序的(EDF)在前，先进先出的在后
+  TaskQueue queues_[PRIORITY_COUNT * 2];
+
+  size_t taskCount_ = 0; // 所有队列中的任务数
+
+  uint64_t starvationUs_ = 0; // 防饿死阈值(微秒)
+
+  std::atomic<uint64_t> preemptUs_ = {0}; // 协程时间片(微秒)
 
   Fiber::ptr rootFiber_; // 调度协程，use_caller为true时有效
 
   std::string name_; // 协程调度器名称
 
+  Placement placement_; // 调度线程的cpu/NUMA放置
+
+  Elastic elastic_; // 弹性线程数配置
+
+  std::atomic<bool> growPending_ = {false}; // 是否有待创建的线程
+
+  uint64_t lastGrowUs_ = 0; // 上次增加线程的时间
+
+  size_t nextThreadIndex_ = 0; // 下一个线程的序号，用于线程名
+
+  std::vector<Thread::ptr> retired_; // 已退出等待回收的线程
+
+  std::atomic<uint64_t> growCount_ = {0}; // 增加线程次数
+
+  std::atomic<uint64_t> shrinkCount_ = {0}; // 减少线程次数
+
+  ShardedCounter scheduledCount_; // 入队任务数
+
+  ShardedCounter switchCount_; // 协程切入次数
+
+  LatencyHistogram queueLatency_; // 排队时间(微秒)
+
+  std::atomic<uint64_t> stallCount_ = {0}; // 卡顿次数，由StallWatchdog累加
+
 protected:
   std::vector<int> threadIds_; // 协程下的线程id数组
 
-  size_t threadCount_ = 0; // 线程数量
+  std::atomic<size_t> threadCount_ = {0}; // 线程数量
 
   std::atomic<size_t> activeThreadCount_ = {0}; // 工作线程数量
 
@@ -160,6 +160,39 @@ Socket::ptr Socket::accept()
   return nullptr;
 }
 
+size_t Socket::acceptBatch(std::vector<Socket::ptr>& socks, size_t max)
+{
+  size_t n = 0;
+  while(n < max)
+  {
+    // 监听socket已被FdCtx设置为非阻塞，这里直接调用accept4不会挂起协程
+    int newsock = ::accept4(sock_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(newsock == -1)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      if(errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        SYLAR_LOG_ERROR(g_logger) << "accept4(" << sock_ << ") errno="
+          << errno << " errstr=" << strerror(errno);
+      }
+      break;
+    }
+    FdMgr::GetInstance()->get(newsock, true);
+    Socket::ptr sock(new Socket(family_, type_, protocol_));
+    if(!sock->init(newsock))
+    {
+      ::close(newsock);
+      continue;
+    }
+    socks.push_back(sock);
+    ++n;
+  }
+  return n;
+}
+
 bool Socket::init(int sock)
 {
   FdCtx::ptr ctx = FdMgr::GetInstance()->get(sock);
@@ -397,6 +430,16 @@ int Socket::recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags
   return -1;
 }
 
+void Socket::setReusePort(bool v)
+{
+  reusePort_ = v;
+  if(isValid())
+  {
+    int val = v ? 1 : 0;
+    setOption(SOL_SOCKET, SO_REUSEPORT, val);
+  }
+}
+
 Address::ptr Socket::getRemoteAddress()
 {
   if(remoteAddress_)
@@ -541,6 +584,10 @@ void Socket::initSock()
 {
   int val = 1;
   setOption(SOL_SOCKET, SO_REUSEADDR, val);
+  if(reusePort_)
+  {
+    setOption(SOL_SOCKET, SO_REUSEPORT, val);
+  }
   if(type_ == SOCK_STREAM)
   {
     setOption(IPPROTO_TCP, TCP_NODELAY, val);
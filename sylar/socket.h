@@ -15,6 +15,7 @@
 #include <memory>
 #include <netinet/in.h>
 #include <type_traits>
+#include <vector>
 #include <sys/socket.h>
 #include <openssl/ssl.h>
 
@@ -153,6 +154,15 @@ public:
     */
   virtual Socket::ptr accept();
 
+  /**
+    * @brief 非阻塞地批量接收连接(accept4)，直到没有待接收的连接或达到上限
+    * @param[out] socks 新连接追加到该数组
+    * @param[in] max 本次最多接收的连接数
+    * @return 本次接收的连接数
+    * @pre Socket必须 bind , listen  成功
+    */
+  size_t acceptBatch(std::vector<Socket::ptr>& socks, size_t max);
+
   /**
     * @brief 绑定地址
     * @param[in] addr 地址
@@ -282,6 +292,16 @@ public:
     */
   virtual int recvFrom(iovec* buffers, size_t length, Address::ptr from, int flags = 0);
 
+  /**
+    * @brief 设置SO_REUSEPORT(需在bind之前调用)
+    */
+  void setReusePort(bool v);
+
+  /**
+    * @brief 是否设置了SO_REUSEPORT
+    */
+  bool isReusePort() const { return reusePort_;}
+
   /**
     * @brief 获取远端地址
     */
@@ -379,6 +399,8 @@ protected:
   int protocol_;
   /// 是否连接
   bool isConnected_;
+  /// 是否设置SO_REUSEPORT
+  bool reusePort_ = false;
   /// 本地地址
   Address::ptr localAddress_;
   /// 远端地址
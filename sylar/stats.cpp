@@ -0,0 +1,150 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 15:48:30
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 15:48:30
+ * @FilePath: /sylar-wxb/sylar/stats.cpp
+ * @Description: 运行时统计用的无锁计数器和HDR风格延迟直方图
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+
+#include "stats.h"
+
+namespace sylar {
+
+static std::atomic<size_t> s_shard_seq = {0};
+
+size_t StatsShardIndex()
+{
+  static thread_local size_t t_shard = s_shard_seq.fetch_add(1, std::memory_order_relaxed) % STATS_SHARDS;
+  return t_shard;
+}
+
+uint64_t ShardedCounter::get() const
+{
+  uint64_t v = 0;
+  for (auto& i : shards_)
+  {
+    v += i.value.load(std::memory_order_relaxed);
+  }
+  return v;
+}
+
+LatencyHistogram::Shard::Shard()
+{
+  for (auto& i : buckets)
+  {
+    i.store(0, std::memory_order_relaxed);
+  }
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  for (auto& i : shards_)
+  {
+    i.store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+  for (auto& i : shards_)
+  {
+    delete i.load(std::memory_order_relaxed);
+  }
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t v)
+{
+  if (v < (1u << SUB_BITS)) return v;
+  int e = 63 - __builtin_clzll(v); // 最高位
+  return ((size_t)(e - SUB_BITS + 1) << SUB_BITS) + ((v >> (e - SUB_BITS)) & ((1u << SUB_BITS) - 1));
+}
+
+uint64_t LatencyHistogram::BucketLower(size_t i)
+{
+  if (i < (1u << SUB_BITS)) return i;
+  int e = (int)(i >> SUB_BITS) + SUB_BITS - 1;
+  return (uint64_t)((1u << SUB_BITS) + (i & ((1u << SUB_BITS) - 1))) << (e - SUB_BITS);
+}
+
+uint64_t LatencyHistogram::BucketUpper(size_t i)
+{
+  return i + 1 < BUCKETS ? BucketLower(i + 1) - 1 : ~0ull;
+}
+
+LatencyHistogram::Shard* LatencyHistogram::getShard()
+{
+  std::atomic<Shard*>& slot = shards_[StatsShardIndex()];
+  Shard* shard = slot.load(std::memory_order_acquire);
+  if (shard) return shard;
+
+  Shard* fresh = new Shard;
+  if (slot.compare_exchange_strong(shard, fresh, std::memory_order_acq_rel)) return fresh;
+  delete fresh; // 同分片的另一个线程先分配了
+  return shard;
+}
+
+void LatencyHistogram::record(uint64_t v)
+{
+  Shard* shard = getShard();
+  shard->buckets[BucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+  shard->count.fetch_add(1, std::memory_order_relaxed);
+  shard->sum.fetch_add(v, std::memory_order_relaxed);
+  uint64_t max = shard->max.load(std::memory_order_relaxed);
+  while (v > max && !shard->max.compare_exchange_weak(max, v, std::memory_order_relaxed));
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+  Snapshot s;
+  for (auto& i : shards_)
+  {
+    Shard* shard = i.load(std::memory_order_acquire);
+    if (!shard) continue;
+    if (s.buckets.empty()) s.buckets.resize(BUCKETS);
+    for (size_t b = 0; b < BUCKETS; ++b)
+    {
+      s.buckets[b] += shard->buckets[b].load(std::memory_order_relaxed);
+    }
+    s.count += shard->count.load(std::memory_order_relaxed);
+    s.sum += shard->sum.load(std::memory_order_relaxed);
+    s.max = std::max(s.max, shard->max.load(std::memory_order_relaxed));
+  }
+  return s;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const
+{
+  // 各分片分别读取，桶计数之和可能与count略有出入，以桶为准
+  uint64_t total = 0;
+  for (auto i : buckets) total += i;
+  if (!total) return 0;
+  uint64_t rank = (uint64_t)(p / 100 * total + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > total) rank = total;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i)
+  {
+    seen += buckets[i];
+    if (seen >= rank) return std::min(BucketUpper(i), max);
+  }
+  return max;
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot& o)
+{
+  if (o.buckets.empty()) return;
+  if (buckets.empty()) buckets.resize(BUCKETS);
+  for (size_t i = 0; i < BUCKETS; ++i)
+  {
+    buckets[i] += o.buckets[i];
+  }
+  count += o.count;
+  sum += o.sum;
+  max = std::max(max, o.max);
+}
+
+} // namespace sylar
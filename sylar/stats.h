@@ -0,0 +1,129 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 15:48:30
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 15:48:30
+ * @FilePath: /sylar-wxb/sylar/stats.h
+ * @Description: 运行时统计用的无锁计数器和HDR风格延迟直方图，按线程分片写入，读取时汇总
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "noncopyable.h"
+
+namespace sylar {
+
+/**
+ * @brief 统计分片数，线程按首次使用的顺序轮流分到各分片
+ */
+static const size_t STATS_SHARDS = 16;
+
+/**
+ * @brief 当前线程使用的分片下标
+ */
+size_t StatsShardIndex();
+
+/**
+ * @brief 分片计数器：每个线程加自己的分片(独占缓存行)，读取时求和
+ */
+class ShardedCounter : Noncopyable
+{
+public:
+  void add(uint64_t v = 1)
+  {
+    shards_[StatsShardIndex()].value.fetch_add(v, std::memory_order_relaxed);
+  }
+
+  uint64_t get() const;
+private:
+  struct alignas(64) Shard
+  {
+    std::atomic<uint64_t> value = {0};
+  };
+  Shard shards_[STATS_SHARDS];
+};
+
+/**
+ * @brief 对数-线性分桶的直方图(HDR风格)
+ * @details 每个2的幂区间再均分为8个桶，相对误差不超过12.5%，覆盖全部uint64_t；
+ *          分片在线程第一次写入时分配，写入只有几次relaxed原子加
+ */
+class LatencyHistogram : Noncopyable
+{
+public:
+  /// 每个2的幂区间细分的位数
+  static const int SUB_BITS = 3;
+  /// 桶数
+  static const size_t BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+  /**
+   * @brief 某一时刻的汇总结果
+   */
+  struct Snapshot
+  {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    /// 各桶计数，为空表示没有数据
+    std::vector<uint64_t> buckets;
+
+    /**
+     * @brief 返回百分位数(p取0~100)，结果是所在桶的上界且不超过max
+     */
+    uint64_t percentile(double p) const;
+
+    double mean() const { return count ? (double)sum / count : 0;}
+
+    /**
+     * @brief 合并另一个快照
+     */
+    void merge(const Snapshot& o);
+  };
+
+  LatencyHistogram();
+  ~LatencyHistogram();
+
+  void record(uint64_t v);
+
+  Snapshot snapshot() const;
+
+  /**
+   * @brief 返回值v所在的桶
+   */
+  static size_t BucketIndex(uint64_t v);
+
+  /**
+   * @brief 返回桶能表示的最小值
+   */
+  static uint64_t BucketLower(size_t i);
+
+  /**
+   * @brief 返回桶能表示的最大值
+   */
+  static uint64_t BucketUpper(size_t i);
+private:
+  struct Shard
+  {
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> count = {0};
+    std::atomic<uint64_t> sum = {0};
+    std::atomic<uint64_t> max = {0};
+
+    Shard();
+  };
+
+  Shard* getShard();
+private:
+  std::atomic<Shard*> shards_[STATS_SHARDS];
+};
+
+} // namespace sylar
+
+#endif
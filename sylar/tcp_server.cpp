@@ -0,0 +1,344 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 10:12:30
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 10:12:30
+ * @FilePath: /sylar-wxb/sylar/tcp_server.cpp
+ * @Description: 
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <algorithm>
+#include <unistd.h>
+
+#include "tcp_server.h"
+#include "config.h"
+#include "fd_manager.h"
+#include "log.h"
+#include "macro.h"
+
+namespace sylar {
+
+static sylar::ConfigVar<uint64_t>::ptr g_tcp_server_read_timeout =
+  sylar::Config::Lookup("tcp_server.read_timeout", (uint64_t)(60 * 1000 * 2), "tcp server read timeout");
+
+static sylar::ConfigVar<std::vector<TcpServerConf>>::ptr g_servers_conf =
+  sylar::Config::Lookup("servers", std::vector<TcpServerConf>(), "tcp server config");
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+TcpServer::TcpServer(IOManager* io_worker, IOManager* accept_worker)
+  : ioWorker_(io_worker), acceptWorker_(accept_worker), recvTimeout_(g_tcp_server_read_timeout->getValue()),
+    name_("sylar/1.0.0"), isStop_(true)
+{
+
+}
+
+TcpServer::~TcpServer()
+{
+  for(auto& i : socks_)
+  {
+    i->close();
+  }
+  socks_.clear();
+}
+
+void TcpServer::setConf(const TcpServerConf& v)
+{
+  conf_.reset(new TcpServerConf(v));
+}
+
+bool TcpServer::bind(Address::ptr addr, bool ssl)
+{
+  std::vector<Address::ptr> addrs;
+  std::vector<Address::ptr> fails;
+  addrs.push_back(addr);
+  return bind(addrs, fails, ssl);
+}
+
+bool TcpServer::bindOne(Address::ptr addr, bool ssl)
+{
+  Socket::ptr sock = ssl ? SSLSocket::CreateTCP(addr) : Socket::CreateTCP(addr);
+  // unix socket不支持SO_REUSEPORT负载均衡
+  if(reusePort_ && addr->getFamily() != AF_UNIX)
+  {
+    sock->setReusePort(true);
+  }
+  if(!sock->bind(addr))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "bind fail errno=" << errno << " errstr=" << strerror(errno)
+      << " addr=[" << addr->toString() << "]";
+    return false;
+  }
+  if(!sock->listen())
+  {
+    SYLAR_LOG_ERROR(g_logger) << "listen fail errno=" << errno << " errstr=" << strerror(errno)
+      << " addr=[" << addr->toString() << "]";
+    return false;
+  }
+  // 监听socket可能在未hook的线程创建，这里注册FdCtx使其成为非阻塞，accept由协程调度
+  FdMgr::GetInstance()->get(sock->getSocket(), true);
+  socks_.push_back(sock);
+  return true;
+}
+
+bool TcpServer::bind(const std::vector<Address::ptr>& addrs, std::vector<Address::ptr>& fails, bool ssl)
+{
+  ssl_ = ssl;
+  size_t acceptors = 1;
+  if(reusePort_)
+  {
+    acceptors = acceptorNum_ ? acceptorNum_ : acceptWorker_->getThreadCount();
+    acceptors = acceptors ? acceptors : 1;
+  }
+
+  for(auto& addr : addrs)
+  {
+    size_t n = addr->getFamily() == AF_UNIX ? 1 : acceptors;
+    for(size_t i = 0; i < n; ++i)
+    {
+      if(!bindOne(addr, ssl))
+      {
+        fails.push_back(addr);
+        break;
+      }
+    }
+  }
+
+  if(!fails.empty())
+  {
+    socks_.clear();
+    return false;
+  }
+
+  for(auto& i : socks_)
+  {
+    SYLAR_LOG_INFO(g_logger) << "type=" << type_ << " name=" << name_ << " ssl=" << ssl_
+      << " reuseport=" << reusePort_ << " server bind success: " << *i;
+  }
+  return true;
+}
+
+bool TcpServer::bindConf(TcpServerConf::ptr conf)
+{
+  conf_ = conf;
+  if(!conf->name.empty())
+  {
+    setName(conf->name);
+  }
+  if(conf->timeout > 0)
+  {
+    recvTimeout_ = conf->timeout;
+  }
+  setReusePort(conf->reuseport, conf->acceptor_num > 0 ? conf->acceptor_num : 0);
+  setAcceptBatch(conf->accept_batch > 0 ? conf->accept_batch : 1);
+
+  std::vector<Address::ptr> addrs;
+  if(!ParseAddress(conf->address, addrs))
+  {
+    return false;
+  }
+  std::vector<Address::ptr> fails;
+  if(!bind(addrs, fails, conf->ssl))
+  {
+    return false;
+  }
+  if(conf->ssl && !loadCertificates(conf->cert_file, conf->key_file))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "loadCertificates fail, cert_file=" << conf->cert_file
+      << " key_file=" << conf->key_file;
+    return false;
+  }
+  return true;
+}
+
+bool TcpServer::loadCertificates(const std::string& cert_file, const std::string& key_file)
+{
+  for(auto& i : socks_)
+  {
+    auto ssl_socket = std::dynamic_pointer_cast<SSLSocket>(i);
+    if(ssl_socket && !ssl_socket->loadCertificates(cert_file, key_file))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TcpServer::dispatchClients(std::vector<Socket::ptr>& clients)
+{
+  if(clients.empty())
+  {
+    return;
+  }
+  std::vector<std::function<void()>> cbs;
+  cbs.reserve(clients.size());
+  for(auto& client : clients)
+  {
+    client->setRecvTimeout(recvTimeout_);
+    cbs.push_back(std::bind(&TcpServer::handleClient, shared_from_this(), client));
+  }
+  clients.clear();
+  ioWorker_->schedule(cbs.begin(), cbs.end());
+}
+
+void TcpServer::startAccept(Socket::ptr sock, int thread)
+{
+  std::vector<Socket::ptr> clients;
+  clients.reserve(acceptBatch_);
+  uint64_t backoff_ms = 0;
+  while(true)
+  {
+    // 挂起后可能在其他线程上被唤醒，回到自己的accept线程；
+    // stop的唤醒任务也在这个线程上执行，和下面检查isStop_到挂起之间不会交错
+    acceptWorker_->switchTo(thread);
+    if(isStop_)
+    {
+      break;
+    }
+
+    // 先非阻塞地把已完成握手的连接取完，没有连接时再挂起等待可读
+    if(!ssl_)
+    {
+      if(sock->acceptBatch(clients, acceptBatch_) > 0)
+      {
+        backoff_ms = 0;
+        dispatchClients(clients);
+        continue;
+      }
+      if(errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        backoff(backoff_ms);
+        continue;
+      }
+    }
+
+    // 自己等待可读而不是挂在hook的accept里，被stop唤醒后回到循环开头检查isStop_
+    int rt = acceptWorker_->addEvent(sock->getSocket(), IOManager::READ);
+    if(rt == 0)
+    {
+      Fiber::YieldToHold();
+      continue;
+    }
+    if(rt < 0)
+    {
+      backoff(backoff_ms);
+      continue;
+    }
+    if(!ssl_)
+    {
+      continue;
+    }
+
+    Socket::ptr client = sock->accept();
+    if(client)
+    {
+      backoff_ms = 0;
+      clients.push_back(client);
+      dispatchClients(clients);
+    }
+    else
+    {
+      backoff(backoff_ms);
+    }
+  }
+  // 只在自己的线程上关闭，不会和accept/注册事件并发，fd号也不会在使用中被复用
+  sock->close();
+}
+
+void TcpServer::backoff(uint64_t& backoff_ms)
+{
+  // EMFILE/ENFILE等错误下监听fd一直可读，退避重试，避免空转刷日志
+  backoff_ms = std::min<uint64_t>(backoff_ms ? backoff_ms * 2 : 1, 100);
+  SYLAR_LOG_ERROR(g_logger) << "accept errno=" << errno << " errstr=" << strerror(errno)
+    << " retry after " << backoff_ms << "ms";
+  usleep(backoff_ms * 1000);
+}
+
+bool TcpServer::start()
+{
+  if(!isStop_)
+  {
+    return true;
+  }
+  isStop_ = false;
+  // 每个监听socket的accept循环固定在一个accept线程上，reuseport时各线程独立accept
+  std::vector<int> threads = acceptWorker_->getThreadIds();
+  acceptThreads_.clear();
+  for(size_t i = 0; i < socks_.size(); ++i)
+  {
+    int thread = threads.empty() ? -1 : threads[i % threads.size()];
+    acceptThreads_.push_back(thread);
+    acceptWorker_->schedule(std::bind(&TcpServer::startAccept, shared_from_this(), socks_[i], thread), thread);
+  }
+  return true;
+}
+
+void TcpServer::stop()
+{
+  if(isStop_.exchange(true))
+  {
+    return;
+  }
+  // 只唤醒accept循环，socket由各循环在自己的线程上关闭
+  auto self = shared_from_this();
+  for(size_t i = 0; i < socks_.size(); ++i)
+  {
+    Socket::ptr sock = socks_[i];
+    acceptWorker_->schedule([self, sock]()
+    {
+      sock->cancelAll();
+    }, i < acceptThreads_.size() ? acceptThreads_[i] : -1);
+  }
+  socks_.clear();
+  acceptThreads_.clear();
+}
+
+void TcpServer::handleClient(Socket::ptr client)
+{
+  SYLAR_LOG_INFO(g_logger) << "handleClient: " << *client;
+}
+
+std::string TcpServer::toString(const std::string& prefix)
+{
+  std::stringstream ss;
+  ss << prefix << "[type=" << type_ << " name=" << name_ << " ssl=" << ssl_
+    << " reuseport=" << reusePort_ << " accept_batch=" << acceptBatch_
+    << " io_worker=" << (ioWorker_ ? ioWorker_->getName() : "")
+    << " accept=" << (acceptWorker_ ? acceptWorker_->getName() : "")
+    << " recv_timeout=" << recvTimeout_ << "]" << std::endl;
+  std::string pfx = prefix.empty() ? "    " : prefix;
+  for(auto& i : socks_)
+  {
+    ss << pfx << pfx << *i << std::endl;
+  }
+  return ss.str();
+}
+
+bool TcpServer::ParseAddress(const std::vector<std::string>& strs, std::vector<Address::ptr>& addrs)
+{
+  for(auto& a : strs)
+  {
+    size_t pos = a.find(":");
+    if(pos == std::string::npos)
+    {
+      addrs.push_back(UnixAddress::ptr(new UnixAddress(a)));
+      continue;
+    }
+    Address::ptr addr = Address::LookupAny(a);
+    if(!addr)
+    {
+      SYLAR_LOG_ERROR(g_logger) << "invalid address: " << a;
+      return false;
+    }
+    addrs.push_back(addr);
+  }
+  return true;
+}
+
+std::vector<TcpServerConf> TcpServer::GetServerConfs()
+{
+  return g_servers_conf->getValue();
+}
+
+} // namespace sylar
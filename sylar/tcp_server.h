@@ -0,0 +1,323 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 10:12:30
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 10:12:30
+ * @FilePath: /sylar-wxb/sylar/tcp_server.h
+ * @Description: TCP服务器封装
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef TCP_SERVER_H
+#define TCP_SERVER_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "address.h"
+#include "config.h"
+#include "iomanager.h"
+#include "noncopyable.h"
+#include "socket.h"
+
+namespace sylar {
+
+/**
+ * @brief TCP服务器配置(对应server.yml中servers的一项)
+ */
+struct TcpServerConf
+{
+  typedef std::shared_ptr<TcpServerConf> ptr;
+
+  /// 监听地址，ip:port 或 unix socket路径
+  std::vector<std::string> address;
+  /// 是否长连接
+  int keepalive = 0;
+  /// 接收超时时间(毫秒)
+  int timeout = 1000 * 2 * 60;
+  /// 是否使用ssl
+  int ssl = 0;
+  /// 是否开启SO_REUSEPORT多监听socket模式
+  int reuseport = 0;
+  /// SO_REUSEPORT模式下每个地址的监听socket数量，0表示与accept线程数相同
+  int acceptor_num = 0;
+  /// 每次唤醒后最多连续accept的连接数
+  int accept_batch = 32;
+  std::string id;
+  /// 服务器类型，tcp, http, rock
+  std::string type = "tcp";
+  std::string name;
+  std::string cert_file;
+  std::string key_file;
+  /// accept使用的IOManager名称
+  std::string accept_worker;
+  /// 连接io使用的IOManager名称
+  std::string io_worker;
+  /// 业务处理使用的IOManager名称
+  std::string process_worker;
+  /// 其他参数
+  std::map<std::string, std::string> args;
+
+  bool isValid() const { return !address.empty();}
+
+  bool operator==(const TcpServerConf& oth) const
+  {
+    return address == oth.address
+      && keepalive == oth.keepalive
+      && timeout == oth.timeout
+      && name == oth.name
+      && ssl == oth.ssl
+      && reuseport == oth.reuseport
+      && acceptor_num == oth.acceptor_num
+      && accept_batch == oth.accept_batch
+      && cert_file == oth.cert_file
+      && key_file == oth.key_file
+      && accept_worker == oth.accept_worker
+      && io_worker == oth.io_worker
+      && process_worker == oth.process_worker
+      && args == oth.args
+      && id == oth.id
+      && type == oth.type;
+  }
+};
+
+/**
+ * @brief 类型转换模板类偏特化(YAML String -> TcpServerConf)
+ */
+template<>
+class LexicalCast<std::string, TcpServerConf>
+{
+public:
+  TcpServerConf operator()(const std::string& v)
+  {
+    YAML::Node node = YAML::Load(v);
+    TcpServerConf conf;
+    conf.id = node["id"].as<std::string>(conf.id);
+    conf.type = node["type"].as<std::string>(conf.type);
+    conf.keepalive = node["keepalive"].as<int>(conf.keepalive);
+    conf.timeout = node["timeout"].as<int>(conf.timeout);
+    conf.name = node["name"].as<std::string>(conf.name);
+    conf.ssl = node["ssl"].as<int>(conf.ssl);
+    conf.reuseport = node["reuseport"].as<int>(conf.reuseport);
+    conf.acceptor_num = node["acceptor_num"].as<int>(conf.acceptor_num);
+    conf.accept_batch = node["accept_batch"].as<int>(conf.accept_batch);
+    conf.cert_file = node["cert_file"].as<std::string>(conf.cert_file);
+    conf.key_file = node["key_file"].as<std::string>(conf.key_file);
+    conf.accept_worker = node["accept_worker"].as<std::string>();
+    conf.io_worker = node["io_worker"].as<std::string>();
+    conf.process_worker = node["process_worker"].as<std::string>();
+    conf.args = LexicalCast<std::string, std::map<std::string, std::string>>()(node["args"].as<std::string>(""));
+    if(node["address"].IsDefined())
+    {
+      for(size_t i = 0; i < node["address"].size(); ++i)
+      {
+        conf.address.push_back(node["address"][i].as<std::string>());
+      }
+    }
+    return conf;
+  }
+};
+
+/**
+ * @brief 类型转换模板类偏特化(TcpServerConf -> YAML String)
+ */
+template<>
+class LexicalCast<TcpServerConf, std::string>
+{
+public:
+  std::string operator()(const TcpServerConf& conf)
+  {
+    YAML::Node node;
+    node["id"] = conf.id;
+    node["type"] = conf.type;
+    node["name"] = conf.name;
+    node["keepalive"] = conf.keepalive;
+    node["timeout"] = conf.timeout;
+    node["ssl"] = conf.ssl;
+    node["reuseport"] = conf.reuseport;
+    node["acceptor_num"] = conf.acceptor_num;
+    node["accept_batch"] = conf.accept_batch;
+    node["cert_file"] = conf.cert_file;
+    node["key_file"] = conf.key_file;
+    node["accept_worker"] = conf.accept_worker;
+    node["io_worker"] = conf.io_worker;
+    node["process_worker"] = conf.process_worker;
+    node["args"] = YAML::Load(LexicalCast<std::map<std::string, std::string>, std::string>()(conf.args));
+    for(auto& i : conf.address)
+    {
+      node["address"].push_back(i);
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+  }
+};
+
+/**
+ * @brief TCP服务器
+ * @details accept在acceptWorker上执行，新连接交给ioWorker处理(handleClient)
+ */
+class TcpServer : public std::enable_shared_from_this<TcpServer>, Noncopyable
+{
+public:
+  typedef std::shared_ptr<TcpServer> ptr;
+
+  /**
+   * @brief 构造函数
+   * @param[in] io_worker 新连接的socket工作的协程调度器
+   * @param[in] accept_worker 服务器socket执行接收socket连接的协程调度器
+   */
+  TcpServer(IOManager* io_worker = IOManager::GetThis(),
+            IOManager* accept_worker = IOManager::GetThis());
+
+  virtual ~TcpServer();
+
+  /**
+   * @brief 绑定地址
+   * @return 是否绑定成功
+   */
+  virtual bool bind(Address::ptr addr, bool ssl = false);
+
+  /**
+   * @brief 绑定地址数组
+   * @param[in] addrs 需要绑定的地址数组
+   * @param[out] fails 绑定失败的地址
+   * @return 是否全部绑定成功
+   */
+  virtual bool bind(const std::vector<Address::ptr>& addrs,
+                    std::vector<Address::ptr>& fails, bool ssl = false);
+
+  /**
+   * @brief 按配置绑定地址并设置服务器参数
+   */
+  bool bindConf(TcpServerConf::ptr conf);
+
+  /**
+   * @brief 加载证书(ssl模式)
+   */
+  bool loadCertificates(const std::string& cert_file, const std::string& key_file);
+
+  /**
+   * @brief 启动服务
+   * @pre 需要bind成功后执行
+   */
+  virtual bool start();
+
+  /**
+   * @brief 停止服务
+   */
+  virtual void stop();
+
+  uint64_t getRecvTimeout() const { return recvTimeout_;}
+
+  void setRecvTimeout(uint64_t v) { recvTimeout_ = v;}
+
+  std::string getName() const { return name_;}
+
+  virtual void setName(const std::string& v) { name_ = v;}
+
+  bool isStop() const { return isStop_;}
+
+  /**
+   * @brief 设置SO_REUSEPORT多监听socket模式
+   * @param[in] v 是否开启
+   * @param[in] acceptor_num 每个地址的监听socket数量，0表示与accept线程数相同
+   * @pre 需要在bind之前调用
+   */
+  void setReusePort(bool v, size_t acceptor_num = 0) { reusePort_ = v; acceptorNum_ = acceptor_num;}
+
+  bool isReusePort() const { return reusePort_;}
+
+  /**
+   * @brief 设置每次唤醒后最多连续accept的连接数
+   */
+  void setAcceptBatch(size_t v) { acceptBatch_ = v ? v : 1;}
+
+  size_t getAcceptBatch() const { return acceptBatch_;}
+
+  TcpServerConf::ptr getConf() const { return conf_;}
+
+  void setConf(TcpServerConf::ptr v) { conf_ = v;}
+
+  void setConf(const TcpServerConf& v);
+
+  std::vector<Socket::ptr> getSocks() const { return socks_;}
+
+  virtual std::string toString(const std::string& prefix = "");
+
+  /**
+   * @brief 解析配置中的地址字符串
+   * @param[in] strs ip:port 或 unix socket路径
+   * @param[out] addrs 解析得到的地址
+   * @return 是否全部解析成功
+   */
+  static bool ParseAddress(const std::vector<std::string>& strs, std::vector<Address::ptr>& addrs);
+
+  /**
+   * @brief 获取配置文件中的servers配置
+   */
+  static std::vector<TcpServerConf> GetServerConfs();
+
+protected:
+  /**
+   * @brief 处理新连接的Socket类
+   */
+  virtual void handleClient(Socket::ptr client);
+
+  /**
+   * @brief 开始接受连接
+   * @param[in] thread 固定执行accept循环的acceptWorker线程id，-1表示不固定
+   */
+  virtual void startAccept(Socket::ptr sock, int thread = -1);
+
+  /**
+   * @brief accept出错时退避等待，等待时间从1ms翻倍到100ms
+   */
+  void backoff(uint64_t& backoff_ms);
+
+  /**
+   * @brief 将一批新连接交给ioWorker(一次加锁、一次tickle)
+   */
+  void dispatchClients(std::vector<Socket::ptr>& clients);
+
+  /**
+   * @brief 为一个地址创建并绑定监听socket
+   */
+  bool bindOne(Address::ptr addr, bool ssl);
+
+protected:
+  /// 监听Socket数组
+  std::vector<Socket::ptr> socks_;
+  /// 每个监听Socket的accept循环所在的线程
+  std::vector<int> acceptThreads_;
+  /// 新连接的Socket工作的调度器
+  IOManager* ioWorker_;
+  /// 服务器Socket接收连接的调度器
+  IOManager* acceptWorker_;
+  /// 接收超时时间(毫秒)
+  uint64_t recvTimeout_;
+  /// 服务器名称
+  std::string name_;
+  /// 服务器类型
+  std::string type_ = "tcp";
+  /// 服务是否停止
+  std::atomic<bool> isStop_;
+  /// 是否使用ssl
+  bool ssl_ = false;
+  /// 是否开启SO_REUSEPORT多监听socket模式
+  bool reusePort_ = false;
+  /// SO_REUSEPORT模式下每个地址的监听socket数量
+  size_t acceptorNum_ = 0;
+  /// 每次唤醒后最多连续accept的连接数
+  size_t acceptBatch_ = 32;
+  /// 服务器配置
+  TcpServerConf::ptr conf_;
+};
+
+} // namespace sylar
+
+#endif
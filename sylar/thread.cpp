@@ -6,9 +6,17 @@
  * @FilePath: /sylar-wxb/sylar/thread.cc
  * @Description: 
  */
+#include <cstring>
+#include <errno.h>
+#include <fstream>
 #include <functional>
 #include <iterator>
+#include <linux/mempolicy.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "thread.h"
 #include "log.h"
@@ -45,8 +53,9 @@ void Thread::SetName(const std::string& name)
   t_thread_name = name;
 }
 
-Thread::Thread(std::function<void()> cb, const std::string& name)
-                : cb_(cb), name_(name)
+Thread::Thread(std::function<void()> cb, const std::string& name
+               , const std::vector<int>& cpus, int numa_node)
+                : cb_(cb), name_(name), cpus_(cpus), numaNode_(numa_node)
 {
   if (name.empty())
   {
@@ -83,6 +92,121 @@ void Thread::join()
   }
 }
 
+/**
+ * @brief 绑定线程到cpu集合
+ */
+static bool set_affinity(pthread_t thread, const std::vector<int>& cpus, const std::string& name)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+  {
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+    {
+      CPU_SET(cpu, &set);
+    }
+  }
+  int rt = pthread_setaffinity_np(thread, sizeof(set), &set);
+  if (rt)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "pthread_setaffinity_np fail, rt=" << rt << " name=" << name;
+    return false;
+  }
+  return true;
+}
+
+bool Thread::setAffinity(const std::vector<int>& cpus)
+{
+  if (cpus.empty() || !thread_)
+  {
+    return false;
+  }
+  return set_affinity(thread_, cpus, name_);
+}
+
+std::vector<int> Thread::ParseCpus(const std::string& str)
+{
+  std::vector<int> cpus;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ','))
+  {
+    if (item.empty())
+    {
+      continue;
+    }
+    auto pos = item.find('-');
+    if (pos == std::string::npos)
+    {
+      cpus.push_back(atoi(item.c_str()));
+      continue;
+    }
+    int b = atoi(item.substr(0, pos).c_str());
+    int e = atoi(item.substr(pos + 1).c_str());
+    for (int c = b; c <= e; ++c)
+    {
+      cpus.push_back(c);
+    }
+  }
+  return cpus;
+}
+
+int Thread::GetNumaNodeCount()
+{
+  std::ifstream ifs("/sys/devices/system/node/online");
+  std::string line;
+  if (!std::getline(ifs, line))
+  {
+    return 1;
+  }
+  std::vector<int> nodes = ParseCpus(line); // 格式和cpu列表相同
+  return nodes.empty() ? 1 : nodes.back() + 1;
+}
+
+std::vector<int> Thread::GetNumaNodeCpus(int node)
+{
+  std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+  std::string line;
+  if (!std::getline(ifs, line))
+  {
+    return {};
+  }
+  return ParseCpus(line);
+}
+
+int Thread::GetCpuNumaNode(int cpu)
+{
+  int count = GetNumaNodeCount();
+  for (int node = 0; node < count; ++node)
+  {
+    for (int c : GetNumaNodeCpus(node))
+    {
+      if (c == cpu)
+      {
+        return node;
+      }
+    }
+  }
+  return -1;
+}
+
+bool Thread::BindNumaNode(int node)
+{
+  if (node < 0 || node >= (int)(sizeof(unsigned long) * 8))
+  {
+    return false;
+  }
+  unsigned long mask = 1ul << node;
+  // 用PREFERRED而不是BIND：节点内存耗尽时退回其他节点而不是OOM
+  if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "set_mempolicy node=" << node << " fail, errno=" << errno
+      << " errstr=" << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
 void* Thread::run(void* arg)
 {
   Thread* thread = (Thread*)arg;
@@ -90,6 +214,14 @@ void* Thread::run(void* arg)
   t_thread_name = thread->name_;
   thread->id_ = sylar::GetThreadId();
   pthread_setname_np(pthread_self(), thread->name_.substr(0, 15).c_str());
+  if (!thread->cpus_.empty())
+  {
+    set_affinity(pthread_self(), thread->cpus_, thread->name_);
+  }
+  if (thread->numaNode_ >= 0 && !BindNumaNode(thread->numaNode_))
+  {
+    thread->numaNode_ = -1;
+  }
 
   std::function<void()> cb;
   cb.swap(thread->cb_);
@@ -21,6 +21,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "noncopyable.h"
 #include "mutex.h"
@@ -33,7 +34,14 @@ class Thread : Noncopyable
 public:
   typedef std::shared_ptr<Thread> ptr;
 
-  Thread(std::function<void()> cb, const std::string& name);
+  /**
+   * @brief 创建并启动线程
+   * @param cpus 线程绑定的cpu集合，为空不绑定
+   * @param numa_node 线程内存优先分配的NUMA节点，-1不设置
+   * @details 绑定在新线程执行cb之前完成，之后线程分配的栈、缓冲区等都落在本节点上
+   */
+  Thread(std::function<void()> cb, const std::string& name
+         , const std::vector<int>& cpus = {}, int numa_node = -1);
 
   ~Thread();
 
@@ -43,12 +51,50 @@ public:
 
   void join();
 
+  /**
+   * @brief 将线程绑定到指定的cpu集合上
+   * @param cpus cpu编号数组，为空时不做处理
+   * @return 是否绑定成功
+   */
+  bool setAffinity(const std::vector<int>& cpus);
+
+  /**
+   * @brief 返回线程绑定的NUMA节点，-1表示没有绑定
+   */
+  int getNumaNode() const { return numaNode_;}
+
   static Thread* GetThis();
 
   static const std::string& GetName();
 
   static void SetName(const std::string& name);
 
+  /**
+   * @brief 解析cpu列表，如"0-3,8"
+   */
+  static std::vector<int> ParseCpus(const std::string& str);
+
+  /**
+   * @brief 返回NUMA节点数量，不支持NUMA时返回1
+   */
+  static int GetNumaNodeCount();
+
+  /**
+   * @brief 返回NUMA节点上的cpu列表，节点不存在返回空
+   */
+  static std::vector<int> GetNumaNodeCpus(int node);
+
+  /**
+   * @brief 返回cpu所在的NUMA节点，未知返回-1
+   */
+  static int GetCpuNumaNode(int cpu);
+
+  /**
+   * @brief 设置当前线程的内存优先从node分配(set_mempolicy MPOL_PREFERRED)
+   * @return 是否设置成功
+   */
+  static bool BindNumaNode(int node);
+
 private:
 
   static void* run(void* arg);
@@ -61,6 +107,10 @@ private:
 
   std::string name_;
 
+  std::vector<int> cpus_; // 启动时绑定的cpu集合
+
+  int numaNode_ = -1; // 绑定的NUMA节点
+
   Semaphore semaphore_;
 
 }; 
@@ -37,10 +37,10 @@ bool Timer::Comparator::operator()(const Timer::ptr& lhs, const Timer::ptr& rhs)
   return lhs.get() < rhs.get();
 }
 
-Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager* manager)
-    :recurring_(recurring), ms_(ms), cb_(cb), manager_(manager)
+Timer::Timer(uint64_t us, std::function<void()> cb, bool recurring, TimerManager* manager)
+    :recurring_(recurring), us_(us), cb_(cb), manager_(manager)
 {
-  next_ = sylar::GetCurrentMS() + ms_;
+  next_ = sylar::GetCurrentUS() + us_;
 }
 
 Timer::Timer(uint64_t next) : next_(next)
@@ -73,14 +73,19 @@ bool Timer::refresh()
       return false;
   }
   manager_->timers_.erase(it);
-  next_ = sylar::GetCurrentMS() + ms_;
+  next_ = sylar::GetCurrentUS() + us_;
   manager_->timers_.insert(shared_from_this()); // 为什么前面要删了？？？
   return true;
 }
 
 bool Timer::reset(uint64_t ms, bool from_now)
 {
-  if(ms_ == ms && !from_now)
+  return resetUs(ms * 1000, from_now);
+}
+
+bool Timer::resetUs(uint64_t us, bool from_now)
+{
+  if(us_ == us && !from_now)
   {
     return true;
   }
@@ -97,10 +102,10 @@ bool Timer::reset(uint64_t ms, bool from_now)
   manager_->timers_.erase(it);
 
   uint64_t start = 0;
-  if(from_now) start = sylar::GetCurrentMS();
-  else start = next_ - ms;
-  ms_ = ms;
-  next_ = start + ms;
+  if(from_now) start = sylar::GetCurrentUS();
+  else start = next_ - us_;
+  us_ = us;
+  next_ = start + us;
   manager_->addTimer(shared_from_this(), lock);
 
   return true;
@@ -108,7 +113,7 @@ bool Timer::reset(uint64_t ms, bool from_now)
 
 TimerManager::TimerManager()
 {
-  previouseTime_ = sylar::GetCurrentMS();
+  previouseTime_ = sylar::GetCurrentUS();
 }
 
 TimerManager::~TimerManager()
@@ -118,7 +123,12 @@ TimerManager::~TimerManager()
 
 Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring)
 {
-  Timer::ptr timer(new Timer(ms, cb, recurring, this));
+  return addTimerUs(ms * 1000, std::move(cb), recurring);
+}
+
+Timer::ptr TimerManager::addTimerUs(uint64_t us, std::function<void()> cb, bool recurring)
+{
+  Timer::ptr timer(new Timer(us, std::move(cb), recurring, this));
   RWMutexType::WriteLock lock(mutex_);
   addTimer(timer, lock);
   return timer;
@@ -140,6 +150,16 @@ Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb
 }
 
 uint64_t TimerManager::getNextTimer()
+{
+  uint64_t us = getNextTimerUs();
+  if(us == ~0ull)
+  {
+    return ~0ull;
+  }
+  return (us + 999) / 1000;
+}
+
+uint64_t TimerManager::getNextTimerUs()
 {
   RWMutexType::ReadLock lock(mutex_);
   tickled_ = false;
@@ -149,15 +169,15 @@ uint64_t TimerManager::getNextTimer()
   }
 
   const Timer::ptr& next = *timers_.begin();
-  uint64_t now_ms = sylar::GetCurrentMS();
+  uint64_t now_us = sylar::GetCurrentUS();
 
-  if(now_ms >= next->next_) return 0;
-  else return next->next_ - now_ms;
+  if(now_us >= next->next_) return 0;
+  else return next->next_ - now_us;
 }
 
 void TimerManager::listExpiredCb(std::vector<std::function<void()> >& cbs)
 {
-  uint64_t now_ms = sylar::GetCurrentMS();
+  uint64_t now_us = sylar::GetCurrentUS();
   std::vector<Timer::ptr> expired;
   {
     RWMutexType::ReadLock lock(mutex_);
@@ -171,12 +191,12 @@ void TimerManager::listExpiredCb(std::vector<std::function<void()> >& cbs)
   {
     return;
   }
-  bool rollover = detectClockRollover(now_ms);
-  if(!rollover && ((*timers_.begin())->next_ > now_ms)) return; // 还没到第一个定时器回调函数的执行时间
+  bool rollover = detectClockRollover(now_us);
+  if(!rollover && ((*timers_.begin())->next_ > now_us)) return; // 还没到第一个定时器回调函数的执行时间
 
-  Timer::ptr now_timer(new Timer(now_ms));
+  Timer::ptr now_timer(new Timer(now_us));
   auto it = rollover ? timers_.end() : timers_.lower_bound(now_timer);
-  while(it != timers_.end() && (*it)->next_ == now_ms) // 找到所有已失效的定时器回调函数
+  while(it != timers_.end() && (*it)->next_ == now_us) // 找到所有已失效的定时器回调函数
   {
     ++it;
   }
@@ -184,12 +204,17 @@ void TimerManager::listExpiredCb(std::vector<std::function<void()> >& cbs)
   timers_.erase(timers_.begin(), it);
   cbs.reserve(expired.size());
 
+  expiredCount_.add(expired.size());
   for(auto& timer : expired)
   {
+    if(!rollover)
+    {
+      lateness_.record(now_us - timer->next_);
+    }
     cbs.push_back(timer->cb_);
     if(timer->recurring_) // 周期函数重新放入
     {
-      timer->next_ = now_ms + timer->ms_;
+      timer->next_ = now_us + timer->us_;
       timers_.insert(timer);
     }
     else
@@ -215,14 +240,14 @@ void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock& lock)
   }
 }
 
-bool TimerManager::detectClockRollover(uint64_t now_ms)
+bool TimerManager::detectClockRollover(uint64_t now_us)
 {
   bool rollover = false;
-  if(now_ms < previouseTime_ && now_ms < (previouseTime_ - 60 * 60 * 1000)) // ???为什么有两个条件
+  if(now_us < previouseTime_ && now_us < (previouseTime_ - 60 * 60 * 1000 * 1000ull)) // ???为什么有两个条件
   {
     rollover = true;
   }
-  previouseTime_ = now_ms;
+  previouseTime_ = now_us;
   return rollover;
 }
 
@@ -232,4 +257,16 @@ bool TimerManager::hasTimer()
   return !timers_.empty();
 }
 
+TimerManager::TimerStats TimerManager::getTimerStats()
+{
+  TimerStats stats;
+  {
+    RWMutexType::ReadLock lock(mutex_);
+    stats.pending = timers_.size();
+  }
+  stats.expired = expiredCount_.get();
+  stats.latenessUs = lateness_.snapshot();
+  return stats;
+}
+
 } // namespace sylar
@@ -12,12 +12,14 @@
 #define TIMER_H
 
 #include <cstdint>
+#include <chrono>
 #include <memory>
 #include <functional>
 #include <vector>
 #include <set>
 
 #include "mutex.h"
+#include "stats.h"
 
 namespace sylar {
 
@@ -46,28 +48,35 @@ public:
    */  
   bool reset(uint64_t ms, bool from_now);
 
+  /**
+   * @brief 以微秒为单位重置定时器时间
+   * @param us 定时器执行间隔(微秒)
+   * @param from_now 是否从当前时间开始计算
+   */
+  bool resetUs(uint64_t us, bool from_now);
+
 private:
   /**
   * @brief 构造函数
-  * @param ms 定时器执行间隔时间
+  * @param us 定时器执行间隔时间(微秒)
   * @param cb 回调函数
   * @param recurring 是否循环
   * @param manager 定时器管理器
   */
-  Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager* manager);
+  Timer(uint64_t us, std::function<void()> cb, bool recurring, TimerManager* manager);
 
   /**
   * @brief 构造函数
-  * @param next 执行的时间戳(毫秒)
+  * @param next 执行的时间戳(微秒)
   */
   Timer(uint64_t next);
 
 private:
   /// 是否循环定时器
   bool recurring_ = false;
-  /// 执行周期
-  uint64_t ms_ = 0;
-  /// 精确的执行时间
+  /// 执行周期(微秒)
+  uint64_t us_ = 0;
+  /// 精确的执行时间(微秒)
   uint64_t next_ = 0;
   /// 回调函数
   std::function<void()> cb_;
@@ -115,6 +124,29 @@ public:
   Timer::ptr addTimer(uint64_t ms, std::function<void()> cb
                       ,bool recurring = false);
 
+  /**
+  * @brief 添加微秒精度的定时器
+  * @param[in] us 定时器执行间隔时间(微秒)
+  * @param[in] cb 定时器回调函数
+  * @param[in] recurring 是否循环定时器
+  */
+  Timer::ptr addTimerUs(uint64_t us, std::function<void()> cb
+                      ,bool recurring = false);
+
+  /**
+  * @brief 按std::chrono时长添加定时器,不足1微秒的部分向上取整
+  * @param[in] d 定时器执行间隔时间
+  * @param[in] cb 定时器回调函数
+  * @param[in] recurring 是否循环定时器
+  */
+  template<class Rep, class Period>
+  Timer::ptr addTimer(std::chrono::duration<Rep, Period> d, std::function<void()> cb
+                      ,bool recurring = false)
+  {
+    auto us = std::chrono::ceil<std::chrono::microseconds>(d).count();
+    return addTimerUs(us > 0 ? us : 0, std::move(cb), recurring);
+  }
+
   /**
   * @brief 添加条件定时器
   * @param[in] ms 定时器执行间隔时间
@@ -127,10 +159,15 @@ public:
                       ,bool recurring = false);
 
   /**
-   * @brief 到最近一个定时器执行的时间间隔(毫秒)
+   * @brief 到最近一个定时器执行的时间间隔(毫秒,向上取整)
    */
   uint64_t getNextTimer();
-  
+
+  /**
+   * @brief 到最近一个定时器执行的时间间隔(微秒),没有定时器时返回~0ull
+   */
+  uint64_t getNextTimerUs();
+
 
   /**
    * @brief 获取需要执行的定时器的回调函数列表
@@ -142,6 +179,21 @@ public:
    * @brief 是否有定时器
    */
   bool hasTimer();
+
+  /**
+   * @brief 定时器统计快照
+   */
+  struct TimerStats
+  {
+    /// 等待到期的定时器数
+    size_t pending = 0;
+    /// 已到期触发的次数
+    uint64_t expired = 0;
+    /// 到期时间到被取出的延迟(微秒)
+    LatencyHistogram::Snapshot latenessUs;
+  };
+
+  TimerStats getTimerStats();
 protected:
 
   /**
@@ -157,7 +209,7 @@ private:
   /**
    * @brief 检测服务器时间是否溢出
    */
-  bool detectClockRollover(uint64_t now_ms);
+  bool detectClockRollover(uint64_t now_us);
 private:
   /// Mutex
   RWMutexType mutex_;
@@ -165,8 +217,12 @@ private:
   std::set<Timer::ptr, Timer::Comparator> timers_;
   /// 是否触发onTimerInsertedAtFront
   bool tickled_ = false;
-  /// 上次执行时间
+  /// 上次执行时间(微秒)
   uint64_t previouseTime_ = 0;
+  /// 到期触发次数
+  ShardedCounter expiredCount_;
+  /// 到期延迟(微秒)
+  LatencyHistogram lateness_;
 
 };
 
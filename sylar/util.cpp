@@ -101,6 +101,23 @@ std::string BacktraceToString(int size, int skip, const std::string& prefix)
   return ss.str();
 }
 
+std::string BacktraceToString(void* const* array, int size, const std::string& prefix)
+{
+  char** strings = backtrace_symbols(array, size);
+  if (strings == NULL)
+  {
+    SYLAR_LOG_ERROR(g_logger) << "backtrace_synbols error";
+    return "";
+  }
+  std::stringstream ss;
+  for (int i = 0; i < size; i++)
+  {
+    ss << prefix << demangle(strings[i]) << std::endl;
+  }
+  free(strings);
+  return ss.str();
+}
+
 uint64_t GetCurrentMS()
 {
   struct timeval tv;
@@ -42,6 +42,14 @@ void Backtrace(std::vector<std::string>& bt, int size = 64, int skip = 1);
  */
 std::string BacktraceToString(int size = 64, int skip = 2, const std::string& prefix = "");
 
+/**
+ * @brief 将backtrace()得到的地址数组转成字符串，用于别处(如信号处理函数)采集的栈
+ * @param array 地址数组
+ * @param size 地址个数
+ * @param prefix 每行的前缀
+ */
+std::string BacktraceToString(void* const* array, int size, const std::string& prefix = "");
+
 /**
  * @brief 获取当前时间的毫秒
  */
@@ -0,0 +1,238 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:30:10
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:30:10
+ * @FilePath: /sylar-wxb/sylar/watchdog.cpp
+ * @Description: 调度线程卡顿检测：协程长时间不回到调度循环时抓取其调用栈并限频上报
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "fiber.h"
+#include "log.h"
+#include "scheduler.h"
+#include "util.h"
+#include "watchdog.h"
+
+namespace sylar {
+
+static Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static ConfigVar<uint64_t>::ptr g_stall_threshold_ms =
+  Config::Lookup<uint64_t>("scheduler.stall_threshold_ms", 0, "report a worker running one task longer than this ms, 0 disables the watchdog");
+
+static ConfigVar<uint64_t>::ptr g_stall_report_interval_ms =
+  Config::Lookup<uint64_t>("scheduler.stall_report_interval_ms", 1000, "minimum interval between two stall reports ms");
+
+static thread_local StallWatchdog::Slot* t_stall_slot = nullptr;
+
+/**
+ * @brief 取栈信号，用实时信号避免和应用常用的信号冲突
+ */
+static int StallSignal()
+{
+  return SIGRTMIN + 1;
+}
+
+/**
+ * @brief 在卡住的线程上取当前协程id和调用栈
+ */
+static void StallHandler(int)
+{
+  int saved_errno = errno;
+  StallWatchdog::Slot* slot = t_stall_slot;
+  if (slot && slot->capture.load(std::memory_order_acquire) == 1)
+  {
+    slot->fiberId = Fiber::GetFiberId();
+    slot->depth = Fiber::IsSwitching() ? 0 : backtrace(slot->pcs, StallWatchdog::MAX_DEPTH); // 切换中间不能展开
+    slot->capture.store(2, std::memory_order_release);
+  }
+  errno = saved_errno;
+}
+
+StallWatchdog::StallWatchdog()
+{
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = &StallHandler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(StallSignal(), &sa, nullptr))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "sigaction for stall watchdog fail errno=" << errno << " " << strerror(errno);
+  }
+  // backtrace第一次调用可能分配内存，先在这里调用一次
+  void* warmup[4];
+  backtrace(warmup, 4);
+
+  g_stall_threshold_ms->addListener([this](const uint64_t& old_value, const uint64_t& new_value)
+  {
+    if (!new_value) return;
+    MutexType::Lock lock(mutex_);
+    startThread();
+  });
+}
+
+StallWatchdog::~StallWatchdog()
+{
+  stopping_ = true;
+  if (thread_) thread_->join();
+  for (auto i : slots_) delete i;
+}
+
+StallWatchdog::Slot* StallWatchdog::addThread(Scheduler* scheduler)
+{
+  Slot* slot = new Slot;
+  slot->scheduler = scheduler;
+  slot->tid = GetThreadId();
+  slot->threadName = Thread::GetName();
+
+  MutexType::Lock lock(mutex_);
+  slots_.push_back(slot);
+  t_stall_slot = slot;
+  if (g_stall_threshold_ms->getValue()) startThread();
+  return slot;
+}
+
+void StallWatchdog::delThread(Slot* slot)
+{
+  MutexType::Lock lock(mutex_);
+  auto it = std::find(slots_.begin(), slots_.end(), slot);
+  if (it != slots_.end()) slots_.erase(it);
+  if (t_stall_slot == slot) t_stall_slot = nullptr;
+  if (slot->refs) // 检测线程正在锁外取栈，由它用完后释放
+  {
+    slot->removed = true;
+    return;
+  }
+  delete slot;
+}
+
+void StallWatchdog::setCallback(Callback cb)
+{
+  MutexType::Lock lock(mutex_);
+  cb_ = cb;
+}
+
+void StallWatchdog::startThread()
+{
+  if (thread_) return;
+  thread_.reset(new Thread(std::bind(&StallWatchdog::run, this), "stall_watchdog"));
+}
+
+void StallWatchdog::run()
+{
+  while (!stopping_)
+  {
+    uint64_t threshold_us = g_stall_threshold_ms->getValue() * 1000;
+    if (!threshold_us)
+    {
+      usleep(100 * 1000);
+      continue;
+    }
+    // 扫描间隔为阈值的1/4，卡顿最晚在1.25倍阈值时被发现
+    usleep(std::max<uint64_t>(threshold_us / 4, 1000));
+    check(threshold_us);
+  }
+}
+
+bool StallWatchdog::capture(Slot* slot)
+{
+  slot->capture.store(1, std::memory_order_release);
+  if (syscall(SYS_tgkill, getpid(), slot->tid, StallSignal()))
+  {
+    slot->capture = 0;
+    return false;
+  }
+  for (int i = 0; i < 100; ++i)
+  {
+    if (slot->capture.load(std::memory_order_acquire) == 2) break;
+    usleep(100);
+  }
+  int expected = 1; // 超时未响应则撤销请求，之后到达的信号不再写入
+  bool ok = !slot->capture.compare_exchange_strong(expected, 0);
+  slot->capture = 0;
+  return ok;
+}
+
+void StallWatchdog::check(uint64_t threshold_us)
+{
+  struct Stalled
+  {
+    Slot* slot;
+    uint64_t since;
+    Report report;
+  };
+  std::vector<Stalled> stalled;
+  Callback cb;
+  uint64_t now = GetCurrentUS();
+  {
+    MutexType::Lock lock(mutex_);
+    for (auto slot : slots_)
+    {
+      uint64_t since = slot->busySinceUs.load(std::memory_order_relaxed);
+      if (!since || now < since + threshold_us || slot->reportedUs == since) continue;
+
+      // 调度器在线程注销前不会析构，计数和取名字都在锁内做
+      slot->reportedUs = since;
+      ++slot->scheduler->stallCount_;
+      if (now - lastReportUs_ < g_stall_report_interval_ms->getValue() * 1000)
+      {
+        ++suppressed_;
+        continue;
+      }
+      lastReportUs_ = now;
+
+      Stalled s;
+      s.slot = slot;
+      s.since = since;
+      s.report.scheduler = slot->scheduler->getName();
+      s.report.thread = slot->threadName;
+      s.report.tid = slot->tid;
+      s.report.stalledMs = (now - since) / 1000;
+      s.report.suppressed = suppressed_;
+      suppressed_ = 0;
+      ++slot->refs;
+      stalled.push_back(std::move(s));
+    }
+    if (stalled.empty()) return;
+    cb = cb_;
+  }
+
+  for (auto& i : stalled)
+  {
+    Slot* slot = i.slot;
+    Report& report = i.report;
+    // 取栈期间任务已结束则栈属于之后的代码，不采用
+    if (capture(slot) && slot->busySinceUs.load(std::memory_order_relaxed) == i.since)
+    {
+      report.fiberId = slot->fiberId;
+      // 跳过信号处理函数和信号返回跳板
+      report.backtrace = slot->depth > 2 ? BacktraceToString(slot->pcs + 2, slot->depth - 2, "    ") : "";
+    }
+    ++reportCount_;
+
+    SYLAR_LOG_ERROR(g_logger) << "stall detected scheduler=" << report.scheduler
+      << " thread=" << report.thread << " tid=" << report.tid
+      << " fiber_id=" << report.fiberId << " stalled_ms=" << report.stalledMs
+      << " suppressed=" << report.suppressed << std::endl << report.backtrace;
+    if (cb) cb(report);
+  }
+
+  MutexType::Lock lock(mutex_);
+  for (auto& i : stalled)
+  {
+    if (--i.slot->refs == 0 && i.slot->removed) delete i.slot;
+  }
+}
+
+} // namespace sylar
@@ -0,0 +1,153 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:30:10
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:30:10
+ * @FilePath: /sylar-wxb/sylar/watchdog.h
+ * @Description: 调度线程卡顿检测：协程长时间不回到调度循环时抓取其调用栈并限频上报
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#include "mutex.h"
+#include "singleton.h"
+#include "thread.h"
+
+namespace sylar {
+
+class Scheduler;
+
+/**
+ * @brief 卡顿检测
+ * @details 调度线程每次切入任务前记录开始时间，切回调度循环后清零；
+ *          检测线程每隔阈值的1/4扫描一次，任务执行超过scheduler.stall_threshold_ms(0关闭)
+ *          就计入调度器的卡顿次数，并向该线程发信号在信号处理函数里取调用栈，
+ *          报告按scheduler.stall_report_interval_ms限频，期间被略过的次数在下次报告中给出。
+ *          信号会打断卡住的线程中不能自动重启的系统调用(如nanosleep)
+ */
+class StallWatchdog
+{
+public:
+  typedef Mutex MutexType;
+
+  /// 报告中最多记录的栈帧数
+  static const int MAX_DEPTH = 64;
+
+  /**
+   * @brief 调度线程的心跳，由调度线程写入
+   */
+  struct Slot
+  {
+    Scheduler* scheduler;
+    pid_t tid;
+    std::string threadName;
+    /// 当前任务的开始时间(微秒)，0表示在调度循环或空闲中
+    std::atomic<uint64_t> busySinceUs = {0};
+
+    /// 已经计数过的任务开始时间，一次卡顿只计一次，检测线程使用
+    uint64_t reportedUs = 0;
+    /// 检测线程在锁外使用中的次数，受mutex_保护
+    int refs = 0;
+    /// 已注销但还在使用中，由检测线程用完后释放，受mutex_保护
+    bool removed = false;
+    /// 取栈请求：0无，1已请求，2已完成
+    std::atomic<int> capture = {0};
+    uint64_t fiberId = 0;
+    int depth = 0;
+    void* pcs[MAX_DEPTH];
+
+    void begin(uint64_t now_us) { busySinceUs.store(now_us, std::memory_order_relaxed);}
+
+    void end() { busySinceUs.store(0, std::memory_order_relaxed);}
+  };
+
+  /**
+   * @brief 一次卡顿报告
+   */
+  struct Report
+  {
+    std::string scheduler;
+    std::string thread;
+    pid_t tid = 0;
+    /// 卡住的协程id，取栈失败为0
+    uint64_t fiberId = 0;
+    /// 报告时任务已执行的时间(毫秒)
+    uint64_t stalledMs = 0;
+    /// 上次报告以来因限频没有报告的卡顿次数
+    uint64_t suppressed = 0;
+    /// 调用栈，取栈失败为空
+    std::string backtrace;
+  };
+
+  typedef std::function<void(const Report&)> Callback;
+
+  StallWatchdog();
+  ~StallWatchdog();
+
+  /**
+   * @brief 登记当前线程，在调度线程进入run时调用
+   */
+  Slot* addThread(Scheduler* scheduler);
+
+  /**
+   * @brief 注销当前线程，在run返回前调用
+   */
+  void delThread(Slot* slot);
+
+  /**
+   * @brief 设置报告回调(如接入告警)，报告总会写system日志
+   */
+  void setCallback(Callback cb);
+
+  /**
+   * @brief 返回已输出的报告数
+   */
+  uint64_t getReportCount() const { return reportCount_;}
+
+private:
+  /**
+   * @brief 检测线程主循环
+   */
+  void run();
+
+  /**
+   * @brief 检查一遍所有线程
+   * @details 锁内只挑出卡住的线程并计数，取栈、写日志和回调都在锁外进行，
+   *          不阻塞调度线程的登记/注销，回调里也可以调用setCallback
+   */
+  void check(uint64_t threshold_us);
+
+  /**
+   * @brief 向slot所在线程请求调用栈，最多等待10ms
+   */
+  bool capture(Slot* slot);
+
+  /**
+   * @brief 阈值开启后启动检测线程(需持有mutex_)
+   */
+  void startThread();
+
+private:
+  MutexType mutex_;
+  std::vector<Slot*> slots_;
+  Thread::ptr thread_;
+  std::atomic<bool> stopping_ = {false};
+  Callback cb_;
+  uint64_t lastReportUs_ = 0;
+  uint64_t suppressed_ = 0;
+  std::atomic<uint64_t> reportCount_ = {0};
+};
+
+typedef Singleton<StallWatchdog> StallWatchdogMgr;
+
+} // namespace sylar
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 11:02:14
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 11:02:14
+ * @FilePath: /sylar-wxb/sylar/worker.cpp
+ * @Description: 按配置(workers)创建的命名协程调度器池
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <cstdlib>
+
+#include "worker.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<std::map<std::string, std::map<std::string, std::string>>>::ptr g_worker_config =
+  sylar::Config::Lookup("workers", std::map<std::string, std::map<std::string, std::string>>(), "worker config");
+
+WorkerManager::WorkerManager()
+{
+}
+
+void WorkerManager::add(Scheduler::ptr s)
+{
+  RWMutexType::WriteLock lock(mutex_);
+  datas_.emplace(s->getName(), s);
+}
+
+Scheduler::ptr WorkerManager::get(const std::string& name)
+{
+  RWMutexType::ReadLock lock(mutex_);
+  auto it = datas_.find(name);
+  return it == datas_.end() ? nullptr : it->second;
+}
+
+IOManager::ptr WorkerManager::getAsIOManager(const std::string& name)
+{
+  return std::dynamic_pointer_cast<IOManager>(get(name));
+}
+
+bool WorkerManager::init()
+{
+  return init(g_worker_config->getValue());
+}
+
+bool WorkerManager::init(const std::map<std::string, std::map<std::string, std::string>>& v)
+{
+  for (auto& i : v)
+  {
+    if (get(i.first))
+    {
+      SYLAR_LOG_WARN(g_logger) << "worker " << i.first << " exists";
+      continue;
+    }
+    auto it = i.second.find("thread_num");
+    int thread_num = it == i.second.end() ? 1 : atoi(it->second.c_str());
+    if (thread_num <= 0)
+    {
+      SYLAR_LOG_ERROR(g_logger) << "worker " << i.first << " invalid thread_num=" << thread_num;
+      return false;
+    }
+
+    Scheduler::Placement placement;
+    it = i.second.find("cpus");
+    if (it != i.second.end())
+    {
+      placement.cpus = ParseCpus(it->second);
+    }
+    it = i.second.find("numa_node");
+    if (it != i.second.end())
+    {
+      placement.numaNode = atoi(it->second.c_str());
+      if (placement.numaNode < 0 || placement.numaNode >= Thread::GetNumaNodeCount())
+      {
+        SYLAR_LOG_ERROR(g_logger) << "worker " << i.first << " invalid numa_node=" << placement.numaNode;
+        return false;
+      }
+    }
+    it = i.second.find("pin_threads");
+    if (it != i.second.end())
+    {
+      placement.pinThreads = it->second == "true" || it->second == "1";
+    }
+
+    Scheduler::Elastic elastic;
+    it = i.second.find("max_threads");
+    if (it != i.second.end())
+    {
+      elastic.maxThreads = atoi(it->second.c_str());
+      it = i.second.find("min_threads");
+      elastic.minThreads = it == i.second.end() ? thread_num : atoi(it->second.c_str());
+      if (elastic.maxThreads < (size_t)thread_num || elastic.minThreads < 1 || elastic.minThreads > (size_t)thread_num)
+      {
+        SYLAR_LOG_ERROR(g_logger) << "worker " << i.first << " invalid min_threads=" << elastic.minThreads
+          << " max_threads=" << elastic.maxThreads << " thread_num=" << thread_num;
+        return false;
+      }
+    }
+
+    // IOManager构造时就启动线程，放置方式要在构造时传入
+    IOManager::ptr s(new IOManager(thread_num, false, i.first, placement));
+    if (elastic.maxThreads)
+    {
+      s->setElastic(elastic);
+    }
+    add(s);
+  }
+  stop_ = datas_.empty();
+  return true;
+}
+
+void WorkerManager::stop()
+{
+  if (stop_)
+  {
+    return;
+  }
+  std::map<std::string, Scheduler::ptr> datas;
+  {
+    RWMutexType::WriteLock lock(mutex_);
+    datas.swap(datas_);
+    stop_ = true;
+  }
+  for (auto& i : datas)
+  {
+    i.second->schedule([](){});
+    i.second->stop();
+  }
+}
+
+uint32_t WorkerManager::getCount()
+{
+  RWMutexType::ReadLock lock(mutex_);
+  return datas_.size();
+}
+
+std::ostream& WorkerManager::dump(std::ostream& os)
+{
+  RWMutexType::ReadLock lock(mutex_);
+  for (auto& i : datas_)
+  {
+    i.second->dump(os) << std::endl;
+  }
+  return os;
+}
+
+std::vector<int> WorkerManager::ParseCpus(const std::string& str)
+{
+  return Thread::ParseCpus(str);
+}
+
+} // namespace sylar
@@ -0,0 +1,133 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 11:02:14
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 11:02:14
+ * @FilePath: /sylar-wxb/sylar/worker.h
+ * @Description: 按配置(workers)创建的命名协程调度器池
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "iomanager.h"
+#include "mutex.h"
+#include "scheduler.h"
+#include "singleton.h"
+
+namespace sylar {
+
+/**
+ * @brief 命名调度器池管理
+ * @details 配置格式(config/worker.yml):
+ *  workers:
+ *      io:
+ *          thread_num: 8
+ *          cpus: 0-3,8      # 可选，池内线程绑定的cpu集合
+ *          numa_node: 0     # 可选，线程内存优先从该节点分配，未配置cpus时绑定到该节点的全部cpu
+ *          pin_threads: true # 可选，每个线程只绑定cpu集合中的一个cpu
+ *          max_threads: 16  # 可选，开启弹性线程数，任务排队过久时最多增加到该线程数
+ *          min_threads: 4   # 可选，持续空闲时最少减少到该线程数，默认thread_num
+ *  每个名称对应一个IOManager(use_caller=false)
+ */
+class WorkerManager
+{
+public:
+  typedef RWMutex RWMutexType;
+
+  WorkerManager();
+
+  /**
+   * @brief 添加一个调度器，名称取调度器名称，已存在则忽略
+   */
+  void add(Scheduler::ptr s);
+
+  /**
+   * @brief 获取名称为name的调度器，不存在返回nullptr
+   */
+  Scheduler::ptr get(const std::string& name);
+
+  /**
+   * @brief 获取名称为name的IOManager，不存在或类型不符返回nullptr
+   */
+  IOManager::ptr getAsIOManager(const std::string& name);
+
+  /**
+   * @brief 将协程或函数投递到名称为name的调度器
+   * @param thread 协程执行的线程id，-1标识任意线程
+   * @return 调度器不存在返回false
+   */
+  template<class FiberOrCb>
+  bool schedule(const std::string& name, FiberOrCb fc, int thread = -1)
+  {
+    auto s = get(name);
+    if (!s)
+    {
+      return false;
+    }
+    s->schedule(fc, thread);
+    return true;
+  }
+
+  /**
+   * @brief 批量投递到名称为name的调度器，只加一次锁、最多tickle一次
+   */
+  template<class InputIterator>
+  bool schedule(const std::string& name, InputIterator begin, InputIterator end)
+  {
+    auto s = get(name);
+    if (!s)
+    {
+      return false;
+    }
+    s->schedule(begin, end);
+    return true;
+  }
+
+  /**
+   * @brief 按workers配置创建并启动所有调度器
+   */
+  bool init();
+
+  /**
+   * @brief 按给定配置创建并启动调度器
+   * @param v 名称 -> 参数(thread_num, cpus, numa_node, pin_threads, min_threads, max_threads)
+   */
+  bool init(const std::map<std::string, std::map<std::string, std::string>>& v);
+
+  /**
+   * @brief 停止所有调度器
+   */
+  void stop();
+
+  bool isStoped() const { return stop_;}
+
+  uint32_t getCount();
+
+  std::ostream& dump(std::ostream& os);
+
+  /**
+   * @brief 解析cpu列表，如"0-3,8"
+   */
+  static std::vector<int> ParseCpus(const std::string& str);
+
+private:
+  RWMutexType mutex_;
+
+  std::map<std::string, Scheduler::ptr> datas_;
+
+  bool stop_ = false;
+};
+
+typedef sylar::Singleton<WorkerManager> WorkerMgr;
+
+} // namespace sylar
+
+#endif
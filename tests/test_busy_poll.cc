@@ -0,0 +1,78 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:10:00
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:10:00
+ * @FilePath: /sylar-wxb/tests/test_busy_poll.cc
+ * @Description: 空闲线程自旋等待测试：多个空闲线程同时自旋/睡眠时，新任务都能被及时唤醒执行
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include "config.h"
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+void test_wake_latency()
+{
+  sylar::Config::Lookup<uint32_t>("iomanager.busy_poll_us")->setValue(1000);
+  std::vector<uint64_t> latency;
+  {
+    sylar::IOManager iom(3, false, "busy_poll");
+    std::atomic<uint64_t> done_us = {0};
+    for(int i = 0; i < 1000; ++i)
+    {
+      // 先唤醒全部线程，让它们几乎同时回到idle，再在随机时刻投递任务，
+      // 任务会落在线程刚进入自旋、正在自旋和已经睡眠的各个时刻
+      for(int j = 0; j < 3; ++j)
+      {
+        iom.schedule([]() {});
+      }
+      usleep(rand() % 1500);
+      done_us = 0;
+      uint64_t begin = sylar::GetCurrentUS();
+      iom.schedule([&done_us]()
+      {
+        done_us = sylar::GetCurrentUS();
+      });
+      while(!done_us)
+      {
+        usleep(100);
+      }
+      latency.push_back(done_us - begin);
+    }
+    uint64_t spins = 0;
+    for(auto& i : iom.getIdleStats())
+    {
+      spins += i->spins;
+    }
+    iom.dumpIdleStats(std::cout);
+    SYLAR_ASSERT(spins > 0);
+  }
+  sylar::Config::Lookup<uint32_t>("iomanager.busy_poll_us")->setValue(0);
+
+  std::sort(latency.begin(), latency.end());
+  uint64_t p50 = latency[latency.size() / 2];
+  uint64_t max = latency.back();
+  SYLAR_LOG_INFO(g_logger) << "wake latency p50=" << p50 << "us max=" << max << "us";
+  // 丢失唤醒时任务要等到epoll_wait最长3秒超时才执行
+  SYLAR_ASSERT(max < 500 * 1000);
+}
+
+int main(int argc, char** argv)
+{
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  test_wake_latency();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 11:48:09
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 11:48:09
+ * @FilePath: /sylar-wxb/tests/test_channel.cc
+ * @Description: Channel/Select正确性测试，以及ping-pong和多生产者汇聚(fan-in)的吞吐
+ *   -t 线程数 -n ping-pong往返次数 -p fan-in生产者数 -m 每个生产者发送数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <iostream>
+#include <unistd.h>
+
+#include "channel.h"
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_threads = 2;
+static int s_rounds = 100000;
+static int s_producers = 8;
+static int s_msgs = 100000;
+
+/**
+ * @brief 多生产者多消费者，关闭后消费者取完剩余元素退出
+ */
+void test_mpmc(size_t capacity)
+{
+  static const int PRODUCERS = 4;
+  static const int ITEMS = 10000;
+  sylar::Channel<int> ch(capacity);
+  std::atomic<uint64_t> sum = {0};
+  std::atomic<int> producing = {PRODUCERS};
+  {
+    sylar::IOManager iom(s_threads, false, "mpmc");
+    for(int i = 0; i < PRODUCERS; ++i)
+    {
+      iom.schedule([&]()
+      {
+        for(int j = 1; j <= ITEMS; ++j)
+        {
+          SYLAR_ASSERT(ch.send(j));
+        }
+        if(--producing == 0)
+        {
+          ch.close();
+        }
+      });
+    }
+    for(int i = 0; i < 2; ++i)
+    {
+      iom.schedule([&]()
+      {
+        int v;
+        while(ch.recv(v))
+        {
+          sum += v;
+        }
+        SYLAR_ASSERT(ch.isClosed());
+      });
+    }
+  }
+  SYLAR_ASSERT(sum == (uint64_t)PRODUCERS * ITEMS * (ITEMS + 1) / 2);
+  SYLAR_ASSERT(!ch.send(1));
+  SYLAR_LOG_INFO(g_logger) << "mpmc capacity=" << capacity << " sum=" << sum;
+}
+
+/**
+ * @brief Select：超时、选中就绪的通道、无缓冲的发送分支
+ */
+void test_select()
+{
+  sylar::IOManager iom(s_threads, false, "select");
+  iom.schedule([]()
+  {
+    sylar::Channel<int> a(1);
+    sylar::Channel<std::string> b(0);
+    int x = 0;
+    std::string y;
+
+    uint64_t begin = sylar::GetCurrentMS();
+    SYLAR_ASSERT(sylar::Select().recv(a, x).recv(b, y).wait(50) == -1);
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    SYLAR_ASSERT(used >= 50 && used < 150);
+    SYLAR_ASSERT(!a.recv(x, 10));
+
+    sylar::IOManager::GetThis()->addTimer(20, [&b]()
+    {
+      sylar::IOManager::GetThis()->schedule([&b]()
+      {
+        SYLAR_ASSERT(b.send("hello"));
+      });
+    });
+    SYLAR_ASSERT(sylar::Select().recv(a, x).recv(b, y).wait() == 1 && y == "hello");
+
+    SYLAR_ASSERT(a.trySend(7) && !a.trySend(8));
+    SYLAR_ASSERT(sylar::Select().recv(b, y).recv(a, x).wait(0) == 1 && x == 7);
+
+    // 无缓冲通道上的发送分支，值被接收方取走才算完成
+    std::string got;
+    sylar::IOManager::GetThis()->schedule([&b, &got]()
+    {
+      SYLAR_ASSERT(b.recv(got));
+    });
+    std::string msg = "world";
+    bool ok = false;
+    SYLAR_ASSERT(sylar::Select().send(b, msg, &ok).wait(1000) == 0 && ok);
+    usleep(1000);
+    SYLAR_ASSERT(got == "world");
+
+    a.close();
+    SYLAR_ASSERT(sylar::Select().recv(a, x, &ok).wait() == 0 && !ok);
+    SYLAR_LOG_INFO(g_logger) << "select passed";
+  });
+}
+
+/**
+ * @brief 两个协程通过一对通道往返传值
+ */
+uint64_t bench_pingpong(size_t capacity)
+{
+  sylar::Channel<int> ping(capacity);
+  sylar::Channel<int> pong(capacity);
+  uint64_t begin = sylar::GetCurrentUS();
+  uint64_t end = begin;
+  {
+    sylar::IOManager iom(s_threads, false, "pingpong");
+    iom.schedule([&]()
+    {
+      int v;
+      while(ping.recv(v))
+      {
+        pong.send(v + 1);
+      }
+    });
+    iom.schedule([&]()
+    {
+      int v = 0;
+      for(int i = 0; i < s_rounds; ++i)
+      {
+        ping.send(v);
+        pong.recv(v);
+      }
+      SYLAR_ASSERT(v == s_rounds);
+      end = sylar::GetCurrentUS();
+      ping.close();
+    });
+  }
+  return end - begin;
+}
+
+/**
+ * @brief 多个生产者汇聚到一个消费者
+ */
+uint64_t bench_fanin(size_t capacity)
+{
+  sylar::Channel<int> ch(capacity);
+  std::atomic<int> producing = {s_producers};
+  uint64_t count = 0;
+  uint64_t begin = sylar::GetCurrentUS();
+  uint64_t end = begin;
+  {
+    sylar::IOManager iom(s_threads, false, "fanin");
+    for(int i = 0; i < s_producers; ++i)
+    {
+      iom.schedule([&]()
+      {
+        for(int j = 0; j < s_msgs; ++j)
+        {
+          ch.send(j);
+        }
+        if(--producing == 0)
+        {
+          ch.close();
+        }
+      });
+    }
+    iom.schedule([&]()
+    {
+      int v;
+      while(ch.recv(v))
+      {
+        ++count;
+      }
+      end = sylar::GetCurrentUS();
+    });
+  }
+  SYLAR_ASSERT(count == (uint64_t)s_producers * s_msgs);
+  return end - begin;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "t:n:p:m:")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': s_threads = atoi(optarg); break;
+      case 'n': s_rounds = atoi(optarg); break;
+      case 'p': s_producers = atoi(optarg); break;
+      case 'm': s_msgs = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_mpmc(0);
+  test_mpmc(1);
+  test_mpmc(64);
+  test_select();
+
+  std::cout << "channel bench: threads=" << s_threads << std::endl;
+  for(size_t cap : {0, 1, 64})
+  {
+    uint64_t us = std::max<uint64_t>(bench_pingpong(cap), 1);
+    std::cout << "  pingpong capacity=" << cap << ": " << s_rounds << " round trips "
+      << us / 1000 << "ms " << (us * 1000 / s_rounds) << "ns/rtt" << std::endl;
+  }
+  for(size_t cap : {0, 64, 1024})
+  {
+    uint64_t us = std::max<uint64_t>(bench_fanin(cap), 1);
+    uint64_t msgs = (uint64_t)s_producers * s_msgs;
+    std::cout << "  fanin capacity=" << cap << " producers=" << s_producers << ": " << msgs << " msgs "
+      << us / 1000 << "ms " << (msgs * 1000000 / us) << " msgs/s" << std::endl;
+  }
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
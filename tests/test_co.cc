@@ -0,0 +1,317 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:05:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:05:37
+ * @FilePath: /sylar-wxb/tests/test_co.cc
+ * @Description: C++20协程前端正确性测试，以及socketpair上echo往返与协程(Fiber+hook)的对比
+ *   -t 线程数 -p 连接数 -n 每个连接往返次数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <fcntl.h>
+#include <iostream>
+#include <malloc.h>
+#include <new>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "co/io.h"
+#include "co/task.h"
+#include "config.h"
+#include "fd_manager.h"
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_threads = 2;
+static int s_pairs = 1000;
+static int s_rounds = 100;
+
+/// 通过operator new分配、尚未释放的字节数
+static std::atomic<int64_t> s_live_bytes = {0};
+
+void* operator new(size_t n)
+{
+  void* p = malloc(n ? n : 1);
+  if(!p)
+  {
+    throw std::bad_alloc();
+  }
+  s_live_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  if(p)
+  {
+    s_live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+    free(p);
+  }
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  operator delete(p);
+}
+
+static sylar::co::Task<int> add_later(int a, int b)
+{
+  co_await sylar::co::Sleep(5);
+  co_return a + b;
+}
+
+static sylar::co::Task<int> throw_later()
+{
+  co_await sylar::co::Yield();
+  throw std::runtime_error("boom");
+  co_return 0;
+}
+
+/**
+ * @brief 嵌套任务、异常、睡眠、就绪超时、Socket收发
+ */
+static sylar::co::Task<void> test_basic(std::atomic<bool>* done)
+{
+  SYLAR_ASSERT(co_await add_later(1, 2) == 3);
+
+  bool caught = false;
+  try { co_await throw_later();}
+  catch(const std::runtime_error&) { caught = true;}
+  SYLAR_ASSERT(caught);
+
+  uint64_t begin = sylar::GetCurrentUS();
+  co_await sylar::co::SleepUs(2000);
+  SYLAR_ASSERT(sylar::GetCurrentUS() - begin >= 2000);
+
+  int fds[2];
+  SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+  begin = sylar::GetCurrentMS();
+  SYLAR_ASSERT(co_await sylar::co::Readable(fds[0], 50) == ETIMEDOUT);
+  uint64_t used = sylar::GetCurrentMS() - begin;
+  SYLAR_ASSERT(used >= 50 && used < 150);
+  SYLAR_ASSERT(co_await sylar::co::Writable(fds[0], 50) == 0);
+  SYLAR_ASSERT(co_await sylar::co::Write(fds[0], "ping", 4) == 4);
+  char buf[16];
+  SYLAR_ASSERT(co_await sylar::co::Read(fds[1], buf, sizeof(buf), 50) == 4);
+  SYLAR_ASSERT(co_await sylar::co::Read(fds[1], buf, sizeof(buf), 20) == -1 && errno == ETIMEDOUT);
+  close(fds[0]);
+  close(fds[1]);
+  *done = true;
+}
+
+static sylar::co::Task<void> echo_socket(sylar::Socket::ptr sock)
+{
+  char buf[64];
+  while(true)
+  {
+    ssize_t n = co_await sylar::co::Recv(sock, buf, sizeof(buf));
+    if(n <= 0)
+    {
+      break;
+    }
+    co_await sylar::co::Send(sock, buf, n);
+  }
+  sock->close();
+}
+
+static sylar::co::Task<void> client_socket(sylar::Socket::ptr sock, std::atomic<bool>* done)
+{
+  char buf[64];
+  for(int i = 0; i < 100; ++i)
+  {
+    std::string msg = "msg" + std::to_string(i);
+    SYLAR_ASSERT(co_await sylar::co::Send(sock, msg.data(), msg.size()) == (ssize_t)msg.size());
+    ssize_t n = co_await sylar::co::Recv(sock, buf, sizeof(buf));
+    SYLAR_ASSERT(n == (ssize_t)msg.size() && std::string(buf, n) == msg);
+  }
+  sock->close();
+  *done = true;
+}
+
+void test_co()
+{
+  std::atomic<bool> basic = {false};
+  std::atomic<bool> tcp = {false};
+  {
+    sylar::IOManager iom(s_threads, false, "co");
+    sylar::co::Spawn(&iom, test_basic(&basic));
+    // 建连用hook过的accept/connect，收发用协程
+    iom.schedule([&iom, &tcp]()
+    {
+      sylar::Socket::ptr server = sylar::Socket::CreateTCPSocket();
+      SYLAR_ASSERT(server->bind(sylar::IPv4Address::Create("127.0.0.1", 0)) && server->listen());
+      sylar::Socket::ptr client = sylar::Socket::CreateTCPSocket();
+      SYLAR_ASSERT(client->connect(server->getLocalAddress()));
+      sylar::Socket::ptr conn = server->accept();
+      SYLAR_ASSERT(conn);
+      sylar::co::Spawn(&iom, echo_socket(conn));
+      sylar::co::Spawn(&iom, client_socket(client, &tcp));
+    });
+  }
+  SYLAR_ASSERT(basic && tcp);
+  SYLAR_LOG_INFO(g_logger) << "co passed";
+}
+
+struct BenchResult
+{
+  uint64_t us = 0;
+  int64_t bytesPerHandler = 0;
+};
+
+static std::atomic<int> s_running = {0};
+static std::atomic<uint64_t> s_end = {0};
+
+static void finish_client()
+{
+  if(--s_running == 0)
+  {
+    s_end = sylar::GetCurrentUS();
+  }
+}
+
+static void fiber_echo(int fd)
+{
+  char buf[64];
+  ssize_t n;
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+  {
+    write(fd, buf, n);
+  }
+}
+
+static void fiber_client(int fd)
+{
+  char buf[64] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde";
+  for(int i = 0; i < s_rounds; ++i)
+  {
+    SYLAR_ASSERT(write(fd, buf, sizeof(buf)) == sizeof(buf));
+    size_t got = 0;
+    while(got < sizeof(buf))
+    {
+      ssize_t n = read(fd, buf + got, sizeof(buf) - got);
+      SYLAR_ASSERT(n > 0);
+      got += n;
+    }
+  }
+  finish_client();
+}
+
+static sylar::co::Task<void> co_echo(int fd)
+{
+  char buf[64];
+  ssize_t n;
+  while((n = co_await sylar::co::Read(fd, buf, sizeof(buf))) > 0)
+  {
+    co_await sylar::co::Write(fd, buf, n);
+  }
+}
+
+static sylar::co::Task<void> co_client(int fd)
+{
+  char buf[64] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde";
+  for(int i = 0; i < s_rounds; ++i)
+  {
+    SYLAR_ASSERT(co_await sylar::co::Write(fd, buf, sizeof(buf)) == sizeof(buf));
+    size_t got = 0;
+    while(got < sizeof(buf))
+    {
+      ssize_t n = co_await sylar::co::Read(fd, buf + got, sizeof(buf) - got);
+      SYLAR_ASSERT(n > 0);
+      got += n;
+    }
+  }
+  finish_client();
+}
+
+/**
+ * @brief s_pairs对socketpair上echo往返
+ * @param[in] coroutine true用C++20协程，false用Fiber+hook
+ */
+BenchResult bench_echo(bool coroutine)
+{
+  std::vector<std::pair<int, int> > pairs(s_pairs);
+  for(auto& i : pairs)
+  {
+    int fds[2];
+    SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    sylar::FdMgr::GetInstance()->get(fds[0], true);
+    sylar::FdMgr::GetInstance()->get(fds[1], true);
+    i = std::make_pair(fds[0], fds[1]);
+  }
+  BenchResult result;
+  {
+    sylar::IOManager iom(s_threads, false, coroutine ? "co" : "fiber");
+    // 先启动服务端，等它们都挂起后统计每个处理者占用的内存
+    int64_t before = s_live_bytes;
+    for(auto& i : pairs)
+    {
+      int fd = i.first;
+      if(coroutine) sylar::co::Spawn(&iom, co_echo(fd));
+      else iom.schedule([fd]() { fiber_echo(fd);});
+    }
+    usleep(200 * 1000);
+    result.bytesPerHandler = (s_live_bytes - before) / s_pairs;
+    if(!coroutine) // 栈用malloc分配，不经过operator new
+    {
+      result.bytesPerHandler += sylar::Config::Lookup<uint32_t>("fiber.stack_size")->getValue();
+    }
+
+    s_running = s_pairs;
+    uint64_t begin = sylar::GetCurrentUS();
+    for(auto& i : pairs)
+    {
+      int fd = i.second;
+      if(coroutine) sylar::co::Spawn(&iom, co_client(fd));
+      else iom.schedule([fd]() { fiber_client(fd);});
+    }
+    while(s_running)
+    {
+      usleep(1000);
+    }
+    result.us = std::max<uint64_t>(s_end - begin, 1);
+    for(auto& i : pairs)
+    {
+      close(i.second); // 服务端读到EOF退出
+    }
+  }
+  for(auto& i : pairs)
+  {
+    close(i.first);
+  }
+  return result;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "t:p:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': s_threads = atoi(optarg); break;
+      case 'p': s_pairs = atoi(optarg); break;
+      case 'n': s_rounds = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_co();
+
+  uint64_t rtts = (uint64_t)s_pairs * s_rounds;
+  std::cout << "echo bench: threads=" << s_threads << " pairs=" << s_pairs << " rounds=" << s_rounds << std::endl;
+  for(bool coroutine : {false, true})
+  {
+    BenchResult r = bench_echo(coroutine);
+    std::cout << "  " << (coroutine ? "C++20 coroutine: " : "Fiber + hook:    ") << r.us / 1000 << "ms "
+      << (rtts * 1000000 / r.us) << " rtt/s, " << r.bytesPerHandler << " bytes/handler" << std::endl;
+  }
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
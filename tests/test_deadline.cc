@@ -0,0 +1,137 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 09:52:06
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 09:52:06
+ * @FilePath: /sylar-wxb/tests/test_deadline.cc
+ * @Description: 协程级截止时间测试
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "macro.h"
+#include "hook.h"
+#include "iomanager.h"
+#include "fd_manager.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static void make_pair(int fds[2])
+{
+  SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  sylar::FdMgr::GetInstance()->get(fds[0], true);
+  sylar::FdMgr::GetInstance()->get(fds[1], true);
+}
+
+/**
+ * @brief 对端每20ms写一个字节，截止时间内的多次recv共用一个截止时间
+ */
+void test_many_reads()
+{
+  int fds[2];
+  make_pair(fds);
+  sylar::Timer::ptr timer = sylar::IOManager::GetThis()->addTimer(20, [fds]()
+  {
+    send(fds[0], "x", 1, 0);
+  }, true);
+
+  uint64_t begin = sylar::GetCurrentMS();
+  int reads = 0;
+  {
+    sylar::Deadline deadline(200);
+    char c;
+    while(recv(fds[1], &c, 1, 0) == 1)
+    {
+      ++reads;
+    }
+    SYLAR_ASSERT(errno == ETIMEDOUT);
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    SYLAR_LOG_INFO(g_logger) << "many reads: reads=" << reads << " used=" << used << "ms";
+    SYLAR_ASSERT(reads >= 3 && used >= 200 && used < 300);
+    timer->cancel();
+
+    // 截止时间过后即使有数据也直接失败；写端不经过hook，否则本身也会超时
+    SYLAR_ASSERT(send_f(fds[0], "y", 1, 0) == 1);
+    SYLAR_ASSERT(recv(fds[1], &c, 1, 0) == -1 && errno == ETIMEDOUT);
+    SYLAR_ASSERT(send(fds[1], "z", 1, 0) == -1 && errno == ETIMEDOUT);
+    SYLAR_ASSERT(sylar::Deadline::GetRemain() == 0);
+  }
+  SYLAR_ASSERT(sylar::Deadline::GetRemain() == ~0ull);
+
+  // 作用域结束后恢复正常，读到上面写入的数据
+  char c;
+  SYLAR_ASSERT(recv(fds[1], &c, 1, 0) == 1);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/**
+ * @brief 嵌套时内层取更早的截止时间，内层结束后外层继续有效
+ */
+void test_nested()
+{
+  int fds[2];
+  make_pair(fds);
+  char c;
+  sylar::Deadline outer(1000);
+  uint64_t begin = sylar::GetCurrentMS();
+  {
+    sylar::Deadline inner(50);
+    SYLAR_ASSERT(recv(fds[1], &c, 1, 0) == -1 && errno == ETIMEDOUT);
+    {
+      sylar::Deadline wider(5000); // 不能放宽
+      SYLAR_ASSERT(wider.getDeadline() == inner.getDeadline());
+    }
+  }
+  uint64_t used = sylar::GetCurrentMS() - begin;
+  SYLAR_LOG_INFO(g_logger) << "nested: inner used=" << used << "ms";
+  SYLAR_ASSERT(used >= 50 && used < 150);
+  SYLAR_ASSERT(!outer.isExpired());
+
+  send(fds[0], "x", 1, 0);
+  SYLAR_ASSERT(recv(fds[1], &c, 1, 0) == 1);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/**
+ * @brief fd上的读超时比截止时间早时按单次调用超时
+ */
+void test_socket_timeout()
+{
+  int fds[2];
+  make_pair(fds);
+  struct timeval tv{0, 30 * 1000};
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  sylar::Deadline deadline(1000);
+  uint64_t begin = sylar::GetCurrentMS();
+  char c;
+  SYLAR_ASSERT(recv(fds[1], &c, 1, 0) == -1 && errno == ETIMEDOUT);
+  uint64_t used = sylar::GetCurrentMS() - begin;
+  SYLAR_LOG_INFO(g_logger) << "socket timeout: used=" << used << "ms";
+  SYLAR_ASSERT(used >= 30 && used < 130);
+  SYLAR_ASSERT(!deadline.isExpired());
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int main(int argc, char** argv)
+{
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::INFO);
+  {
+    sylar::IOManager iom(2, false, "io");
+    iom.schedule([]()
+    {
+      test_many_reads();
+      test_nested();
+      test_socket_timeout();
+      SYLAR_LOG_INFO(g_logger) << "all passed";
+    });
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 14:32:10
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 14:32:10
+ * @FilePath: /sylar-wxb/tests/test_elastic.cc
+ * @Description: 弹性线程数测试：排队过久时增加线程，空闲后减少线程，指定到已退出线程的任务仍能执行
+ *   -m 最大线程数 -l 压测任务数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_max = 4;
+static int s_load = 32;
+
+static void busy_us(uint64_t us)
+{
+  uint64_t end = sylar::GetCurrentUS() + us;
+  while(sylar::GetCurrentUS() < end);
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "m:l:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'm': s_max = atoi(optarg); break;
+      case 'l': s_load = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  std::atomic<int> done = {0};
+  std::atomic<int> pinned_tid = {-1};
+  std::atomic<bool> pinned_ran = {false};
+  {
+    sylar::IOManager iom(1, false, "elastic");
+    sylar::Scheduler::Elastic elastic;
+    elastic.minThreads = 1;
+    elastic.maxThreads = s_max;
+    elastic.latencyUs = 1000;
+    elastic.idleMs = 200;
+    iom.setElastic(elastic);
+    SYLAR_ASSERT(iom.getThreadCount() == 1);
+
+    // 计算并不停让出，入队和出队时都能看到排队延迟
+    uint64_t begin = sylar::GetCurrentUS();
+    size_t max_threads = 0;
+    for(int i = 0; i < s_load; ++i)
+    {
+      iom.schedule([&done, &pinned_tid]()
+      {
+        for(int j = 0; j < 20; ++j)
+        {
+          busy_us(500);
+          sylar::Fiber::YieldToReady();
+        }
+        pinned_tid = sylar::GetThreadId();
+        ++done;
+      });
+    }
+    while(done < s_load)
+    {
+      max_threads = std::max(max_threads, iom.getThreadCount());
+      usleep(1000);
+    }
+    uint64_t used = sylar::GetCurrentUS() - begin;
+    SYLAR_ASSERT(max_threads > 1 && max_threads <= (size_t)s_max);
+    SYLAR_ASSERT(iom.getGrowCount() == max_threads - 1);
+    std::cout << "load: " << s_load << " tasks in " << used / 1000 << "ms, threads grew 1 -> " << max_threads
+      << std::endl;
+
+    // 空闲超过阈值后退回下限
+    uint64_t idle_begin = sylar::GetCurrentMS();
+    while(iom.getThreadCount() > 1 && sylar::GetCurrentMS() - idle_begin < 3000)
+    {
+      usleep(10 * 1000);
+    }
+    SYLAR_ASSERT(iom.getThreadCount() == 1);
+    SYLAR_ASSERT(iom.getShrinkCount() >= max_threads - 1);
+    std::cout << "idle: shrank back to " << iom.getThreadCount() << " thread in "
+      << sylar::GetCurrentMS() - idle_begin << "ms" << std::endl;
+
+    // 最后执行压测任务的线程多半已经退出，指定到它的任务改由剩下的线程执行
+    iom.schedule([&pinned_ran]() { pinned_ran = true;}, pinned_tid);
+    uint64_t wait_begin = sylar::GetCurrentMS();
+    while(!pinned_ran && sylar::GetCurrentMS() - wait_begin < 1000)
+    {
+      usleep(1000);
+    }
+    SYLAR_ASSERT(pinned_ran);
+
+    std::stringstream ss;
+    iom.dump(ss);
+    SYLAR_LOG_INFO(g_logger) << ss.str();
+  }
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 10:41:18
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 10:41:18
+ * @FilePath: /sylar-wxb/tests/test_fiber_mutex.cc
+ * @Description: 协程锁正确性测试和多协程竞争下与Mutex的对比
+ *   -t 线程数 -f 每线程协程数 -n 每个协程加锁次数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <unistd.h>
+
+#include "log.h"
+#include "macro.h"
+#include "mutex.h"
+#include "iomanager.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_threads = 4;
+static int s_fibers = 256;
+static int s_rounds = 2000;
+
+/**
+ * @brief 所有协程对同一把锁做s_rounds次加锁自增，返回耗时(毫秒)
+ * @param yield 持锁期间是否让出协程(模拟持锁做io)
+ */
+template<class MutexType>
+static uint64_t run_counter(bool yield)
+{
+  MutexType mutex;
+  uint64_t counter = 0;
+  std::atomic<int> running = {s_threads * s_fibers};
+  uint64_t begin = sylar::GetCurrentMS();
+  uint64_t end = begin;
+  {
+    sylar::IOManager iom(s_threads, false, "bench");
+    for(int i = 0; i < s_threads * s_fibers; ++i)
+    {
+      iom.schedule([&mutex, &counter, &running, &end, yield]()
+      {
+        for(int j = 0; j < s_rounds; ++j)
+        {
+          typename MutexType::Lock lock(mutex);
+          ++counter;
+          if(yield)
+          {
+            sylar::Fiber::YieldToReady();
+          }
+        }
+        if(--running == 0) // 不计入调度器退出的时间
+        {
+          end = sylar::GetCurrentMS();
+        }
+      });
+    }
+  }
+  uint64_t used = std::max<uint64_t>(end - begin, 1);
+  SYLAR_ASSERT(counter == (uint64_t)s_threads * s_fibers * s_rounds);
+  return used;
+}
+
+/**
+ * @brief 写者持锁让出期间读者不能看到写了一半的数据
+ */
+static void test_rwmutex()
+{
+  sylar::FiberRWMutex mutex;
+  int a = 0;
+  int b = 0;
+  std::atomic<int> reads = {0};
+  std::atomic<int> readers = {0};
+  std::atomic<int> max_readers = {0};
+  {
+    sylar::IOManager iom(s_threads, false, "rw");
+    for(int i = 0; i < 64; ++i)
+    {
+      iom.schedule([&, i]()
+      {
+        for(int j = 0; j < 500; ++j)
+        {
+          if(i % 8 == 0)
+          {
+            sylar::FiberRWMutex::WriteLock lock(mutex);
+            SYLAR_ASSERT(readers == 0);
+            ++a;
+            sylar::Fiber::YieldToReady();
+            ++b;
+          }
+          else
+          {
+            sylar::FiberRWMutex::ReadLock lock(mutex);
+            int n = ++readers;
+            int m = max_readers;
+            while(n > m && !max_readers.compare_exchange_weak(m, n));
+            SYLAR_ASSERT(a == b);
+            sylar::Fiber::YieldToReady();
+            SYLAR_ASSERT(a == b);
+            --readers;
+            ++reads;
+          }
+        }
+      });
+    }
+  }
+  SYLAR_ASSERT(a == 8 * 500 && b == a);
+  SYLAR_LOG_INFO(g_logger) << "rwmutex: writes=" << a << " reads=" << reads
+    << " max_concurrent_readers=" << max_readers;
+}
+
+/**
+ * @brief 有界队列上的生产者消费者
+ */
+static void test_condvar()
+{
+  static const int PRODUCERS = 8;
+  static const int ITEMS = 10000;
+  sylar::FiberMutex mutex;
+  sylar::FiberCondVar not_full;
+  sylar::FiberCondVar not_empty;
+  std::deque<int> queue;
+  uint64_t sum = 0;
+  int consumed = 0;
+  {
+    sylar::IOManager iom(s_threads, false, "cond");
+    for(int i = 0; i < PRODUCERS; ++i)
+    {
+      iom.schedule([&]()
+      {
+        for(int j = 1; j <= ITEMS; ++j)
+        {
+          sylar::FiberMutex::Lock lock(mutex);
+          not_full.wait(mutex, [&]() { return queue.size() < 16;});
+          queue.push_back(j);
+          not_empty.notifyOne();
+        }
+      });
+    }
+    for(int i = 0; i < PRODUCERS / 2; ++i)
+    {
+      iom.schedule([&]()
+      {
+        while(true)
+        {
+          sylar::FiberMutex::Lock lock(mutex);
+          not_empty.wait(mutex, [&]() { return !queue.empty() || consumed == PRODUCERS * ITEMS;});
+          if(queue.empty())
+          {
+            break;
+          }
+          sum += queue.front();
+          queue.pop_front();
+          if(++consumed == PRODUCERS * ITEMS)
+          {
+            not_empty.notifyAll();
+          }
+          not_full.notifyOne();
+        }
+      });
+    }
+  }
+  SYLAR_ASSERT(sum == (uint64_t)PRODUCERS * ITEMS * (ITEMS + 1) / 2);
+  SYLAR_LOG_INFO(g_logger) << "condvar: consumed=" << consumed << " sum=" << sum;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "t:f:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': s_threads = atoi(optarg); break;
+      case 'f': s_fibers = atoi(optarg); break;
+      case 'n': s_rounds = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_rwmutex();
+  test_condvar();
+
+  uint64_t ops = (uint64_t)s_threads * s_fibers * s_rounds;
+  uint64_t mutex_ms = run_counter<sylar::Mutex>(false);
+  uint64_t fiber_ms = run_counter<sylar::FiberMutex>(false);
+  // 持锁让出时Mutex会让同线程的其他协程把线程阻塞死，只能用FiberMutex
+  uint64_t yield_ms = run_counter<sylar::FiberMutex>(true);
+  std::cout << "lock bench: threads=" << s_threads << " fibers/thread=" << s_fibers
+    << " rounds=" << s_rounds << std::endl
+    << "  Mutex:      " << mutex_ms << "ms " << (ops * 1000 / mutex_ms) << " ops/s" << std::endl
+    << "  FiberMutex: " << fiber_ms << "ms " << (ops * 1000 / fiber_ms) << " ops/s" << std::endl
+    << "  FiberMutex(yield while locked): " << yield_ms << "ms " << (ops * 1000 / yield_ms) << " ops/s" << std::endl;
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 12:26:51
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 12:26:51
+ * @FilePath: /sylar-wxb/tests/test_future.cc
+ * @Description: Future/Promise、WaitGroup、WhenAll/WhenAny正确性测试，以及逐个调度和ParallelMap批量调度扇出的对比
+ *   -t 线程数 -n 扇出任务数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <iostream>
+#include <numeric>
+#include <unistd.h>
+
+#include "future.h"
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_threads = 4;
+static int s_tasks = 100000;
+
+/**
+ * @brief 100个各耗时10ms的"后端调用"并行扇出再汇聚，总耗时应接近单次调用
+ */
+void test_fanout()
+{
+  sylar::IOManager iom(s_threads, false, "fanout");
+  iom.schedule([&iom]()
+  {
+    std::vector<int> keys(100);
+    std::iota(keys.begin(), keys.end(), 0);
+    uint64_t begin = sylar::GetCurrentMS();
+    auto futures = sylar::ParallelMap(&iom, keys.begin(), keys.end(), [](int k)
+    {
+      usleep(10 * 1000);
+      return k * k;
+    });
+    std::vector<int> results = sylar::WhenAll(futures).get();
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    SYLAR_ASSERT(results.size() == keys.size());
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+      SYLAR_ASSERT(results[i] == (int)(i * i));
+    }
+    SYLAR_ASSERT(used < 200);
+    SYLAR_LOG_INFO(g_logger) << "fanout: 100 x 10ms calls in " << used << "ms";
+  });
+}
+
+/**
+ * @brief 异常传递、WhenAny、void结果、多个协程等待同一个Future、重复设置
+ */
+void test_future()
+{
+  sylar::IOManager iom(s_threads, false, "future");
+  iom.schedule([&iom]()
+  {
+    auto bad = sylar::Async(&iom, []() -> int { throw std::runtime_error("boom");});
+    bool caught = false;
+    try { bad.get();}
+    catch(const std::runtime_error& e) { caught = std::string(e.what()) == "boom";}
+    SYLAR_ASSERT(caught);
+
+    std::vector<sylar::Future<int> > futures;
+    futures.push_back(sylar::Async(&iom, []() { return 1;}));
+    futures.push_back(bad);
+    caught = false;
+    try { sylar::WhenAll(futures).get();}
+    catch(const std::runtime_error&) { caught = true;}
+    SYLAR_ASSERT(caught);
+
+    std::vector<sylar::Future<int> > racers;
+    for(int delay : {50, 5, 30})
+    {
+      racers.push_back(sylar::Async(&iom, [delay]()
+      {
+        usleep(delay * 1000);
+        return delay;
+      }));
+    }
+    size_t first = sylar::WhenAny(racers).get();
+    SYLAR_ASSERT(first == 1 && racers[first].get() == 5);
+
+    std::atomic<int> ran = {0};
+    std::vector<sylar::Future<void> > voids;
+    for(int i = 0; i < 10; ++i)
+    {
+      voids.push_back(sylar::Async(&iom, [&ran]() { ++ran;}));
+    }
+    sylar::WhenAll(voids).get();
+    SYLAR_ASSERT(ran == 10);
+
+    // 由定时器设置结果，多个协程同时等待
+    sylar::Promise<std::string> promise;
+    sylar::Future<std::string> future = promise.getFuture();
+    sylar::WaitGroup wg(8);
+    std::atomic<int> seen = {0};
+    for(int i = 0; i < 8; ++i)
+    {
+      iom.schedule([future, &wg, &seen]()
+      {
+        if(future.get() == "ready")
+        {
+          ++seen;
+        }
+        wg.done();
+      });
+    }
+    iom.addTimer(20, [promise]() { promise.setValue(std::string("ready"));});
+    wg.wait();
+    SYLAR_ASSERT(seen == 8 && future.isReady());
+    caught = false;
+    try { promise.setValue(std::string("again"));}
+    catch(const std::logic_error&) { caught = true;}
+    SYLAR_ASSERT(caught);
+    SYLAR_LOG_INFO(g_logger) << "future passed";
+  });
+}
+
+/**
+ * @brief 每个任务单独schedule，用WaitGroup等待
+ */
+uint64_t bench_waitgroup(sylar::IOManager& iom)
+{
+  std::atomic<uint64_t> sum = {0};
+  sylar::WaitGroup wg(s_tasks);
+  uint64_t begin = sylar::GetCurrentUS();
+  for(int i = 0; i < s_tasks; ++i)
+  {
+    iom.schedule([i, &sum, &wg]()
+    {
+      sum += i;
+      wg.done();
+    });
+  }
+  wg.wait();
+  uint64_t used = sylar::GetCurrentUS() - begin;
+  SYLAR_ASSERT(sum == (uint64_t)s_tasks * (s_tasks - 1) / 2);
+  return used;
+}
+
+/**
+ * @brief 每个任务单独Async调度，WhenAll汇聚
+ */
+uint64_t bench_async(sylar::IOManager& iom)
+{
+  uint64_t begin = sylar::GetCurrentUS();
+  std::vector<sylar::Future<uint64_t> > futures;
+  futures.reserve(s_tasks);
+  for(int i = 0; i < s_tasks; ++i)
+  {
+    futures.push_back(sylar::Async(&iom, [i]() { return (uint64_t)i;}));
+  }
+  std::vector<uint64_t> results = sylar::WhenAll(futures).get();
+  uint64_t used = sylar::GetCurrentUS() - begin;
+  SYLAR_ASSERT(std::accumulate(results.begin(), results.end(), (uint64_t)0) == (uint64_t)s_tasks * (s_tasks - 1) / 2);
+  return used;
+}
+
+/**
+ * @brief ParallelMap批量调度，WhenAll汇聚
+ */
+uint64_t bench_batch(sylar::IOManager& iom)
+{
+  std::vector<int> keys(s_tasks);
+  std::iota(keys.begin(), keys.end(), 0);
+  uint64_t begin = sylar::GetCurrentUS();
+  auto futures = sylar::ParallelMap(&iom, keys.begin(), keys.end(), [](int k) { return (uint64_t)k;});
+  std::vector<uint64_t> results = sylar::WhenAll(futures).get();
+  uint64_t used = sylar::GetCurrentUS() - begin;
+  SYLAR_ASSERT(std::accumulate(results.begin(), results.end(), (uint64_t)0) == (uint64_t)s_tasks * (s_tasks - 1) / 2);
+  return used;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "t:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': s_threads = atoi(optarg); break;
+      case 'n': s_tasks = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_fanout();
+  test_future();
+
+  uint64_t wg_us = 1;
+  uint64_t async_us = 1;
+  uint64_t batch_us = 1;
+  {
+    sylar::IOManager iom(s_threads, false, "bench");
+    iom.schedule([&]()
+    {
+      wg_us = std::max<uint64_t>(bench_waitgroup(iom), 1);
+      async_us = std::max<uint64_t>(bench_async(iom), 1);
+      batch_us = std::max<uint64_t>(bench_batch(iom), 1);
+    });
+  }
+  std::cout << "fan-out bench: threads=" << s_threads << " tasks=" << s_tasks << std::endl
+    << "  schedule each + WaitGroup: " << wg_us / 1000 << "ms "
+    << ((uint64_t)s_tasks * 1000000 / wg_us) << " tasks/s" << std::endl
+    << "  Async each + WhenAll:      " << async_us / 1000 << "ms "
+    << ((uint64_t)s_tasks * 1000000 / async_us) << " tasks/s" << std::endl
+    << "  ParallelMap + WhenAll:     " << batch_us / 1000 << "ms "
+    << ((uint64_t)s_tasks * 1000000 / batch_us) << " tasks/s" << std::endl;
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 09:45:20
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 09:45:20
+ * @FilePath: /sylar-wxb/tests/test_hook_alloc.cc
+ * @Description: 统计hook后recv/send稳态下每次调用的内存分配次数
+ *   立即完成的调用必须为0次；挂起等待的调用只打印结果
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "fd_manager.h"
+
+static std::atomic<uint64_t> s_allocs = {0};
+
+void* operator new(size_t size)
+{
+  ++s_allocs;
+  void* p = malloc(size ? size : 1);
+  if(!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int WARMUP = 1000;
+static const int ROUNDS = 100000;
+
+static void make_pair(int fds[2])
+{
+  SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  // socketpair没有被hook，手动登记使其走协程io
+  sylar::FdMgr::GetInstance()->get(fds[0], true);
+  sylar::FdMgr::GetInstance()->get(fds[1], true);
+  struct timeval tv{1, 0}; // 带超时，覆盖挂起时的定时器路径
+  setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * @brief 数据已经就绪，recv/send都立即完成
+ */
+void test_ready()
+{
+  int fds[2];
+  make_pair(fds);
+  char buf[64] = {0};
+  for(int i = 0; i < WARMUP; ++i)
+  {
+    SYLAR_ASSERT(send(fds[0], buf, sizeof(buf), 0) == sizeof(buf));
+    SYLAR_ASSERT(recv(fds[1], buf, sizeof(buf), 0) == sizeof(buf));
+  }
+
+  uint64_t begin = s_allocs;
+  for(int i = 0; i < ROUNDS; ++i)
+  {
+    send(fds[0], buf, sizeof(buf), 0);
+    recv(fds[1], buf, sizeof(buf), 0);
+  }
+  uint64_t allocs = s_allocs - begin;
+  SYLAR_LOG_INFO(g_logger) << "ready: " << ROUNDS * 2 << " calls, allocs=" << allocs
+    << " (" << allocs * 1.0 / (ROUNDS * 2) << "/call)";
+  SYLAR_ASSERT(allocs == 0);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static int s_ping[2];
+static int s_pong[2];
+static std::atomic<uint64_t> s_blocked_allocs = {0};
+
+void pong()
+{
+  char buf[64];
+  for(int i = 0; i < WARMUP + ROUNDS; ++i)
+  {
+    if(recv(s_ping[1], buf, sizeof(buf), 0) != sizeof(buf)
+        || send(s_pong[0], buf, sizeof(buf), 0) != sizeof(buf))
+    {
+      break;
+    }
+  }
+}
+
+/**
+ * @brief 两个协程乒乓，每次recv都要挂起等待
+ */
+void ping()
+{
+  char buf[64] = {0};
+  uint64_t begin = 0;
+  for(int i = 0; i < WARMUP + ROUNDS; ++i)
+  {
+    if(i == WARMUP)
+    {
+      begin = s_allocs;
+    }
+    SYLAR_ASSERT(send(s_ping[0], buf, sizeof(buf), 0) == sizeof(buf));
+    SYLAR_ASSERT(recv(s_pong[1], buf, sizeof(buf), 0) == sizeof(buf));
+  }
+  s_blocked_allocs = s_allocs - begin;
+}
+
+int main(int argc, char** argv)
+{
+  // 调度时的DEBUG日志本身会分配内存
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::INFO);
+  {
+    sylar::IOManager iom(1, false, "io");
+    iom.schedule(test_ready);
+  }
+
+  {
+    sylar::IOManager iom(1, false, "io");
+    iom.schedule([]()
+    {
+      make_pair(s_ping);
+      make_pair(s_pong);
+      sylar::IOManager::GetThis()->schedule(pong);
+      sylar::IOManager::GetThis()->schedule(ping);
+    });
+  }
+  // 每轮ping/pong各一次send和一次挂起的recv
+  SYLAR_LOG_INFO(g_logger) << "blocked: " << ROUNDS * 4 << " calls, allocs=" << s_blocked_allocs
+    << " (" << s_blocked_allocs * 1.0 / (ROUNDS * 4) << "/call)";
+  close(s_ping[0]);
+  close(s_ping[1]);
+  close(s_pong[0]);
+  close(s_pong[1]);
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,282 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 15:32:48
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:20:00
+ * @FilePath: /sylar-wxb/tests/test_http_bench.cc
+ * @Description: 类wrk的HTTP压测工具，输出RPS和延迟分位数
+ *   用法: test_http_bench [-c 连接数] [-t 线程数] [-d 秒] [-P pipeline深度]
+ *                         [-h host] [-p port] [-u path]
+ *   不指定-h时在本进程内启动一个HttpServer作为压测目标(未指定-p时绑定临时端口)，
+ *   结束时断言所有连接都建立成功、没有错误和非2xx响应
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <strings.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "util.h"
+#include "http/http_server.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_conns = 64;
+static int s_threads = 2;
+static int s_seconds = 3;
+static int s_pipeline = 1;
+static std::string s_host;
+static int s_port = 0;
+static std::string s_path = "/hello";
+
+static volatile bool s_running = true;
+static std::atomic<uint64_t> s_requests = {0};
+static std::atomic<uint64_t> s_bytes = {0};
+static std::atomic<uint64_t> s_errors = {0};
+static std::atomic<uint64_t> s_non2xx = {0};
+static std::atomic<int> s_connected = {0};
+
+static sylar::Mutex s_mutex;
+static std::vector<uint32_t> s_latencies; // 微秒
+
+/**
+ * @brief 在[data, data+len)中解析一个完整响应
+ * @return 响应长度，不完整返回0，出错返回-1
+ */
+static int64_t parse_response(const char* data, size_t len, int& status)
+{
+  const char* hend = (const char*)memmem(data, len, "\r\n\r\n", 4);
+  if(!hend)
+  {
+    return 0;
+  }
+  size_t header_len = hend - data + 4;
+  if(len < 12 || memcmp(data, "HTTP/1.", 7) != 0)
+  {
+    return -1;
+  }
+  status = atoi(data + 9);
+  int64_t content_length = 0;
+  const char* cur = (const char*)memchr(data, '\n', header_len) + 1;
+  while(cur < hend)
+  {
+    const char* eol = (const char*)memchr(cur, '\n', hend + 2 - cur);
+    if(eol - cur > 15 && strncasecmp(cur, "content-length:", 15) == 0)
+    {
+      content_length = atoll(cur + 15);
+    }
+    cur = eol + 1;
+  }
+  if(len < header_len + content_length)
+  {
+    return 0;
+  }
+  return header_len + content_length;
+}
+
+void run_client(sylar::Address::ptr addr)
+{
+  sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+  if(!sock->connect(addr))
+  {
+    ++s_errors;
+    SYLAR_LOG_ERROR(g_logger) << "connect " << *addr << " fail";
+    return;
+  }
+  ++s_connected;
+
+  std::string one = "GET " + s_path + " HTTP/1.1\r\nHost: " + (s_host.empty() ? "127.0.0.1" : s_host)
+    + "\r\nUser-Agent: sylar-bench\r\n\r\n";
+  std::string req;
+  for(int i = 0; i < s_pipeline; ++i)
+  {
+    req += one;
+  }
+
+  std::vector<uint32_t> latencies;
+  latencies.reserve(1024 * 64);
+  std::vector<char> buf(64 * 1024);
+  size_t begin = 0;
+  size_t end = 0;
+  while(s_running)
+  {
+    uint64_t start = sylar::GetCurrentUS();
+    if(sock->send(req.data(), req.size()) != (int)req.size())
+    {
+      ++s_errors;
+      break;
+    }
+    int got = 0;
+    while(got < s_pipeline)
+    {
+      if(end == buf.size())
+      {
+        if(begin == 0)
+        {
+          buf.resize(buf.size() * 2);
+        }
+        else
+        {
+          memmove(&buf[0], &buf[begin], end - begin);
+          end -= begin;
+          begin = 0;
+        }
+      }
+      int rt = sock->recv(&buf[end], buf.size() - end);
+      if(rt <= 0)
+      {
+        ++s_errors;
+        goto out;
+      }
+      end += rt;
+      s_bytes += rt;
+      while(got < s_pipeline)
+      {
+        int status = 0;
+        int64_t n = parse_response(&buf[begin], end - begin, status);
+        if(n < 0)
+        {
+          ++s_errors;
+          goto out;
+        }
+        if(n == 0)
+        {
+          break;
+        }
+        if(status < 200 || status > 299)
+        {
+          ++s_non2xx;
+        }
+        begin += n;
+        ++got;
+        latencies.push_back(sylar::GetCurrentUS() - start);
+      }
+      if(begin == end)
+      {
+        begin = end = 0;
+      }
+    }
+    s_requests += got;
+  }
+out:
+  sock->close();
+  sylar::Mutex::Lock lock(s_mutex);
+  s_latencies.insert(s_latencies.end(), latencies.begin(), latencies.end());
+}
+
+static double percentile(double p)
+{
+  if(s_latencies.empty())
+  {
+    return 0;
+  }
+  size_t idx = std::min(s_latencies.size() - 1, (size_t)(p * s_latencies.size()));
+  return s_latencies[idx] / 1000.0;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "c:t:d:P:h:p:u:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'c': s_conns = atoi(optarg); break;
+      case 't': s_threads = atoi(optarg); break;
+      case 'd': s_seconds = atoi(optarg); break;
+      case 'P': s_pipeline = std::max(1, atoi(optarg)); break;
+      case 'h': s_host = optarg; break;
+      case 'p': s_port = atoi(optarg); break;
+      case 'u': s_path = optarg; break;
+      default: break;
+    }
+  }
+  g_logger->setLevel(sylar::LogLevel::WARN);
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  if(!s_host.empty() && !s_port)
+  {
+    s_port = 80;
+  }
+
+  std::string target = (s_host.empty() ? "127.0.0.1" : s_host) + ":" + std::to_string(s_port);
+  sylar::Address::ptr addr = sylar::Address::LookupAny(target);
+  if(!addr)
+  {
+    std::cout << "invalid address " << target << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<sylar::IOManager> accept_worker;
+  std::unique_ptr<sylar::IOManager> io_worker;
+  sylar::http::HttpServer::ptr server;
+  if(s_host.empty())
+  {
+    accept_worker.reset(new sylar::IOManager(1, false, "accept"));
+    io_worker.reset(new sylar::IOManager(2, false, "io"));
+    server.reset(new sylar::http::HttpServer(true, io_worker.get(), accept_worker.get()));
+    server->getServletDispatch()->addServlet("/hello", [](const sylar::http::HttpRequest& req,
+                                                          sylar::http::HttpResponse& rsp,
+                                                          sylar::Socket::ptr session)
+    {
+      rsp.setHeader("Content-Type", "text/plain");
+      rsp.setBody("hello world");
+      return 0;
+    });
+    if(!server->bind(addr))
+    {
+      return 1;
+    }
+    addr = server->getSocks()[0]->getLocalAddress();
+    target = addr->toString();
+    server->start();
+  }
+
+  std::cout << "Running " << s_seconds << "s test @ http://" << target << s_path << std::endl
+    << "  " << s_threads << " threads and " << s_conns << " connections, pipeline " << s_pipeline << std::endl;
+  uint64_t used = 0;
+  {
+    sylar::IOManager client_worker(s_threads, false, "bench");
+    uint64_t begin = sylar::GetCurrentMS();
+    for(int i = 0; i < s_conns; ++i)
+    {
+      client_worker.schedule(std::bind(&run_client, addr));
+    }
+    sleep(s_seconds);
+    s_running = false;
+    used = sylar::GetCurrentMS() - begin;
+  }
+
+  std::sort(s_latencies.begin(), s_latencies.end());
+  double avg = 0;
+  for(auto i : s_latencies)
+  {
+    avg += i;
+  }
+  avg = s_latencies.empty() ? 0 : avg / s_latencies.size() / 1000.0;
+
+  std::cout << "  Latency(ms) avg=" << avg << " p50=" << percentile(0.5) << " p90=" << percentile(0.9)
+    << " p99=" << percentile(0.99) << " max=" << percentile(1) << std::endl
+    << "  " << s_requests << " requests in " << used / 1000.0 << "s, "
+    << s_bytes / 1024.0 / 1024 << "MB read, connected " << s_connected << "/" << s_conns << std::endl;
+  if(s_errors || s_non2xx)
+  {
+    std::cout << "  Socket errors: " << s_errors << ", Non-2xx responses: " << s_non2xx << std::endl;
+  }
+  std::cout << "Requests/sec: " << s_requests * 1000.0 / used << std::endl
+    << "Transfer/sec: " << s_bytes * 1000.0 / used / 1024 / 1024 << "MB" << std::endl;
+
+  if(server)
+  {
+    server->stop();
+  }
+  SYLAR_ASSERT(s_connected == s_conns);
+  SYLAR_ASSERT(s_requests > 0);
+  SYLAR_ASSERT2(s_errors == 0 && s_non2xx == 0, "errors=" + std::to_string(s_errors)
+                + " non2xx=" + std::to_string(s_non2xx));
+  return 0;
+}
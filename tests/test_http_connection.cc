@@ -0,0 +1,193 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:48:19
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:05:00
+ * @FilePath: /sylar-wxb/tests/test_http_connection.cc
+ * @Description: HTTP连接池测试，本进程内启动HttpServer作为后端
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <atomic>
+#include <unistd.h>
+
+#include "log.h"
+#include "iomanager.h"
+#include "macro.h"
+#include "util.h"
+#include "http/http_connection.h"
+#include "http/http_server.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_port = 18030;
+static std::atomic<int> s_ok = {0};
+static std::atomic<int> s_done = {0};
+
+sylar::http::HttpServer::ptr start_server(sylar::IOManager* iom)
+{
+  sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, iom, iom));
+  // 空闲的长连接尽快断开，便于进程退出
+  server->setRecvTimeout(500);
+  server->getServletDispatch()->addGlobServlet("/*", [](const sylar::http::HttpRequest& req,
+                                                        sylar::http::HttpResponse& rsp,
+                                                        sylar::Socket::ptr session)
+  {
+    rsp.setBody(std::string(req.getPath()) + "?" + std::string(req.getQuery()) + "|" + std::string(req.getBody()));
+    return 0;
+  });
+  auto addr = sylar::Address::LookupAny("127.0.0.1:" + std::to_string(s_port));
+  SYLAR_ASSERT(server->bind(addr));
+  server->start();
+  return server;
+}
+
+/**
+ * @brief 并发请求数远大于连接池上限，多余的协程在FiberSemaphore上等待
+ */
+void test_concurrent(sylar::IOManager* iom)
+{
+  sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", s_port, 4, 30 * 1000, 1000));
+  const int n = 200;
+  s_ok = s_done = 0;
+  uint64_t begin = sylar::GetCurrentMS();
+  for(int i = 0; i < n; ++i)
+  {
+    iom->schedule([pool, i]()
+    {
+      auto r = pool->doGet("/concurrent?i=" + std::to_string(i), 1000);
+      if(r->result == 0 && r->response->getBody() == "/concurrent?i=" + std::to_string(i) + "|")
+      {
+        ++s_ok;
+      }
+      else
+      {
+        SYLAR_LOG_ERROR(g_logger) << r->toString();
+      }
+      ++s_done;
+    });
+  }
+  while(s_done < n)
+  {
+    usleep(1000);
+  }
+  SYLAR_LOG_INFO(g_logger) << "concurrent: ok=" << s_ok << "/" << n << " created=" << pool->getCreated()
+    << " idle=" << pool->getIdleCount() << " used=" << sylar::GetCurrentMS() - begin << "ms";
+  SYLAR_ASSERT(s_ok == n);
+  SYLAR_ASSERT(pool->getCreated() <= 4);
+}
+
+/**
+ * @brief 每个连接最多处理10个请求
+ */
+void test_max_request()
+{
+  sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", s_port, 4, 30 * 1000, 10));
+  for(int i = 0; i < 100; ++i)
+  {
+    auto r = pool->doPost("/max_request", 1000, {{"Content-Type", "text/plain"}}, "body");
+    SYLAR_ASSERT(r->result == 0 && r->response->getBody() == "/max_request?|body");
+  }
+  SYLAR_LOG_INFO(g_logger) << "max_request: created=" << pool->getCreated();
+  SYLAR_ASSERT(pool->getCreated() == 10);
+}
+
+/**
+ * @brief 空闲超时的连接不再复用
+ */
+void test_idle_timeout()
+{
+  sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", s_port, 4, 100, 1000));
+  pool->doGet("/idle", 1000);
+  pool->doGet("/idle", 1000);
+  SYLAR_ASSERT(pool->getCreated() == 1);
+  usleep(200 * 1000);
+  pool->doGet("/idle", 1000);
+  SYLAR_LOG_INFO(g_logger) << "idle_timeout: created=" << pool->getCreated() << " total=" << pool->getTotal();
+  SYLAR_ASSERT(pool->getCreated() == 2 && pool->getTotal() == 1);
+}
+
+/**
+ * @brief 同一连接上pipeline发送一批请求
+ */
+void test_batch()
+{
+  auto pool = sylar::http::HttpConnectionPoolMgr::GetInstance()->get("127.0.0.1", s_port);
+  std::vector<std::string> paths;
+  for(int i = 0; i < 16; ++i)
+  {
+    paths.push_back("/batch/" + std::to_string(i));
+  }
+  std::vector<sylar::http::HttpRequest> reqs(paths.size());
+  for(size_t i = 0; i < paths.size(); ++i)
+  {
+    reqs[i].setPath(paths[i]);
+  }
+  uint64_t begin = sylar::GetCurrentUS();
+  auto results = pool->doRequestBatch(reqs, 1000);
+  uint64_t used = sylar::GetCurrentUS() - begin;
+  for(size_t i = 0; i < results.size(); ++i)
+  {
+    SYLAR_ASSERT(results[i]->result == 0 && results[i]->response->getBody() == paths[i] + "?|");
+  }
+  SYLAR_LOG_INFO(g_logger) << "batch: " << results.size() << " pipelined requests in " << used << "us, created="
+    << pool->getCreated();
+}
+
+/**
+ * @brief 直接喂给响应解析器的chunked编码，包括分段到达和各种非法格式
+ */
+void test_chunked()
+{
+  const std::string head = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+  const std::string body = "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n";
+  std::string data = head + body;
+  for(size_t i = head.size(); i < data.size(); ++i)
+  {
+    sylar::http::HttpResponseParser parser;
+    sylar::http::HttpResponse rsp;
+    SYLAR_ASSERT(parser.execute(data.data(), i, rsp) == 0);
+  }
+  sylar::http::HttpResponseParser parser;
+  sylar::http::HttpResponse rsp;
+  SYLAR_ASSERT(parser.execute(data.data(), data.size(), rsp) == (int64_t)data.size());
+  SYLAR_ASSERT(rsp.getBody() == "hello world");
+
+  for(auto& bad : {"5\r\nhelloXX0\r\n\r\n",                 // 数据后缺少\r\n
+                   "5\r\nhello\n0\r\n\r\n",                   // 只有\n
+                   "10000000000000005\r\nhello\r\n0\r\n\r\n", // 长度超过16位十六进制
+                   "ffffffffffffffff\r\nhello\r\n0\r\n\r\n",  // 长度超过body上限
+                   "xyz\r\n"})
+  {
+    std::string msg = head + bad;
+    sylar::http::HttpResponseParser parser;
+    sylar::http::HttpResponse rsp;
+    SYLAR_ASSERT2(parser.execute(msg.data(), msg.size(), rsp) < 0, bad);
+  }
+  SYLAR_LOG_INFO(g_logger) << "chunked passed";
+}
+
+int main(int argc, char** argv)
+{
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  test_chunked();
+  sylar::IOManager server_iom(2, false, "server");
+  auto server = start_server(&server_iom);
+
+  sylar::IOManager client_iom(2, false, "client");
+  test_concurrent(&client_iom);
+  client_iom.schedule([]()
+  {
+    test_max_request();
+    test_idle_timeout();
+    test_batch();
+    ++s_done;
+  });
+  while(s_done < 201)
+  {
+    usleep(1000);
+  }
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  server->stop();
+  return 0;
+}
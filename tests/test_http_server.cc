@@ -0,0 +1,262 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 15:10:26
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:20:00
+ * @FilePath: /sylar-wxb/tests/test_http_server.cc
+ * @Description: HTTP服务器测试：本机临时端口上用原始socket发请求，检查流水线、长连接/短连接、
+ *   缓冲区搬移后到达的请求体、431/501错误以及精确/通配路由
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "http/http_server.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_port = 0;
+
+struct Response
+{
+  int status = 0;
+  bool close = false;
+  std::string body;
+};
+
+/**
+ * @brief 主线程没有调度器，这里的socket调用都是阻塞的原始调用
+ */
+static int connect_server()
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  SYLAR_ASSERT(fd >= 0);
+  struct timeval tv{3, 0}; // 服务器没有按预期响应时失败而不是卡住
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(s_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  SYLAR_ASSERT(connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+  return fd;
+}
+
+static void send_all(int fd, const std::string& data)
+{
+  size_t off = 0;
+  while(off < data.size())
+  {
+    ssize_t rt = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+    SYLAR_ASSERT(rt > 0);
+    off += rt;
+  }
+}
+
+/**
+ * @brief 从buf开头解析一个完整响应，不完整返回0
+ */
+static size_t parse_response(const std::string& buf, Response& rsp)
+{
+  size_t hend = buf.find("\r\n\r\n");
+  if(hend == std::string::npos)
+  {
+    return 0;
+  }
+  SYLAR_ASSERT(buf.compare(0, 7, "HTTP/1.") == 0);
+  rsp.status = atoi(buf.c_str() + 9);
+  std::string header = buf.substr(0, hend);
+  rsp.close = strcasestr(header.c_str(), "\r\nconnection: close") != nullptr;
+  const char* cl = strcasestr(header.c_str(), "\r\ncontent-length:");
+  size_t length = cl ? strtoul(cl + 17, nullptr, 10) : 0;
+  if(buf.size() < hend + 4 + length)
+  {
+    return 0;
+  }
+  rsp.body = buf.substr(hend + 4, length);
+  return hend + 4 + length;
+}
+
+/**
+ * @brief 读取n个响应
+ */
+static std::vector<Response> read_responses(int fd, size_t n)
+{
+  std::vector<Response> rt;
+  std::string buf;
+  char tmp[4096];
+  while(rt.size() < n)
+  {
+    Response rsp;
+    size_t used = parse_response(buf, rsp);
+    if(used)
+    {
+      rt.push_back(rsp);
+      buf.erase(0, used);
+      continue;
+    }
+    ssize_t len = recv(fd, tmp, sizeof(tmp), 0);
+    SYLAR_ASSERT2(len > 0, "recv response fail errno=" + std::to_string(errno));
+    buf.append(tmp, len);
+  }
+  SYLAR_ASSERT(buf.empty());
+  return rt;
+}
+
+/**
+ * @brief 对端已关闭连接
+ */
+static bool is_closed(int fd)
+{
+  char c;
+  return recv(fd, &c, 1, 0) == 0;
+}
+
+void test_pipeline_keepalive()
+{
+  int fd = connect_server();
+  // 一次写入三个请求，服务器一次读到后依次处理，响应按顺序返回
+  send_all(fd, "GET /sylar/xx HTTP/1.1\r\nHost: a\r\n\r\n"
+               "GET /sylar/yy?k=v HTTP/1.1\r\nHost: a\r\n\r\n"
+               "POST /echo HTTP/1.1\r\nHost: a\r\nContent-Length: 5\r\n\r\nhello");
+  std::vector<Response> rsps = read_responses(fd, 3);
+  SYLAR_ASSERT(rsps[0].status == 200 && rsps[0].body == "exact" && !rsps[0].close);
+  SYLAR_ASSERT(rsps[1].status == 200 && rsps[1].body == "glob:/sylar/yy" && !rsps[1].close);
+  SYLAR_ASSERT(rsps[2].status == 200 && rsps[2].body == "hello" && !rsps[2].close);
+
+  // 长连接上继续请求，未注册的路径走默认的404
+  send_all(fd, "GET /other HTTP/1.1\r\nHost: a\r\n\r\n");
+  rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 404 && !rsps[0].close);
+  close(fd);
+  SYLAR_LOG_INFO(g_logger) << "pipeline keepalive passed";
+}
+
+void test_close()
+{
+  // Connection: close，响应后服务器关闭连接，后面流水线的请求不再处理
+  int fd = connect_server();
+  send_all(fd, "GET /sylar/xx HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n"
+               "GET /sylar/xx HTTP/1.1\r\nHost: a\r\n\r\n");
+  std::vector<Response> rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 200 && rsps[0].close);
+  SYLAR_ASSERT(is_closed(fd));
+  close(fd);
+
+  // HTTP/1.0默认短连接
+  fd = connect_server();
+  send_all(fd, "GET /sylar/xx HTTP/1.0\r\n\r\n");
+  rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 200 && rsps[0].close);
+  SYLAR_ASSERT(is_closed(fd));
+  close(fd);
+
+  // HTTP/1.0显式keep-alive
+  fd = connect_server();
+  send_all(fd, "GET /sylar/xx HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+  rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 200 && !rsps[0].close);
+  send_all(fd, "GET /sylar/xx HTTP/1.0\r\n\r\n");
+  rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 200 && rsps[0].close);
+  close(fd);
+  SYLAR_LOG_INFO(g_logger) << "close passed";
+}
+
+void test_large_body()
+{
+  // 请求体比读缓冲区(4K)大，先只发头部和一部分，等服务器解析完头部后缓冲区扩容搬移，再发剩下的
+  std::string body;
+  for(int i = 0; i < 20000; ++i)
+  {
+    body.push_back('a' + i % 26);
+  }
+  int fd = connect_server();
+  send_all(fd, "POST /echo HTTP/1.1\r\nHost: a\r\nContent-Length: " + std::to_string(body.size())
+               + "\r\nX-Test: moved\r\n\r\n" + body.substr(0, 1000));
+  usleep(50 * 1000);
+  send_all(fd, body.substr(1000) + "GET /sylar/xx HTTP/1.1\r\nHost: a\r\n\r\n");
+  std::vector<Response> rsps = read_responses(fd, 2);
+  SYLAR_ASSERT(rsps[0].status == 200 && rsps[0].body == body);
+  SYLAR_ASSERT(rsps[1].status == 200 && rsps[1].body == "exact");
+  close(fd);
+  SYLAR_LOG_INFO(g_logger) << "large body passed";
+}
+
+void test_errors()
+{
+  // 头部超过http.request.max_header_size(8K)
+  int fd = connect_server();
+  send_all(fd, "GET /sylar/xx HTTP/1.1\r\nX-Big: " + std::string(9000, 'x') + "\r\n");
+  std::vector<Response> rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 431 && rsps[0].close);
+  SYLAR_ASSERT(is_closed(fd));
+  close(fd);
+
+  // 不支持chunked请求体
+  fd = connect_server();
+  send_all(fd, "POST /echo HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n");
+  rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 501 && rsps[0].close);
+  SYLAR_ASSERT(is_closed(fd));
+  close(fd);
+
+  // 请求行格式错误
+  fd = connect_server();
+  send_all(fd, "GET\r\n\r\n");
+  rsps = read_responses(fd, 1);
+  SYLAR_ASSERT(rsps[0].status == 400 && rsps[0].close);
+  close(fd);
+  SYLAR_LOG_INFO(g_logger) << "errors passed";
+}
+
+int main(int argc, char** argv)
+{
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  sylar::IOManager iom(2, false, "http");
+  sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+  auto sd = server->getServletDispatch();
+  sd->addServlet("/sylar/xx", [](const sylar::http::HttpRequest& req,
+                                 sylar::http::HttpResponse& rsp,
+                                 sylar::Socket::ptr session)
+  {
+    rsp.setBody("exact");
+    return 0;
+  });
+  sd->addGlobServlet("/sylar/*", [](const sylar::http::HttpRequest& req,
+                                    sylar::http::HttpResponse& rsp,
+                                    sylar::Socket::ptr session)
+  {
+    rsp.setBody("glob:" + std::string(req.getPath()));
+    return 0;
+  });
+  sd->addServlet("/echo", [](const sylar::http::HttpRequest& req,
+                             sylar::http::HttpResponse& rsp,
+                             sylar::Socket::ptr session)
+  {
+    rsp.setBody(std::string(req.getBody()));
+    return 0;
+  });
+  // 绑定临时端口，多个实例可以同时运行
+  SYLAR_ASSERT(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+  s_port = std::dynamic_pointer_cast<sylar::IPAddress>(server->getSocks()[0]->getLocalAddress())->getPort();
+  server->start();
+
+  test_pipeline_keepalive();
+  test_close();
+  test_large_body();
+  test_errors();
+  server->stop();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 18:05:20
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 18:05:20
+ * @FilePath: /sylar-wxb/tests/test_lock_profiler.cc
+ * @Description: 锁竞争分析测试：按加锁位置统计次数、竞争和等待/持有时间，排序输出
+ *   需要用 cmake -DSYLAR_LOCK_PROFILING=ON 编译，否则只检查未开启时的输出
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "iomanager.h"
+#include "lock_profiler.h"
+#include "log.h"
+#include "macro.h"
+#include "mutex.h"
+#include "thread.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static sylar::Mutex s_hot;
+static sylar::Spinlock s_cold;
+static sylar::RWMutex s_rw;
+static int s_hot_line = 0;
+static int s_cold_line = 0;
+static int s_read_line = 0;
+static volatile uint64_t s_sink = 0;
+
+static const sylar::LockProfiler::SiteStats* find_site(const std::vector<sylar::LockProfiler::SiteStats>& stats, int line)
+{
+  std::string suffix = "test_lock_profiler.cc:" + std::to_string(line);
+  for(auto& i : stats)
+  {
+    if(i.site.size() >= suffix.size() && !i.site.compare(i.site.size() - suffix.size(), suffix.size(), suffix)) return &i;
+  }
+  return nullptr;
+}
+
+void hot_path()
+{
+  for(int i = 0; i < 2000; ++i)
+  {
+    sylar::Mutex::Lock lock(s_hot); s_hot_line = __LINE__;
+    for(int j = 0; j < 200; ++j) s_sink += j;
+  }
+}
+
+void test_sites()
+{
+  std::vector<sylar::Thread::ptr> thrs;
+  for(int i = 0; i < 4; ++i)
+  {
+    thrs.emplace_back(new sylar::Thread(&hot_path, "hot_" + std::to_string(i)));
+  }
+  for(auto& i : thrs)
+  {
+    i->join();
+  }
+  for(int i = 0; i < 1000; ++i)
+  {
+    sylar::Spinlock::Lock lock(s_cold); s_cold_line = __LINE__;
+  }
+  for(int i = 0; i < 100; ++i)
+  {
+    sylar::RWMutex::ReadLock lock(s_rw); s_read_line = __LINE__;
+    lock.unlock();
+    lock.lock(); // 重新加锁也计入同一位置
+  }
+
+  // 调度器内部的锁也会被统计
+  {
+    sylar::IOManager iom(2, false, "lockprof");
+    for(int i = 0; i < 1000; ++i)
+    {
+      iom.schedule([]() { s_sink += 1;});
+    }
+  }
+
+  std::vector<sylar::LockProfiler::SiteStats> stats = sylar::LockProfiler::GetStats();
+  const sylar::LockProfiler::SiteStats* hot = find_site(stats, s_hot_line);
+  const sylar::LockProfiler::SiteStats* cold = find_site(stats, s_cold_line);
+  const sylar::LockProfiler::SiteStats* read = find_site(stats, s_read_line);
+  SYLAR_ASSERT(hot && cold && read);
+  SYLAR_LOG_INFO(g_logger) << "hot acquired=" << hot->acquisitions << " contended=" << hot->contended
+    << " wait_total_us=" << hot->waitNs.sum / 1000 << " hold_p50_ns=" << hot->holdNs.percentile(50);
+  SYLAR_ASSERT(hot->acquisitions == 8000 && hot->waitNs.count == 8000 && hot->holdNs.count == 8000);
+  SYLAR_ASSERT(hot->type == "sylar::Mutex" && !hot->shared);
+  SYLAR_ASSERT(cold->acquisitions == 1000 && cold->contended == 0 && cold->waitNs.sum == 0);
+  SYLAR_ASSERT(read->acquisitions == 200 && read->shared);
+  // 按总等待时间排序
+  for(size_t i = 1; i < stats.size(); ++i)
+  {
+    SYLAR_ASSERT(stats[i - 1].waitNs.sum >= stats[i].waitNs.sum);
+  }
+  bool has_scheduler = false;
+  for(auto& i : stats)
+  {
+    has_scheduler |= i.site.find("scheduler.") != std::string::npos;
+  }
+  SYLAR_ASSERT(has_scheduler);
+
+  std::stringstream ss;
+  sylar::LockProfiler::Dump(ss, 10);
+  std::cout << ss.str();
+  SYLAR_LOG_INFO(g_logger) << "sites passed";
+}
+
+int main(int argc, char** argv)
+{
+  if(!sylar::LockProfiler::IsEnabled())
+  {
+    std::stringstream ss;
+    sylar::LockProfiler::Dump(ss);
+    SYLAR_ASSERT(ss.str().find("disabled") != std::string::npos);
+    SYLAR_LOG_INFO(g_logger) << "lock profiling not compiled in, skip";
+    return 0;
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  test_sites();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:20:15
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:20:15
+ * @FilePath: /sylar-wxb/tests/test_metrics.cc
+ * @Description: 指标注册表测试：多线程写入、标签、Prometheus文本格式、配置前缀/禁用，以及通过HTTP拉取
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <iostream>
+#include <unistd.h>
+
+#include "config.h"
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "metrics.h"
+#include "util.h"
+#include "http/http_connection.h"
+#include "http/http_server.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const int s_port = 18040;
+
+static bool contains(const std::string& text, const std::string& line)
+{
+  return text.find(line + "\n") != std::string::npos;
+}
+
+void test_registry()
+{
+  sylar::MetricsRegistry reg;
+  sylar::Counter::ptr get = reg.counter("http_requests_total", "requests", {{"method", "GET"}});
+  sylar::Counter::ptr post = reg.counter("http_requests_total", "requests", {{"method", "POST"}});
+  SYLAR_ASSERT(get && post && get != post);
+  SYLAR_ASSERT(reg.counter("http_requests_total", "requests", {{"method", "GET"}}) == get);
+  SYLAR_ASSERT(!reg.gauge("http_requests_total", "wrong type"));
+  SYLAR_ASSERT(!reg.counter("bad-name", "invalid"));
+  SYLAR_ASSERT(!reg.counter("ok", "invalid label", {{"0bad", "x"}}));
+
+  sylar::Histogram::ptr lat = reg.histogram("rpc_latency_us", "latency", {}, {10, 100, 1000});
+  sylar::Gauge::ptr conns = reg.gauge("connections", "open connections");
+  std::vector<sylar::Thread::ptr> thrs;
+  for(int i = 0; i < 8; ++i)
+  {
+    thrs.emplace_back(new sylar::Thread([get, post, lat, conns]()
+    {
+      for(int j = 0; j < 10000; ++j)
+      {
+        get->inc();
+        post->inc(2);
+        lat->observe(j % 2000);
+        conns->add(1);
+      }
+    }, "metrics_" + std::to_string(i)));
+  }
+  for(auto& i : thrs)
+  {
+    i->join();
+  }
+  SYLAR_ASSERT(get->get() == 80000 && post->get() == 160000 && conns->get() == 80000);
+  conns->set(1.5);
+  reg.addCallback("uptime_seconds", "uptime", sylar::Metric::GAUGE, {{"path", "a\"b\\c"}}, []() { return 42.0;});
+
+  std::string text = reg.toPrometheus();
+  std::cout << text;
+  SYLAR_ASSERT(contains(text, "# TYPE http_requests_total counter"));
+  SYLAR_ASSERT(contains(text, "http_requests_total{method=\"GET\"} 80000"));
+  SYLAR_ASSERT(contains(text, "http_requests_total{method=\"POST\"} 160000"));
+  SYLAR_ASSERT(contains(text, "connections 1.5"));
+  SYLAR_ASSERT(contains(text, "uptime_seconds{path=\"a\\\"b\\\\c\"} 42"));
+  // 0~1999均匀分布：<=10有11个值，<=100有101个，<=1000有1001个(边界按内部分桶取整，误差不超过12.5%)
+  SYLAR_ASSERT(contains(text, "rpc_latency_us_bucket{le=\"10\"} " + std::to_string(11 * 40)));
+  SYLAR_ASSERT(contains(text, "rpc_latency_us_bucket{le=\"+Inf\"} 80000"));
+  SYLAR_ASSERT(contains(text, "rpc_latency_us_count 80000"));
+
+  // 前缀和禁用在导出时生效
+  sylar::Config::Lookup<std::string>("metrics.prefix")->setValue("app_");
+  sylar::Config::Lookup<std::set<std::string> >("metrics.disabled")->setValue({"connections"});
+  text = reg.toPrometheus();
+  SYLAR_ASSERT(contains(text, "app_http_requests_total{method=\"GET\"} 80000"));
+  SYLAR_ASSERT(text.find("connections") == std::string::npos);
+  sylar::Config::Lookup<std::string>("metrics.prefix")->setValue("");
+  sylar::Config::Lookup<std::set<std::string> >("metrics.disabled")->setValue({});
+
+  reg.remove("http_requests_total", {{"method", "GET"}});
+  text = reg.toPrometheus();
+  SYLAR_ASSERT(text.find("method=\"GET\"") == std::string::npos && contains(text, "http_requests_total{method=\"POST\"} 160000"));
+  SYLAR_LOG_INFO(g_logger) << "registry passed";
+}
+
+void test_pull()
+{
+  std::atomic<bool> done = {false};
+  sylar::IOManager iom(2, false, "metrics");
+  sylar::MetricsMgr::GetInstance()->addScheduler(&iom);
+  sylar::Counter::ptr hits = sylar::MetricsMgr::GetInstance()->counter("test_hits_total", "servlet hits");
+
+  sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+  server->setRecvTimeout(500);
+  server->getServletDispatch()->addServlet("/metrics", std::make_shared<sylar::http::MetricsServlet>());
+  server->getServletDispatch()->addServlet("/hit", [hits](const sylar::http::HttpRequest& req,
+                                                          sylar::http::HttpResponse& rsp,
+                                                          sylar::Socket::ptr session)
+  {
+    hits->inc();
+    return 0;
+  });
+  SYLAR_ASSERT(server->bind(sylar::Address::LookupAny("127.0.0.1:" + std::to_string(s_port))));
+  server->start();
+
+  iom.schedule([&done]()
+  {
+    sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", s_port, 1, 30 * 1000, 100));
+    for(int i = 0; i < 10; ++i)
+    {
+      SYLAR_ASSERT(pool->doGet("/hit", 1000)->result == 0);
+    }
+    auto r = pool->doGet("/metrics", 1000);
+    SYLAR_ASSERT(r->result == 0);
+    const std::string& text = r->response->getBody();
+    SYLAR_LOG_INFO(g_logger) << "pulled " << text.size() << " bytes:\n" << text;
+    SYLAR_ASSERT(contains(text, "test_hits_total 10"));
+    SYLAR_ASSERT(contains(text, "sylar_scheduler_threads{scheduler=\"metrics\"} 2"));
+    SYLAR_ASSERT(text.find("sylar_scheduler_queue_latency_us_count{scheduler=\"metrics\"}") != std::string::npos);
+    SYLAR_ASSERT(text.find("sylar_timer_lateness_us_bucket{scheduler=\"metrics\",le=\"+Inf\"}") != std::string::npos);
+    done = true;
+  });
+  while(!done)
+  {
+    usleep(1000);
+  }
+  server->stop();
+  sylar::MetricsMgr::GetInstance()->removeScheduler(&iom);
+  SYLAR_LOG_INFO(g_logger) << "pull passed";
+}
+
+int main(int argc, char** argv)
+{
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  test_registry();
+  test_pull();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 15:06:41
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 15:06:41
+ * @FilePath: /sylar-wxb/tests/test_preempt.cc
+ * @Description: 协程时间片抢占测试：计算型协程与io型协程混合时，io型协程的唤醒延迟(不抢占/抢占对比)
+ *   -c 计算协程数 -w 每个计算协程的计算量(毫秒) -s 时间片(微秒) -n 每个io协程的探测次数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_cpu = 4;
+static int s_work_ms = 100;
+static int s_slice_us = 2000; // 线程cpu时间的定时器精度是内核tick，比tick短的时间片按tick计
+static int s_probes = 100;
+
+/**
+ * @brief 计算型协程：不调用任何hook函数，只在循环里放抢占点
+ */
+static void cpu_task(std::atomic<int>* done)
+{
+  uint64_t used = 0; // 只计自己运行的时间，让出期间不算
+  volatile uint64_t x = 0;
+  while(used < (uint64_t)s_work_ms * 1000)
+  {
+    uint64_t begin = sylar::GetCurrentUS();
+    for(int i = 0; i < 1000; ++i)
+    {
+      x = x + i;
+    }
+    used += sylar::GetCurrentUS() - begin;
+    sylar::Fiber::MaybeYield();
+  }
+  ++*done;
+}
+
+/**
+ * @brief 一个时间片内没有抢占点的协程不会被打断
+ */
+void test_no_safe_point()
+{
+  std::atomic<int> order = {0};
+  int cpu_order = -1;
+  int other_order = -1;
+  {
+    sylar::IOManager iom(1, false, "nopoint");
+    iom.setPreemptUs(1000);
+    iom.schedule([&]()
+    {
+      uint64_t end = sylar::GetCurrentUS() + 20 * 1000;
+      while(sylar::GetCurrentUS() < end);
+      cpu_order = order++;
+    });
+    iom.schedule([&]() { other_order = order++;});
+  }
+  SYLAR_ASSERT(cpu_order == 0 && other_order == 1);
+}
+
+/**
+ * @brief 单线程上s_cpu个计算协程和一个io协程，io协程每睡1ms做一次echo往返，统计睡眠到期后多久完成往返
+ */
+std::vector<uint64_t> bench(uint64_t slice_us, uint64_t& preempts)
+{
+  int fds[2];
+  SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  sylar::FdMgr::GetInstance()->get(fds[0], true); // socketpair不经过hook，手动登记后读写才会挂起协程
+  sylar::FdMgr::GetInstance()->get(fds[1], true);
+  std::vector<uint64_t> lat;
+  std::atomic<int> done = {0};
+  uint64_t before = sylar::Fiber::TotalPreempts();
+  {
+    sylar::IOManager iom(1, false, "preempt");
+    iom.setPreemptUs(slice_us);
+    iom.schedule([&fds]()
+    {
+      char c;
+      while(read(fds[1], &c, 1) == 1)
+      {
+        write(fds[1], &c, 1);
+      }
+    });
+    iom.schedule([&fds, &lat, &done]()
+    {
+      char c = 'x';
+      for(int i = 0; i < s_probes; ++i)
+      {
+        // 睡眠到期到往返完成，期间被计算协程占住的时间都算在延迟里
+        uint64_t begin = sylar::GetCurrentUS();
+        usleep(1000);
+        SYLAR_ASSERT(write(fds[0], &c, 1) == 1);
+        SYLAR_ASSERT(read(fds[0], &c, 1) == 1);
+        lat.push_back(sylar::GetCurrentUS() - begin - 1000);
+      }
+      ++done;
+    });
+    for(int i = 0; i < s_cpu; ++i)
+    {
+      iom.schedule([&done]() { cpu_task(&done);});
+    }
+    while(done < s_cpu + 1)
+    {
+      usleep(1000);
+    }
+    shutdown(fds[0], SHUT_WR); // echo协程读到EOF退出
+  }
+  close(fds[0]);
+  close(fds[1]);
+  preempts = sylar::Fiber::TotalPreempts() - before;
+  std::sort(lat.begin(), lat.end());
+  return lat;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "c:w:s:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'c': s_cpu = atoi(optarg); break;
+      case 'w': s_work_ms = atoi(optarg); break;
+      case 's': s_slice_us = atoi(optarg); break;
+      case 'n': s_probes = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_no_safe_point();
+
+  std::cout << "io fiber wake-to-rtt latency with cpu-bound fibers on one thread: cpu fibers=" << s_cpu << " work=" << s_work_ms
+    << "ms probes=" << s_probes << std::endl;
+  std::vector<uint64_t> p99;
+  for(uint64_t slice : {0ull, (unsigned long long)s_slice_us})
+  {
+    uint64_t preempts = 0;
+    std::vector<uint64_t> lat = bench(slice, preempts);
+    p99.push_back(lat[lat.size() * 99 / 100]);
+    std::cout << "  " << (slice ? "slice=" + std::to_string(slice) + "us: " : "no preemption: ")
+      << "p50=" << lat[lat.size() / 2] << "us p90=" << lat[lat.size() * 9 / 10] << "us p99=" << p99.back() << "us max=" << lat.back()
+      << "us preempts=" << preempts << std::endl;
+    SYLAR_ASSERT(slice ? preempts > 0 : preempts == 0);
+  }
+  SYLAR_ASSERT(p99[1] < p99[0]);
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
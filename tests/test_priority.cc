@@ -0,0 +1,213 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 13:48:22
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 13:48:22
+ * @FilePath: /sylar-wxb/tests/test_priority.cc
+ * @Description: 任务优先级/EDF调度顺序和防饿死测试，以及低优先级任务压满时高优先级任务的调度延迟
+ *   -t 线程数 -l 压测任务数 -n 探测任务数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <unistd.h>
+
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_threads = 2;
+static int s_load = 64;
+static int s_probes = 2000;
+
+static void busy_us(uint64_t us)
+{
+  uint64_t end = sylar::GetCurrentUS() + us;
+  while(sylar::GetCurrentUS() < end);
+}
+
+/**
+ * @brief 单线程调度器被占住时入队，放开后检查执行顺序
+ */
+void test_order()
+{
+  std::vector<std::string> order;
+  sylar::Mutex mutex;
+  auto record = [&order, &mutex](const std::string& name)
+  {
+    return [&order, &mutex, name]()
+    {
+      sylar::Mutex::Lock lock(mutex);
+      order.push_back(name);
+    };
+  };
+  {
+    sylar::IOManager iom(1, false, "order");
+    iom.setStarvationUs(0);
+    std::atomic<bool> blocked = {false};
+    iom.schedule([&blocked]()
+    {
+      blocked = true;
+      busy_us(20 * 1000);
+    });
+    while(!blocked);
+    uint64_t now = sylar::GetCurrentUS();
+    iom.schedule(record("low"), sylar::Scheduler::LOW);
+    iom.schedule(record("normal"));
+    iom.schedule(record("high"), sylar::Scheduler::HIGH);
+    iom.schedule(record("high_d3"), sylar::Scheduler::HIGH, now + 3000);
+    iom.schedule(record("high_d1"), sylar::Scheduler::HIGH, now + 1000);
+    iom.schedule(record("high_d2"), sylar::Scheduler::HIGH, now + 2000);
+    iom.schedule(record("normal_d1"), sylar::Scheduler::NORMAL, now + 1000);
+  }
+  std::vector<std::string> expect = {"high_d1", "high_d2", "high_d3", "high", "normal_d1", "normal", "low"};
+  SYLAR_ASSERT(order == expect);
+
+  // 协程让出后沿用优先级
+  std::vector<std::string> yields;
+  {
+    sylar::IOManager iom(1, false, "sticky");
+    iom.setStarvationUs(0);
+    std::atomic<bool> blocked = {false};
+    iom.schedule([&]()
+    {
+      blocked = true;
+      busy_us(10 * 1000);
+    });
+    while(!blocked);
+    iom.schedule([&]()
+    {
+      sylar::Fiber::YieldToReady();
+      sylar::Mutex::Lock lock(mutex);
+      yields.push_back("high");
+    }, sylar::Scheduler::HIGH);
+    for(int i = 0; i < 3; ++i)
+    {
+      iom.schedule([&]()
+      {
+        sylar::Mutex::Lock lock(mutex);
+        yields.push_back("normal");
+      });
+    }
+  }
+  SYLAR_ASSERT(yields.size() == 4 && yields[0] == "high");
+  SYLAR_LOG_INFO(g_logger) << "order passed";
+}
+
+/**
+ * @brief 高优先级任务压满时，低优先级任务等待时间受防饿死阈值限制
+ */
+void test_starvation()
+{
+  std::atomic<bool> stop = {false};
+  std::atomic<uint64_t> low_wait = {~0ull};
+  {
+    sylar::IOManager iom(1, false, "starve");
+    iom.setStarvationUs(5000);
+    for(int i = 0; i < 8; ++i)
+    {
+      iom.schedule([&stop]()
+      {
+        while(!stop)
+        {
+          busy_us(100);
+          sylar::Fiber::YieldToReady();
+        }
+      }, sylar::Scheduler::HIGH);
+    }
+    usleep(10 * 1000);
+    uint64_t begin = sylar::GetCurrentUS();
+    iom.schedule([&low_wait, &stop, begin]()
+    {
+      low_wait = sylar::GetCurrentUS() - begin;
+      stop = true;
+    }, sylar::Scheduler::LOW);
+    usleep(200 * 1000);
+    stop = true;
+  }
+  SYLAR_ASSERT(low_wait < 50 * 1000);
+  SYLAR_LOG_INFO(g_logger) << "starvation passed: low task waited " << low_wait << "us";
+}
+
+/**
+ * @brief 压测任务不停计算并让出，定时投放探测任务，统计探测任务从入队到执行的延迟
+ * @param[in] mode 0全部NORMAL先进先出，1探测HIGH/压测LOW，2同为NORMAL但探测带截止时间
+ */
+std::vector<uint64_t> bench_latency(int mode)
+{
+  std::atomic<bool> stop = {false};
+  std::vector<uint64_t> lat(s_probes);
+  std::atomic<int> done = {0};
+  {
+    sylar::IOManager iom(s_threads, false, "prio");
+    sylar::Scheduler::Priority load_prio = mode == 1 ? sylar::Scheduler::LOW : sylar::Scheduler::NORMAL;
+    for(int i = 0; i < s_load; ++i)
+    {
+      iom.schedule([&stop]()
+      {
+        while(!stop)
+        {
+          busy_us(50);
+          sylar::Fiber::YieldToReady();
+        }
+      }, load_prio);
+    }
+    usleep(10 * 1000);
+    for(int i = 0; i < s_probes; ++i)
+    {
+      uint64_t begin = sylar::GetCurrentUS();
+      auto probe = [&lat, &done, i, begin]()
+      {
+        lat[i] = sylar::GetCurrentUS() - begin;
+        ++done;
+      };
+      if(mode == 1) iom.schedule(probe, sylar::Scheduler::HIGH);
+      else if(mode == 2) iom.schedule(probe, sylar::Scheduler::NORMAL, begin + 1000);
+      else iom.schedule(probe);
+      usleep(500);
+    }
+    while(done < s_probes)
+    {
+      usleep(1000);
+    }
+    stop = true;
+  }
+  std::sort(lat.begin(), lat.end());
+  return lat;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "t:l:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': s_threads = atoi(optarg); break;
+      case 'l': s_load = atoi(optarg); break;
+      case 'n': s_probes = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_order();
+  test_starvation();
+
+  std::cout << "probe latency under saturated load: threads=" << s_threads << " load tasks=" << s_load
+    << " probes=" << s_probes << std::endl;
+  const char* names[] = {"FIFO (all NORMAL):       ", "HIGH probe / LOW load:   ", "EDF within NORMAL:       "};
+  for(int mode = 0; mode < 3; ++mode)
+  {
+    std::vector<uint64_t> lat = bench_latency(mode);
+    std::cout << "  " << names[mode] << "p50=" << lat[lat.size() / 2] << "us p99=" << lat[lat.size() * 99 / 100]
+      << "us max=" << lat.back() << "us" << std::endl;
+  }
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
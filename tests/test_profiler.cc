@@ -0,0 +1,204 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 16:55:40
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 16:55:40
+ * @FilePath: /sylar-wxb/tests/test_profiler.cc
+ * @Description: 采样cpu分析测试：两种协程入口按耗时归类，折叠栈格式，以及通过HTTP按需采样
+ *   -o 折叠栈输出文件
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "profiler.h"
+#include "util.h"
+#include "http/http_connection.h"
+#include "http/http_server.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_port = 0;
+static std::string s_output;
+static std::atomic<bool> s_stop = {false};
+static volatile uint64_t s_sink = 0;
+
+/**
+ * @brief 占用cpu约ms毫秒(按进程cpu时间，不受其他线程影响)
+ */
+void spin(uint64_t ms)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  uint64_t end = ts.tv_sec * 1000000000ull + ts.tv_nsec + ms * 1000000;
+  do
+  {
+    for(int i = 0; i < 1000; ++i) s_sink += i * i;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  } while(ts.tv_sec * 1000000000ull + ts.tv_nsec < end);
+}
+
+/**
+ * @brief 普通函数入口，每轮占用2ms cpu
+ * @details 不能是static，-rdynamic只导出全局符号
+ */
+void light_task()
+{
+  while(!s_stop)
+  {
+    spin(2);
+    usleep(100);
+  }
+}
+
+void test_entries()
+{
+  s_stop = false;
+  sylar::IOManager iom(1, false, "prof");
+  // lambda入口每轮占用3ms cpu，两个入口各两个协程，lambda应占约60%的样本
+  for(int i = 0; i < 2; ++i)
+  {
+    iom.schedule([]()
+    {
+      while(!s_stop)
+      {
+        spin(3);
+        usleep(100);
+      }
+    });
+  }
+  iom.schedule(&light_task);
+  iom.schedule(&light_task);
+
+  SYLAR_ASSERT(sylar::CpuProfiler::Start(250));
+  SYLAR_ASSERT(!sylar::CpuProfiler::Start());
+  usleep(1500 * 1000);
+  sylar::CpuProfiler::Stop();
+  s_stop = true;
+  iom.stop();
+
+  std::stringstream top;
+  sylar::CpuProfiler::WriteTop(top);
+  std::cout << top.str();
+  std::stringstream folded;
+  sylar::CpuProfiler::WriteFolded(folded);
+  std::cout << folded.str();
+  SYLAR_LOG_INFO(g_logger) << "samples=" << sylar::CpuProfiler::GetSampleCount()
+    << " dropped=" << sylar::CpuProfiler::GetDropCount();
+  SYLAR_ASSERT(sylar::CpuProfiler::GetSampleCount() >= 50);
+
+  // 每行是 入口;外层;...;内层 数量，两个入口都出现且栈顶在spin里
+  uint64_t heavy = 0, light = 0;
+  std::string line;
+  while(std::getline(folded, line))
+  {
+    size_t sp = line.rfind(' ');
+    SYLAR_ASSERT(sp != std::string::npos);
+    uint64_t n = std::stoull(line.substr(sp + 1));
+    if(line.find("test_entries()::{lambda()#1}") == 0) heavy += n;
+    if(line.find("light_task()") == 0) light += n;
+  }
+  SYLAR_LOG_INFO(g_logger) << "heavy=" << heavy << " light=" << light;
+  SYLAR_ASSERT(heavy > light && light > 0);
+  SYLAR_ASSERT(folded.str().find("light_task();spin(unsigned long) ") != std::string::npos);
+
+  std::stringstream by_fiber;
+  sylar::CpuProfiler::WriteFolded(by_fiber, true);
+  SYLAR_ASSERT(by_fiber.str().find("test_entries()::{lambda()#1}#") != std::string::npos);
+  if(!s_output.empty())
+  {
+    SYLAR_ASSERT(sylar::CpuProfiler::DumpFolded(s_output));
+  }
+  SYLAR_LOG_INFO(g_logger) << "entries passed";
+}
+
+/**
+ * @brief 采样打断在协程切换中间时不能展开调用栈，否则unwinder会读到错误的返回地址崩溃
+ */
+void test_switching()
+{
+  s_stop = false;
+  {
+    sylar::IOManager iom(2, false, "prof_switch");
+    for(int i = 0; i < 8; ++i)
+    {
+      iom.schedule([]()
+      {
+        while(!s_stop)
+        {
+          sylar::Fiber::YieldToReady();
+        }
+      });
+    }
+    SYLAR_ASSERT(sylar::CpuProfiler::Start(1000));
+    usleep(3000 * 1000);
+    sylar::CpuProfiler::Stop();
+    s_stop = true;
+  }
+  std::stringstream folded;
+  sylar::CpuProfiler::WriteFolded(folded);
+  SYLAR_LOG_INFO(g_logger) << "switching samples=" << sylar::CpuProfiler::GetSampleCount();
+  SYLAR_ASSERT(sylar::CpuProfiler::GetSampleCount() >= 100);
+  SYLAR_LOG_INFO(g_logger) << "switching passed";
+}
+
+void test_servlet()
+{
+  s_stop = false;
+  std::atomic<bool> done = {false};
+  sylar::IOManager iom(2, false, "prof_http");
+  sylar::http::HttpServer::ptr server(new sylar::http::HttpServer(true, &iom, &iom));
+  server->setRecvTimeout(5000);
+  server->getServletDispatch()->addServlet("/profile", std::make_shared<sylar::http::ProfilerServlet>(2));
+  // 绑定临时端口，多个实例可以同时运行
+  SYLAR_ASSERT(server->bind(sylar::Address::LookupAny("127.0.0.1:0")));
+  s_port = std::dynamic_pointer_cast<sylar::IPAddress>(server->getSocks()[0]->getLocalAddress())->getPort();
+  SYLAR_ASSERT(s_port > 0);
+  server->start();
+  iom.schedule(&light_task);
+
+  iom.schedule([&done]()
+  {
+    sylar::http::HttpConnectionPool::ptr pool(new sylar::http::HttpConnectionPool("127.0.0.1", s_port, 2, 30 * 1000, 100));
+    // 采样进行中再次请求返回503
+    SYLAR_ASSERT(sylar::CpuProfiler::Start());
+    auto busy = pool->doGet("/profile?seconds=1", 3000);
+    SYLAR_ASSERT(busy->result == 0 && busy->response->getStatus() == sylar::http::HttpStatus::SERVICE_UNAVAILABLE);
+    sylar::CpuProfiler::Stop();
+
+    auto r = pool->doGet("/profile?seconds=1&format=top", 3000);
+    SYLAR_ASSERT(r->result == 0 && r->response->getStatus() == sylar::http::HttpStatus::OK);
+    SYLAR_LOG_INFO(g_logger) << "top:\n" << r->response->getBody();
+    SYLAR_ASSERT(r->response->getBody().find("light_task()") != std::string::npos);
+    done = true;
+  });
+  while(!done)
+  {
+    usleep(1000);
+  }
+  s_stop = true;
+  server->stop();
+  SYLAR_ASSERT(!sylar::CpuProfiler::IsRunning());
+  SYLAR_LOG_INFO(g_logger) << "servlet passed";
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "o:")) != -1)
+  {
+    if(opt == 'o') s_output = optarg;
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  test_entries();
+  test_switching();
+  test_servlet();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
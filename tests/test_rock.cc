@@ -0,0 +1,161 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 18:52:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 18:52:37
+ * @FilePath: /sylar-wxb/tests/test_rock.cc
+ * @Description: Rock RPC测试：超时、未知cmd，以及单连接N个协程并发请求的吞吐
+ *   用法: test_rock [-n 协程数] [-d 秒] [-p port]
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <atomic>
+#include <unistd.h>
+
+#include <google/protobuf/wrappers.pb.h>
+
+#include "log.h"
+#include "iomanager.h"
+#include "macro.h"
+#include "util.h"
+#include "rock/rock_server.h"
+#include "rock/rock_stream.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_fibers = 100;
+static int s_seconds = 3;
+static int s_port = 18062;
+
+static volatile bool s_running = true;
+static std::atomic<uint64_t> s_ok = {0};
+static std::atomic<uint64_t> s_fail = {0};
+static std::atomic<int> s_done = {0};
+
+enum Cmd
+{
+  CMD_ECHO = 100,
+  CMD_SLOW = 101,
+};
+
+sylar::RockServer::ptr start_server(sylar::IOManager* worker, sylar::IOManager* io)
+{
+  sylar::RockServer::ptr server(new sylar::RockServer(worker, io, io));
+  server->addHandler(CMD_ECHO, [](sylar::RockRequest::ptr req, sylar::RockResponse::ptr rsp,
+                                  sylar::RockStream::ptr stream)
+  {
+    auto v = req->getAsPB<google::protobuf::StringValue>();
+    if(!v)
+    {
+      return false;
+    }
+    return rsp->setAsPB(*v);
+  });
+  server->addHandler(CMD_SLOW, [](sylar::RockRequest::ptr req, sylar::RockResponse::ptr rsp,
+                                  sylar::RockStream::ptr stream)
+  {
+    usleep(200 * 1000);
+    return true;
+  });
+  SYLAR_ASSERT(server->bind(sylar::Address::LookupAny("127.0.0.1:" + std::to_string(s_port))));
+  server->start();
+  return server;
+}
+
+void test_basic(sylar::RockConnection::ptr conn)
+{
+  google::protobuf::StringValue v;
+  v.set_value("hello rock");
+  sylar::RockRequest::ptr req = std::make_shared<sylar::RockRequest>();
+  req->setCmd(CMD_ECHO);
+  req->setAsPB(v);
+  auto r = conn->request(req, 1000);
+  SYLAR_ASSERT(r->result == sylar::RockResult::OK && r->response->getResult() == 0);
+  SYLAR_ASSERT(r->response->getAsPB<google::protobuf::StringValue>()->value() == "hello rock");
+
+  req = std::make_shared<sylar::RockRequest>();
+  req->setCmd(CMD_SLOW);
+  r = conn->request(req, 50);
+  SYLAR_LOG_INFO(g_logger) << "slow request: " << r->toString();
+  SYLAR_ASSERT(r->result == sylar::RockResult::TIMEOUT);
+
+  req = std::make_shared<sylar::RockRequest>();
+  req->setCmd(999);
+  r = conn->request(req, 1000);
+  SYLAR_ASSERT(r->result == sylar::RockResult::OK && r->response->getResult() == 404);
+  SYLAR_LOG_INFO(g_logger) << "basic test passed";
+}
+
+void run_fiber(sylar::RockConnection::ptr conn, int id)
+{
+  google::protobuf::StringValue v;
+  v.set_value("fiber_" + std::to_string(id));
+  while(s_running)
+  {
+    sylar::RockRequest::ptr req = std::make_shared<sylar::RockRequest>();
+    req->setCmd(CMD_ECHO);
+    req->setAsPB(v);
+    auto r = conn->request(req, 1000);
+    if(r->result == sylar::RockResult::OK
+        && r->response->getAsPB<google::protobuf::StringValue>()->value() == v.value())
+    {
+      ++s_ok;
+    }
+    else
+    {
+      ++s_fail;
+    }
+  }
+  ++s_done;
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "n:d:p:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'n': s_fibers = atoi(optarg); break;
+      case 'd': s_seconds = atoi(optarg); break;
+      case 'p': s_port = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  sylar::IOManager server_io(1, false, "server_io");
+  sylar::IOManager server_worker(2, false, "server_worker");
+  auto server = start_server(&server_worker, &server_io);
+
+  sylar::IOManager client(2, false, "client");
+  sylar::RockConnection::ptr conn = std::make_shared<sylar::RockConnection>();
+  client.schedule([conn]()
+  {
+    SYLAR_ASSERT(conn->connect(sylar::Address::LookupAny("127.0.0.1:" + std::to_string(s_port))));
+    test_basic(conn);
+    for(int i = 0; i < s_fibers; ++i)
+    {
+      sylar::IOManager::GetThis()->schedule(std::bind(&run_fiber, conn, i));
+    }
+  });
+
+  sleep(1);
+  uint64_t begin = sylar::GetCurrentMS();
+  uint64_t ok_begin = s_ok;
+  sleep(s_seconds);
+  uint64_t used = sylar::GetCurrentMS() - begin;
+  uint64_t ok = s_ok - ok_begin;
+  s_running = false;
+  while(s_done < s_fibers)
+  {
+    usleep(1000);
+  }
+  std::cout << "rock bench: " << s_fibers << " fibers over 1 connection, " << used << "ms" << std::endl
+    << "  requests=" << ok << " fail=" << s_fail << " rps=" << ok * 1000.0 / used << std::endl;
+
+  // 在连接所在的IOManager中关闭，才能唤醒阻塞在recv上的读协程
+  client.schedule([conn]() { conn->close(); });
+  server->stop();
+  return 0;
+}
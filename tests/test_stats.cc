@@ -0,0 +1,178 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 15:48:30
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 15:48:30
+ * @FilePath: /sylar-wxb/tests/test_stats.cc
+ * @Description: 运行时统计测试：直方图分桶和百分位误差、分片计数器、调度器/io/定时器统计快照，以及写入开销
+ *   -t 线程数 -n 任务数
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fd_manager.h"
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "stats.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_threads = 2;
+static int s_tasks = 10000;
+
+void test_histogram()
+{
+  // 分桶连续且覆盖全部取值
+  for(size_t i = 0; i < sylar::LatencyHistogram::BUCKETS; ++i)
+  {
+    uint64_t lower = sylar::LatencyHistogram::BucketLower(i);
+    SYLAR_ASSERT(sylar::LatencyHistogram::BucketIndex(lower) == i);
+    SYLAR_ASSERT(sylar::LatencyHistogram::BucketIndex(sylar::LatencyHistogram::BucketUpper(i)) == i);
+    if(i) SYLAR_ASSERT(sylar::LatencyHistogram::BucketUpper(i - 1) + 1 == lower);
+  }
+  SYLAR_ASSERT(sylar::LatencyHistogram::BucketUpper(sylar::LatencyHistogram::BUCKETS - 1) == ~0ull);
+
+  sylar::LatencyHistogram h;
+  std::vector<uint64_t> values;
+  std::mt19937_64 rng(1);
+  std::lognormal_distribution<double> dist(5, 2);
+  for(int i = 0; i < 100000; ++i)
+  {
+    uint64_t v = (uint64_t)dist(rng);
+    values.push_back(v);
+    h.record(v);
+  }
+  std::sort(values.begin(), values.end());
+  sylar::LatencyHistogram::Snapshot s = h.snapshot();
+  SYLAR_ASSERT(s.count == values.size() && s.max == values.back());
+  for(double p : {50.0, 90.0, 99.0, 99.9})
+  {
+    uint64_t exact = values[(size_t)(p / 100 * values.size() + 0.5) - 1];
+    uint64_t est = s.percentile(p);
+    SYLAR_ASSERT(est >= exact && est <= exact + exact / 8 + 1);
+  }
+  SYLAR_LOG_INFO(g_logger) << "histogram passed";
+}
+
+void test_sharded()
+{
+  sylar::ShardedCounter counter;
+  sylar::LatencyHistogram h;
+  std::vector<sylar::Thread::ptr> thrs;
+  for(int i = 0; i < 8; ++i)
+  {
+    thrs.emplace_back(new sylar::Thread([&counter, &h]()
+    {
+      for(int j = 0; j < 100000; ++j)
+      {
+        counter.add();
+        h.record(j);
+      }
+    }, "stats_" + std::to_string(i)));
+  }
+  for(auto& i : thrs)
+  {
+    i->join();
+  }
+  SYLAR_ASSERT(counter.get() == 800000);
+  SYLAR_ASSERT(h.snapshot().count == 800000 && h.snapshot().max == 99999);
+
+  // 写入开销
+  const int N = 10000000;
+  uint64_t begin = sylar::GetCurrentUS();
+  for(int i = 0; i < N; ++i)
+  {
+    counter.add();
+  }
+  uint64_t mid = sylar::GetCurrentUS();
+  for(int i = 0; i < N; ++i)
+  {
+    h.record(i & 1023);
+  }
+  uint64_t end = sylar::GetCurrentUS();
+  std::cout << "ShardedCounter::add " << (mid - begin) * 1000.0 / N << "ns, LatencyHistogram::record "
+    << (end - mid) * 1000.0 / N << "ns" << std::endl;
+  SYLAR_LOG_INFO(g_logger) << "sharded passed";
+}
+
+void test_runtime()
+{
+  int fds[2];
+  SYLAR_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  sylar::FdMgr::GetInstance()->get(fds[0], true);
+  sylar::FdMgr::GetInstance()->get(fds[1], true);
+  std::atomic<int> done = {0};
+  {
+    sylar::IOManager iom(s_threads, false, "stats");
+    for(int i = 0; i < s_tasks; ++i)
+    {
+      iom.schedule([&done]()
+      {
+        sylar::Fiber::YieldToReady();
+        ++done;
+      });
+    }
+    for(int i = 0; i < 20; ++i)
+    {
+      iom.addTimerUs(500 * i, [&done]() { ++done;});
+    }
+    iom.schedule([&fds, &done]()
+    {
+      char c = 0;
+      for(int i = 0; i < 100; ++i)
+      {
+        SYLAR_ASSERT(write(fds[0], &c, 1) == 1);
+        SYLAR_ASSERT(read(fds[1], &c, 1) == 1);
+      }
+      ++done;
+    });
+    while(done < s_tasks + 21)
+    {
+      usleep(1000);
+    }
+
+    sylar::Scheduler::Stats s = iom.getStats();
+    SYLAR_ASSERT(s.threads == (size_t)s_threads);
+    // 每个任务入队两次(初次和让出)，定时器回调各一次
+    SYLAR_ASSERT(s.scheduled >= (uint64_t)s_tasks * 2 + 20);
+    SYLAR_ASSERT(s.switches >= (uint64_t)s_tasks * 2);
+    SYLAR_ASSERT(s.queueLatencyUs.count + s.queued >= s.scheduled - 200);
+    sylar::IOManager::IoStats io = iom.getIoStats();
+    SYLAR_ASSERT(io.eventsPerWakeup.count > 0);
+    sylar::TimerManager::TimerStats t = iom.getTimerStats();
+    SYLAR_ASSERT(t.expired == 20 && t.latenessUs.count == 20);
+    iom.dumpStats(std::cout);
+  }
+  close(fds[0]);
+  close(fds[1]);
+  SYLAR_LOG_INFO(g_logger) << "runtime passed";
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "t:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 't': s_threads = atoi(optarg); break;
+      case 'n': s_tasks = atoi(optarg); break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  test_histogram();
+  test_sharded();
+  test_runtime();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 10:40:11
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 10:40:11
+ * @FilePath: /sylar-wxb/tests/test_tcp_server.cc
+ * @Description: echo服务器吞吐量测试
+ *   用法: test_tcp_server [-c 连接数] [-d 秒] [-s 消息字节] [-r 开启reuseport] [-b accept批量] [-i 就地运行唤醒的协程] [-B 忙轮询微秒]
+ * 
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved. 
+ */
+#include <algorithm>
+#include <atomic>
+#include <unistd.h>
+
+#include "log.h"
+#include "iomanager.h"
+#include "tcp_server.h"
+#include "util.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_conns = 64;
+static int s_seconds = 3;
+static int s_size = 64;
+static bool s_reuseport = false;
+static int s_batch = 32;
+static int s_port = 18090;
+static bool s_inline = false;
+static int s_busy_poll = 0;
+
+static std::atomic<uint64_t> s_msgs = {0};
+static std::atomic<uint64_t> s_bytes = {0};
+static std::atomic<int> s_connected = {0};
+static volatile bool s_running = true;
+
+class EchoServer : public sylar::TcpServer
+{
+public:
+  EchoServer(sylar::IOManager* io_worker, sylar::IOManager* accept_worker)
+    : TcpServer(io_worker, accept_worker) {}
+
+protected:
+  void handleClient(sylar::Socket::ptr client) override
+  {
+    std::string buf;
+    buf.resize(4096);
+    while(true)
+    {
+      int rt = client->recv(&buf[0], buf.size());
+      if(rt <= 0)
+      {
+        break;
+      }
+      int off = 0;
+      while(off < rt)
+      {
+        int n = client->send(&buf[off], rt - off);
+        if(n <= 0)
+        {
+          client->close();
+          return;
+        }
+        off += n;
+      }
+    }
+    client->close();
+  }
+};
+
+void run_client(sylar::Address::ptr addr)
+{
+  sylar::Socket::ptr sock = sylar::Socket::CreateTCP(addr);
+  if(!sock->connect(addr))
+  {
+    SYLAR_LOG_ERROR(g_logger) << "connect " << *addr << " fail";
+    return;
+  }
+  ++s_connected;
+  std::string msg(s_size, 'x');
+  std::string buf(s_size, '\0');
+  while(s_running)
+  {
+    if(sock->send(&msg[0], msg.size()) != (int)msg.size())
+    {
+      break;
+    }
+    int got = 0;
+    while(got < s_size)
+    {
+      int n = sock->recv(&buf[got], s_size - got);
+      if(n <= 0)
+      {
+        sock->close();
+        return;
+      }
+      got += n;
+    }
+    ++s_msgs;
+    s_bytes += s_size;
+  }
+  sock->close();
+}
+
+int main(int argc, char** argv)
+{
+  int opt;
+  while((opt = getopt(argc, argv, "c:d:s:rb:p:iB:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'c': s_conns = atoi(optarg); break;
+      case 'd': s_seconds = atoi(optarg); break;
+      case 's': s_size = atoi(optarg); break;
+      case 'r': s_reuseport = true; break;
+      case 'b': s_batch = atoi(optarg); break;
+      case 'p': s_port = atoi(optarg); break;
+      case 'i': s_inline = true; break;
+      case 'B': s_busy_poll = atoi(optarg); break;
+      default: break;
+    }
+  }
+  g_logger->setLevel(sylar::LogLevel::WARN);
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+
+  sylar::Address::ptr addr = sylar::Address::LookupAny("127.0.0.1:" + std::to_string(s_port));
+  {
+    sylar::IOManager accept_worker(2, false, "accept");
+    sylar::IOManager io_worker(2, false, "io");
+    sylar::IOManager client_worker(2, false, "client");
+    io_worker.setInlineDispatch(s_inline, 64);
+    client_worker.setInlineDispatch(s_inline, 64);
+    io_worker.setBusyPoll(s_busy_poll, 0);
+
+    EchoServer::ptr server(new EchoServer(&io_worker, &accept_worker));
+    server->setReusePort(s_reuseport);
+    server->setAcceptBatch(s_batch);
+    if(!server->bind(addr))
+    {
+      return 1;
+    }
+    server->start();
+
+    uint64_t ctl_begin = io_worker.getEpollCtlCount() + client_worker.getEpollCtlCount();
+    uint64_t wait_begin = io_worker.getEpollWaitCount() + client_worker.getEpollWaitCount();
+    uint64_t begin = sylar::GetCurrentMS();
+    for(int i = 0; i < s_conns; ++i)
+    {
+      client_worker.schedule(std::bind(&run_client, addr));
+    }
+    sleep(s_seconds);
+    s_running = false;
+    uint64_t used = sylar::GetCurrentMS() - begin;
+    uint64_t ctls = io_worker.getEpollCtlCount() + client_worker.getEpollCtlCount() - ctl_begin;
+    uint64_t waits = io_worker.getEpollWaitCount() + client_worker.getEpollWaitCount() - wait_begin;
+
+    std::cout << "echo bench: conns=" << s_connected << "/" << s_conns
+      << " msg_size=" << s_size << " reuseport=" << s_reuseport
+      << " accept_batch=" << s_batch << " inline=" << s_inline << " time=" << used << "ms" << std::endl
+      << "  msgs=" << s_msgs << " qps=" << (s_msgs * 1000.0 / used)
+      << " throughput=" << (s_bytes * 1000.0 / used / 1024 / 1024) << "MB/s" << std::endl
+      << "  epoll_ctl=" << ctls << " (" << (ctls * 1.0 / std::max<uint64_t>(s_msgs, 1)) << "/msg)"
+      << " epoll_wait=" << waits << " (" << (waits * 1.0 / std::max<uint64_t>(s_msgs, 1)) << "/msg)"
+      << " inline=" << (io_worker.getInlineCount() + client_worker.getInlineCount()) << std::endl;
+    if(s_busy_poll)
+    {
+      io_worker.dumpIdleStats(std::cout);
+    }
+
+    sleep(1);
+    server->stop();
+  }
+  return 0;
+}
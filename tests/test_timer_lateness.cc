@@ -0,0 +1,107 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 10:24:37
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 10:24:37
+ * @FilePath: /sylar-wxb/tests/test_timer_lateness.cc
+ * @Description: 微秒定时器唤醒精度测试，统计实际触发时间比预期晚多少(p50/p99)
+ *   -n 次数 -d 定时间隔(微秒) -t 使用timerfd代替epoll_pwait2 -s 用usleep代替定时器
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+
+#include "config.h"
+#include "log.h"
+#include "macro.h"
+#include "iomanager.h"
+#include "util.h"
+
+static int s_count = 20000;
+static uint64_t s_delay_us = 100;
+static bool s_sleep = false;
+
+static std::vector<uint64_t> s_lateness;
+static uint64_t s_expect = 0;
+
+/**
+ * @brief 定时器链：每次回调记录延迟后再加下一个定时器
+ */
+static void on_timer()
+{
+  uint64_t now = sylar::GetCurrentUS();
+  s_lateness.push_back(now - s_expect);
+  if((int)s_lateness.size() >= s_count)
+  {
+    return;
+  }
+  s_expect = sylar::GetCurrentUS() + s_delay_us;
+  sylar::IOManager::GetThis()->addTimerUs(s_delay_us, on_timer);
+}
+
+/**
+ * @brief 协程中循环usleep(hook后走定时器)
+ */
+static void run_sleep()
+{
+  for(int i = 0; i < s_count; ++i)
+  {
+    uint64_t begin = sylar::GetCurrentUS();
+    usleep(s_delay_us);
+    s_lateness.push_back(sylar::GetCurrentUS() - begin - s_delay_us);
+  }
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& v, double p)
+{
+  return v[std::min(v.size() - 1, (size_t)(v.size() * p))];
+}
+
+int main(int argc, char** argv)
+{
+  bool timerfd = false;
+  int opt;
+  while((opt = getopt(argc, argv, "n:d:ts")) != -1)
+  {
+    switch(opt)
+    {
+      case 'n': s_count = atoi(optarg); break;
+      case 'd': s_delay_us = atoi(optarg); break;
+      case 't': timerfd = true; break;
+      case 's': s_sleep = true; break;
+      default: break;
+    }
+  }
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+  sylar::Config::Lookup<bool>("iomanager.epoll_pwait2")->setValue(!timerfd);
+  s_lateness.reserve(s_count);
+
+  bool pwait2 = false;
+  {
+    sylar::IOManager iom(1, false, "timer");
+    pwait2 = iom.isEpollPwait2();
+    if(s_sleep)
+    {
+      iom.schedule(run_sleep);
+    }
+    else
+    {
+      iom.schedule([]()
+      {
+        s_expect = sylar::GetCurrentUS() + s_delay_us;
+        sylar::IOManager::GetThis()->addTimerUs(s_delay_us, on_timer);
+      });
+    }
+  }
+
+  SYLAR_ASSERT((int)s_lateness.size() == s_count);
+  std::sort(s_lateness.begin(), s_lateness.end());
+  std::cout << "timer lateness: backend=" << (pwait2 ? "epoll_pwait2" : "timerfd")
+    << " mode=" << (s_sleep ? "usleep" : "timer") << " delay=" << s_delay_us << "us count=" << s_count
+    << std::endl << "  p50=" << percentile(s_lateness, 0.5) << "us p90=" << percentile(s_lateness, 0.9)
+    << "us p99=" << percentile(s_lateness, 0.99) << "us max=" << s_lateness.back() << "us" << std::endl;
+  return 0;
+}
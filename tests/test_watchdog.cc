@@ -0,0 +1,146 @@
+/*
+ * @Author: Xiabing
+ * @Date: 2026-10-19 17:30:10
+ * @LastEditors: Xiabing
+ * @LastEditTime: 2026-10-19 17:30:10
+ * @FilePath: /sylar-wxb/tests/test_watchdog.cc
+ * @Description: 卡顿检测测试：阻塞协程被发现并取到其id和调用栈，报告限频，正常让出的协程不计入
+ *
+ * Copyright (c) 2024 by Xiabing, All Rights Reserved.
+ */
+#include <atomic>
+#include <unistd.h>
+
+#include "config.h"
+#include "iomanager.h"
+#include "log.h"
+#include "macro.h"
+#include "metrics.h"
+#include "util.h"
+#include "watchdog.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static sylar::Mutex s_mutex;
+static std::vector<sylar::StallWatchdog::Report> s_reports;
+
+/**
+ * @brief 不经过hook的阻塞，占住调度线程ms毫秒
+ * @details 不能是static，-rdynamic只导出全局符号
+ */
+void blocking_work(uint64_t ms)
+{
+  uint64_t end = sylar::GetCurrentMS() + ms;
+  while(sylar::GetCurrentMS() < end);
+}
+
+static void on_report(const sylar::StallWatchdog::Report& r)
+{
+  sylar::Mutex::Lock lock(s_mutex);
+  s_reports.push_back(r);
+}
+
+static size_t report_count()
+{
+  sylar::Mutex::Lock lock(s_mutex);
+  return s_reports.size();
+}
+
+static void wait_for(std::atomic<bool>& flag)
+{
+  while(!flag)
+  {
+    usleep(1000);
+  }
+}
+
+void test_watchdog()
+{
+  sylar::Config::Lookup<uint64_t>("scheduler.stall_threshold_ms")->setValue(50);
+  sylar::Config::Lookup<uint64_t>("scheduler.stall_report_interval_ms")->setValue(500);
+  sylar::StallWatchdogMgr::GetInstance()->setCallback(&on_report);
+
+  sylar::IOManager iom(2, false, "wd");
+  std::atomic<bool> done = {false};
+  std::atomic<bool> healthy_done = {false};
+  std::atomic<uint64_t> fiber_id = {0};
+
+  // 正常协程每次都在hook里让出，不应计入卡顿
+  iom.schedule([&healthy_done]()
+  {
+    for(int i = 0; i < 40; ++i) usleep(10 * 1000);
+    healthy_done = true;
+  });
+  // 两次阻塞在同一个限频周期内，只报告第一次
+  iom.schedule([&done, &fiber_id]()
+  {
+    fiber_id = sylar::Fiber::GetFiberId();
+    blocking_work(200);
+    sylar::Fiber::YieldToReady();
+    blocking_work(200);
+    done = true;
+  });
+  wait_for(done);
+  wait_for(healthy_done);
+
+  sylar::Scheduler::Stats stats = iom.getStats();
+  SYLAR_LOG_INFO(g_logger) << "stalls=" << stats.stalls << " reports=" << report_count();
+  SYLAR_ASSERT(stats.stalls == 2);
+  SYLAR_ASSERT(report_count() == 1);
+  {
+    sylar::Mutex::Lock lock(s_mutex);
+    const sylar::StallWatchdog::Report& r = s_reports[0];
+    SYLAR_LOG_INFO(g_logger) << "fiber_id=" << r.fiberId << " stalled_ms=" << r.stalledMs
+      << " thread=" << r.thread << "\n" << r.backtrace;
+    SYLAR_ASSERT(r.scheduler == "wd" && r.fiberId == fiber_id && r.stalledMs >= 50 && r.suppressed == 0);
+    SYLAR_ASSERT(r.backtrace.find("blocking_work") != std::string::npos);
+  }
+
+  // 过了限频周期，下一次报告带上被略过的次数
+  usleep(600 * 1000);
+  // 回调在锁外执行，回调里可以重新设置回调
+  sylar::StallWatchdogMgr::GetInstance()->setCallback([](const sylar::StallWatchdog::Report& r)
+  {
+    on_report(r);
+    sylar::StallWatchdogMgr::GetInstance()->setCallback(&on_report);
+  });
+  done = false;
+  iom.schedule([&done]()
+  {
+    blocking_work(150);
+    done = true;
+  });
+  wait_for(done);
+  usleep(50 * 1000);
+  SYLAR_ASSERT(report_count() == 2);
+  {
+    sylar::Mutex::Lock lock(s_mutex);
+    SYLAR_ASSERT(s_reports[1].suppressed == 1);
+  }
+
+  sylar::MetricsRegistry reg;
+  reg.addScheduler(&iom);
+  std::string text = reg.toPrometheus();
+  SYLAR_ASSERT(text.find("sylar_scheduler_stalls_total{scheduler=\"wd\"} 3\n") != std::string::npos);
+  reg.removeScheduler(&iom);
+
+  // 关闭后不再检测
+  sylar::Config::Lookup<uint64_t>("scheduler.stall_threshold_ms")->setValue(0);
+  done = false;
+  iom.schedule([&done]()
+  {
+    blocking_work(150);
+    done = true;
+  });
+  wait_for(done);
+  SYLAR_ASSERT(iom.getStats().stalls == 3);
+  SYLAR_LOG_INFO(g_logger) << "watchdog passed";
+}
+
+int main(int argc, char** argv)
+{
+  SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::INFO);
+  test_watchdog();
+  SYLAR_LOG_INFO(g_logger) << "all passed";
+  return 0;
+}
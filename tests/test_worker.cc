@@ -0,0 +1,112 @@
+#include <atomic>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "log.h"
+#include "macro.h"
+#include "worker.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_count = {0};
+
+void test_cross_pool()
+{
+  // accept -> worker -> io
+  sylar::WorkerMgr::GetInstance()->schedule("accept", []()
+  {
+    SYLAR_LOG_INFO(g_logger) << "on accept";
+    sylar::WorkerMgr::GetInstance()->schedule("worker", []()
+    {
+      SYLAR_LOG_INFO(g_logger) << "on worker";
+      sylar::WorkerMgr::GetInstance()->schedule("io", []()
+      {
+        SYLAR_LOG_INFO(g_logger) << "on io";
+        ++s_count;
+      });
+    });
+  });
+}
+
+void test_batch()
+{
+  std::vector<std::function<void()>> cbs;
+  for (int i = 0; i < 10000; ++i)
+  {
+    cbs.push_back([](){ ++s_count; });
+  }
+  uint64_t b = sylar::GetCurrentMS();
+  sylar::WorkerMgr::GetInstance()->schedule("worker", cbs.begin(), cbs.end());
+  while (s_count < 10001)
+  {
+    usleep(1000);
+  }
+  SYLAR_LOG_INFO(g_logger) << "batch 10000 tasks done, used " << sylar::GetCurrentMS() - b << "ms";
+}
+
+void test_affinity()
+{
+  std::map<std::string, std::map<std::string, std::string>> conf;
+  conf["pinned"]["thread_num"] = "2";
+  conf["pinned"]["cpus"] = "0";
+  conf["numa"]["thread_num"] = "2";
+  conf["numa"]["numa_node"] = "0";
+  conf["numa"]["pin_threads"] = "true";
+  sylar::WorkerMgr::GetInstance()->init(conf);
+  // 每个线程都要在启动时就绑定好cpu
+  sylar::Scheduler::ptr pinned = sylar::WorkerMgr::GetInstance()->get("pinned");
+  std::vector<int> threads = pinned->getThreadIds();
+  SYLAR_ASSERT(threads.size() == 2);
+  for (auto id : threads)
+  {
+    pinned->schedule([id]()
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      sched_getaffinity(0, sizeof(set), &set);
+      SYLAR_LOG_INFO(g_logger) << "pinned thread=" << id << " cpu_count=" << CPU_COUNT(&set) << " cpu0=" << CPU_ISSET(0, &set);
+      SYLAR_ASSERT(sylar::GetThreadId() == id);
+      SYLAR_ASSERT(CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set));
+      ++s_count;
+    }, id);
+  }
+  sylar::WorkerMgr::GetInstance()->schedule("numa", []()
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+    int mode = -1;
+    unsigned long mask = 0;
+    syscall(SYS_get_mempolicy, &mode, &mask, sizeof(mask) * 8, nullptr, 0);
+    int cpu = sched_getcpu();
+    SYLAR_LOG_INFO(g_logger) << "numa nodes=" << sylar::Thread::GetNumaNodeCount()
+      << " node0 cpus=" << sylar::Thread::GetNumaNodeCpus(0).size()
+      << " cpu_count=" << CPU_COUNT(&set) << " cpu=" << cpu << " cpu_node=" << sylar::Thread::GetCpuNumaNode(cpu)
+      << " mempolicy=" << mode << " mask=" << mask << " thread_node=" << sylar::Thread::GetThis()->getNumaNode();
+    SYLAR_ASSERT(CPU_COUNT(&set) == 1 && sylar::Thread::GetCpuNumaNode(cpu) == 0);
+    SYLAR_ASSERT(mode == MPOL_PREFERRED && mask == 1 && sylar::Thread::GetThis()->getNumaNode() == 0);
+    ++s_count;
+  });
+}
+
+int main(int argc, char** argv)
+{
+  YAML::Node root = YAML::LoadFile(std::string(PROJECT_DIR) + "config/worker.yml");
+  sylar::Config::LoadFromYaml(root);
+  sylar::WorkerMgr::GetInstance()->init();
+  sylar::WorkerMgr::GetInstance()->dump(std::cout);
+
+  test_cross_pool();
+  test_batch();
+  test_affinity();
+  while (s_count < 10004)
+  {
+    usleep(1000);
+  }
+  sylar::WorkerMgr::GetInstance()->stop();
+  SYLAR_LOG_INFO(g_logger) << "count=" << s_count;
+  return 0;
+}